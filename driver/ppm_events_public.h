@@ -134,6 +134,8 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #define PPM_CL_ACTIVE (1 << 19)			/* libsinsp-specific flag. Set in the first non-clone event for
 										   this thread. */
 #define PPM_CL_CLONE_NEWUSER (1 << 20)
+#define PPM_CL_FDS_NOT_LOADED (1 << 21)	/* libsinsp-specific flag. Set for processes found in /proc */
+										/* whose fd table hasn't been scanned yet. */
 
 /*
  * Futex Operations
@@ -0,0 +1,633 @@
+#!/bin/bash
+#
+# This script runs the sysdig and csysdig benchmarks and output checks on all
+# the trace files (i.e. all the files with scap extension) in a directory.
+# The tests that take a reference build check that the two builds print the
+# same thing, and report the time of both.
+#
+# Usage:
+#  ./sysdig_benchmark.sh [options] test traces_directory
+#
+# Options:
+#  -s path   sysdig build to test (default ../build/userspace/sysdig/sysdig)
+#  -c path   csysdig build to test (default: csysdig next to the sysdig one)
+#  -r path   reference sysdig build
+#  -R path   reference csysdig build (default: csysdig next to the reference
+#            sysdig)
+#  -a args   test specific arguments, see below
+#
+# Tests:
+#  output       throughput of the formatted output, with the default buffered
+#               output and with --unbuffered. -a adds sysdig arguments, e.g.
+#               "-pc" or "-j".
+#  json         checks that the JSON output is valid, that it has one object
+#               per line of the text output, with the same values for -p
+#               formats, and that it's byte for byte the same as the one of
+#               the reference build. Reports the JSON and text throughput.
+#  compression  rewrites every trace with every compression mode, checks that
+#               the result decodes to the same events, and reports sizes and
+#               write/read times.
+#  chisel       runs table chisels with both builds and compares their
+#               output. -a is a ';' separated list of chisels with their
+#               arguments (default "topfiles_bytes;topprocs_file;topprocs_net;
+#               fdbytes_by proc.name"). spy_users and httptop read several
+#               fields for every event and stress the field extraction.
+#  view         runs csysdig views in raw mode with both builds and compares
+#               the tables. -a is the list of views (default "procs files
+#               connections directories").
+#  render       reports the bytes csysdig sends to the terminal on every
+#               refresh, with incremental and full rendering. The screen size
+#               comes from LINES and COLUMNS (default 80x24). -a is the list
+#               of views (default "procs files connections").
+#  sketch       checks the approximate DISTINCT and percentile view
+#               aggregations against the exact values computed from the sysdig
+#               output, within the error bounds of the sketches.
+#
+# Rows with the same value in the sorting column of a table can be printed in
+# any order, so the tables are compared after sorting their lines (see
+# compare_builds() below).
+#
+# Examples:
+#  ./sysdig_benchmark.sh -a "-j" output traces
+#  ./sysdig_benchmark.sh -r /usr/bin/sysdig json traces
+#  ./sysdig_benchmark.sh -r /usr/bin/sysdig -a "spy_users;httptop" chisel traces
+#  LINES=50 COLUMNS=200 ./sysdig_benchmark.sh render traces
+#
+set -eu
+
+SYSDIG=../build/userspace/sysdig/sysdig
+CSYSDIG=
+REFERENCE=
+CREFERENCE=
+ARGS=
+ARGS_SET=0
+
+while getopts "s:c:r:R:a:" opt
+do
+	case $opt in
+	s) SYSDIG=$OPTARG ;;
+	c) CSYSDIG=$OPTARG ;;
+	r) REFERENCE=$OPTARG ;;
+	R) CREFERENCE=$OPTARG ;;
+	a) ARGS=$OPTARG; ARGS_SET=1 ;;
+	*) exit 1 ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 2 ]; then
+	echo "usage: $0 [-s sysdig] [-c csysdig] [-r reference sysdig] [-R reference csysdig] [-a args] test traces_directory"
+	exit 1
+fi
+
+TEST=$1
+TRACESDIR=$2
+CSYSDIG=${CSYSDIG:-$(dirname $SYSDIG)/csysdig}
+if [ -n "$REFERENCE" ]; then
+	CREFERENCE=${CREFERENCE:-$(dirname $REFERENCE)/csysdig}
+fi
+
+TMPDIR=$(mktemp -d)
+trap "rm -rf $TMPDIR" EXIT
+
+ret=0
+
+now()
+{
+	date +%s.%N
+}
+
+elapsed()
+{
+	awk "BEGIN { print $2 - $1 }"
+}
+
+need_reference()
+{
+	if [ -z "$REFERENCE" ]; then
+		echo "the $TEST test needs a reference build (-r)"
+		exit 1
+	fi
+}
+
+#
+# The chisels and views of a build directory are in its chisels subdirectory.
+# They are searched before the installed ones, so that each build runs its own.
+#
+chisel_dir()
+{
+	echo $(dirname $1)/chisels
+}
+
+#
+# Print the seconds and, when GNU time is available, the peak memory (KB)
+# taken by a sysdig or csysdig command line, discarding its output
+#
+measure()
+{
+	export SYSDIG_CHISEL_DIR=$(chisel_dir $1)
+
+	if [ -x /usr/bin/time ]; then
+		/usr/bin/time -f "%e %M" "$@" 2>&1 >/dev/null | tail -1
+	else
+		local start=$(now)
+		"$@" > /dev/null 2>&1
+		echo "$(elapsed $start $(now)) -"
+	fi
+
+	unset SYSDIG_CHISEL_DIR
+}
+
+#
+# Run the same arguments with the build and with the reference, and compare
+# their output. $1 is the label of the difference, $2 is how to compare:
+#  - exact: byte for byte
+#  - sort: after sorting the lines, for tables where the rows with the same
+#    value in the sorting column can be printed in any order
+#  - top: like sort, for the top N tables of the chisels, sorted by their first
+#    column, where the two builds can also pick different rows among the ones
+#    that have the same value as the last one. Those rows only need to be as
+#    many in both. Outputs without a table header line are compared like sort.
+# $3 and $4 are the build and the reference, the rest are the arguments. Both
+# runs must succeed, so that two builds failing the same way (e.g. not finding
+# a view) don't pass.
+#
+compare_builds()
+{
+	local label=$1
+	local how=$2
+	local build=$3
+	local reference=$4
+	shift 4
+
+	if ! SYSDIG_CHISEL_DIR=$(chisel_dir $build) "$build" "$@" > $TMPDIR/new 2>&1 ||
+		! SYSDIG_CHISEL_DIR=$(chisel_dir $reference) "$reference" "$@" > $TMPDIR/reference 2>&1; then
+		echo "$label: $(tail -n 1 $TMPDIR/new) / $(tail -n 1 $TMPDIR/reference)"
+		ret=1
+		return
+	fi
+
+	if [ "$how" = top ]; then
+		for out in $TMPDIR/new $TMPDIR/reference
+		do
+			awk 'FNR == NR { if(/^-+$/) table = 1; if(NF) last = $1; next }
+				table && $1 == last && NF > 1 { $0 = $1 " <tie>" }
+				{ print }' $out $out > $out.top
+			mv $out.top $out
+		done
+	fi
+
+	if [ "$how" != exact ]; then
+		sort -o $TMPDIR/new $TMPDIR/new
+		sort -o $TMPDIR/reference $TMPDIR/reference
+	fi
+
+	if ! cmp -s $TMPDIR/new $TMPDIR/reference; then
+		echo "$label differs from the reference"
+		ret=1
+	fi
+}
+
+test_output()
+{
+	printf "%-40s %-14s %10s %10s %12s\n" trace mode lines seconds lines/s
+
+	for f in $TRACESDIR/*.scap
+	do
+		for MODE in buffered unbuffered
+		do
+			if [ $MODE = buffered ]; then
+				OPTS=""
+			else
+				OPTS="--unbuffered"
+			fi
+
+			START=$(now)
+			LINES=$($SYSDIG -r $f $ARGS $OPTS | cat | wc -l)
+			END=$(now)
+
+			awk -v t=$(basename $f) -v m=$MODE -v l=$LINES -v s=$START -v e=$END \
+				'BEGIN { printf "%-40s %-14s %10d %10.3f %12.0f\n", t, m, l, e - s, l / (e - s) }'
+		done
+	done
+}
+
+#
+# Check that a -j output is a valid JSON array with one object per line of the
+# text output (-A and -X print the buffers on several lines, so only the
+# validity is checked for them). For -p formats, also check that the object
+# members have the values printed in the text line. Multi word values can't
+# be split from the text line, so only the lines made of single word values
+# are compared, and numbers are compared only when the text output prints
+# them as numbers too (e.g. evt.time is a timestamp in JSON and a time of the
+# day in the text output).
+#
+check_json()
+{
+	python3 - "$1" "$2" "$3" <<'EOF'
+import json, sys
+
+jsonfile, textfile, fmt = sys.argv[1:4]
+
+try:
+	objs = json.load(open(jsonfile))
+except ValueError as e:
+	print("invalid JSON: %s" % e)
+	sys.exit(1)
+
+if fmt in ("-A", "-X"):
+	sys.exit(0)
+
+lines = open(textfile).read().splitlines()
+if len(objs) != len(lines):
+	print("%d JSON objects for %d text lines" % (len(objs), len(lines)))
+	sys.exit(1)
+
+if not fmt.startswith("-p"):
+	sys.exit(0)
+
+fields = [t[1:] for t in fmt[2:].lstrip("*").split()]
+for obj, line in zip(objs, lines):
+	vals = line.split(" ")
+	if len(vals) != len(fields):
+		continue
+	for field, val in zip(fields, vals):
+		jval = obj.get(field)
+		if jval is None:
+			ok = (val == "<NA>")
+		elif isinstance(jval, bool):
+			ok = (val == str(jval).lower())
+		elif isinstance(jval, (int, float)) and not val.lstrip("-").replace(".", "", 1).isdigit():
+			ok = True
+		else:
+			ok = (str(jval) == val)
+		if not ok:
+			print("%s is %s in the JSON output and %s in the text output" % (field, jval, val))
+			sys.exit(1)
+EOF
+}
+
+test_json()
+{
+	need_reference
+
+	for f in $TRACESDIR/*.scap
+	do
+		for OPTS in "" "-pc" "-A" "-X" "-b" \
+			"-p*%evt.num %evt.rawtime %evt.latency %evt.count %evt.type %proc.name %fd.num %fd.name" \
+			"-p*%evt.num %evt.time %evt.type %evt.args" \
+			"-p%evt.num %proc.name %fd.name %fd.num %evt.buffer %user.name %evt.num"
+		do
+			TZ=UTC $SYSDIG -r $f -j ${OPTS:+"$OPTS"} > $TMPDIR/json
+			TZ=UTC $SYSDIG -r $f ${OPTS:+"$OPTS"} > $TMPDIR/text
+
+			if ! check_json $TMPDIR/json $TMPDIR/text "$OPTS"; then
+				echo "$(basename $f): wrong JSON output for \"-j $OPTS\""
+				ret=1
+			fi
+
+			TZ=UTC compare_builds "$(basename $f): output of \"-j $OPTS\"" exact $SYSDIG $REFERENCE -r $f -j ${OPTS:+"$OPTS"}
+		done
+	done
+
+	printf "%-40s %-10s %-6s %10s %12s\n" trace build output lines lines/s
+
+	for f in $TRACESDIR/*.scap
+	do
+		for BUILD in $REFERENCE $SYSDIG
+		do
+			for OPTS in "" "-j"
+			do
+				START=$(now)
+				LINES=$($BUILD -r $f $OPTS | wc -l)
+				END=$(now)
+
+				if [ "$BUILD" = "$SYSDIG" ]; then
+					B=new
+				else
+					B=reference
+				fi
+
+				awk -v t=$(basename $f) -v b=$B -v o=${OPTS:-text} -v l=$LINES -v s=$START -v e=$END \
+					'BEGIN { printf "%-40s %-10s %-6s %10d %12.0f\n", t, b, o, l, l / (e - s) }'
+			done
+		done
+	done
+}
+
+test_compression()
+{
+	FORMAT="%evt.num %evt.time %evt.cpu %proc.name %thread.tid %evt.dir %evt.type %evt.args %fd.name"
+
+	printf "%-40s %-10s %12s %8s %10s %10s\n" trace mode bytes ratio write_s read_s
+
+	for f in $TRACESDIR/*.scap
+	do
+		SIZE=$(stat -L -c %s $f)
+		EXPECTED=$($SYSDIG -r $f -p"$FORMAT" | md5sum)
+
+		for MODE in none gzip events lz
+		do
+			OUT=$TMPDIR/$MODE.scap
+
+			if [ $MODE = none ]; then
+				OPTS=""
+			else
+				OPTS="--compression=$MODE"
+			fi
+
+			START=$(now)
+			$SYSDIG -r $f -w $OUT $OPTS
+			WRITE=$(elapsed $START $(now))
+
+			START=$(now)
+			$SYSDIG -r $OUT "evt.num=0"
+			READ=$(elapsed $START $(now))
+
+			if [ "$($SYSDIG -r $OUT -p"$FORMAT" | md5sum)" != "$EXPECTED" ]; then
+				echo "$(basename $f): $MODE round trip mismatch"
+				ret=1
+			fi
+
+			OUTSIZE=$(stat -c %s $OUT)
+			printf "%-40s %-10s %12d %8.2f %10.3f %10.3f\n" $(basename $f) $MODE $OUTSIZE $(awk "BEGIN { print $SIZE / $OUTSIZE }") $WRITE $READ
+		done
+	done
+}
+
+test_chisel()
+{
+	need_reference
+
+	if [ $ARGS_SET = 0 ]; then
+		ARGS="topfiles_bytes;topprocs_file;topprocs_net;fdbytes_by proc.name"
+	fi
+
+	IFS=';' read -ra CHISEL_LIST <<< "$ARGS"
+
+	printf "%-40s %-24s %-10s %10s %12s\n" trace chisel build seconds "max RSS(KB)"
+
+	for f in $TRACESDIR/*.scap
+	do
+		for CHISEL in "${CHISEL_LIST[@]}"
+		do
+			compare_builds "$(basename $f): output of $CHISEL" top $SYSDIG $REFERENCE -r $f -c $CHISEL
+
+			for BUILD in $REFERENCE $SYSDIG
+			do
+				if [ "$BUILD" = "$SYSDIG" ]; then
+					B=new
+				else
+					B=reference
+				fi
+
+				printf "%-40s %-24s %-10s %10s %12s\n" $(basename $f) "$CHISEL" $B $(measure $BUILD -r $f -c $CHISEL)
+			done
+		done
+	done
+}
+
+test_view()
+{
+	need_reference
+
+	if [ $ARGS_SET = 0 ]; then
+		ARGS="procs files connections directories"
+	fi
+
+	printf "%-40s %-12s %-10s %10s %12s\n" trace view build seconds "max RSS(KB)"
+
+	for f in $TRACESDIR/*.scap
+	do
+		for VIEW in $ARGS
+		do
+			compare_builds "$(basename $f): output of the $VIEW view" sort $CSYSDIG $CREFERENCE -r $f --raw -v$VIEW
+
+			for BUILD in $CREFERENCE $CSYSDIG
+			do
+				if [ "$BUILD" = "$CSYSDIG" ]; then
+					B=new
+				else
+					B=reference
+				fi
+
+				printf "%-40s %-12s %-10s %10s %12s\n" $(basename $f) $VIEW $B $(measure $BUILD -r $f --raw -v$VIEW)
+			done
+		done
+	done
+}
+
+test_render()
+{
+	if [ $ARGS_SET = 0 ]; then
+		ARGS="procs files connections"
+	fi
+
+	export LINES=${LINES:-24}
+	export COLUMNS=${COLUMNS:-80}
+
+	printf "%-40s %-12s %-12s %10s %12s %12s %12s\n" trace view mode refreshes "bytes/ref" "max bytes" "ms/ref"
+
+	for f in $TRACESDIR/*.scap
+	do
+		for VIEW in $ARGS
+		do
+			for MODE in incremental full
+			do
+				if [ "$MODE" = "full" ]; then
+					OPT=--render-benchmark=full
+				else
+					OPT=--render-benchmark
+				fi
+
+				if ! SYSDIG_CHISEL_DIR=$(chisel_dir $CSYSDIG) $CSYSDIG -r $f $OPT -v$VIEW > $TMPDIR/render 2>&1 ||
+					! grep -q "refreshes$" $TMPDIR/render; then
+					echo "$(basename $f): $VIEW $MODE: $(tail -n 1 $TMPDIR/render)"
+					ret=1
+					continue
+				fi
+
+				STATS=$(awk '
+					/refreshes$/ { n = $3 }
+					/^bytes:/ { b = $4; m = $7 }
+					/^time per refresh:/ { t = $4; sub(/ms$/, "", t) }
+					END { printf("%s %s %s %s", n, (b == "")? 0 : b, (m == "")? 0 : m, (t == "")? 0 : t) }' $TMPDIR/render)
+
+				printf "%-40s %-12s %-12s %10s %12s %12s %12s\n" $(basename $f) $VIEW $MODE $STATS
+			done
+		done
+	done
+}
+
+#
+# The view used by the sketch test: the distinct count of the file names and
+# the 50th and 99th percentiles of the latency, per process name
+#
+SKETCH_FILTER="evt.dir=< and fd.name!=''"
+
+write_sketch_view()
+{
+	cat > $TMPDIR/v_sketch_accuracy.lua <<EOF
+view_info =
+{
+	id = "sketch_accuracy",
+	name = "Sketch Accuracy",
+	description = "Approximate aggregations test view.",
+	tags = {"Test"},
+	filter = "$SKETCH_FILTER",
+	view_type = "table",
+	applies_to = {""},
+	columns =
+	{
+		{
+			name = "NA",
+			field = "proc.name",
+			is_key = true
+		},
+		{
+			name = "FILES",
+			field = "fd.name",
+			colsize = 10,
+			aggregation = "DISTINCT"
+		},
+		{
+			is_sorting = true,
+			name = "P50",
+			field = "evt.latency",
+			colsize = 10,
+			aggregation = "P50"
+		},
+		{
+			name = "P99",
+			field = "evt.latency",
+			colsize = 10,
+			aggregation = "P99"
+		},
+		{
+			name = "PROC",
+			field = "proc.name",
+			colsize = 20
+		}
+	}
+}
+EOF
+}
+
+#
+# The error bounds come from the sketches in table.h:
+#  - DISTINCT is exact up to SINSP_TABLE_DISTINCT_EXACT_MAX (64) values. Past
+#    that, the HyperLogLog counter with 1024 registers has a standard error
+#    of 1.04 / sqrt(1024) = 3.25%, and the check allows 3 standard errors.
+#  - The percentile buckets have a relative error of 2%, and the rank of the
+#    value is computed like below, so the value is within 2% of the exact one.
+# On top of that, csysdig prints human readable numbers (e.g. 1.21K,
+# 35.20ms), so the approximate value can be off by half a unit of the last
+# digit printed.
+#
+test_sketch()
+{
+	write_sketch_view
+
+	#
+	# Convert the human readable numbers and times printed by csysdig to
+	# "value rounding", where rounding is half a unit of the last digit
+	#
+	TONUM='
+	function tonum(s,    m, d)
+	{
+		m = 1
+		if(s ~ /ns$/) { sub(/ns$/, "", s) }
+		else if(s ~ /us$/) { sub(/us$/, "", s); m = 1000 }
+		else if(s ~ /ms$/) { sub(/ms$/, "", s); m = 1000000 }
+		else if(s ~ /s$/) { sub(/s$/, "", s); m = 1000000000 }
+		else if(s ~ /K$/) { sub(/K$/, "", s); m = 1024 }
+		else if(s ~ /M$/) { sub(/M$/, "", s); m = 1024 * 1024 }
+		else if(s ~ /G$/) { sub(/G$/, "", s); m = 1024 * 1024 * 1024 }
+		d = index(s, ".")
+		d = (d == 0)? 0 : length(s) - d
+		return (s * m) " " (0.5 * m / (10 ^ d))
+	}'
+
+	for f in $TRACESDIR/*.scap
+	do
+		EXACT=$TMPDIR/exact
+		APPROX=$TMPDIR/approx
+
+		#
+		# Exact values: distinct file names and latency percentiles per process
+		#
+		$SYSDIG -r $f -p "%evt.latency %proc.name %fd.name" "$SKETCH_FILTER" | sort -k2,2 -k1,1n | awk '
+			function flush()
+			{
+				if(n == 0) return
+				nd = 0
+				for(k in names) nd++
+				printf("%s %d %d %d\n", proc, nd, lat[int(0.5 * (n - 1))], lat[int(0.99 * (n - 1))])
+				delete names
+				n = 0
+			}
+			{
+				if($2 != proc) { flush(); proc = $2 }
+				lat[n++] = ($1 < 1)? 0 : $1
+				name = $0
+				sub(/^[^ ]+ [^ ]+ /, "", name)
+				names[name] = 1
+			}
+			END { flush() }' > $EXACT
+
+		#
+		# Approximate values, from the last sample printed by the view
+		#
+		SYSDIG_CHISEL_DIR=$TMPDIR $CSYSDIG -r $f --raw -vsketch_accuracy | awk "$TONUM"'
+			/^-+$/ { if(n != 0) { sample = rows; n = 0; rows = "" } next }
+			{ rows = rows $4 " " tonum($1) " " tonum($2) " " tonum($3) "\n"; n++ }
+			END { printf("%s", (n != 0)? rows : sample) }' > $APPROX
+
+		if ! awk -v trace=$(basename $f) '
+			function check(what, exact, approx, rounding, relerr,    err)
+			{
+				err = approx - exact
+				if(err < 0) err = -err
+				if(err > exact * relerr + rounding)
+				{
+					printf("%s: %s of %s is %s instead of %s (bound %.1f%%)\n", trace, what, proc, approx, exact, relerr * 100)
+					failed = 1
+				}
+			}
+			FNR == NR { approx[$1] = $0; next }
+			{
+				proc = $1
+				if(!(proc in approx))
+				{
+					printf("%s: %s missing from the view\n", trace, proc)
+					failed = 1
+					next
+				}
+				split(approx[proc], a, " ")
+				check("distinct file names", $2, a[2], a[3], ($2 <= 64)? 0 : 3 * 1.04 / sqrt(1024))
+				check("p50 latency", $3, a[4], a[5], 0.02)
+				check("p99 latency", $4, a[6], a[7], 0.02)
+			}
+			END { exit failed }' $APPROX $EXACT; then
+			ret=1
+		else
+			echo "$(basename $f): $(wc -l < $EXACT) processes OK"
+		fi
+	done
+}
+
+case $TEST in
+output) test_output ;;
+json) test_json ;;
+compression) test_compression ;;
+chisel) test_chisel ;;
+view) test_view ;;
+render) test_render ;;
+sketch) test_sketch ;;
+*)
+	echo "unknown test $TEST"
+	exit 1
+	;;
+esac
+
+exit $ret
@@ -57,6 +57,28 @@ extern "C" {
 //
 #define PF_CLONING 1
 
+//
+// A trace file stream. The savefile code reads and writes trace files only
+// through this interface, so that the on-disk compression format can be
+// chosen when the file is opened (see scap_stream.c).
+//
+typedef struct scap_stream scap_stream;
+
+typedef struct scap_stream_ops
+{
+	int (*m_read)(scap_stream* s, void* buf, unsigned int len);
+	int (*m_write)(scap_stream* s, const void* buf, unsigned int len);
+	int64_t (*m_seek)(scap_stream* s, int64_t offset, int whence);
+	int64_t (*m_offset)(scap_stream* s); // Position in the file on disk, i.e. after compression
+	int (*m_flush)(scap_stream* s);
+	int (*m_close)(scap_stream* s);
+}scap_stream_ops;
+
+struct scap_stream
+{
+	const scap_stream_ops* m_ops;
+};
+
 //
 // The device descriptor
 //
@@ -78,11 +100,8 @@ struct scap
 {
 	scap_device* m_devs;
 	uint32_t m_ndevs;
-#ifdef USE_ZLIB
-	gzFile m_file;
-#else
-	FILE* m_file;
-#endif
+	scap_stream* m_file;
+	char* m_fname; // Name of the trace file of an offline capture
 	char* m_file_evt_buf;
 	uint32_t m_last_evt_dump_flags;
 	char m_lasterr[SCAP_LASTERR_SIZE];
@@ -96,6 +115,18 @@ struct scap
 	proc_entry_callback m_proc_callback;
 	void* m_proc_callback_context;
 	struct ppm_proclist_info* m_driver_procinfo;
+	bool m_lazy_fds;
+	struct scap_ns_socket_list* m_lazy_sockets_by_ns; // Socket tables read by scap_proc_scan_fds(), kept for the whole capture
+	struct scap_evc_reader* m_evc_reader; // State of the decoder of EVC blocks
+};
+
+//
+// A trace file opened for writing
+//
+struct scap_dumper
+{
+	scap_stream* m_f;
+	struct scap_evc_writer* m_evc; // Not NULL if events are batched into EVC blocks
 };
 
 struct scap_ns_socket_list
@@ -149,12 +180,14 @@ void scap_fd_free_proc_fd_table(scap_t* handle, scap_threadinfo* pi);
 int32_t scap_fd_info_to_string(scap_fdinfo* fdi, OUT char* str, uint32_t strlen);
 // Calculate the length on disk of an fd entry's info
 uint32_t scap_fd_info_len(scap_fdinfo* fdi);
-// Write the given fd info to disk
-int32_t scap_fd_write_to_disk(scap_t* handle, scap_fdinfo* fdi, gzFile f);
+// Serialize the given fd info into a buffer of at least scap_fd_info_len() bytes
+int32_t scap_fd_write_to_buf(scap_t* handle, scap_fdinfo* fdi, char* buf);
 // Populate the given fd by reading the info from disk
-uint32_t scap_fd_read_from_disk(scap_t* handle, OUT scap_fdinfo* fdi, OUT size_t* nbytes, gzFile f);
+uint32_t scap_fd_read_from_disk(scap_t* handle, OUT scap_fdinfo* fdi, OUT size_t* nbytes, scap_stream* f);
 // Parse the headers of a trace file and load the tables
-int32_t scap_read_init(scap_t* handle, gzFile f);
+int32_t scap_read_init(scap_t* handle, scap_stream* f);
+// Load the process and fd tables of the trace file being read into m_proclist
+int32_t scap_read_proc_tables(scap_t* handle);
 // Add the file descriptor info pointed by fdi to the fd table for process pi.
 // Note: silently skips if fdi->type is SCAP_FD_UNKNOWN.
 int32_t scap_add_fd_to_proc_table(scap_t* handle, scap_threadinfo* pi, scap_fdinfo* fdi);
@@ -162,6 +195,8 @@ int32_t scap_add_fd_to_proc_table(scap_t* handle, scap_threadinfo* pi, scap_fdin
 void scap_fd_remove(scap_t* handle, scap_threadinfo* pi, int64_t fd);
 // Read an event from disk
 int32_t scap_next_offline(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid);
+// Free the state used to decode EVC blocks
+void scap_free_evc_reader(scap_t* handle);
 // read the filedescriptors for a given process directory
 int32_t scap_fd_scan_fd_dir(scap_t* handle, char * procdir, scap_threadinfo* pi, struct scap_ns_socket_list** sockets_by_ns, char *error);
 // read tcp or udp sockets from the proc filesystem
@@ -181,6 +216,46 @@ void scap_free_userlist(scap_userlist* uhandle);
 
 int32_t scap_fd_post_process_unix_sockets(scap_t* handle, scap_fdinfo* sockets);
 
+//
+// Trace file streams
+//
+// Open a trace file for reading. The compression format is detected from the
+// first bytes of the file.
+scap_stream* scap_stream_open_read(const char* fname);
+// Open a trace file for writing with the given compression. If fd is not -1,
+// the stream is written to it instead of to fname.
+scap_stream* scap_stream_open_write(const char* fname, int fd, compression_mode compress);
+
+static inline int scap_stream_read(scap_stream* s, void* buf, unsigned int len)
+{
+	return s->m_ops->m_read(s, buf, len);
+}
+
+static inline int scap_stream_write(scap_stream* s, const void* buf, unsigned int len)
+{
+	return s->m_ops->m_write(s, buf, len);
+}
+
+static inline int64_t scap_stream_seek(scap_stream* s, int64_t offset, int whence)
+{
+	return s->m_ops->m_seek(s, offset, whence);
+}
+
+static inline int64_t scap_stream_offset(scap_stream* s)
+{
+	return s->m_ops->m_offset(s);
+}
+
+static inline int scap_stream_flush(scap_stream* s)
+{
+	return s->m_ops->m_flush(s);
+}
+
+static inline int scap_stream_close(scap_stream* s)
+{
+	return s->m_ops->m_close(s);
+}
+
 int32_t scap_proc_fill_cgroups(struct scap_threadinfo* tinfo, const char* procdirname);
 
 //
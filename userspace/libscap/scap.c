@@ -64,7 +64,8 @@ char* scap_getlasterr(scap_t* handle)
 scap_t* scap_open_live_int(char *error, 
 						   proc_entry_callback proc_callback,
 						   void* proc_callback_context,
-						   bool import_users)
+						   bool import_users,
+						   bool lazy_fds)
 {
 #if !defined(HAS_CAPTURE)
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
@@ -126,6 +127,9 @@ scap_t* scap_open_live_int(char *error,
 	//
 	handle->m_proc_callback = proc_callback;
 	handle->m_proc_callback_context = proc_callback_context;
+	handle->m_lazy_fds = lazy_fds;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_fname = NULL;
 	handle->m_machine_info.num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
 	handle->m_machine_info.memory_size_bytes = (uint64_t)sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
 	gethostname(handle->m_machine_info.hostname, sizeof(handle->m_machine_info.hostname) / sizeof(handle->m_machine_info.hostname[0]));
@@ -309,6 +313,10 @@ scap_t* scap_open_offline_int(const char* fname,
 	handle->m_machine_info.num_cpus = (uint32_t)-1;
 	handle->m_last_evt_dump_flags = 0;
 	handle->m_driver_procinfo = NULL;
+	handle->m_lazy_fds = false;
+	handle->m_lazy_sockets_by_ns = NULL;
+	handle->m_evc_reader = NULL;
+	handle->m_fname = NULL;
 
 	handle->m_file_evt_buf = (char*)malloc(FILE_READ_BUF_SIZE);
 	if(!handle->m_file_evt_buf)
@@ -318,10 +326,18 @@ scap_t* scap_open_offline_int(const char* fname,
 		return NULL;
 	}
 
+	handle->m_fname = strdup(fname);
+	if(!handle->m_fname)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error allocating the file name");
+		scap_close(handle);
+		return NULL;
+	}
+
 	//
 	// Open the file
 	//
-	handle->m_file = gzopen(fname, "rb");
+	handle->m_file = scap_stream_open_read(fname);
 	if(handle->m_file == NULL)
 	{
 		snprintf(error, SCAP_LASTERR_SIZE, "can't open file %s", fname);
@@ -368,7 +384,7 @@ scap_t* scap_open_offline(const char* fname, char *error)
 
 scap_t* scap_open_live(char *error)
 {
-	return scap_open_live_int(error, NULL, NULL, true);
+	return scap_open_live_int(error, NULL, NULL, true, false);
 }
 
 scap_t* scap_open(scap_open_args args, char *error)
@@ -383,7 +399,8 @@ scap_t* scap_open(scap_open_args args, char *error)
 	{
 		return scap_open_live_int(error, args.proc_callback, 
 			args.proc_callback_context,
-			args.import_users);
+			args.import_users,
+			args.lazy_fds);
 	}
 }
 
@@ -391,7 +408,7 @@ void scap_close(scap_t* handle)
 {
 	if(handle->m_file)
 	{
-		gzclose(handle->m_file);
+		scap_stream_close(handle->m_file);
 	}
 	else
 	{
@@ -428,12 +445,28 @@ void scap_close(scap_t* handle)
 		free(handle->m_file_evt_buf);
 	}
 
+	if(handle->m_fname)
+	{
+		free(handle->m_fname);
+	}
+
+	if(handle->m_evc_reader)
+	{
+		scap_free_evc_reader(handle);
+	}
+
 	// Free the process table
 	if(handle->m_proclist != NULL)
 	{
 		scap_proc_free_table(handle);
 	}
 
+	// Free the socket tables used to load the fds lazily
+	if(handle->m_lazy_sockets_by_ns != NULL)
+	{
+		scap_fd_free_ns_sockets_list(handle, &handle->m_lazy_sockets_by_ns);
+	}
+
 	// Free the interface list
 	if(handle->m_addrlist)
 	{
@@ -982,7 +1015,7 @@ int64_t scap_get_readfile_offset(scap_t* handle)
 		return -1;
 	}
 
-	return gzoffset(handle->m_file);
+	return scap_stream_offset(handle->m_file);
 }
 
 static int32_t scap_handle_eventmask(scap_t* handle, uint32_t op, uint32_t event_id)
@@ -233,6 +233,7 @@ typedef struct scap_open_args
 	proc_entry_callback proc_callback; ///< Callback to be invoked for each thread/fd that is extracted from /proc, or NULL if no callback is needed.
 	void* proc_callback_context; ///< Opaque pointer that will be included in the calls to proc_callback. Ignored if proc_callback is NULL.
 	bool import_users; ///< true if the user list should be created when opening the capture.
+	bool lazy_fds; ///< true if the fd tables of the processes found in /proc at startup should not be scanned when opening the capture. They can be loaded later with scap_proc_scan_fds(). Ignored for offline captures.
 }scap_open_args;
 
 
@@ -418,7 +419,9 @@ typedef enum event_direction
 typedef enum compression_mode
 {
 	SCAP_COMPRESSION_NONE = 0,
-	SCAP_COMPRESSION_GZIP = 1
+	SCAP_COMPRESSION_GZIP = 1,
+	SCAP_COMPRESSION_EVTCODEC = 2, ///< Events are batched and encoded with a syscall-aware codec, then gzipped
+	SCAP_COMPRESSION_LZ = 3 ///< Fast LZ77 block compression. Compresses less than gzip, but is several times faster
 }compression_mode;
 
 /*!
@@ -580,6 +583,8 @@ int64_t scap_get_readfile_offset(scap_t* handle);
 
   \param handle Handle to the capture instance.
   \param fname The name of the tracefile.
+  \param compress The compression mode. Files written with any mode are read
+   transparently by \ref scap_open_offline.
 
   \return Dump handle that can be used to identify this specific dump instance. 
 */
@@ -589,8 +594,11 @@ scap_dumper_t* scap_dump_open(scap_t *handle, const char *fname, compression_mod
   \brief Close a tracefile. 
 
   \param d The dump handle, returned by \ref scap_dump_open
+
+  \return SCAP_SUCCESS if the pending events were written and the file was
+   closed, SCAP_FAILURE otherwise. The handle is freed in both cases.
 */
-void scap_dump_close(scap_dumper_t *d);
+int32_t scap_dump_close(scap_dumper_t *d);
 
 /*!
   \brief Return the current size of a tracefile.
@@ -604,8 +612,11 @@ int64_t scap_dump_get_offset(scap_dumper_t *d);
   \brief Flush all pending output into the file. 
 
   \param d The dump handle, returned by \ref scap_dump_open
+
+  \return SCAP_SUCCESS if the pending output was written, SCAP_FAILURE
+   otherwise.
 */
-void scap_dump_flush(scap_dumper_t *d);
+int32_t scap_dump_flush(scap_dumper_t *d);
 
 /*!
   \brief Tell how many bytes would be written (a dry run of scap_dump)
@@ -840,6 +851,12 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Scan /proc/<pid>/fd for a process whose fds were skipped because the capture
+// was opened with lazy_fds. The fds are delivered through the proc callback, or
+// added to the process list if no callback was specified. With scan_sockets,
+// the socket tables in /proc/net are read once and reused until scap_close().
+int32_t scap_proc_scan_fds(scap_t* handle, int64_t pid, bool scan_sockets);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
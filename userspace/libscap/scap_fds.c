@@ -217,75 +217,69 @@ uint32_t scap_fd_info_len(scap_fdinfo *fdi)
 }
 
 //
-// Write the given fd info to disk
+// Serialize the given fd info into buf, which must be at least
+// scap_fd_info_len(fdi) bytes long
 //
-int32_t scap_fd_write_to_disk(scap_t *handle, scap_fdinfo *fdi, gzFile f)
+int32_t scap_fd_write_to_buf(scap_t *handle, scap_fdinfo *fdi, char *buf)
 {
-
 	uint8_t type = (uint8_t)fdi->type;
 	uint16_t stlen;
-	if(gzwrite(f, &(fdi->fd), sizeof(uint64_t)) != sizeof(uint64_t) ||
-	        gzwrite(f, &(fdi->ino), sizeof(uint64_t)) != sizeof(uint64_t) ||
-	        gzwrite(f, &(type), sizeof(uint8_t)) != sizeof(uint8_t))
-	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1)");
-		return SCAP_FAILURE;
-	}
+	char *p = buf;
+
+	memcpy(p, &(fdi->fd), sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	memcpy(p, &(fdi->ino), sizeof(uint64_t));
+	p += sizeof(uint64_t);
+	*p++ = type;
 
 	switch(fdi->type)
 	{
 	case SCAP_FD_IPV4_SOCK:
-		if(gzwrite(f, &(fdi->info.ipv4info.sip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(fdi->info.ipv4info.dip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(fdi->info.ipv4info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv4info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv4info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi2)");
-			return SCAP_FAILURE;
-		}
+		memcpy(p, &(fdi->info.ipv4info.sip), sizeof(uint32_t));
+		p += sizeof(uint32_t);
+		memcpy(p, &(fdi->info.ipv4info.dip), sizeof(uint32_t));
+		p += sizeof(uint32_t);
+		memcpy(p, &(fdi->info.ipv4info.sport), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		memcpy(p, &(fdi->info.ipv4info.dport), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		*p++ = fdi->info.ipv4info.l4proto;
 		break;
 	case SCAP_FD_IPV4_SERVSOCK:
-		if(gzwrite(f, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv4serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi3)");
-			return SCAP_FAILURE;
-		}
+		memcpy(p, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t));
+		p += sizeof(uint32_t);
+		memcpy(p, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		*p++ = fdi->info.ipv4serverinfo.l4proto;
 		break;
 	case SCAP_FD_IPV6_SOCK:
-		if(gzwrite(f, (char*)fdi->info.ipv6info.sip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        gzwrite(f, (char*)fdi->info.ipv6info.dip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        gzwrite(f, &(fdi->info.ipv6info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv6info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv6info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi7)");
-		}
+		memcpy(p, fdi->info.ipv6info.sip, sizeof(uint32_t) * 4);
+		p += sizeof(uint32_t) * 4;
+		memcpy(p, fdi->info.ipv6info.dip, sizeof(uint32_t) * 4);
+		p += sizeof(uint32_t) * 4;
+		memcpy(p, &(fdi->info.ipv6info.sport), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		memcpy(p, &(fdi->info.ipv6info.dport), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		*p++ = fdi->info.ipv6info.l4proto;
 		break;
 	case SCAP_FD_IPV6_SERVSOCK:
-		if(gzwrite(f, &(fdi->info.ipv6serverinfo.ip), sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        gzwrite(f, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, &(fdi->info.ipv6serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi8)");
-		}
+		memcpy(p, fdi->info.ipv6serverinfo.ip, sizeof(uint32_t) * 4);
+		p += sizeof(uint32_t) * 4;
+		memcpy(p, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		*p++ = fdi->info.ipv6serverinfo.l4proto;
 		break;
 	case SCAP_FD_UNIX_SOCK:
-		if(gzwrite(f, &(fdi->info.unix_socket_info.source), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t)) != sizeof(uint64_t))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi4)");
-			return SCAP_FAILURE;
-		}
+		memcpy(p, &(fdi->info.unix_socket_info.source), sizeof(uint64_t));
+		p += sizeof(uint64_t);
+		memcpy(p, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t));
+		p += sizeof(uint64_t);
 		stlen = (uint16_t)strnlen(fdi->info.unix_socket_info.fname, SCAP_MAX_PATH_SIZE);
-		if(gzwrite(f, &stlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        (stlen > 0 && gzwrite(f, fdi->info.unix_socket_info.fname, stlen) != stlen))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi5)");
-			return SCAP_FAILURE;
-		}
+		memcpy(p, &stlen, sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		memcpy(p, fdi->info.unix_socket_info.fname, stlen);
+		p += stlen;
 		break;
 	case SCAP_FD_FIFO:
 	case SCAP_FD_FILE:
@@ -297,36 +291,37 @@ int32_t scap_fd_write_to_disk(scap_t *handle, scap_fdinfo *fdi, gzFile f)
 	case SCAP_FD_INOTIFY:
 	case SCAP_FD_TIMERFD:
 		stlen = (uint16_t)strnlen(fdi->info.fname, SCAP_MAX_PATH_SIZE);
-		if(gzwrite(f, &stlen,  sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        (stlen > 0 && gzwrite(f, fdi->info.fname, stlen) != stlen))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi6)");
-			return SCAP_FAILURE;
-		}
+		memcpy(p, &stlen, sizeof(uint16_t));
+		p += sizeof(uint16_t);
+		memcpy(p, fdi->info.fname, stlen);
+		p += stlen;
 		break;
 	default:
 		ASSERT(false);
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi1): unknown fd type %d", (int)type);
 		return SCAP_FAILURE;
 	}
 
+	ASSERT((uint32_t)(p - buf) == scap_fd_info_len(fdi));
+
 	return SCAP_SUCCESS;
 }
 
-uint32_t scap_fd_read_prop_from_disk(scap_t *handle, OUT void *target, size_t expected_size, OUT size_t *nbytes, gzFile f)
+uint32_t scap_fd_read_prop_from_disk(scap_t *handle, OUT void *target, size_t expected_size, OUT size_t *nbytes, scap_stream* f)
 {
 	size_t readsize;
-	readsize = gzread(f, target, (unsigned int)expected_size);
+	readsize = scap_stream_read(f, target, (unsigned int)expected_size);
 	CHECK_READ_SIZE(readsize, expected_size);
 	(*nbytes) += readsize;
 	return SCAP_SUCCESS;
 }
 
-uint32_t scap_fd_read_fname_from_disk(scap_t* handle, char* fname,OUT size_t* nbytes, gzFile f)
+uint32_t scap_fd_read_fname_from_disk(scap_t* handle, char* fname,OUT size_t* nbytes, scap_stream* f)
 {
 	size_t readsize;
 	uint16_t stlen;
 
-	readsize = gzread(f, &(stlen), sizeof(uint16_t));
+	readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 	CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 	if(stlen >= SCAP_MAX_PATH_SIZE)
@@ -337,7 +332,7 @@ uint32_t scap_fd_read_fname_from_disk(scap_t* handle, char* fname,OUT size_t* nb
 
 	(*nbytes) += readsize;
 
-	readsize = gzread(f, fname, stlen);
+	readsize = scap_stream_read(f, fname, stlen);
 	CHECK_READ_SIZE(readsize, stlen);
 
 	(*nbytes) += stlen;
@@ -351,7 +346,7 @@ uint32_t scap_fd_read_fname_from_disk(scap_t* handle, char* fname,OUT size_t* nb
 // Populate the given fd by reading the info from disk
 // Returns the number of read bytes.
 //
-uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t *nbytes, gzFile f)
+uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t *nbytes, scap_stream* f)
 {
 	uint8_t type;
 	uint32_t res = SCAP_SUCCESS;
@@ -369,11 +364,11 @@ uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t
 	switch(fdi->type)
 	{
 	case SCAP_FD_IPV4_SOCK:
-		if(gzread(f, &(fdi->info.ipv4info.sip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzread(f, &(fdi->info.ipv4info.dip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzread(f, &(fdi->info.ipv4info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv4info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv4info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		if(scap_stream_read(f, &(fdi->info.ipv4info.sip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4info.dip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading the fd info from file (1)");
 			return SCAP_FAILURE;
@@ -383,9 +378,9 @@ uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t
 
 		break;
 	case SCAP_FD_IPV4_SERVSOCK:
-		if(gzread(f, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzread(f, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv4serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		if(scap_stream_read(f, &(fdi->info.ipv4serverinfo.ip), sizeof(uint32_t)) != sizeof(uint32_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv4serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading the fd info from file (2)");
 			return SCAP_FAILURE;
@@ -394,11 +389,11 @@ uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t
 		(*nbytes) += (sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint8_t));
 		break;
 	case SCAP_FD_IPV6_SOCK:
-		if(gzread(f, (char*)fdi->info.ipv6info.sip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        gzread(f, (char*)fdi->info.ipv6info.dip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
-		        gzread(f, &(fdi->info.ipv6info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv6info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv6info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		if(scap_stream_read(f, (char*)fdi->info.ipv6info.sip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
+		        scap_stream_read(f, (char*)fdi->info.ipv6info.dip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4 ||
+		        scap_stream_read(f, &(fdi->info.ipv6info.sport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv6info.dport), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv6info.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi3)");
 		}
@@ -409,9 +404,9 @@ uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t
 				sizeof(uint8_t)); // l4proto
 		break;
 	case SCAP_FD_IPV6_SERVSOCK:
-		if(gzread(f, (char*)fdi->info.ipv6serverinfo.ip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4||
-		        gzread(f, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzread(f, &(fdi->info.ipv6serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
+		if(scap_stream_read(f, (char*)fdi->info.ipv6serverinfo.ip, sizeof(uint32_t) * 4) != sizeof(uint32_t) * 4||
+		        scap_stream_read(f, &(fdi->info.ipv6serverinfo.port), sizeof(uint16_t)) != sizeof(uint16_t) ||
+		        scap_stream_read(f, &(fdi->info.ipv6serverinfo.l4proto), sizeof(uint8_t)) != sizeof(uint8_t))
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fi4)");
 		}
@@ -420,8 +415,8 @@ uint32_t scap_fd_read_from_disk(scap_t *handle, OUT scap_fdinfo *fdi, OUT size_t
 				sizeof(uint8_t)); // l4proto
 		break;
 	case SCAP_FD_UNIX_SOCK:
-		if(gzread(f, &(fdi->info.unix_socket_info.source), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzread(f, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t)) != sizeof(uint64_t))
+		if(scap_stream_read(f, &(fdi->info.unix_socket_info.source), sizeof(uint64_t)) != sizeof(uint64_t) ||
+		        scap_stream_read(f, &(fdi->info.unix_socket_info.destination), sizeof(uint64_t)) != sizeof(uint64_t))
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading the fd info from file (fi5)");
 			return SCAP_FAILURE;
@@ -683,9 +683,11 @@ static int32_t scap_proc_add_from_proc(scap_t* handle, uint32_t tid, int parentt
 	}
 	
 	//
-	// Only add fds for processes, not threads
+	// Only add fds for processes, not threads. When lazy fd loading is enabled,
+	// the fds of the processes found during the initial scan are skipped: the
+	// consumer loads them on demand through scap_proc_scan_fds().
 	//
-	if(parenttid == -1)
+	if(parenttid == -1 && !(handle->m_lazy_fds && tid_to_scan == -1))
 	{
 		res = scap_fd_scan_fd_dir(handle, dir_name, tinfo, sockets_by_ns, error);
 	}
@@ -884,6 +886,83 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 #endif // HAS_CAPTURE
 }
 
+int32_t scap_proc_scan_fds(scap_t* handle, int64_t pid, bool scan_sockets)
+{
+#if !defined(HAS_CAPTURE)
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
+	return SCAP_FAILURE;
+#else
+	struct scap_threadinfo* tinfo;
+	struct scap_ns_socket_list* no_sockets = (void*)-1;
+	struct scap_ns_socket_list** sockets_by_ns;
+	char dir_name[SCAP_MAX_PATH_SIZE];
+	bool free_tinfo = false;
+	int32_t res;
+
+	//
+	// No /proc parsing for offline captures
+	//
+	if(handle->m_file)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "cannot scan fds of an offline capture");
+		return SCAP_FAILURE;
+	}
+
+	if(handle->m_proc_callback == NULL)
+	{
+		HASH_FIND_INT64(handle->m_proclist, &pid, tinfo);
+		if(tinfo == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process %" PRId64 " not found", pid);
+			return SCAP_NOTFOUND;
+		}
+	}
+	else
+	{
+		//
+		// The fds are delivered through the callback, which only needs to know
+		// which process they belong to
+		//
+		tinfo = (scap_threadinfo*)calloc(1, sizeof(scap_threadinfo));
+		if(tinfo == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (3)");
+			return SCAP_FAILURE;
+		}
+
+		tinfo->tid = pid;
+		tinfo->pid = pid;
+		tinfo->ptid = -1;
+		free_tinfo = true;
+	}
+
+	//
+	// The socket tables of a network namespace are read from /proc/net the first
+	// time a process in it is scanned, and reused for the whole capture.
+	// Sockets created after that are not in them, but their fds were already
+	// added by the events that created them.
+	//
+	if(scan_sockets)
+	{
+		sockets_by_ns = &handle->m_lazy_sockets_by_ns;
+	}
+	else
+	{
+		sockets_by_ns = &no_sockets;
+	}
+
+	snprintf(dir_name, sizeof(dir_name), "%s/proc/%" PRId64 "/", scap_get_host_root(), pid);
+	res = scap_fd_scan_fd_dir(handle, dir_name, tinfo, sockets_by_ns, handle->m_lasterr);
+
+	if(free_tinfo)
+	{
+		free(tinfo);
+	}
+
+	return res;
+#endif // HAS_CAPTURE
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 #if !defined(HAS_CAPTURE)
@@ -22,6 +22,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "scap.h"
 #include "scap-int.h"
@@ -41,12 +42,12 @@ static uint32_t scap_normalize_block_len(uint32_t blocklen)
 	return ((blocklen + 3) >> 2) << 2;
 }
 
-static int32_t scap_write_padding(gzFile f, uint32_t blocklen)
+static int32_t scap_write_padding(scap_stream* f, uint32_t blocklen)
 {
 	int32_t val = 0;
 	uint32_t bytestowrite = scap_normalize_block_len(blocklen) - blocklen;
 
-	if(gzwrite(f, &val, bytestowrite) == bytestowrite)
+	if(scap_stream_write(f, &val, bytestowrite) == bytestowrite)
 	{
 		return SCAP_SUCCESS;
 	}
@@ -56,220 +57,540 @@ static int32_t scap_write_padding(gzFile f, uint32_t blocklen)
 	}
 }
 
-static int32_t scap_write_proc_fds(scap_t *handle, struct scap_threadinfo *tinfo, gzFile f)
+//
+// The process and fd tables are written as a sequence of blocks, each holding
+// at most SCAP_METADATA_CHUNK_SIZE bytes of entries. The entries are serialized
+// into a memory chunk that is flushed as a separate block as soon as the next
+// entry doesn't fit, so the tables are walked only once and the memory needed
+// to write them doesn't depend on their size. Readers just accumulate the
+// content of consecutive PL and FDL blocks.
+//
+#define SCAP_METADATA_CHUNK_SIZE (64 * 1024)
+
+typedef struct scap_block_chunk
+{
+	uint32_t block_type;
+	uint32_t len;
+	char buf[SCAP_METADATA_CHUNK_SIZE];
+}scap_block_chunk;
+
+static inline char* scap_chunk_put(char* p, const void* src, uint32_t len)
+{
+	memcpy(p, src, len);
+	return p + len;
+}
+
+//
+// Write the content of a chunk as a block, and reset it
+//
+static int32_t scap_write_chunk(scap_t *handle, scap_stream* f, scap_block_chunk *chunk)
 {
 	block_header bh;
 	uint32_t bt;
-	uint32_t totlen = MEMBER_SIZE(scap_threadinfo, tid);  // This includes the tid
+
+	bh.block_type = chunk->block_type;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + chunk->len + 4);
+	bt = bh.block_total_length;
+
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_write(f, chunk->buf, chunk->len) != (int)chunk->len ||
+	        scap_write_padding(f, chunk->len) != SCAP_SUCCESS ||
+	        scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (chunk)");
+		return SCAP_FAILURE;
+	}
+
+	chunk->len = 0;
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the fd list blocks of a process. Every block starts with the tid of the
+// process, so a big fd table is simply split into multiple FDL blocks.
+//
+static int32_t scap_write_proc_fds(scap_t *handle, struct scap_threadinfo *tinfo, scap_stream* f, scap_block_chunk *chunk)
+{
 	struct scap_fdinfo *fdi;
 	struct scap_fdinfo *tfdi;
+	uint32_t entrylen;
+
+	chunk->block_type = FDL_BLOCK_TYPE;
+	chunk->len = sizeof(tinfo->tid);
+	memcpy(chunk->buf, &tinfo->tid, sizeof(tinfo->tid));
 
-	//
-	// First pass of the table to calculate the length
-	//
 	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
 	{
-		totlen += scap_fd_info_len(fdi);
+		entrylen = scap_fd_info_len(fdi);
+
+		if(chunk->len + entrylen > SCAP_METADATA_CHUNK_SIZE)
+		{
+			if(scap_write_chunk(handle, f, chunk) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+
+			chunk->len = sizeof(tinfo->tid);
+			memcpy(chunk->buf, &tinfo->tid, sizeof(tinfo->tid));
+		}
+
+		if(scap_fd_write_to_buf(handle, fdi, chunk->buf + chunk->len) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		chunk->len += entrylen;
 	}
 
-	//
-	// Create the block
-	//
-	bh.block_type = FDL_BLOCK_TYPE;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+	return scap_write_chunk(handle, f, chunk);
+}
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh))
+//
+// Write the fd list blocks
+//
+static int32_t scap_write_fdlist(scap_t *handle, scap_stream* f)
+{
+	struct scap_threadinfo *tinfo;
+	struct scap_threadinfo *ttinfo;
+	scap_block_chunk *chunk;
+	int32_t res = SCAP_SUCCESS;
+
+	chunk = (scap_block_chunk *)malloc(sizeof(scap_block_chunk));
+	if(chunk == NULL)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd1)");
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the fd list chunk");
 		return SCAP_FAILURE;
 	}
 
-	//
-	// Write the tid
-	//
-	if(gzwrite(f, &tinfo->tid, sizeof(tinfo->tid)) != sizeof(tinfo->tid))
+	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd2)");
-		return SCAP_FAILURE;
+		res = scap_write_proc_fds(handle, tinfo, f, chunk);
+		if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
 	}
 
-	//
-	// Second pass pass of the table to dump it
-	//
-	HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+	free(chunk);
+	return res;
+}
+
+//
+// Process list blocks are written in the V5 format. The data that is shared
+// by all the threads of a process (exe, args, env, cgroups, fd limit, memory
+// counters) is stored once per process, and thread entries reference it.
+// Strings are replaced by indexes in a dictionary that is local to the block;
+// env and cgroups are split into their entries and each entry is encoded
+// separately, so the common PATH or cgroup names are stored only once per
+// block. Each block is self contained and has this layout:
+//
+//  uint32 nstrings, then nstrings x {uint16 len, char[len]}
+//  uint32 nprocs, then nprocs process entries
+//  uint32 nthreads, then nthreads thread entries
+//
+// See scap_pl_add_thread() for the format of the entries.
+//
+typedef struct scap_pl_string
+{
+	const char* str;
+	uint16_t idx;
+	UT_hash_handle hh;
+}scap_pl_string;
+
+typedef struct scap_pl_proc
+{
+	uint64_t pid;
+	uint32_t idx;
+	struct scap_threadinfo *tinfo; // The thread the process data was taken from
+	UT_hash_handle hh;
+}scap_pl_proc;
+
+typedef struct scap_pl_writer
+{
+	scap_pl_string *strings;
+	scap_pl_proc *procs;
+	uint32_t nstrings;
+	uint32_t nprocs;
+	uint32_t nthreads;
+	uint32_t strings_len;
+	uint32_t procs_len;
+	uint32_t threads_len;
+	char strings_buf[SCAP_METADATA_CHUNK_SIZE];
+	char procs_buf[SCAP_METADATA_CHUNK_SIZE];
+	char threads_buf[SCAP_METADATA_CHUNK_SIZE];
+}scap_pl_writer;
+
+#define SCAP_PL_THREAD_ENTRY_LEN (sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint64_t) + \
+	2 * sizeof(uint16_t) + 3 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + sizeof(int64_t))
+
+#define SCAP_PL_PROC_ENTRY_FIXED_LEN (sizeof(uint64_t) + 2 * sizeof(uint16_t) + sizeof(uint64_t) + \
+	3 * sizeof(uint32_t) + sizeof(int64_t) + 2 * sizeof(uint16_t))
+
+//
+// Number of entries of a '\0'-separated list
+//
+static uint32_t scap_pl_count_entries(const char *list, uint16_t len)
+{
+	uint32_t j;
+	uint32_t res;
+
+	if(len == 0)
 	{
-		if(scap_fd_write_to_disk(handle, fdi, f) != SCAP_SUCCESS)
+		return 0;
+	}
+
+	for(j = 0, res = 1; j < len; j++)
+	{
+		if(list[j] == '\0')
 		{
-			return SCAP_FAILURE;
+			res++;
 		}
 	}
 
-	//
-	// Add the padding
-	//
-	if(scap_write_padding(f, totlen) != SCAP_SUCCESS)
+	return res;
+}
+
+static void scap_pl_reset(scap_pl_writer *w)
+{
+	scap_pl_string *s;
+	scap_pl_string *ts;
+	scap_pl_proc *p;
+	scap_pl_proc *tp;
+
+	HASH_ITER(hh, w->strings, s, ts)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd3)");
+		HASH_DEL(w->strings, s);
+		free(s);
+	}
+
+	HASH_ITER(hh, w->procs, p, tp)
+	{
+		HASH_DEL(w->procs, p);
+		free(p);
+	}
+
+	w->nstrings = 0;
+	w->nprocs = 0;
+	w->nthreads = 0;
+	w->strings_len = 0;
+	w->procs_len = 0;
+	w->threads_len = 0;
+}
+
+//
+// Return the dictionary index of a string, adding it to the dictionary if needed.
+// The dictionary lives in strings_buf, which is also where the hash keys point to.
+//
+static int32_t scap_pl_intern(scap_t *handle, scap_pl_writer *w, const char *str, uint16_t len, OUT uint16_t *idx)
+{
+	scap_pl_string *s;
+	char *dst;
+	int32_t uth_status = SCAP_SUCCESS;
+
+	HASH_FIND(hh, w->strings, str, len, s);
+	if(s != NULL)
+	{
+		*idx = s->idx;
+		return SCAP_SUCCESS;
+	}
+
+	s = (scap_pl_string *)malloc(sizeof(scap_pl_string));
+	if(s == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process list dictionary allocation error");
 		return SCAP_FAILURE;
 	}
 
-	//
-	// Create the trailer
-	//
-	bt = bh.block_total_length;
-	if(gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	dst = scap_chunk_put(w->strings_buf + w->strings_len, &len, sizeof(uint16_t));
+	memcpy(dst, str, len);
+	w->strings_len += sizeof(uint16_t) + len;
+
+	s->str = dst;
+	s->idx = (uint16_t)w->nstrings++;
+
+	HASH_ADD_KEYPTR(hh, w->strings, s->str, len, s);
+	if(uth_status != SCAP_SUCCESS)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (fd4)");
+		free(s);
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process list dictionary allocation error (2)");
 		return SCAP_FAILURE;
 	}
 
+	*idx = s->idx;
 	return SCAP_SUCCESS;
 }
 
 //
-// Write the fd list blocks
+// Encode a '\0'-separated list as {uint16 count, uint16 idx[count]}
 //
-static int32_t scap_write_fdlist(scap_t *handle, gzFile f)
+static char* scap_pl_put_list(scap_t *handle, scap_pl_writer *w, char *p, const char *list, uint16_t len)
 {
-	struct scap_threadinfo *tinfo;
-	struct scap_threadinfo *ttinfo;
-	int32_t res;
+	uint16_t count = (uint16_t)scap_pl_count_entries(list, len);
+	uint16_t idx;
+	uint32_t start = 0;
+	uint32_t j;
 
-	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	p = scap_chunk_put(p, &count, sizeof(uint16_t));
+
+	for(j = 0; count != 0 && j <= len; j++)
 	{
-		res = scap_write_proc_fds(handle, tinfo, f);
-		if(res != SCAP_SUCCESS)
+		if(j == len || list[j] == '\0')
 		{
-			return res;
+			if(scap_pl_intern(handle, w, list + start, (uint16_t)(j - start), &idx) != SCAP_SUCCESS)
+			{
+				return NULL;
+			}
+
+			p = scap_chunk_put(p, &idx, sizeof(uint16_t));
+			start = j + 1;
 		}
 	}
 
-	return SCAP_SUCCESS;
+	return p;
 }
 
 //
-// Write the process list block
+// Check if two threads carry the same per-process data
 //
-static int32_t scap_write_proclist(scap_t *handle, gzFile f)
+static bool scap_pl_same_process(struct scap_threadinfo *a, struct scap_threadinfo *b)
 {
-	block_header bh;
-	uint32_t bt;
-	uint32_t totlen = 0;
-	struct scap_threadinfo *tinfo;
-	struct scap_threadinfo *ttinfo;
-	uint16_t commlen;
-	uint16_t exelen;
+	return a->pid == b->pid &&
+		a->fdlimit == b->fdlimit &&
+		a->vmsize_kb == b->vmsize_kb &&
+		a->vmrss_kb == b->vmrss_kb &&
+		a->vmswap_kb == b->vmswap_kb &&
+		a->vpid == b->vpid &&
+		a->args_len == b->args_len &&
+		a->env_len == b->env_len &&
+		a->cgroups_len == b->cgroups_len &&
+		strncmp(a->exe, b->exe, SCAP_MAX_PATH_SIZE) == 0 &&
+		memcmp(a->args, b->args, a->args_len) == 0 &&
+		memcmp(a->env, b->env, a->env_len) == 0 &&
+		memcmp(a->cgroups, b->cgroups, a->cgroups_len) == 0;
+}
+
+//
+// Upper bound of the bytes that adding a thread can take in the block,
+// assuming that its process and all its strings are new
+//
+static uint32_t scap_pl_max_entry_len(struct scap_threadinfo *tinfo)
+{
+	uint32_t nenv = scap_pl_count_entries(tinfo->env, tinfo->env_len);
+	uint32_t ncgroups = scap_pl_count_entries(tinfo->cgroups, tinfo->cgroups_len);
+
+	return SCAP_PL_THREAD_ENTRY_LEN +
+		SCAP_PL_PROC_ENTRY_FIXED_LEN + tinfo->args_len + (nenv + ncgroups) * sizeof(uint16_t) +
+		3 * sizeof(uint16_t) + (uint32_t)strnlen(tinfo->comm, SCAP_MAX_PATH_SIZE) +
+		(uint32_t)strnlen(tinfo->exe, SCAP_MAX_PATH_SIZE) + (uint32_t)strnlen(tinfo->cwd, SCAP_MAX_PATH_SIZE) +
+		(nenv + ncgroups) * sizeof(uint16_t) + tinfo->env_len + tinfo->cgroups_len;
+}
+
+//
+// Add a thread to the block. The entries have this format:
+//
+// process: uint64 pid, uint16 exe, uint16 argslen, char args[argslen],
+//          uint64 fdlimit, uint32 vmsize_kb, uint32 vmrss_kb, uint32 vmswap_kb,
+//          int64 vpid, uint16 nenv, uint16 env[nenv], uint16 ncgroups,
+//          uint16 cgroups[ncgroups]
+// thread:  uint64 tid, uint32 process index, uint64 ptid, uint16 comm, uint16 cwd,
+//          uint32 flags, uint32 uid, uint32 gid, uint64 pfmajor, uint64 pfminor,
+//          int64 vtid
+//
+// where exe, comm, cwd, env[] and cgroups[] are dictionary indexes.
+//
+static int32_t scap_pl_add_thread(scap_t *handle, scap_pl_writer *w, struct scap_threadinfo *tinfo)
+{
+	scap_pl_proc *proc;
+	char *p;
+	uint16_t idx;
 	uint16_t argslen;
-	uint16_t cwdlen;
+	int32_t uth_status = SCAP_SUCCESS;
 
-	//
-	// First pass pass of the table to calculate the length
-	//
-	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	HASH_FIND_INT64(w->procs, &tinfo->pid, proc);
+
+	if(proc == NULL || !scap_pl_same_process(proc->tinfo, tinfo))
 	{
-		totlen += (uint32_t)
-		    (sizeof(uint64_t) +	// tid
-		    sizeof(uint64_t) +	// pid
-		    sizeof(uint64_t) +	// ptid
-		    2 + strnlen(tinfo->comm, SCAP_MAX_PATH_SIZE) +
-		    2 + strnlen(tinfo->exe, SCAP_MAX_PATH_SIZE) +
-		    2 + tinfo->args_len +
-		    2 + strnlen(tinfo->cwd, SCAP_MAX_PATH_SIZE) +
-		    sizeof(uint64_t) +	// fdlimit
-		    sizeof(uint32_t) +	// uid
-		    sizeof(uint32_t) +	// gid
-		    sizeof(uint32_t) +  // vmsize_kb
-		    sizeof(uint32_t) +  // vmrss_kb
-		    sizeof(uint32_t) +  // vmswap_kb
-		    sizeof(uint64_t) +  // pfmajor
-		    sizeof(uint64_t) +  // pfminor
-		    2 + tinfo->env_len +
-		    sizeof(int64_t) +  // vtid
-		    sizeof(int64_t) +  // vpid
-		    2 + tinfo->cgroups_len +
-		    sizeof(uint32_t));
+		p = w->procs_buf + w->procs_len;
+
+		if(scap_pl_intern(handle, w, tinfo->exe, (uint16_t)strnlen(tinfo->exe, SCAP_MAX_PATH_SIZE), &idx) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		argslen = tinfo->args_len;
+
+		p = scap_chunk_put(p, &(tinfo->pid), sizeof(uint64_t));
+		p = scap_chunk_put(p, &idx, sizeof(uint16_t));
+		p = scap_chunk_put(p, &argslen, sizeof(uint16_t));
+		p = scap_chunk_put(p, tinfo->args, argslen);
+		p = scap_chunk_put(p, &(tinfo->fdlimit), sizeof(uint64_t));
+		p = scap_chunk_put(p, &(tinfo->vmsize_kb), sizeof(uint32_t));
+		p = scap_chunk_put(p, &(tinfo->vmrss_kb), sizeof(uint32_t));
+		p = scap_chunk_put(p, &(tinfo->vmswap_kb), sizeof(uint32_t));
+		p = scap_chunk_put(p, &(tinfo->vpid), sizeof(int64_t));
+
+		p = scap_pl_put_list(handle, w, p, tinfo->env, tinfo->env_len);
+		if(p == NULL)
+		{
+			return SCAP_FAILURE;
+		}
+
+		p = scap_pl_put_list(handle, w, p, tinfo->cgroups, tinfo->cgroups_len);
+		if(p == NULL)
+		{
+			return SCAP_FAILURE;
+		}
+
+		w->procs_len = (uint32_t)(p - w->procs_buf);
+
+		if(proc == NULL)
+		{
+			proc = (scap_pl_proc *)malloc(sizeof(scap_pl_proc));
+			if(proc == NULL)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process list allocation error");
+				return SCAP_FAILURE;
+			}
+
+			proc->pid = tinfo->pid;
+			HASH_ADD_INT64(w->procs, pid, proc);
+			if(uth_status != SCAP_SUCCESS)
+			{
+				free(proc);
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process list allocation error (2)");
+				return SCAP_FAILURE;
+			}
+		}
+
+		proc->idx = w->nprocs++;
+		proc->tinfo = tinfo;
 	}
 
-	//
-	// Create the block
-	//
-	bh.block_type = PL_BLOCK_TYPE_V4;
-	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+	p = w->threads_buf + w->threads_len;
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh))
+	p = scap_chunk_put(p, &(tinfo->tid), sizeof(uint64_t));
+	p = scap_chunk_put(p, &(proc->idx), sizeof(uint32_t));
+	p = scap_chunk_put(p, &(tinfo->ptid), sizeof(uint64_t));
+
+	if(scap_pl_intern(handle, w, tinfo->comm, (uint16_t)strnlen(tinfo->comm, SCAP_MAX_PATH_SIZE), &idx) != SCAP_SUCCESS)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (1)");
 		return SCAP_FAILURE;
 	}
+	p = scap_chunk_put(p, &idx, sizeof(uint16_t));
 
-	//
-	// Second pass pass of the table to dump it
-	//
-	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	if(scap_pl_intern(handle, w, tinfo->cwd, (uint16_t)strnlen(tinfo->cwd, SCAP_MAX_PATH_SIZE), &idx) != SCAP_SUCCESS)
 	{
-		commlen = (uint16_t)strnlen(tinfo->comm, SCAP_MAX_PATH_SIZE);
-		exelen = (uint16_t)strnlen(tinfo->exe, SCAP_MAX_PATH_SIZE);
-		argslen = tinfo->args_len;
-		cwdlen = (uint16_t)strnlen(tinfo->cwd, SCAP_MAX_PATH_SIZE);
-
-		if(gzwrite(f, &(tinfo->tid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(tinfo->pid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(tinfo->ptid), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &commlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->comm, commlen) != commlen ||
-		        gzwrite(f, &exelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->exe, exelen) != exelen ||
-		        gzwrite(f, &argslen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->args, argslen) != argslen ||
-		        gzwrite(f, &cwdlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->cwd, cwdlen) != cwdlen ||
-		        gzwrite(f, &(tinfo->fdlimit), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(tinfo->flags), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->uid), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->gid), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->vmsize_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->vmrss_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->vmswap_kb), sizeof(uint32_t)) != sizeof(uint32_t) ||
-		        gzwrite(f, &(tinfo->pfmajor), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(tinfo->pfminor), sizeof(uint64_t)) != sizeof(uint64_t) ||
-		        gzwrite(f, &(tinfo->env_len), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->env, tinfo->env_len) != tinfo->env_len ||
-		        gzwrite(f, &(tinfo->vtid), sizeof(int64_t)) != sizeof(int64_t) ||
-		        gzwrite(f, &(tinfo->vpid), sizeof(int64_t)) != sizeof(int64_t) ||
-		        gzwrite(f, &(tinfo->cgroups_len), sizeof(uint16_t)) != sizeof(uint16_t) ||
-		        gzwrite(f, tinfo->cgroups, tinfo->cgroups_len) != tinfo->cgroups_len)
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (2)");
-			return SCAP_FAILURE;
-		}
+		return SCAP_FAILURE;
 	}
+	p = scap_chunk_put(p, &idx, sizeof(uint16_t));
 
-	//
-	// Blocks need to be 4-byte padded
-	//
-	if(scap_write_padding(f, totlen) != SCAP_SUCCESS)
+	p = scap_chunk_put(p, &(tinfo->flags), sizeof(uint32_t));
+	p = scap_chunk_put(p, &(tinfo->uid), sizeof(uint32_t));
+	p = scap_chunk_put(p, &(tinfo->gid), sizeof(uint32_t));
+	p = scap_chunk_put(p, &(tinfo->pfmajor), sizeof(uint64_t));
+	p = scap_chunk_put(p, &(tinfo->pfminor), sizeof(uint64_t));
+	p = scap_chunk_put(p, &(tinfo->vtid), sizeof(int64_t));
+
+	w->threads_len = (uint32_t)(p - w->threads_buf);
+	w->nthreads++;
+
+	return SCAP_SUCCESS;
+}
+
+static inline uint32_t scap_pl_block_len(scap_pl_writer *w)
+{
+	return 3 * sizeof(uint32_t) + w->strings_len + w->procs_len + w->threads_len;
+}
+
+//
+// Write the current content of the writer as a block, and reset it
+//
+static int32_t scap_pl_flush(scap_t *handle, scap_stream* f, scap_pl_writer *w)
+{
+	block_header bh;
+	uint32_t bt;
+	uint32_t totlen = scap_pl_block_len(w);
+
+	bh.block_type = PL_BLOCK_TYPE_V5;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+	bt = bh.block_total_length;
+
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_write(f, &w->nstrings, sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_stream_write(f, w->strings_buf, w->strings_len) != (int)w->strings_len ||
+	        scap_stream_write(f, &w->nprocs, sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_stream_write(f, w->procs_buf, w->procs_len) != (int)w->procs_len ||
+	        scap_stream_write(f, &w->nthreads, sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_stream_write(f, w->threads_buf, w->threads_len) != (int)w->threads_len ||
+	        scap_write_padding(f, totlen) != SCAP_SUCCESS ||
+	        scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (2)");
+		return SCAP_FAILURE;
+	}
+
+	scap_pl_reset(w);
+	return SCAP_SUCCESS;
+}
+
+//
+// Write the process list blocks
+//
+static int32_t scap_write_proclist(scap_t *handle, scap_stream* f)
+{
+	struct scap_threadinfo *tinfo;
+	struct scap_threadinfo *ttinfo;
+	scap_pl_writer *w;
+	int32_t res = SCAP_SUCCESS;
+
+	w = (scap_pl_writer *)calloc(1, sizeof(scap_pl_writer));
+	if(w == NULL)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (3)");
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the process list writer");
 		return SCAP_FAILURE;
 	}
 
+	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	{
+		//
+		// A single entry always fits in an empty block, since args, env
+		// and cgroups are bounded. Also, since every dictionary entry takes
+		// at least two bytes, the indexes always fit in 16 bits.
+		//
+		if(scap_pl_block_len(w) + scap_pl_max_entry_len(tinfo) > SCAP_METADATA_CHUNK_SIZE)
+		{
+			res = scap_pl_flush(handle, f, w);
+			if(res != SCAP_SUCCESS)
+			{
+				break;
+			}
+		}
+
+		res = scap_pl_add_thread(handle, w, tinfo);
+		if(res != SCAP_SUCCESS)
+		{
+			break;
+		}
+	}
+
 	//
-	// Create the trailer
+	// Flush the last block. This is done even if the table is empty, since
+	// readers expect at least one process list block.
 	//
-	bt = bh.block_total_length;
-	if(gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(res == SCAP_SUCCESS)
 	{
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (4)");
-		return SCAP_FAILURE;
+		res = scap_pl_flush(handle, f, w);
 	}
 
-	return SCAP_SUCCESS;
+	scap_pl_reset(w);
+	free(w);
+	return res;
 }
 
 //
 // Write the machine info block
 //
-static int32_t scap_write_machine_info(scap_t *handle, gzFile f)
+static int32_t scap_write_machine_info(scap_t *handle, scap_stream* f)
 {
 	block_header bh;
 	uint32_t bt;
@@ -282,9 +603,9 @@ static int32_t scap_write_machine_info(scap_t *handle, gzFile f)
 
 	bt = bh.block_total_length;
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh) ||
-	        gzwrite(f, &handle->m_machine_info, sizeof(handle->m_machine_info)) != sizeof(handle->m_machine_info) ||
-	        gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_write(f, &handle->m_machine_info, sizeof(handle->m_machine_info)) != sizeof(handle->m_machine_info) ||
+	        scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (MI1)");
 		return SCAP_FAILURE;
@@ -296,7 +617,7 @@ static int32_t scap_write_machine_info(scap_t *handle, gzFile f)
 //
 // Write the interface list block
 //
-static int32_t scap_write_iflist(scap_t *handle, gzFile f)
+static int32_t scap_write_iflist(scap_t *handle, scap_stream* f)
 {
 	block_header bh;
 	uint32_t bt;
@@ -320,7 +641,7 @@ static int32_t scap_write_iflist(scap_t *handle, gzFile f)
 	bh.block_type = IL_BLOCK_TYPE;
 	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + handle->m_addrlist->totlen + 4);
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh))
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
 		return SCAP_FAILURE;
@@ -335,7 +656,7 @@ static int32_t scap_write_iflist(scap_t *handle, gzFile f)
 
 		entrylen = sizeof(scap_ifinfo_ipv4) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
 
-		if(gzwrite(f, entry, entrylen) != entrylen)
+		if(scap_stream_write(f, entry, entrylen) != entrylen)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
 			return SCAP_FAILURE;
@@ -353,7 +674,7 @@ static int32_t scap_write_iflist(scap_t *handle, gzFile f)
 
 		entrylen = sizeof(scap_ifinfo_ipv6) + entry->ifnamelen - SCAP_MAX_PATH_SIZE;
 
-		if(gzwrite(f, entry, entrylen) != entrylen)
+		if(scap_stream_write(f, entry, entrylen) != entrylen)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF2)");
 			return SCAP_FAILURE;
@@ -375,7 +696,7 @@ static int32_t scap_write_iflist(scap_t *handle, gzFile f)
 	// Create the trailer
 	//
 	bt = bh.block_total_length;
-	if(gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
 		return SCAP_FAILURE;
@@ -387,7 +708,7 @@ static int32_t scap_write_iflist(scap_t *handle, gzFile f)
 //
 // Write the user list block
 //
-static int32_t scap_write_userlist(scap_t *handle, gzFile f)
+static int32_t scap_write_userlist(scap_t *handle, scap_stream* f)
 {
 	block_header bh;
 	uint32_t bt;
@@ -438,7 +759,7 @@ static int32_t scap_write_userlist(scap_t *handle, gzFile f)
 	bh.block_type = UL_BLOCK_TYPE;
 	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh))
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF1)");
 		return SCAP_FAILURE;
@@ -456,15 +777,15 @@ static int32_t scap_write_userlist(scap_t *handle, gzFile f)
 		homedirlen = (uint16_t)strnlen(info->homedir, SCAP_MAX_PATH_SIZE);
 		shelllen = (uint16_t)strnlen(info->shell, SCAP_MAX_PATH_SIZE);
 
-		if(gzwrite(f, &(type), sizeof(type)) != sizeof(type) ||
-			gzwrite(f, &(info->uid), sizeof(info->uid)) != sizeof(info->uid) ||
-		    gzwrite(f, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
-		    gzwrite(f, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    gzwrite(f, info->name, namelen) != namelen ||
-		    gzwrite(f, &homedirlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    gzwrite(f, info->homedir, homedirlen) != homedirlen ||
-		    gzwrite(f, &shelllen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    gzwrite(f, info->shell, shelllen) != shelllen)
+		if(scap_stream_write(f, &(type), sizeof(type)) != sizeof(type) ||
+			scap_stream_write(f, &(info->uid), sizeof(info->uid)) != sizeof(info->uid) ||
+		    scap_stream_write(f, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
+		    scap_stream_write(f, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_stream_write(f, info->name, namelen) != namelen ||
+		    scap_stream_write(f, &homedirlen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_stream_write(f, info->homedir, homedirlen) != homedirlen ||
+		    scap_stream_write(f, &shelllen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_stream_write(f, info->shell, shelllen) != shelllen)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U1)");
 			return SCAP_FAILURE;
@@ -481,10 +802,10 @@ static int32_t scap_write_userlist(scap_t *handle, gzFile f)
 
 		namelen = (uint16_t)strnlen(info->name, MAX_CREDENTIALS_STR_LEN);
 
-		if(gzwrite(f, &(type), sizeof(type)) != sizeof(type) ||
-			gzwrite(f, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
-		    gzwrite(f, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
-		    gzwrite(f, info->name, namelen) != namelen)
+		if(scap_stream_write(f, &(type), sizeof(type)) != sizeof(type) ||
+			scap_stream_write(f, &(info->gid), sizeof(info->gid)) != sizeof(info->gid) ||
+		    scap_stream_write(f, &namelen, sizeof(uint16_t)) != sizeof(uint16_t) ||
+		    scap_stream_write(f, info->name, namelen) != namelen)
 		{
 			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (U2)");
 			return SCAP_FAILURE;
@@ -504,7 +825,7 @@ static int32_t scap_write_userlist(scap_t *handle, gzFile f)
 	// Create the trailer
 	//
 	bt = bh.block_total_length;
-	if(gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (IF4)");
 		return SCAP_FAILURE;
@@ -513,11 +834,325 @@ static int32_t scap_write_userlist(scap_t *handle, gzFile f)
 	return SCAP_SUCCESS;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// EVENT BLOCK CODEC
+///////////////////////////////////////////////////////////////////////////////
+//
+// With SCAP_COMPRESSION_EVTCODEC, events are not written as individual EV/EVF
+// blocks. They are batched and encoded into EVC blocks, exploiting the
+// structure of syscall streams:
+//
+//  - timestamps are delta-encoded against the previous event
+//  - tids are looked up in a small move-to-front dictionary of the recently
+//    active threads, so a thread doing a burst of syscalls costs a few bits
+//  - the type of an exit event is the type of the previous event of the same
+//    thread + 1, and a thread usually keeps running on the same cpu: both are
+//    encoded with a single bit in these cases
+//  - all the other integers are varints
+//
+// The event metadata and the event parameters go in two separate streams,
+// which makes the gzip pass that follows much more effective. Blocks are
+// self contained: the dictionary and the timestamp are reset at the
+// beginning of every block. Block layout:
+//
+//  uint32 nevents, uint32 metalen, uint8 meta[metalen], uint8 params[]
+//
+// where each event has this metadata:
+//
+//  uint8 tag, [varint tid], [varint cpuid], [varint type], [varint flags],
+//  varint zigzag(ts delta), varint paramslen
+//
+#define SCAP_EVC_NTHREADS 15
+#define SCAP_EVC_TAG_TID_MASK 0x0f	// Index in the thread dictionary, or SCAP_EVC_NTHREADS for a new tid
+#define SCAP_EVC_TAG_SAME_CPU 0x10	// Same cpu as the previous event of the thread
+#define SCAP_EVC_TAG_NEXT_TYPE 0x20	// Type is the type of the previous event of the thread + 1
+#define SCAP_EVC_TAG_FLAGS 0x40		// The event has dump flags
+#define SCAP_EVC_MAX_EVENTS 8192
+#define SCAP_EVC_MAX_META_LEN 40	// Worst case metadata size of an event
+#define SCAP_EVC_BATCH_SIZE (256 * 1024)
+
+typedef struct scap_evc_thread
+{
+	uint64_t tid;
+	uint16_t type;
+	uint16_t cpuid;
+}scap_evc_thread;
+
+//
+// Codec state, mirrored by the encoder and the decoder
+//
+typedef struct scap_evc_state
+{
+	scap_evc_thread threads[SCAP_EVC_NTHREADS];
+	uint32_t nthreads;
+	uint64_t ts;
+	uint16_t cpuid;
+}scap_evc_state;
+
+struct scap_evc_writer
+{
+	scap_evc_state state;
+	uint32_t nevents;
+	uint32_t metalen;
+	uint32_t datalen;
+	uint32_t datasize;
+	char* data;
+	uint8_t meta[SCAP_EVC_MAX_EVENTS * SCAP_EVC_MAX_META_LEN];
+};
+
+struct scap_evc_reader
+{
+	scap_evc_state state;
+	uint32_t remaining;
+	const uint8_t* meta;
+	const uint8_t* meta_end;
+	const char* data;
+	const char* data_end;
+	char* buf;
+	uint32_t bufsize;
+};
+
+static inline uint32_t scap_evc_find_thread(scap_evc_state* s, uint64_t tid)
+{
+	uint32_t j;
+
+	for(j = 0; j < s->nthreads; j++)
+	{
+		if(s->threads[j].tid == tid)
+		{
+			break;
+		}
+	}
+
+	return j;
+}
+
+//
+// Move the thread at position idx (or a new one, if idx is past the end of
+// the dictionary) to the front, updating its state
+//
+static inline void scap_evc_touch_thread(scap_evc_state* s, uint32_t idx, uint64_t tid, uint16_t type, uint16_t cpuid)
+{
+	if(idx >= s->nthreads)
+	{
+		if(s->nthreads < SCAP_EVC_NTHREADS)
+		{
+			s->nthreads++;
+		}
+
+		idx = s->nthreads - 1;
+	}
+
+	memmove(&s->threads[1], &s->threads[0], idx * sizeof(scap_evc_thread));
+	s->threads[0].tid = tid;
+	s->threads[0].type = type;
+	s->threads[0].cpuid = cpuid;
+	s->cpuid = cpuid;
+}
+
+static inline uint8_t* scap_evc_put_varint(uint8_t* p, uint64_t v)
+{
+	while(v >= 0x80)
+	{
+		*p++ = (uint8_t)(v | 0x80);
+		v >>= 7;
+	}
+
+	*p++ = (uint8_t)v;
+	return p;
+}
+
+static inline uint64_t scap_evc_zigzag(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t scap_evc_unzigzag(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static struct scap_evc_writer* scap_evc_writer_create()
+{
+	struct scap_evc_writer* w = (struct scap_evc_writer*)calloc(1, sizeof(struct scap_evc_writer));
+
+	if(w == NULL)
+	{
+		return NULL;
+	}
+
+	w->datasize = SCAP_EVC_BATCH_SIZE;
+	w->data = (char*)malloc(w->datasize);
+	if(w->data == NULL)
+	{
+		free(w);
+		return NULL;
+	}
+
+	return w;
+}
+
+static void scap_evc_writer_free(struct scap_evc_writer* w)
+{
+	free(w->data);
+	free(w);
+}
+
+//
+// Write the pending events as an EVC block, and reset the codec
+//
+static int32_t scap_evc_flush(scap_t *handle, scap_dumper_t *d)
+{
+	struct scap_evc_writer* w = d->m_evc;
+	block_header bh;
+	uint32_t bt;
+	uint32_t totlen;
+
+	if(w->nevents == 0)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	totlen = 2 * sizeof(uint32_t) + w->metalen + w->datalen;
+	bh.block_type = EVC_BLOCK_TYPE;
+	bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + totlen + 4);
+	bt = bh.block_total_length;
+
+	if(scap_stream_write(d->m_f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_write(d->m_f, &w->nevents, sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_stream_write(d->m_f, &w->metalen, sizeof(uint32_t)) != sizeof(uint32_t) ||
+	        scap_stream_write(d->m_f, w->meta, w->metalen) != (int)w->metalen ||
+	        scap_stream_write(d->m_f, w->data, w->datalen) != (int)w->datalen ||
+	        scap_write_padding(d->m_f, totlen) != SCAP_SUCCESS ||
+	        scap_stream_write(d->m_f, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		if(handle != NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (evc)");
+		}
+		return SCAP_FAILURE;
+	}
+
+	memset(&w->state, 0, sizeof(w->state));
+	w->nevents = 0;
+	w->metalen = 0;
+	w->datalen = 0;
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Add an event to the current EVC batch
+//
+static int32_t scap_evc_add(scap_t *handle, scap_dumper_t *d, scap_evt *e, uint16_t cpuid, uint32_t flags)
+{
+	struct scap_evc_writer* w = d->m_evc;
+	uint32_t paramslen;
+	uint32_t idx;
+	uint16_t refcpu;
+	uint8_t tag;
+	uint8_t* p;
+
+	if(e->len < sizeof(scap_evt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid event len %u", e->len);
+		return SCAP_FAILURE;
+	}
+
+	paramslen = e->len - sizeof(scap_evt);
+
+	if(w->nevents == SCAP_EVC_MAX_EVENTS || w->datalen + paramslen > SCAP_EVC_BATCH_SIZE)
+	{
+		if(scap_evc_flush(handle, d) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	if(paramslen > w->datasize)
+	{
+		char* data = (char*)realloc(w->data, paramslen);
+		if(data == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the evc buffer");
+			return SCAP_FAILURE;
+		}
+
+		w->data = data;
+		w->datasize = paramslen;
+	}
+
+	idx = scap_evc_find_thread(&w->state, e->tid);
+	if(idx < w->state.nthreads)
+	{
+		tag = (uint8_t)idx;
+		refcpu = w->state.threads[idx].cpuid;
+
+		if(e->type == w->state.threads[idx].type + 1)
+		{
+			tag |= SCAP_EVC_TAG_NEXT_TYPE;
+		}
+	}
+	else
+	{
+		tag = SCAP_EVC_NTHREADS;
+		refcpu = w->state.cpuid;
+	}
+
+	if(cpuid == refcpu)
+	{
+		tag |= SCAP_EVC_TAG_SAME_CPU;
+	}
+
+	if(flags != 0)
+	{
+		tag |= SCAP_EVC_TAG_FLAGS;
+	}
+
+	p = w->meta + w->metalen;
+	*p++ = tag;
+
+	if((tag & SCAP_EVC_TAG_TID_MASK) == SCAP_EVC_NTHREADS)
+	{
+		p = scap_evc_put_varint(p, e->tid);
+	}
+
+	if(!(tag & SCAP_EVC_TAG_SAME_CPU))
+	{
+		p = scap_evc_put_varint(p, cpuid);
+	}
+
+	if(!(tag & SCAP_EVC_TAG_NEXT_TYPE))
+	{
+		p = scap_evc_put_varint(p, e->type);
+	}
+
+	if(tag & SCAP_EVC_TAG_FLAGS)
+	{
+		p = scap_evc_put_varint(p, flags);
+	}
+
+	p = scap_evc_put_varint(p, scap_evc_zigzag((int64_t)(e->ts - w->state.ts)));
+	p = scap_evc_put_varint(p, paramslen);
+
+	w->metalen = (uint32_t)(p - w->meta);
+
+	memcpy(w->data + w->datalen, (char*)e + sizeof(scap_evt), paramslen);
+	w->datalen += paramslen;
+	w->nevents++;
+
+	w->state.ts = e->ts;
+	scap_evc_touch_thread(&w->state, idx, e->tid, e->type, cpuid);
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Create the dump file headers and add the tables
 //
-static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fname)
+static scap_dumper_t *scap_setup_dump(scap_t *handle, scap_stream* f, const char *fname)
 {
+	scap_dumper_t *d;
 	block_header bh;
 	section_header_block sh;
 	uint32_t bt;
@@ -535,9 +1170,9 @@ static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fnam
 
 	bt = bh.block_total_length;
 
-	if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh) ||
-	        gzwrite(f, &sh, sizeof(sh)) != sizeof(sh) ||
-	        gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(scap_stream_write(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_write(f, &sh, sizeof(sh)) != sizeof(sh) ||
+	        scap_stream_write(f, &bt, sizeof(bt)) != sizeof(bt))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file %s  (5)", fname);
 		return NULL;
@@ -546,13 +1181,17 @@ static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fnam
 	//
 	// If we're dumping in live mode, refresh the process tables list
 	// so we don't lose information about processes created in the interval
-	// between opening the handle and starting the dump
+	// between opening the handle and starting the dump.
+	// The fd tables are always scanned here, even if the handle was opened
+	// with lazy fd loading, since the dump must be self contained.
 	//
 #if defined(HAS_CAPTURE)
 	if(handle->m_file == NULL)
 	{
 		proc_entry_callback tcb = handle->m_proc_callback;
+		bool lazy_fds = handle->m_lazy_fds;
 		handle->m_proc_callback = NULL;
+		handle->m_lazy_fds = false;
 
 		scap_proc_free_table(handle);
 		char filename[SCAP_MAX_PATH_SIZE];
@@ -560,13 +1199,27 @@ static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fnam
 		if(scap_proc_scan_proc_dir(handle, filename, -1, -1, NULL, handle->m_lasterr, true) != SCAP_SUCCESS)
 		{
 			handle->m_proc_callback = tcb;
+			handle->m_lazy_fds = lazy_fds;
 			return NULL;
 		}
 
 		handle->m_proc_callback = tcb;
+		handle->m_lazy_fds = lazy_fds;
 	}
 #endif
 
+	//
+	// If we're reading a file and its tables were handed to the user while
+	// reading the headers, load them again so they can be copied into the dump.
+	//
+	if(handle->m_file != NULL && handle->m_proc_callback != NULL)
+	{
+		if(scap_read_proc_tables(handle) != SCAP_SUCCESS)
+		{
+			return NULL;
+		}
+	}
+
 	//
 	// Write the machine info
 	//
@@ -617,9 +1270,19 @@ static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fnam
 	}
 
 	//
-	// Done, return the file
+	// Done, return the dumper
 	//
-	return (scap_dumper_t *)f;
+	d = (scap_dumper_t *)malloc(sizeof(scap_dumper_t));
+	if(d == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the dumper");
+		return NULL;
+	}
+
+	d->m_f = f;
+	d->m_evc = NULL;
+
+	return d;
 }
 
 //
@@ -627,23 +1290,9 @@ static scap_dumper_t *scap_setup_dump(scap_t *handle, gzFile f, const char *fnam
 //
 scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress)
 {
-	gzFile f = NULL;
+	scap_dumper_t *d;
+	scap_stream* f = NULL;
 	int fd = -1;
-	const char* mode;
-
-	switch(compress)
-	{
-	case SCAP_COMPRESSION_GZIP:
-		mode = "wb";
-		break;
-	case SCAP_COMPRESSION_NONE:
-		mode = "wbT";
-		break;
-	default:
-		ASSERT(false);
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
-		return NULL;
-	}
 
 	if(fname[0] == '-' && fname[1] == '\0')
 	{
@@ -654,13 +1303,13 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 #endif
 		if(fd != -1)
 		{
-			f = gzdopen(fd, mode);
+			f = scap_stream_open_write(fname, fd, compress);
 			fname = "standard output";
 		}
 	}
 	else
 	{
-		f = gzopen(fname, mode);
+		f = scap_stream_open_write(fname, -1, compress);
 	}
 
 	if(f == NULL)
@@ -676,15 +1325,51 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		return NULL;
 	}
 
-	return scap_setup_dump(handle, f, fname);
-}
+	d = scap_setup_dump(handle, f, fname);
+	if(d == NULL)
+	{
+		scap_stream_close(f);
+		return NULL;
+	}
+
+	if(compress == SCAP_COMPRESSION_EVTCODEC)
+	{
+		d->m_evc = scap_evc_writer_create();
+		if(d->m_evc == NULL)
+		{
+			scap_dump_close(d);
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the event codec for %s", fname);
+			return NULL;
+		}
+	}
+
+	return d;
+}
+
+//
+// Close a "savefile" opened with scap_dump_open
+//
+int32_t scap_dump_close(scap_dumper_t *d)
+{
+	int32_t res = SCAP_SUCCESS;
+
+	if(d->m_evc != NULL)
+	{
+		if(scap_evc_flush(NULL, d) != SCAP_SUCCESS)
+		{
+			res = SCAP_FAILURE;
+		}
+
+		scap_evc_writer_free(d->m_evc);
+	}
+
+	if(scap_stream_close(d->m_f) != 0)
+	{
+		res = SCAP_FAILURE;
+	}
 
-//
-// Close a "savefile" opened with scap_dump_open
-//
-void scap_dump_close(scap_dumper_t *d)
-{
-	gzclose((gzFile)d);
+	free(d);
+	return res;
 }
 
 //
@@ -692,12 +1377,25 @@ void scap_dump_close(scap_dumper_t *d)
 //
 int64_t scap_dump_get_offset(scap_dumper_t *d)
 {
-	return gzoffset((gzFile)d);
+	return scap_stream_offset(d->m_f);
 }
 
-void scap_dump_flush(scap_dumper_t *d)
+int32_t scap_dump_flush(scap_dumper_t *d)
 {
-	gzflush((gzFile)d, Z_FULL_FLUSH);
+	if(d->m_evc != NULL)
+	{
+		if(scap_evc_flush(NULL, d) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	if(scap_stream_flush(d->m_f) != 0)
+	{
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
 }
 
 //
@@ -717,46 +1415,51 @@ int32_t scap_dump(scap_t *handle, scap_dumper_t *d, scap_evt *e, uint16_t cpuid,
 {
 	block_header bh;
 	uint32_t bt;
-	gzFile f = (gzFile)d;
+	scap_stream* f = d->m_f;
+	uint8_t hdr[sizeof(block_header) + sizeof(cpuid) + sizeof(flags)];
+	uint8_t trailer[sizeof(uint32_t) + sizeof(bt)];
+	uint32_t hdrlen = sizeof(block_header) + sizeof(cpuid);
+	uint32_t padlen;
+
+	if(d->m_evc != NULL)
+	{
+		return scap_evc_add(handle, d, e, cpuid, flags);
+	}
 
+	//
+	// The block is written with three writes: the header with the cpuid and
+	// the flags, the event, and the padding with the trailer
+	//
 	if(flags == 0)
 	{
-		//
-		// Write the section header
-		//
 		bh.block_type = EV_BLOCK_TYPE;
-		bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(cpuid) + e->len + 4);
-		bt = bh.block_total_length;
-
-		if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh) ||
-				gzwrite(f, &cpuid, sizeof(cpuid)) != sizeof(cpuid) ||
-				gzwrite(f, e, e->len) != e->len ||
-				scap_write_padding(f, sizeof(cpuid) + e->len) != SCAP_SUCCESS ||
-				gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (6)");
-			return SCAP_FAILURE;
-		}
 	}
 	else
 	{
-		//
-		// Write the section header
-		//
 		bh.block_type = EVF_BLOCK_TYPE;
-		bh.block_total_length = scap_normalize_block_len(sizeof(block_header) + sizeof(cpuid) + sizeof(flags) + e->len + 4);
-		bt = bh.block_total_length;
+		hdrlen += sizeof(flags);
+	}
 
-		if(gzwrite(f, &bh, sizeof(bh)) != sizeof(bh) ||
-				gzwrite(f, &cpuid, sizeof(cpuid)) != sizeof(cpuid) ||
-				gzwrite(f, &flags, sizeof(flags)) != sizeof(flags) ||
-				gzwrite(f, e, e->len) != e->len ||
-				scap_write_padding(f, sizeof(cpuid) + e->len) != SCAP_SUCCESS ||
-				gzwrite(f, &bt, sizeof(bt)) != sizeof(bt))
-		{
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (6)");
-			return SCAP_FAILURE;
-		}
+	bh.block_total_length = scap_normalize_block_len(hdrlen + e->len + 4);
+	bt = bh.block_total_length;
+	padlen = scap_normalize_block_len(sizeof(cpuid) + e->len) - (sizeof(cpuid) + e->len);
+
+	memcpy(hdr, &bh, sizeof(bh));
+	memcpy(hdr + sizeof(bh), &cpuid, sizeof(cpuid));
+	if(flags != 0)
+	{
+		memcpy(hdr + sizeof(bh) + sizeof(cpuid), &flags, sizeof(flags));
+	}
+
+	memset(trailer, 0, padlen);
+	memcpy(trailer + padlen, &bt, sizeof(bt));
+
+	if(scap_stream_write(f, hdr, hdrlen) != (int)hdrlen ||
+			scap_stream_write(f, e, e->len) != (int)e->len ||
+			scap_stream_write(f, trailer, padlen + sizeof(bt)) != (int)(padlen + sizeof(bt)))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (6)");
+		return SCAP_FAILURE;
 	}
 
 	//
@@ -778,12 +1481,12 @@ int32_t scap_dump(scap_t *handle, scap_dumper_t *d, scap_evt *e, uint16_t cpuid,
 //
 // Load the machine info block
 //
-static int32_t scap_read_machine_info(scap_t *handle, gzFile f, uint32_t block_length)
+static int32_t scap_read_machine_info(scap_t *handle, scap_stream* f, uint32_t block_length)
 {
 	//
 	// Read the section header block
 	//
-	if(gzread(f, &handle->m_machine_info, sizeof(handle->m_machine_info)) != 
+	if(scap_stream_read(f, &handle->m_machine_info, sizeof(handle->m_machine_info)) != 
 		sizeof(handle->m_machine_info))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file (1)");
@@ -793,10 +1496,49 @@ static int32_t scap_read_machine_info(scap_t *handle, gzFile f, uint32_t block_l
 	return SCAP_SUCCESS;
 }
 
+//
+// Add a process entry read from file to the table, or fire the notification callback
+//
+static int32_t scap_proc_add_from_file(scap_t *handle, struct scap_threadinfo *tinfo)
+{
+	int32_t uth_status = SCAP_SUCCESS;
+	struct scap_threadinfo *ntinfo;
+
+	if(handle->m_proc_callback == NULL)
+	{
+		//
+		// Allocate the new entry and copy the temp one into into it.
+		//
+		ntinfo = (scap_threadinfo *)malloc(sizeof(scap_threadinfo));
+		if(ntinfo == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (fd1)");
+			return SCAP_FAILURE;
+		}
+
+		// Structure copy
+		*ntinfo = *tinfo;
+
+		HASH_ADD_INT64(handle->m_proclist, tid, ntinfo);
+		if(uth_status != SCAP_SUCCESS)
+		{
+			free(ntinfo);
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (fd2)");
+			return SCAP_FAILURE;
+		}
+	}
+	else
+	{
+		handle->m_proc_callback(handle->m_proc_callback_context, tinfo->tid, tinfo, NULL, handle);
+	}
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Parse a process list block
 //
-static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_length, uint32_t block_type)
+static int32_t scap_read_proclist(scap_t *handle, scap_stream* f, uint32_t block_length, uint32_t block_type)
 {
 	size_t readsize;
 	size_t totreadsize = 0;
@@ -804,8 +1546,6 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 	struct scap_threadinfo tinfo;
 	uint16_t stlen;
 	uint32_t padding;
-	int32_t uth_status = SCAP_SUCCESS;
-	struct scap_threadinfo *ntinfo;
 
 	tinfo.fdlist = NULL;
 	tinfo.flags = 0;
@@ -824,7 +1564,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// tid
 		//
-		readsize = gzread(f, &(tinfo.tid), sizeof(uint64_t));
+		readsize = scap_stream_read(f, &(tinfo.tid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		totreadsize += readsize;
@@ -832,7 +1572,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// pid
 		//
-		readsize = gzread(f, &(tinfo.pid), sizeof(uint64_t));
+		readsize = scap_stream_read(f, &(tinfo.pid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		totreadsize += readsize;
@@ -840,7 +1580,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// ptid
 		//
-		readsize = gzread(f, &(tinfo.ptid), sizeof(uint64_t));
+		readsize = scap_stream_read(f, &(tinfo.ptid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		totreadsize += readsize;
@@ -848,7 +1588,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// comm
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -859,7 +1599,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		totreadsize += readsize;
 
-		readsize = gzread(f, tinfo.comm, stlen);
+		readsize = scap_stream_read(f, tinfo.comm, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -870,7 +1610,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// exe
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -881,7 +1621,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		totreadsize += readsize;
 
-		readsize = gzread(f, tinfo.exe, stlen);
+		readsize = scap_stream_read(f, tinfo.exe, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -892,7 +1632,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// args
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_ARGS_SIZE)
@@ -903,7 +1643,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		totreadsize += readsize;
 
-		readsize = gzread(f, tinfo.args, stlen);
+		readsize = scap_stream_read(f, tinfo.args, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -915,7 +1655,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// cwd
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -926,7 +1666,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		totreadsize += readsize;
 
-		readsize = gzread(f, tinfo.cwd, stlen);
+		readsize = scap_stream_read(f, tinfo.cwd, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -937,7 +1677,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// fdlimit
 		//
-		readsize = gzread(f, &(tinfo.fdlimit), sizeof(uint64_t));
+		readsize = scap_stream_read(f, &(tinfo.fdlimit), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		totreadsize += readsize;
@@ -945,7 +1685,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// flags
 		//
-		readsize = gzread(f, &(tinfo.flags), sizeof(uint32_t));
+		readsize = scap_stream_read(f, &(tinfo.flags), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		totreadsize += readsize;
@@ -953,7 +1693,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// uid
 		//
-		readsize = gzread(f, &(tinfo.uid), sizeof(uint32_t));
+		readsize = scap_stream_read(f, &(tinfo.uid), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		totreadsize += readsize;
@@ -961,7 +1701,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// gid
 		//
-		readsize = gzread(f, &(tinfo.gid), sizeof(uint32_t));
+		readsize = scap_stream_read(f, &(tinfo.gid), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		totreadsize += readsize;
@@ -979,7 +1719,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmsize_kb
 			//
-			readsize = gzread(f, &(tinfo.vmsize_kb), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(tinfo.vmsize_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -987,7 +1727,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmrss_kb
 			//
-			readsize = gzread(f, &(tinfo.vmrss_kb), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(tinfo.vmrss_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -995,7 +1735,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmswap_kb
 			//
-			readsize = gzread(f, &(tinfo.vmswap_kb), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(tinfo.vmswap_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -1003,7 +1743,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// pfmajor
 			//
-			readsize = gzread(f, &(tinfo.pfmajor), sizeof(uint64_t));
+			readsize = scap_stream_read(f, &(tinfo.pfmajor), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			totreadsize += readsize;
@@ -1011,7 +1751,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// pfminor
 			//
-			readsize = gzread(f, &(tinfo.pfminor), sizeof(uint64_t));
+			readsize = scap_stream_read(f, &(tinfo.pfminor), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			totreadsize += readsize;
@@ -1023,7 +1763,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// env
 				//
-				readsize = gzread(f, &(stlen), sizeof(uint16_t));
+				readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 				if(stlen > SCAP_MAX_ENV_SIZE)
@@ -1034,7 +1774,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 				totreadsize += readsize;
 
-				readsize = gzread(f, tinfo.env, stlen);
+				readsize = scap_stream_read(f, tinfo.env, stlen);
 				CHECK_READ_SIZE(readsize, stlen);
 
 				// the string is not null-terminated on file
@@ -1049,7 +1789,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// vtid
 				//
-				readsize = gzread(f, &(tinfo.vtid), sizeof(int64_t));
+				readsize = scap_stream_read(f, &(tinfo.vtid), sizeof(int64_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 				totreadsize += readsize;
@@ -1057,7 +1797,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// vpid
 				//
-				readsize = gzread(f, &(tinfo.vpid), sizeof(int64_t));
+				readsize = scap_stream_read(f, &(tinfo.vpid), sizeof(int64_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 				totreadsize += readsize;
@@ -1065,7 +1805,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// cgroups
 				//
-				readsize = gzread(f, &(stlen), sizeof(uint16_t));
+				readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 				if(stlen > SCAP_MAX_CGROUPS_SIZE)
@@ -1075,72 +1815,397 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				}
 				tinfo.cgroups_len = stlen;
 
-				totreadsize += readsize;
+				totreadsize += readsize;
+
+				readsize = scap_stream_read(f, tinfo.cgroups, stlen);
+				CHECK_READ_SIZE(readsize, stlen);
+
+				totreadsize += readsize;
+			}
+			break;
+		default:
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process block type (fd1)");
+			ASSERT(false);
+			return SCAP_FAILURE;
+		}
+
+		//
+		// All parsed. Add the entry to the table, or fire the notification callback
+		//
+		if(scap_proc_add_from_file(handle, &tinfo) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	//
+	// Read the padding bytes so we properly align to the end of the data
+	//
+	if(totreadsize > block_length)
+	{
+		ASSERT(false);
+		return SCAP_FAILURE;
+	}
+	padding_len = block_length - totreadsize;
+
+	readsize = (size_t)scap_stream_read(f, &padding, (unsigned int)padding_len);
+	CHECK_READ_SIZE(readsize, padding_len);
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Cursor used to decode a V5 process list block from memory
+//
+typedef struct scap_pl_reader
+{
+	const char *p;
+	const char *end;
+	const char **strings; // Each one points to {uint16 len, char[len]}
+	uint32_t nstrings;
+	const char **procs;
+	uint32_t nprocs;
+}scap_pl_reader;
+
+static int32_t scap_pl_get(scap_t *handle, scap_pl_reader *r, OUT void *dst, uint32_t len)
+{
+	if((uint32_t)(r->end - r->p) < len)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process list block (truncated entry)");
+		return SCAP_FAILURE;
+	}
+
+	if(dst != NULL)
+	{
+		memcpy(dst, r->p, len);
+	}
+
+	r->p += len;
+	return SCAP_SUCCESS;
+}
+
+static int32_t scap_pl_get_string_idx(scap_t *handle, scap_pl_reader *r, OUT const char **str, OUT uint16_t *len)
+{
+	uint16_t idx;
+
+	if(scap_pl_get(handle, r, &idx, sizeof(uint16_t)) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(idx >= r->nstrings)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process list block (string %u)", (unsigned int)idx);
+		return SCAP_FAILURE;
+	}
+
+	memcpy(len, r->strings[idx], sizeof(uint16_t));
+	*str = r->strings[idx] + sizeof(uint16_t);
+	return SCAP_SUCCESS;
+}
+
+//
+// Decode a dictionary string into a null-terminated buffer of dstsize bytes
+//
+static int32_t scap_pl_get_string(scap_t *handle, scap_pl_reader *r, OUT char *dst, uint32_t dstsize)
+{
+	const char *str;
+	uint16_t len;
+
+	if(scap_pl_get_string_idx(handle, r, &str, &len) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(len >= dstsize)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid string len %d in process list block", (int)len);
+		return SCAP_FAILURE;
+	}
+
+	memcpy(dst, str, len);
+	dst[len] = 0;
+	return SCAP_SUCCESS;
+}
+
+//
+// Decode a dictionary-encoded list into a '\0'-separated buffer of dstsize bytes
+//
+static int32_t scap_pl_get_list(scap_t *handle, scap_pl_reader *r, OUT char *dst, uint32_t dstsize, OUT uint16_t *dstlen)
+{
+	const char *str;
+	uint16_t count;
+	uint16_t len;
+	uint32_t totlen = 0;
+	uint32_t j;
+
+	if(scap_pl_get(handle, r, &count, sizeof(uint16_t)) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	for(j = 0; j < count; j++)
+	{
+		if(scap_pl_get_string_idx(handle, r, &str, &len) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		if(totlen + len + (j != 0) > dstsize)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid list len in process list block");
+			return SCAP_FAILURE;
+		}
+
+		if(j != 0)
+		{
+			dst[totlen++] = 0;
+		}
+
+		memcpy(dst + totlen, str, len);
+		totlen += len;
+	}
+
+	if(totlen < dstsize)
+	{
+		dst[totlen] = 0;
+	}
+
+	*dstlen = (uint16_t)totlen;
+	return SCAP_SUCCESS;
+}
+
+//
+// Skip a process entry, just validating its size
+//
+static int32_t scap_pl_skip_proc(scap_t *handle, scap_pl_reader *r)
+{
+	uint16_t len;
+	uint32_t j;
+
+	if(scap_pl_get(handle, r, NULL, sizeof(uint64_t) + sizeof(uint16_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &len, sizeof(uint16_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, NULL, len + sizeof(uint64_t) + 3 * sizeof(uint32_t) + sizeof(int64_t)) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	//
+	// env and cgroups
+	//
+	for(j = 0; j < 2; j++)
+	{
+		if(scap_pl_get(handle, r, &len, sizeof(uint16_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, r, NULL, len * sizeof(uint16_t)) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Decode the process entry at the current position into tinfo
+//
+static int32_t scap_pl_get_proc(scap_t *handle, scap_pl_reader *r, OUT struct scap_threadinfo *tinfo)
+{
+	uint16_t argslen;
+
+	if(scap_pl_get(handle, r, &(tinfo->pid), sizeof(uint64_t)) != SCAP_SUCCESS ||
+		scap_pl_get_string(handle, r, tinfo->exe, SCAP_MAX_PATH_SIZE) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &argslen, sizeof(uint16_t)) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(argslen >= SCAP_MAX_ARGS_SIZE)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid argslen %d", argslen);
+		return SCAP_FAILURE;
+	}
+
+	if(scap_pl_get(handle, r, tinfo->args, argslen) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	// the string is not null-terminated on file
+	tinfo->args[argslen] = 0;
+	tinfo->args_len = argslen;
+
+	if(scap_pl_get(handle, r, &(tinfo->fdlimit), sizeof(uint64_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &(tinfo->vmsize_kb), sizeof(uint32_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &(tinfo->vmrss_kb), sizeof(uint32_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &(tinfo->vmswap_kb), sizeof(uint32_t)) != SCAP_SUCCESS ||
+		scap_pl_get(handle, r, &(tinfo->vpid), sizeof(int64_t)) != SCAP_SUCCESS ||
+		scap_pl_get_list(handle, r, tinfo->env, SCAP_MAX_ENV_SIZE, &(tinfo->env_len)) != SCAP_SUCCESS ||
+		scap_pl_get_list(handle, r, tinfo->cgroups, SCAP_MAX_CGROUPS_SIZE, &(tinfo->cgroups_len)) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Parse a V5 process list block. See scap_write_proclist() for the format.
+//
+static int32_t scap_read_proclist_v5(scap_t *handle, scap_stream* f, uint32_t block_length)
+{
+	size_t readsize;
+	char *readbuf;
+	scap_pl_reader r;
+	scap_pl_reader pr;
+	struct scap_threadinfo tinfo;
+	uint32_t procidx;
+	uint32_t nthreads;
+	uint32_t j;
+	int32_t res = SCAP_FAILURE;
+
+	//
+	// Bring the block to memory. The writer keeps the blocks small.
+	//
+	readbuf = (char *)malloc(block_length);
+	if(readbuf == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "memory allocation error in scap_read_proclist_v5");
+		return SCAP_FAILURE;
+	}
+
+	readsize = scap_stream_read(f, readbuf, block_length);
+	if(readsize != block_length)
+	{
+		free(readbuf);
+		CHECK_READ_SIZE(readsize, block_length);
+	}
+
+	memset(&r, 0, sizeof(r));
+	r.p = readbuf;
+	r.end = readbuf + block_length;
+
+	//
+	// Index the dictionary
+	//
+	if(scap_pl_get(handle, &r, &r.nstrings, sizeof(uint32_t)) != SCAP_SUCCESS)
+	{
+		goto scap_read_proclist_v5_end;
+	}
+
+	if(r.nstrings > block_length / sizeof(uint16_t))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process list block (%u strings)", r.nstrings);
+		goto scap_read_proclist_v5_end;
+	}
+
+	r.strings = (const char **)malloc(r.nstrings * sizeof(char *) + 1);
+	if(r.strings == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "memory allocation error in scap_read_proclist_v5 (2)");
+		goto scap_read_proclist_v5_end;
+	}
 
-				readsize = gzread(f, tinfo.cgroups, stlen);
-				CHECK_READ_SIZE(readsize, stlen);
+	for(j = 0; j < r.nstrings; j++)
+	{
+		uint16_t len;
 
-				totreadsize += readsize;
-			}
-			break;
-		default:
-			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process block type (fd1)");
-			ASSERT(false);
-			return SCAP_FAILURE;
+		r.strings[j] = r.p;
+		if(scap_pl_get(handle, &r, &len, sizeof(uint16_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, NULL, len) != SCAP_SUCCESS)
+		{
+			goto scap_read_proclist_v5_end;
 		}
+	}
 
-		//
-		// All parsed. Add the entry to the table, or fire the notification callback
-		//
-		if(handle->m_proc_callback == NULL)
-		{
-			//
-			// All parsed. Allocate the new entry and copy the temp one into into it.
-			//
-			ntinfo = (scap_threadinfo *)malloc(sizeof(scap_threadinfo));
-			if(ntinfo == NULL)
-			{
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (fd1)");
-				return SCAP_FAILURE;
-			}
+	//
+	// Index the process entries
+	//
+	if(scap_pl_get(handle, &r, &r.nprocs, sizeof(uint32_t)) != SCAP_SUCCESS)
+	{
+		goto scap_read_proclist_v5_end;
+	}
 
-			// Structure copy
-			*ntinfo = tinfo;
+	if(r.nprocs > block_length / SCAP_PL_PROC_ENTRY_FIXED_LEN)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process list block (%u processes)", r.nprocs);
+		goto scap_read_proclist_v5_end;
+	}
 
-			HASH_ADD_INT64(handle->m_proclist, tid, ntinfo);
-			if(uth_status != SCAP_SUCCESS)
-			{
-				free(ntinfo);
-				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "process table allocation error (fd2)");
-				return SCAP_FAILURE;
-			}
-		}
-		else
+	r.procs = (const char **)malloc(r.nprocs * sizeof(char *) + 1);
+	if(r.procs == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "memory allocation error in scap_read_proclist_v5 (3)");
+		goto scap_read_proclist_v5_end;
+	}
+
+	for(j = 0; j < r.nprocs; j++)
+	{
+		r.procs[j] = r.p;
+		if(scap_pl_skip_proc(handle, &r) != SCAP_SUCCESS)
 		{
-			handle->m_proc_callback(handle->m_proc_callback_context, tinfo.tid, &tinfo, NULL, handle);
+			goto scap_read_proclist_v5_end;
 		}
 	}
 
 	//
-	// Read the padding bytes so we properly align to the end of the data
+	// Decode the threads
 	//
-	if(totreadsize > block_length)
+	if(scap_pl_get(handle, &r, &nthreads, sizeof(uint32_t)) != SCAP_SUCCESS)
 	{
-		ASSERT(false);
-		return SCAP_FAILURE;
+		goto scap_read_proclist_v5_end;
 	}
-	padding_len = block_length - totreadsize;
 
-	readsize = (size_t)gzread(f, &padding, (unsigned int)padding_len);
-	CHECK_READ_SIZE(readsize, padding_len);
+	tinfo.fdlist = NULL;
 
-	return SCAP_SUCCESS;
+	for(j = 0; j < nthreads; j++)
+	{
+		if(scap_pl_get(handle, &r, &(tinfo.tid), sizeof(uint64_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &procidx, sizeof(uint32_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.ptid), sizeof(uint64_t)) != SCAP_SUCCESS ||
+			scap_pl_get_string(handle, &r, tinfo.comm, SCAP_MAX_PATH_SIZE) != SCAP_SUCCESS ||
+			scap_pl_get_string(handle, &r, tinfo.cwd, SCAP_MAX_PATH_SIZE) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.flags), sizeof(uint32_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.uid), sizeof(uint32_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.gid), sizeof(uint32_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.pfmajor), sizeof(uint64_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.pfminor), sizeof(uint64_t)) != SCAP_SUCCESS ||
+			scap_pl_get(handle, &r, &(tinfo.vtid), sizeof(int64_t)) != SCAP_SUCCESS)
+		{
+			goto scap_read_proclist_v5_end;
+		}
+
+		if(procidx >= r.nprocs)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted process list block (process %u)", procidx);
+			goto scap_read_proclist_v5_end;
+		}
+
+		pr = r;
+		pr.p = r.procs[procidx];
+		if(scap_pl_get_proc(handle, &pr, &tinfo) != SCAP_SUCCESS)
+		{
+			goto scap_read_proclist_v5_end;
+		}
+
+		if(scap_proc_add_from_file(handle, &tinfo) != SCAP_SUCCESS)
+		{
+			goto scap_read_proclist_v5_end;
+		}
+	}
+
+	res = SCAP_SUCCESS;
+
+scap_read_proclist_v5_end:
+	free(r.strings);
+	free(r.procs);
+	free(readbuf);
+	return res;
 }
 
 //
 // Parse an interface list block
 //
-static int32_t scap_read_iflist(scap_t *handle, gzFile f, uint32_t block_length)
+static int32_t scap_read_iflist(scap_t *handle, scap_stream* f, uint32_t block_length)
 {
 	int32_t res = SCAP_SUCCESS;
 	size_t readsize;
@@ -1175,7 +2240,7 @@ static int32_t scap_read_iflist(scap_t *handle, gzFile f, uint32_t block_length)
 		return SCAP_FAILURE;
 	}
 
-	readsize = gzread(f, readbuf, block_length);
+	readsize = scap_stream_read(f, readbuf, block_length);
 	CHECK_READ_SIZE(readsize, block_length);
 
 	//
@@ -1466,7 +2531,7 @@ scap_read_iflist_error:
 //
 // Parse a user list block
 //
-static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_length)
+static int32_t scap_read_userlist(scap_t *handle, scap_stream* f, uint32_t block_length)
 {
 	size_t readsize;
 	size_t totreadsize = 0;
@@ -1509,7 +2574,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// type
 		//
-		readsize = gzread(f, &(type), sizeof(type));
+		readsize = scap_stream_read(f, &(type), sizeof(type));
 		CHECK_READ_SIZE(readsize, sizeof(type));
 
 		totreadsize += readsize;
@@ -1531,7 +2596,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// uid
 			//
-			readsize = gzread(f, &(puser->uid), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(puser->uid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -1539,7 +2604,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// gid
 			//
-			readsize = gzread(f, &(puser->gid), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(puser->gid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -1547,7 +2612,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// name
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -1558,7 +2623,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			totreadsize += readsize;
 
-			readsize = gzread(f, puser->name, stlen);
+			readsize = scap_stream_read(f, puser->name, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -1569,7 +2634,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// homedir
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -1580,7 +2645,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			totreadsize += readsize;
 
-			readsize = gzread(f, puser->homedir, stlen);
+			readsize = scap_stream_read(f, puser->homedir, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -1591,7 +2656,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// shell
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -1602,7 +2667,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			totreadsize += readsize;
 
-			readsize = gzread(f, puser->shell, stlen);
+			readsize = scap_stream_read(f, puser->shell, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -1627,7 +2692,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// gid
 			//
-			readsize = gzread(f, &(pgroup->gid), sizeof(uint32_t));
+			readsize = scap_stream_read(f, &(pgroup->gid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			totreadsize += readsize;
@@ -1635,7 +2700,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// name
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_stream_read(f, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -1646,7 +2711,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			totreadsize += readsize;
 
-			readsize = gzread(f, pgroup->name, stlen);
+			readsize = scap_stream_read(f, pgroup->name, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -1666,7 +2731,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 	}
 	padding_len = block_length - totreadsize;
 
-	readsize = gzread(f, &padding, (unsigned int)padding_len);
+	readsize = scap_stream_read(f, &padding, (unsigned int)padding_len);
 	CHECK_READ_SIZE(readsize, padding_len);
 
 	return SCAP_SUCCESS;
@@ -1675,7 +2740,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 //
 // Parse a process list block
 //
-static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length)
+static int32_t scap_read_fdlist(scap_t *handle, scap_stream* f, uint32_t block_length)
 {
 	size_t readsize;
 	size_t totreadsize = 0;
@@ -1691,7 +2756,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length)
 	//
 	// Read the tid
 	//
-	readsize = gzread(f, &tid, sizeof(tid));
+	readsize = scap_stream_read(f, &tid, sizeof(tid));
 	CHECK_READ_SIZE(readsize, sizeof(tid));
 	totreadsize += readsize;
 
@@ -1767,7 +2832,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length)
 	}
 	padding_len = block_length - totreadsize;
 
-	readsize = gzread(f, &padding, (unsigned int)padding_len);
+	readsize = scap_stream_read(f, &padding, (unsigned int)padding_len);
 	CHECK_READ_SIZE(readsize, padding_len);
 
 	return SCAP_SUCCESS;
@@ -1776,7 +2841,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length)
 //
 // Parse the headers of a trace file and load the tables
 //
-int32_t scap_read_init(scap_t *handle, gzFile f)
+int32_t scap_read_init(scap_t *handle, scap_stream* f)
 {
 	block_header bh;
 	section_header_block sh;
@@ -1794,9 +2859,9 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 	//
 	// Read the section header block
 	//
-	if(gzread(f, &bh, sizeof(bh)) != sizeof(bh) ||
-	        gzread(f, &sh, sizeof(sh)) != sizeof(sh) ||
-	        gzread(f, &bt, sizeof(bt)) != sizeof(bt))
+	if(scap_stream_read(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_read(f, &sh, sizeof(sh)) != sizeof(sh) ||
+	        scap_stream_read(f, &bt, sizeof(bt)) != sizeof(bt))
 	{
 		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file (1)");
 		return SCAP_FAILURE;
@@ -1819,7 +2884,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 	//
 	while(true)
 	{
-		readsize = gzread(f, &bh, sizeof(bh));
+		readsize = scap_stream_read(f, &bh, sizeof(bh));
 
 		//
 		// If we don't find the event block header,
@@ -1859,6 +2924,14 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 				return SCAP_FAILURE;
 			}
 			break;
+		case PL_BLOCK_TYPE_V5:
+			found_pl = 1;
+
+			if(scap_read_proclist_v5(handle, f, bh.block_total_length - sizeof(block_header) - 4) != SCAP_SUCCESS)
+			{
+				return SCAP_FAILURE;
+			}
+			break;
 		case FDL_BLOCK_TYPE:
 		case FDL_BLOCK_TYPE_INT:
 			found_fdl = 1;
@@ -1871,12 +2944,13 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case EV_BLOCK_TYPE:
 		case EV_BLOCK_TYPE_INT:
 		case EVF_BLOCK_TYPE:
+		case EVC_BLOCK_TYPE:
 			found_ev = 1;
 
 			//
 			// We're done with the metadata headers. Rewind the file position so we are aligned to start reading the events.
 			//
-			fseekres = gzseek(f, (long)0 - sizeof(bh), SEEK_CUR);
+			fseekres = scap_stream_seek(f, -(int64_t)sizeof(bh), SEEK_CUR);
 			if(fseekres != -1)
 			{
 				break;
@@ -1909,7 +2983,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 			// Unknwon block type. Skip the block.
 			//
 			toread = bh.block_total_length - sizeof(block_header) - 4;
-			fseekres = (int)gzseek(f, (long)toread, SEEK_CUR);
+			fseekres = (int)scap_stream_seek(f, toread, SEEK_CUR);
 			if(fseekres == -1)
 			{
 				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip block of type %x and size %u.",
@@ -1928,7 +3002,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		//
 		// Read and validate the trailer
 		//
-		readsize = gzread(f, &bt, sizeof(bt));
+		readsize = scap_stream_read(f, &bt, sizeof(bt));
 		CHECK_READ_SIZE(readsize, sizeof(bt));
 
 		if(bt != bh.block_total_length)
@@ -1973,6 +3047,318 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 	return SCAP_SUCCESS;
 }
 
+//
+// Read the process and fd list blocks of the file being read again, this time
+// adding them to m_proclist instead of firing the notification callback.
+// The file is opened a second time, so the position of the event reader
+// doesn't change.
+//
+int32_t scap_read_proc_tables(scap_t *handle)
+{
+	block_header bh;
+	section_header_block sh;
+	uint32_t bt;
+	size_t readsize;
+	int32_t res = SCAP_FAILURE;
+	proc_entry_callback tcb = handle->m_proc_callback;
+	scap_stream* f;
+
+	ASSERT(handle->m_fname != NULL);
+
+	f = scap_stream_open_read(handle->m_fname);
+	if(f == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open file %s", handle->m_fname);
+		return SCAP_FAILURE;
+	}
+
+	scap_proc_free_table(handle);
+	handle->m_proc_callback = NULL;
+
+	if(scap_stream_read(f, &bh, sizeof(bh)) != sizeof(bh) ||
+	        scap_stream_read(f, &sh, sizeof(sh)) != sizeof(sh) ||
+	        scap_stream_read(f, &bt, sizeof(bt)) != sizeof(bt))
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file (1)");
+		goto scap_read_proc_tables_end;
+	}
+
+	while(true)
+	{
+		readsize = scap_stream_read(f, &bh, sizeof(bh));
+		if(readsize != sizeof(bh))
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file");
+			goto scap_read_proc_tables_end;
+		}
+
+		switch(bh.block_type)
+		{
+		case PL_BLOCK_TYPE_V1:
+		case PL_BLOCK_TYPE_V2:
+		case PL_BLOCK_TYPE_V3:
+		case PL_BLOCK_TYPE_V4:
+		case PL_BLOCK_TYPE_V1_INT:
+		case PL_BLOCK_TYPE_V2_INT:
+		case PL_BLOCK_TYPE_V3_INT:
+			if(scap_read_proclist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			{
+				goto scap_read_proc_tables_end;
+			}
+			break;
+		case PL_BLOCK_TYPE_V5:
+			if(scap_read_proclist_v5(handle, f, bh.block_total_length - sizeof(block_header) - 4) != SCAP_SUCCESS)
+			{
+				goto scap_read_proc_tables_end;
+			}
+			break;
+		case FDL_BLOCK_TYPE:
+		case FDL_BLOCK_TYPE_INT:
+			if(scap_read_fdlist(handle, f, bh.block_total_length - sizeof(block_header) - 4) != SCAP_SUCCESS)
+			{
+				goto scap_read_proc_tables_end;
+			}
+			break;
+		case EV_BLOCK_TYPE:
+		case EV_BLOCK_TYPE_INT:
+		case EVF_BLOCK_TYPE:
+		case EVC_BLOCK_TYPE:
+			//
+			// scap_read_init() already validated the headers, so the first
+			// event block means we have all the tables
+			//
+			res = SCAP_SUCCESS;
+			goto scap_read_proc_tables_end;
+		default:
+			if(scap_stream_seek(f, bh.block_total_length - sizeof(block_header) - 4, SEEK_CUR) == -1)
+			{
+				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error seeking in file");
+				goto scap_read_proc_tables_end;
+			}
+			break;
+		}
+
+		readsize = scap_stream_read(f, &bt, sizeof(bt));
+		if(readsize != sizeof(bt) || bt != bh.block_total_length)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error reading from file");
+			goto scap_read_proc_tables_end;
+		}
+	}
+
+scap_read_proc_tables_end:
+	handle->m_proc_callback = tcb;
+	scap_stream_close(f);
+	if(res != SCAP_SUCCESS)
+	{
+		scap_proc_free_table(handle);
+	}
+	return res;
+}
+
+//
+// Decoding of EVC blocks. See scap_evc_add() for the format.
+//
+void scap_free_evc_reader(scap_t* handle)
+{
+	free(handle->m_evc_reader->buf);
+	free(handle->m_evc_reader);
+	handle->m_evc_reader = NULL;
+}
+
+static inline int32_t scap_evc_get_varint(const uint8_t** pp, const uint8_t* end, OUT uint64_t* v)
+{
+	const uint8_t* p = *pp;
+	uint64_t res = 0;
+	uint32_t shift = 0;
+
+	while(p < end && shift < 64)
+	{
+		res |= (uint64_t)(*p & 0x7f) << shift;
+		if(!(*p++ & 0x80))
+		{
+			*pp = p;
+			*v = res;
+			return SCAP_SUCCESS;
+		}
+
+		shift += 7;
+	}
+
+	return SCAP_FAILURE;
+}
+
+//
+// Load an EVC block in memory and prepare to decode its events
+//
+static int32_t scap_evc_load_block(scap_t *handle, scap_stream* f, uint32_t block_total_length)
+{
+	struct scap_evc_reader* r = handle->m_evc_reader;
+	uint32_t readlen = block_total_length - sizeof(block_header);
+	uint32_t metalen;
+	size_t readsize;
+
+	if(block_total_length < sizeof(block_header) + 2 * sizeof(uint32_t) + 4)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "block length too short %u", block_total_length);
+		return SCAP_FAILURE;
+	}
+
+	if(r == NULL)
+	{
+		r = (struct scap_evc_reader*)calloc(1, sizeof(struct scap_evc_reader));
+		if(r == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the evc reader");
+			return SCAP_FAILURE;
+		}
+
+		handle->m_evc_reader = r;
+	}
+
+	if(readlen > r->bufsize)
+	{
+		char* buf = (char*)realloc(r->buf, readlen);
+		if(buf == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the evc buffer");
+			return SCAP_FAILURE;
+		}
+
+		r->buf = buf;
+		r->bufsize = readlen;
+	}
+
+	readsize = scap_stream_read(f, r->buf, readlen);
+	CHECK_READ_SIZE(readsize, readlen);
+
+	memcpy(&r->remaining, r->buf, sizeof(uint32_t));
+	memcpy(&metalen, r->buf + sizeof(uint32_t), sizeof(uint32_t));
+
+	//
+	// The last 4 bytes are the block trailer
+	//
+	if(metalen > readlen - 2 * sizeof(uint32_t) - 4)
+	{
+		r->remaining = 0;
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted evc block (metalen %u)", metalen);
+		return SCAP_FAILURE;
+	}
+
+	r->meta = (const uint8_t*)r->buf + 2 * sizeof(uint32_t);
+	r->meta_end = r->meta + metalen;
+	r->data = (const char*)r->meta_end;
+	r->data_end = r->buf + readlen - 4;
+	memset(&r->state, 0, sizeof(r->state));
+
+	return SCAP_SUCCESS;
+}
+
+//
+// Decode the next event of the current EVC block into the read buffer
+//
+static int32_t scap_evc_next(scap_t *handle, OUT scap_evt **pevent, OUT uint16_t *pcpuid)
+{
+	struct scap_evc_reader* r = handle->m_evc_reader;
+	scap_evt* e = (scap_evt*)handle->m_file_evt_buf;
+	uint64_t tid;
+	uint64_t cpuid;
+	uint64_t type;
+	uint64_t flags = 0;
+	uint64_t tsdelta;
+	uint64_t paramslen;
+	uint32_t idx;
+	uint8_t tag;
+
+	if(r->meta >= r->meta_end)
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	tag = *r->meta++;
+	idx = tag & SCAP_EVC_TAG_TID_MASK;
+
+	if(idx == SCAP_EVC_NTHREADS)
+	{
+		if(scap_evc_get_varint(&r->meta, r->meta_end, &tid) != SCAP_SUCCESS)
+		{
+			goto scap_evc_next_corrupted;
+		}
+	}
+	else if(idx < r->state.nthreads)
+	{
+		tid = r->state.threads[idx].tid;
+	}
+	else
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	if(tag & SCAP_EVC_TAG_SAME_CPU)
+	{
+		cpuid = (idx == SCAP_EVC_NTHREADS) ? r->state.cpuid : r->state.threads[idx].cpuid;
+	}
+	else if(scap_evc_get_varint(&r->meta, r->meta_end, &cpuid) != SCAP_SUCCESS)
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	if(tag & SCAP_EVC_TAG_NEXT_TYPE)
+	{
+		if(idx == SCAP_EVC_NTHREADS)
+		{
+			goto scap_evc_next_corrupted;
+		}
+
+		type = r->state.threads[idx].type + 1;
+	}
+	else if(scap_evc_get_varint(&r->meta, r->meta_end, &type) != SCAP_SUCCESS)
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	if((tag & SCAP_EVC_TAG_FLAGS) &&
+		scap_evc_get_varint(&r->meta, r->meta_end, &flags) != SCAP_SUCCESS)
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	if(scap_evc_get_varint(&r->meta, r->meta_end, &tsdelta) != SCAP_SUCCESS ||
+		scap_evc_get_varint(&r->meta, r->meta_end, &paramslen) != SCAP_SUCCESS)
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	if(paramslen > (uint64_t)(r->data_end - r->data) ||
+		paramslen > FILE_READ_BUF_SIZE - sizeof(scap_evt))
+	{
+		goto scap_evc_next_corrupted;
+	}
+
+	r->state.ts += (uint64_t)scap_evc_unzigzag(tsdelta);
+
+	e->ts = r->state.ts;
+	e->tid = tid;
+	e->len = (uint32_t)(sizeof(scap_evt) + paramslen);
+	e->type = (uint16_t)type;
+	memcpy((char*)e + sizeof(scap_evt), r->data, (size_t)paramslen);
+	r->data += paramslen;
+
+	scap_evc_touch_thread(&r->state, idx, tid, (uint16_t)type, (uint16_t)cpuid);
+	r->remaining--;
+
+	handle->m_last_evt_dump_flags = (uint32_t)flags;
+	*pcpuid = (uint16_t)cpuid;
+	*pevent = e;
+
+	return SCAP_SUCCESS;
+
+scap_evc_next_corrupted:
+	r->remaining = 0;
+	snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted evc block");
+	return SCAP_FAILURE;
+}
+
 //
 // Read an event from disk
 //
@@ -1981,14 +3367,22 @@ int32_t scap_next_offline(scap_t *handle, OUT scap_evt **pevent, OUT uint16_t *p
 	block_header bh;
 	size_t readsize;
 	uint32_t readlen;
-	gzFile f = handle->m_file;
+	scap_stream* f = handle->m_file;
 
 	ASSERT(f != NULL);
 
+	//
+	// If we're in the middle of an EVC block, just decode the next event
+	//
+	if(handle->m_evc_reader != NULL && handle->m_evc_reader->remaining != 0)
+	{
+		return scap_evc_next(handle, pevent, pcpuid);
+	}
+
 	//
 	// Read the block header
 	//
-	readsize = gzread(f, &bh, sizeof(bh));
+	readsize = scap_stream_read(f, &bh, sizeof(bh));
 	if(readsize != sizeof(bh))
 	{
 		if(readsize == 0)
@@ -2004,6 +3398,21 @@ int32_t scap_next_offline(scap_t *handle, OUT scap_evt **pevent, OUT uint16_t *p
 		}
 	}
 
+	if(bh.block_type == EVC_BLOCK_TYPE)
+	{
+		if(scap_evc_load_block(handle, f, bh.block_total_length) != SCAP_SUCCESS)
+		{
+			return SCAP_FAILURE;
+		}
+
+		if(handle->m_evc_reader->remaining == 0)
+		{
+			return scap_next_offline(handle, pevent, pcpuid);
+		}
+
+		return scap_evc_next(handle, pevent, pcpuid);
+	}
+
 	if(bh.block_type != EV_BLOCK_TYPE && 
 		bh.block_type != EV_BLOCK_TYPE_INT &&
 		bh.block_type != EVF_BLOCK_TYPE)
@@ -2022,7 +3431,7 @@ int32_t scap_next_offline(scap_t *handle, OUT scap_evt **pevent, OUT uint16_t *p
 	// Read the event
 	//
 	readlen = bh.block_total_length - sizeof(bh);
-	readsize = gzread(f, handle->m_file_evt_buf, readlen);
+	readsize = scap_stream_read(f, handle->m_file_evt_buf, readlen);
 	CHECK_READ_SIZE(readsize, readlen);
 
 	//
@@ -83,6 +83,7 @@ typedef struct _section_header_block
 											// backward compatibility
 
 #define PL_BLOCK_TYPE_V4		0x210
+#define PL_BLOCK_TYPE_V5		0x211	// Per-process data stored once, dictionary-encoded strings
 
 ///////////////////////////////////////////////////////////////////////////////
 // FD LIST BLOCK
@@ -121,6 +122,12 @@ typedef struct _section_header_block
 ///////////////////////////////////////////////////////////////////////////////
 #define EVF_BLOCK_TYPE	0x208
 
+///////////////////////////////////////////////////////////////////////////////
+// ENCODED EVENTS BLOCK
+// A batch of events written with SCAP_COMPRESSION_EVTCODEC
+///////////////////////////////////////////////////////////////////////////////
+#define EVC_BLOCK_TYPE	0x212
+
 #if defined __sun
 #pragma pack()
 #else
@@ -0,0 +1,1167 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scap.h"
+#include "scap-int.h"
+
+#ifdef _WIN32
+#define fdopen _fdopen
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// GZIP STREAMS
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// zlib streams. These are used to write gzip compressed and, with the "T"
+// mode, uncompressed files. Files are read with the buffered read streams.
+//
+#define SCAP_GZ_WRITE_BUF_SIZE (256 * 1024)
+
+typedef struct scap_gz_stream
+{
+	scap_stream m_stream;
+	gzFile m_f;
+}scap_gz_stream;
+
+static int scap_gz_read(scap_stream* s, void* buf, unsigned int len)
+{
+	return gzread(((scap_gz_stream*)s)->m_f, buf, len);
+}
+
+static int scap_gz_write(scap_stream* s, const void* buf, unsigned int len)
+{
+	return gzwrite(((scap_gz_stream*)s)->m_f, buf, len);
+}
+
+static int64_t scap_gz_seek(scap_stream* s, int64_t offset, int whence)
+{
+	return gzseek(((scap_gz_stream*)s)->m_f, (long)offset, whence);
+}
+
+static int64_t scap_gz_offset(scap_stream* s)
+{
+	return gzoffset(((scap_gz_stream*)s)->m_f);
+}
+
+static int scap_gz_flush(scap_stream* s)
+{
+	return gzflush(((scap_gz_stream*)s)->m_f, Z_FULL_FLUSH);
+}
+
+static int scap_gz_close(scap_stream* s)
+{
+	int res = gzclose(((scap_gz_stream*)s)->m_f);
+
+	free(s);
+	return res;
+}
+
+static const scap_stream_ops g_scap_gz_ops =
+{
+	scap_gz_read,
+	scap_gz_write,
+	scap_gz_seek,
+	scap_gz_offset,
+	scap_gz_flush,
+	scap_gz_close
+};
+
+static scap_stream* scap_gz_stream_create(gzFile f)
+{
+	scap_gz_stream* gs;
+
+	if(f == NULL)
+	{
+		return NULL;
+	}
+
+	gs = (scap_gz_stream*)malloc(sizeof(scap_gz_stream));
+	if(gs == NULL)
+	{
+		gzclose(f);
+		return NULL;
+	}
+
+	//
+	// The events are written a few bytes at a time, so use a buffer big enough
+	// to turn them into few large writes
+	//
+	gzbuffer(f, SCAP_GZ_WRITE_BUF_SIZE);
+
+	gs->m_stream.m_ops = &g_scap_gz_ops;
+	gs->m_f = f;
+
+	return &gs->m_stream;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LZ STREAMS
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// A fast LZ77 codec in the spirit of LZ4. The file starts with
+// SCAP_LZ_MAGIC, followed by independently compressed frames:
+//
+//  uint32_t rawlen, uint32_t complen, complen bytes of data
+//
+// complen == rawlen means that the frame is stored uncompressed. The
+// compressed data is a sequence of:
+//
+//  token: high nibble = literal count, low nibble = match length - 4
+//  [literal count - 15 as a run of 255 bytes terminated by a byte < 255]
+//  literals
+//  uint16_t match offset
+//  [match length - 19 as a run of 255 bytes terminated by a byte < 255]
+//
+// The last sequence only contains literals.
+//
+#define SCAP_LZ_MAGIC "\x89SLZ"
+#define SCAP_LZ_MAGIC_LEN 4
+#define SCAP_LZ_BLOCK_SIZE (256 * 1024)
+#define SCAP_LZ_BOUND(len) ((len) + (len) / 255 + 16)
+#define SCAP_LZ_HASH_BITS 14
+#define SCAP_LZ_MIN_MATCH 4
+#define SCAP_LZ_MAX_OFFSET 65535
+// Matches don't start in the last SCAP_LZ_MF_LIMIT bytes of a frame
+#define SCAP_LZ_MF_LIMIT 12
+// Matches don't cover the last SCAP_LZ_LAST_LITERALS bytes of a frame
+#define SCAP_LZ_LAST_LITERALS 5
+//
+// Number of already consumed bytes kept in front of the read buffer, so that
+// the reader can step back over a block header that crossed a frame boundary
+//
+#define SCAP_LZ_KEEP 64
+
+typedef struct scap_lz_stream
+{
+	scap_stream m_stream;
+	FILE* m_f;
+	uint8_t* m_buf; // Raw data: pending data when writing, decoded data when reading
+	uint32_t m_len; // Valid bytes in m_buf
+	uint32_t m_pos; // Read position in m_buf
+	uint8_t* m_zbuf; // Compressed frame
+	uint32_t* m_table; // Match finder hash table, only allocated when writing
+	int64_t m_offset; // Bytes read from or written to m_f
+	int64_t m_buf_start; // Uncompressed offset of m_buf[0]
+	bool m_error;
+}scap_lz_stream;
+
+static inline uint32_t scap_lz_read32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t scap_lz_hash(uint32_t v)
+{
+	return (v * 2654435761U) >> (32 - SCAP_LZ_HASH_BITS);
+}
+
+static inline uint8_t* scap_lz_put_length(uint8_t* op, uint32_t len)
+{
+	while(len >= 255)
+	{
+		*op++ = 255;
+		len -= 255;
+	}
+
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+static inline uint8_t* scap_lz_put_literals(uint8_t* op, const uint8_t* lit, uint32_t litlen, uint8_t** ptoken)
+{
+	uint8_t* token = op++;
+
+	if(litlen >= 15)
+	{
+		*token = 15 << 4;
+		op = scap_lz_put_length(op, litlen - 15);
+	}
+	else
+	{
+		*token = (uint8_t)(litlen << 4);
+	}
+
+	memcpy(op, lit, litlen);
+	*ptoken = token;
+	return op + litlen;
+}
+
+//
+// Compress src into dst, which must be at least SCAP_LZ_BOUND(srclen) bytes.
+// Returns the compressed length.
+//
+static uint32_t scap_lz_compress(const uint8_t* src, uint32_t srclen, uint8_t* dst, uint32_t* table)
+{
+	const uint8_t* ip = src;
+	const uint8_t* anchor = src;
+	const uint8_t* end = src + srclen;
+	const uint8_t* mflimit = end - SCAP_LZ_MF_LIMIT;
+	const uint8_t* matchlimit = end - SCAP_LZ_LAST_LITERALS;
+	uint8_t* op = dst;
+	uint8_t* token;
+
+	if(srclen > SCAP_LZ_MF_LIMIT)
+	{
+		memset(table, 0, sizeof(uint32_t) << SCAP_LZ_HASH_BITS);
+
+		while(ip < mflimit)
+		{
+			uint32_t seq = scap_lz_read32(ip);
+			uint32_t h = scap_lz_hash(seq);
+			const uint8_t* ref = src + table[h];
+			const uint8_t* mend;
+			uint32_t offset;
+
+			table[h] = (uint32_t)(ip - src);
+
+			if(ref >= ip || ip - ref > SCAP_LZ_MAX_OFFSET || scap_lz_read32(ref) != seq)
+			{
+				//
+				// Skip faster through data that doesn't compress
+				//
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			while(ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			offset = (uint32_t)(ip - ref);
+			mend = ip + SCAP_LZ_MIN_MATCH;
+			ref += SCAP_LZ_MIN_MATCH;
+			while(mend < matchlimit && *mend == *ref)
+			{
+				mend++;
+				ref++;
+			}
+
+			op = scap_lz_put_literals(op, anchor, (uint32_t)(ip - anchor), &token);
+
+			*op++ = (uint8_t)(offset & 0xff);
+			*op++ = (uint8_t)(offset >> 8);
+
+			if(mend - ip - SCAP_LZ_MIN_MATCH >= 15)
+			{
+				*token |= 15;
+				op = scap_lz_put_length(op, (uint32_t)(mend - ip - SCAP_LZ_MIN_MATCH - 15));
+			}
+			else
+			{
+				*token |= (uint8_t)(mend - ip - SCAP_LZ_MIN_MATCH);
+			}
+
+			ip = mend;
+			anchor = ip;
+		}
+	}
+
+	op = scap_lz_put_literals(op, anchor, (uint32_t)(end - anchor), &token);
+
+	return (uint32_t)(op - dst);
+}
+
+//
+// Decompress src into dst, which has room for dstlen bytes.
+// Returns the decompressed length, or -1 if the data is corrupted.
+//
+static int64_t scap_lz_decompress(const uint8_t* src, uint32_t srclen, uint8_t* dst, uint32_t dstlen)
+{
+	const uint8_t* ip = src;
+	const uint8_t* iend = src + srclen;
+	uint8_t* op = dst;
+	uint8_t* oend = dst + dstlen;
+
+	while(ip < iend)
+	{
+		uint32_t token = *ip++;
+		uint32_t litlen = token >> 4;
+		uint32_t mlen = token & 15;
+		uint32_t offset;
+		uint8_t b;
+
+		if(litlen == 15)
+		{
+			do
+			{
+				if(ip >= iend)
+				{
+					return -1;
+				}
+
+				b = *ip++;
+				litlen += b;
+			}
+			while(b == 255);
+		}
+
+		if(litlen > (uint32_t)(iend - ip) || litlen > (uint32_t)(oend - op))
+		{
+			return -1;
+		}
+
+		memcpy(op, ip, litlen);
+		ip += litlen;
+		op += litlen;
+
+		if(ip == iend)
+		{
+			break;
+		}
+
+		if(iend - ip < 2)
+		{
+			return -1;
+		}
+
+		offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+
+		if(offset == 0 || offset > (uint32_t)(op - dst))
+		{
+			return -1;
+		}
+
+		if(mlen == 15)
+		{
+			do
+			{
+				if(ip >= iend)
+				{
+					return -1;
+				}
+
+				b = *ip++;
+				mlen += b;
+			}
+			while(b == 255);
+		}
+
+		mlen += SCAP_LZ_MIN_MATCH;
+
+		if(mlen > (uint32_t)(oend - op))
+		{
+			return -1;
+		}
+
+		if(offset >= mlen)
+		{
+			memcpy(op, op - offset, mlen);
+			op += mlen;
+		}
+		else
+		{
+			//
+			// Overlapping match, e.g. a run of the same byte
+			//
+			const uint8_t* ref = op - offset;
+			uint8_t* mend = op + mlen;
+
+			while(op < mend)
+			{
+				*op++ = *ref++;
+			}
+		}
+	}
+
+	return op - dst;
+}
+
+static int scap_lz_write_frame(scap_lz_stream* ls)
+{
+	uint32_t hdr[2];
+	uint32_t complen;
+	const uint8_t* data;
+
+	if(ls->m_len == 0)
+	{
+		return 0;
+	}
+
+	complen = scap_lz_compress(ls->m_buf, ls->m_len, ls->m_zbuf, ls->m_table);
+	if(complen < ls->m_len)
+	{
+		data = ls->m_zbuf;
+	}
+	else
+	{
+		complen = ls->m_len;
+		data = ls->m_buf;
+	}
+
+	hdr[0] = ls->m_len;
+	hdr[1] = complen;
+
+	if(fwrite(hdr, 1, sizeof(hdr), ls->m_f) != sizeof(hdr) ||
+	        fwrite(data, 1, complen, ls->m_f) != complen)
+	{
+		ls->m_error = true;
+		return -1;
+	}
+
+	ls->m_offset += sizeof(hdr) + complen;
+	ls->m_buf_start += ls->m_len;
+	ls->m_len = 0;
+
+	return 0;
+}
+
+//
+// Load the next frame into the read buffer.
+// Returns the number of new bytes, 0 at the end of the file, -1 on error.
+//
+static int64_t scap_lz_read_frame(scap_lz_stream* ls)
+{
+	uint32_t hdr[2];
+	uint32_t keep;
+	size_t readsize;
+	int64_t rawlen;
+
+	if(ls->m_error)
+	{
+		return -1;
+	}
+
+	readsize = fread(hdr, 1, sizeof(hdr), ls->m_f);
+	if(readsize == 0 && feof(ls->m_f))
+	{
+		return 0;
+	}
+
+	if(readsize != sizeof(hdr) ||
+	        hdr[0] > SCAP_LZ_BLOCK_SIZE ||
+	        hdr[1] > SCAP_LZ_BOUND(SCAP_LZ_BLOCK_SIZE) ||
+	        fread(ls->m_zbuf, 1, hdr[1], ls->m_f) != hdr[1])
+	{
+		ls->m_error = true;
+		return -1;
+	}
+
+	ls->m_offset += sizeof(hdr) + hdr[1];
+
+	keep = ls->m_len < SCAP_LZ_KEEP ? ls->m_len : SCAP_LZ_KEEP;
+	memmove(ls->m_buf, ls->m_buf + ls->m_len - keep, keep);
+	ls->m_buf_start += ls->m_len - keep;
+
+	if(hdr[1] == hdr[0])
+	{
+		memcpy(ls->m_buf + keep, ls->m_zbuf, hdr[0]);
+		rawlen = hdr[0];
+	}
+	else
+	{
+		rawlen = scap_lz_decompress(ls->m_zbuf, hdr[1], ls->m_buf + keep, hdr[0]);
+		if(rawlen != hdr[0])
+		{
+			ls->m_error = true;
+			return -1;
+		}
+	}
+
+	ls->m_len = keep + (uint32_t)rawlen;
+	ls->m_pos = keep;
+
+	return rawlen;
+}
+
+static int scap_lz_read(scap_stream* s, void* buf, unsigned int len)
+{
+	scap_lz_stream* ls = (scap_lz_stream*)s;
+	unsigned int done = 0;
+
+	while(done < len)
+	{
+		uint32_t avail = ls->m_len - ls->m_pos;
+
+		if(avail == 0)
+		{
+			int64_t res = scap_lz_read_frame(ls);
+
+			if(res <= 0)
+			{
+				return (res < 0) ? -1 : (int)done;
+			}
+
+			continue;
+		}
+
+		if(avail > len - done)
+		{
+			avail = len - done;
+		}
+
+		memcpy((uint8_t*)buf + done, ls->m_buf + ls->m_pos, avail);
+		ls->m_pos += avail;
+		done += avail;
+	}
+
+	return (int)done;
+}
+
+static int scap_lz_write(scap_stream* s, const void* buf, unsigned int len)
+{
+	scap_lz_stream* ls = (scap_lz_stream*)s;
+	unsigned int done = 0;
+
+	while(done < len)
+	{
+		uint32_t room = SCAP_LZ_BLOCK_SIZE - ls->m_len;
+
+		if(room > len - done)
+		{
+			room = len - done;
+		}
+
+		memcpy(ls->m_buf + ls->m_len, (const uint8_t*)buf + done, room);
+		ls->m_len += room;
+		done += room;
+
+		if(ls->m_len == SCAP_LZ_BLOCK_SIZE && scap_lz_write_frame(ls) != 0)
+		{
+			return -1;
+		}
+	}
+
+	return (int)len;
+}
+
+//
+// Only used when reading. Backwards seeks are limited to the last
+// SCAP_LZ_KEEP bytes, which is enough to step back over a block header.
+//
+static int64_t scap_lz_seek(scap_stream* s, int64_t offset, int whence)
+{
+	scap_lz_stream* ls = (scap_lz_stream*)s;
+
+	if(ls->m_table != NULL)
+	{
+		return -1;
+	}
+
+	if(whence == SEEK_SET)
+	{
+		offset -= ls->m_buf_start + ls->m_pos;
+	}
+	else if(whence != SEEK_CUR)
+	{
+		return -1;
+	}
+
+	if(offset < 0)
+	{
+		if(-offset > ls->m_pos)
+		{
+			return -1;
+		}
+
+		ls->m_pos += (int32_t)offset;
+	}
+	else
+	{
+		while(offset > 0)
+		{
+			uint32_t avail = ls->m_len - ls->m_pos;
+
+			if(avail == 0)
+			{
+				if(scap_lz_read_frame(ls) <= 0)
+				{
+					return -1;
+				}
+
+				continue;
+			}
+
+			if(avail > offset)
+			{
+				avail = (uint32_t)offset;
+			}
+
+			ls->m_pos += avail;
+			offset -= avail;
+		}
+	}
+
+	return ls->m_buf_start + ls->m_pos;
+}
+
+static int64_t scap_lz_offset(scap_stream* s)
+{
+	return ((scap_lz_stream*)s)->m_offset;
+}
+
+static int scap_lz_flush(scap_stream* s)
+{
+	scap_lz_stream* ls = (scap_lz_stream*)s;
+
+	if(ls->m_table == NULL)
+	{
+		return 0;
+	}
+
+	if(scap_lz_write_frame(ls) != 0)
+	{
+		return -1;
+	}
+
+	return fflush(ls->m_f);
+}
+
+static int scap_lz_close(scap_stream* s)
+{
+	scap_lz_stream* ls = (scap_lz_stream*)s;
+	int res = 0;
+
+	if(ls->m_table != NULL)
+	{
+		res = scap_lz_write_frame(ls);
+		free(ls->m_table);
+	}
+
+	if(fclose(ls->m_f) != 0 || ls->m_error)
+	{
+		res = -1;
+	}
+
+	free(ls->m_buf);
+	free(ls->m_zbuf);
+	free(ls);
+
+	return res;
+}
+
+static const scap_stream_ops g_scap_lz_ops =
+{
+	scap_lz_read,
+	scap_lz_write,
+	scap_lz_seek,
+	scap_lz_offset,
+	scap_lz_flush,
+	scap_lz_close
+};
+
+static scap_stream* scap_lz_stream_create(FILE* f, bool write)
+{
+	scap_lz_stream* ls;
+
+	if(f == NULL)
+	{
+		return NULL;
+	}
+
+	ls = (scap_lz_stream*)calloc(1, sizeof(scap_lz_stream));
+	if(ls == NULL)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	ls->m_stream.m_ops = &g_scap_lz_ops;
+	ls->m_f = f;
+	ls->m_buf = (uint8_t*)malloc(SCAP_LZ_KEEP + SCAP_LZ_BLOCK_SIZE);
+	ls->m_zbuf = (uint8_t*)malloc(SCAP_LZ_BOUND(SCAP_LZ_BLOCK_SIZE));
+	if(write)
+	{
+		ls->m_table = (uint32_t*)malloc(sizeof(uint32_t) << SCAP_LZ_HASH_BITS);
+	}
+
+	if(ls->m_buf == NULL || ls->m_zbuf == NULL || (write && ls->m_table == NULL))
+	{
+		free(ls->m_table);
+		ls->m_table = NULL;
+		scap_lz_close(&ls->m_stream);
+		return NULL;
+	}
+
+	ls->m_offset = SCAP_LZ_MAGIC_LEN;
+
+	if(write && fwrite(SCAP_LZ_MAGIC, 1, SCAP_LZ_MAGIC_LEN, f) != SCAP_LZ_MAGIC_LEN)
+	{
+		scap_lz_close(&ls->m_stream);
+		return NULL;
+	}
+
+	return &ls->m_stream;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BUFFERED READ STREAMS
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Reader for gzip compressed and uncompressed files. Unlike gzread, it reads
+// the file with its own input buffer, so the offset in the file on disk, used
+// to report the read progress, is a counter updated when the buffer is
+// refilled rather than a query to zlib and to the operating system.
+//
+#define SCAP_ZR_IN_SIZE (64 * 1024)
+#define SCAP_ZR_BLOCK_SIZE (256 * 1024)
+//
+// Number of already consumed bytes kept in front of the read buffer, so that
+// the reader can step back over a block header, like the LZ reader
+//
+#define SCAP_ZR_KEEP 64
+
+typedef struct scap_zr_stream
+{
+	scap_stream m_stream;
+	FILE* m_f;
+	uint8_t* m_buf; // Decompressed data
+	uint32_t m_len; // Valid bytes in m_buf
+	uint32_t m_pos; // Read position in m_buf
+	int64_t m_offset; // Bytes read from m_f
+	int64_t m_buf_start; // Uncompressed offset of m_buf[0]
+	bool m_gzip; // false if the file is not compressed
+	bool m_eof; // m_f has been read completely
+	bool m_error;
+#ifdef USE_ZLIB
+	uint8_t* m_in; // Data read from m_f and not decompressed yet
+	z_stream m_strm;
+#endif
+}scap_zr_stream;
+
+#ifdef USE_ZLIB
+//
+// Move the unconsumed input to the start of the input buffer and fill the
+// rest of it. Returns the number of new bytes, 0 at the end of the file, -1 on
+// error.
+//
+static int64_t scap_zr_fill_input(scap_zr_stream* zs)
+{
+	size_t readsize;
+
+	if(zs->m_eof)
+	{
+		return 0;
+	}
+
+	memmove(zs->m_in, zs->m_strm.next_in, zs->m_strm.avail_in);
+	zs->m_strm.next_in = zs->m_in;
+
+	readsize = fread(zs->m_in + zs->m_strm.avail_in, 1, SCAP_ZR_IN_SIZE - zs->m_strm.avail_in, zs->m_f);
+	if(readsize < SCAP_ZR_IN_SIZE - zs->m_strm.avail_in)
+	{
+		if(ferror(zs->m_f))
+		{
+			zs->m_error = true;
+			return -1;
+		}
+
+		zs->m_eof = true;
+	}
+
+	zs->m_offset += readsize;
+	zs->m_strm.avail_in += (uInt)readsize;
+
+	return readsize;
+}
+
+//
+// Decompress up to len bytes into dst. Returns the number of decompressed
+// bytes, which is less than len only at the end of the file, or -1 on error.
+//
+static int64_t scap_zr_inflate(scap_zr_stream* zs, uint8_t* dst, uint32_t len)
+{
+	zs->m_strm.next_out = dst;
+	zs->m_strm.avail_out = len;
+
+	while(zs->m_strm.avail_out != 0)
+	{
+		int res;
+
+		if(zs->m_strm.avail_in == 0)
+		{
+			int64_t readsize = scap_zr_fill_input(zs);
+
+			if(readsize < 0)
+			{
+				return -1;
+			}
+			else if(readsize == 0)
+			{
+				break;
+			}
+		}
+
+		res = inflate(&zs->m_strm, Z_NO_FLUSH);
+
+		if(res == Z_STREAM_END)
+		{
+			//
+			// Like gzread, continue with the next gzip member if there's one,
+			// and ignore anything else that follows
+			//
+			if(zs->m_strm.avail_in < 2 && scap_zr_fill_input(zs) < 0)
+			{
+				return -1;
+			}
+
+			if(zs->m_strm.avail_in < 2 ||
+			        zs->m_strm.next_in[0] != 0x1f ||
+			        zs->m_strm.next_in[1] != 0x8b)
+			{
+				zs->m_strm.avail_in = 0;
+				zs->m_eof = true;
+				break;
+			}
+
+			if(inflateReset(&zs->m_strm) != Z_OK)
+			{
+				zs->m_error = true;
+				return -1;
+			}
+		}
+		else if(res != Z_OK && res != Z_BUF_ERROR)
+		{
+			zs->m_error = true;
+			return -1;
+		}
+	}
+
+	return len - zs->m_strm.avail_out;
+}
+#endif
+
+//
+// Load the next block of data into the read buffer.
+// Returns the number of new bytes, 0 at the end of the file, -1 on error.
+//
+static int64_t scap_zr_read_block(scap_zr_stream* zs)
+{
+	uint32_t keep;
+	int64_t rawlen;
+
+	if(zs->m_error)
+	{
+		return -1;
+	}
+
+	keep = zs->m_len < SCAP_ZR_KEEP ? zs->m_len : SCAP_ZR_KEEP;
+	memmove(zs->m_buf, zs->m_buf + zs->m_len - keep, keep);
+	zs->m_buf_start += zs->m_len - keep;
+	zs->m_len = keep;
+	zs->m_pos = keep;
+
+#ifdef USE_ZLIB
+	if(zs->m_gzip)
+	{
+		rawlen = scap_zr_inflate(zs, zs->m_buf + keep, SCAP_ZR_BLOCK_SIZE);
+		if(rawlen < 0)
+		{
+			return -1;
+		}
+	}
+	else
+#endif
+	{
+		rawlen = fread(zs->m_buf + keep, 1, SCAP_ZR_BLOCK_SIZE, zs->m_f);
+		if(rawlen < SCAP_ZR_BLOCK_SIZE && ferror(zs->m_f))
+		{
+			zs->m_error = true;
+			return -1;
+		}
+
+		zs->m_offset += rawlen;
+	}
+
+	zs->m_len += (uint32_t)rawlen;
+
+	return rawlen;
+}
+
+static int scap_zr_read(scap_stream* s, void* buf, unsigned int len)
+{
+	scap_zr_stream* zs = (scap_zr_stream*)s;
+	unsigned int done = 0;
+
+	while(done < len)
+	{
+		uint32_t avail = zs->m_len - zs->m_pos;
+
+		if(avail == 0)
+		{
+			int64_t res = scap_zr_read_block(zs);
+
+			if(res <= 0)
+			{
+				return (res < 0) ? -1 : (int)done;
+			}
+
+			continue;
+		}
+
+		if(avail > len - done)
+		{
+			avail = len - done;
+		}
+
+		memcpy((uint8_t*)buf + done, zs->m_buf + zs->m_pos, avail);
+		zs->m_pos += avail;
+		done += avail;
+	}
+
+	return (int)done;
+}
+
+static int scap_zr_write(scap_stream* s, const void* buf, unsigned int len)
+{
+	return -1;
+}
+
+//
+// Backwards seeks are limited to the last SCAP_ZR_KEEP bytes
+//
+static int64_t scap_zr_seek(scap_stream* s, int64_t offset, int whence)
+{
+	scap_zr_stream* zs = (scap_zr_stream*)s;
+
+	if(whence == SEEK_SET)
+	{
+		offset -= zs->m_buf_start + zs->m_pos;
+	}
+	else if(whence != SEEK_CUR)
+	{
+		return -1;
+	}
+
+	if(offset < 0)
+	{
+		if(-offset > zs->m_pos)
+		{
+			return -1;
+		}
+
+		zs->m_pos += (int32_t)offset;
+	}
+	else
+	{
+		while(offset > 0)
+		{
+			uint32_t avail = zs->m_len - zs->m_pos;
+
+			if(avail == 0)
+			{
+				if(scap_zr_read_block(zs) <= 0)
+				{
+					return -1;
+				}
+
+				continue;
+			}
+
+			if(avail > offset)
+			{
+				avail = (uint32_t)offset;
+			}
+
+			zs->m_pos += avail;
+			offset -= avail;
+		}
+	}
+
+	return zs->m_buf_start + zs->m_pos;
+}
+
+static int64_t scap_zr_offset(scap_stream* s)
+{
+	return ((scap_zr_stream*)s)->m_offset;
+}
+
+static int scap_zr_flush(scap_stream* s)
+{
+	return 0;
+}
+
+static int scap_zr_close(scap_stream* s)
+{
+	scap_zr_stream* zs = (scap_zr_stream*)s;
+	int res = 0;
+
+#ifdef USE_ZLIB
+	if(zs->m_in != NULL)
+	{
+		inflateEnd(&zs->m_strm);
+		free(zs->m_in);
+	}
+#endif
+
+	if(fclose(zs->m_f) != 0 || zs->m_error)
+	{
+		res = -1;
+	}
+
+	free(zs->m_buf);
+	free(zs);
+
+	return res;
+}
+
+static const scap_stream_ops g_scap_zr_ops =
+{
+	scap_zr_read,
+	scap_zr_write,
+	scap_zr_seek,
+	scap_zr_offset,
+	scap_zr_flush,
+	scap_zr_close
+};
+
+//
+// f must be positioned at the start of the file
+//
+static scap_stream* scap_zr_stream_create(FILE* f, bool gzip)
+{
+	scap_zr_stream* zs;
+
+	zs = (scap_zr_stream*)calloc(1, sizeof(scap_zr_stream));
+	if(zs == NULL)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	zs->m_stream.m_ops = &g_scap_zr_ops;
+	zs->m_f = f;
+	zs->m_buf = (uint8_t*)malloc(SCAP_ZR_KEEP + SCAP_ZR_BLOCK_SIZE);
+	if(zs->m_buf == NULL)
+	{
+		scap_zr_close(&zs->m_stream);
+		return NULL;
+	}
+
+#ifdef USE_ZLIB
+	if(gzip)
+	{
+		zs->m_gzip = true;
+
+		//
+		// 16 + MAX_WBITS: gzip header and trailer
+		//
+		if(inflateInit2(&zs->m_strm, 16 + MAX_WBITS) != Z_OK)
+		{
+			scap_zr_close(&zs->m_stream);
+			return NULL;
+		}
+
+		zs->m_in = (uint8_t*)malloc(SCAP_ZR_IN_SIZE);
+		if(zs->m_in == NULL)
+		{
+			inflateEnd(&zs->m_strm);
+			scap_zr_close(&zs->m_stream);
+			return NULL;
+		}
+
+		zs->m_strm.next_in = zs->m_in;
+		zs->m_strm.avail_in = 0;
+	}
+#endif
+
+	return &zs->m_stream;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// STREAM CREATION
+///////////////////////////////////////////////////////////////////////////////
+scap_stream* scap_stream_open_read(const char* fname)
+{
+	char magic[SCAP_LZ_MAGIC_LEN];
+	size_t magiclen;
+	FILE* f = fopen(fname, "rb");
+
+	if(f == NULL)
+	{
+		return NULL;
+	}
+
+	magiclen = fread(magic, 1, sizeof(magic), f);
+
+	if(magiclen == sizeof(magic) &&
+	        memcmp(magic, SCAP_LZ_MAGIC, sizeof(magic)) == 0)
+	{
+		return scap_lz_stream_create(f, false);
+	}
+
+	//
+	// Everything else is either gzip compressed or not compressed
+	//
+	if(fseek(f, 0, SEEK_SET) != 0)
+	{
+		fclose(f);
+		return NULL;
+	}
+
+	return scap_zr_stream_create(f, magiclen >= 2 && (uint8_t)magic[0] == 0x1f && (uint8_t)magic[1] == 0x8b);
+}
+
+scap_stream* scap_stream_open_write(const char* fname, int fd, compression_mode compress)
+{
+	const char* mode;
+	scap_stream* s;
+
+	switch(compress)
+	{
+	case SCAP_COMPRESSION_LZ:
+		mode = NULL;
+		break;
+	case SCAP_COMPRESSION_GZIP:
+	case SCAP_COMPRESSION_EVTCODEC:
+		mode = "wb";
+		break;
+	case SCAP_COMPRESSION_NONE:
+		mode = "wbT";
+		break;
+	default:
+		ASSERT(false);
+		return NULL;
+	}
+
+	if(fd != -1)
+	{
+		if(mode == NULL)
+		{
+			s = scap_lz_stream_create(fdopen(fd, "wb"), true);
+		}
+		else
+		{
+			s = scap_gz_stream_create(gzdopen(fd, mode));
+		}
+	}
+	else
+	{
+		if(mode == NULL)
+		{
+			s = scap_lz_stream_create(fopen(fname, "wb"), true);
+		}
+		else
+		{
+			s = scap_gz_stream_create(gzopen(fname, mode));
+		}
+	}
+
+	return s;
+}
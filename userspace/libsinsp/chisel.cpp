@@ -127,6 +127,7 @@ const static struct luaL_reg ll_chisel [] =
 	{"set_event_formatter", &lua_cbacks::set_event_formatter},
 	{"set_interval_ns", &lua_cbacks::set_interval_ns},
 	{"set_interval_s", &lua_cbacks::set_interval_s},
+	{"set_table", &lua_cbacks::set_table},
 	{"exec", &lua_cbacks::exec},
 	{NULL,NULL}
 };
@@ -134,6 +135,7 @@ const static struct luaL_reg ll_chisel [] =
 const static struct luaL_reg ll_evt [] = 
 {
 	{"field", &lua_cbacks::field},
+	{"fields", &lua_cbacks::fields},
 	{"get_num", &lua_cbacks::get_num},
 	{"get_ts", &lua_cbacks::get_ts},
 	{"get_type", &lua_cbacks::get_type},
@@ -232,6 +234,9 @@ sinsp_chisel::sinsp_chisel(sinsp* inspector, string filename)
 	m_lua_has_handle_evt = false;
 	m_lua_is_first_evt = true;
 	m_lua_cinfo = NULL;
+	m_lua_evt = NULL;
+	m_lua_table = NULL;
+	m_lua_table_top_number = 0;
 	m_lua_last_interval_sample_time = 0;
 	m_lua_last_interval_ts = 0;
 
@@ -264,6 +269,12 @@ void sinsp_chisel::free_lua_chisel()
 		m_lua_cinfo = NULL;
 	}
 
+	if(m_lua_table != NULL)
+	{
+		delete m_lua_table;
+		m_lua_table = NULL;
+	}
+
 	m_lua_script_info.reset();
 #endif
 }
@@ -376,6 +387,26 @@ sinsp_field_aggregation sinsp_chisel::string_to_aggregation(string ag)
 	{
 		res = A_MAX;
 	}
+	else if(ag == "DISTINCT")
+	{
+		res = A_DISTINCT;
+	}
+	else if(ag == "P50")
+	{
+		res = A_P50;
+	}
+	else if(ag == "P90")
+	{
+		res = A_P90;
+	}
+	else if(ag == "P95")
+	{
+		res = A_P95;
+	}
+	else if(ag == "P99")
+	{
+		res = A_P99;
+	}
 	else
 	{
 		throw sinsp_exception("unknown view column aggregation " + ag);
@@ -1019,7 +1050,13 @@ void sinsp_chisel::load(string cmdstr)
 	//
 	luaL_openlib(m_ls, "sysdig", ll_sysdig, 0);
 	luaL_openlib(m_ls, "chisel", ll_chisel, 0);
-	luaL_openlib(m_ls, "evt", ll_evt, 0);
+
+	//
+	// The evt functions find the chisel, and through it the current event, in
+	// their upvalue, which is faster than a global lookup
+	//
+	lua_pushlightuserdata(m_ls, this);
+	luaL_openlib(m_ls, "evt", ll_evt, 1);
 
 	//
 	// Add our chisel paths to package.path
@@ -1316,6 +1353,14 @@ void sinsp_chisel::on_init()
 
 	lua_pop(m_ls, 1);
 
+	//
+	// init() can remove on_event, e.g. when a table aggregates the events
+	// natively
+	//
+	lua_getglobal(m_ls, "on_event");
+	m_lua_has_handle_evt = (lua_isfunction(m_ls, -1) != 0);
+	lua_pop(m_ls, 1);
+
 	//
 	// If the chisel called chisel.exec(), free this chisel and load the new one
 	//
@@ -1359,9 +1404,58 @@ void sinsp_chisel::first_event_inits(sinsp_evt* evt)
 		m_lua_last_interval_sample_time = ts - ts % m_lua_cinfo->m_callback_interval;
 	}
 
+	//
+	// Start the first sample of the table
+	//
+	if(m_lua_table != NULL)
+	{
+		m_lua_table->flush(evt);
+	}
+
 	m_lua_is_first_evt = false;
 }
 
+//
+// Push the rows of the last table sample as an array of arrays, each with the
+// values of the columns in the order in which the chisel declared them
+//
+void sinsp_chisel::push_lua_table_rows(uint64_t time_delta)
+{
+	vector<sinsp_sample_row>* sample = m_lua_table->get_sample(time_delta);
+	vector<filtercheck_field_info>* legend = m_lua_table->get_legend();
+	uint32_t nrows = (uint32_t)sample->size();
+	uint32_t ncols = (uint32_t)m_lua_table_cols.size();
+
+	if(m_lua_table_top_number != 0 && nrows > m_lua_table_top_number)
+	{
+		nrows = m_lua_table_top_number;
+	}
+
+	lua_createtable(m_ls, nrows, 0);
+
+	for(uint32_t j = 0; j < nrows; j++)
+	{
+		sinsp_sample_row* row = &sample->at(j);
+
+		lua_createtable(m_ls, ncols, 0);
+
+		for(uint32_t k = 0; k < ncols; k++)
+		{
+			uint32_t col = m_lua_table_cols[k];
+			sinsp_table_field* fld = (col == 0)? &row->m_key : &row->m_values[col - 1];
+
+			if(lua_cbacks::table_field_to_lua_stack(m_ls, fld, &legend->at(col), m_lua_table_aggregations[k], time_delta) == 0)
+			{
+				lua_pushnil(m_ls);
+			}
+
+			lua_rawseti(m_ls, -2, k + 1);
+		}
+
+		lua_rawseti(m_ls, -2, j + 1);
+	}
+}
+
 bool sinsp_chisel::run(sinsp_evt* evt)
 {
 #ifdef HAS_LUA_CHISELS
@@ -1372,8 +1466,7 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 	//
 	// Make the event available to the API
 	//
-	lua_pushlightuserdata(m_ls, evt);
-	lua_setglobal(m_ls, "sievt");
+	m_lua_evt = evt;
 
 	//
 	// If this is the first event, put the event pointer on the stack.
@@ -1400,6 +1493,14 @@ bool sinsp_chisel::run(sinsp_evt* evt)
 		}
 	}
 
+	//
+	// If the script has a table, let it aggregate the event
+	//
+	if(m_lua_table != NULL)
+	{
+		m_lua_table->process_event(evt);
+	}
+
 	//
 	// If the script has the on_event callback, call it
 	//
@@ -1469,7 +1570,20 @@ void sinsp_chisel::do_timeout(sinsp_evt* evt)
 			lua_pushnumber(m_ls, (double)(ts % 1000000000)); 
 			lua_pushnumber(m_ls, (double)delta); 
 
-			if(lua_pcall(m_ls, 3, 1, 0) != 0) 
+			//
+			// If the script has a table, the sample that has just ended is
+			// passed to on_interval() too
+			//
+			int nargs = 3;
+
+			if(m_lua_table != NULL)
+			{
+				m_lua_table->flush(evt);
+				push_lua_table_rows(delta);
+				nargs++;
+			}
+
+			if(lua_pcall(m_ls, nargs, 1, 0) != 0) 
 			{
 				throw sinsp_exception(m_filename + " chisel error: calling on_interval() failed:" + lua_tostring(m_ls, -1));
 			}
@@ -1550,7 +1664,24 @@ void sinsp_chisel::on_capture_end()
 		lua_pushnumber(m_ls, (double)(te % 1000000000)); 
 		lua_pushnumber(m_ls, (double)delta);
 
-		if(lua_pcall(m_ls, 3, 0, 0) != 0) 
+		int nargs = 3;
+
+		if(m_lua_table != NULL)
+		{
+			if(m_lua_is_first_evt)
+			{
+				lua_newtable(m_ls);
+			}
+			else
+			{
+				m_lua_table->flush(NULL);
+				push_lua_table_rows(m_lua_last_interval_ts != 0? te - m_lua_last_interval_ts : delta);
+			}
+
+			nargs++;
+		}
+
+		if(lua_pcall(m_ls, nargs, 0, 0) != 0) 
 		{
 			throw sinsp_exception(m_filename + " chisel error: " + lua_tostring(m_ls, -1));
 		}
@@ -23,6 +23,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 class sinsp_filter_check;
 class sinsp_evt_formatter;
 class sinsp_view_info;
+class sinsp_table;
 
 typedef struct lua_State lua_State;
 
@@ -136,6 +137,7 @@ private:
 	static bool parse_view_info(lua_State *ls, OUT chisel_desc* cd);
 	static bool init_lua_chisel(chisel_desc &cd, string const &path);
 	void first_event_inits(sinsp_evt* evt);
+	void push_lua_table_rows(uint64_t time_delta);
 
 	sinsp* m_inspector;
 	string m_description;
@@ -150,6 +152,15 @@ private:
 	vector<sinsp_filter_check*> m_allocated_fltchecks;
 	char m_lua_fld_storage[1024];
 	chiselinfo* m_lua_cinfo;
+	sinsp_evt* m_lua_evt; // The event being processed, for the evt.* functions
+	//
+	// The table created with chisel.set_table(), which aggregates the events
+	// natively instead of in on_event()
+	//
+	sinsp_table* m_lua_table;
+	uint32_t m_lua_table_top_number;
+	vector<uint32_t> m_lua_table_cols; // Table column of every column declared by the chisel
+	vector<sinsp_field_aggregation> m_lua_table_aggregations;
 	string m_new_chisel_to_exec;
 
 	friend class lua_cbacks;
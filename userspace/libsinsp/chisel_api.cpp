@@ -35,6 +35,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "chisel_api.h"
 #include "filter.h"
 #include "filterchecks.h"
+#include "table.h"
 #ifdef HAS_ANALYZER
 #include "analyzer.h"
 #endif
@@ -60,7 +61,7 @@ void lua_stackdump(lua_State *L);
 ///////////////////////////////////////////////////////////////////////////////
 #ifdef HAS_LUA_CHISELS
 
-uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len)
+uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len, sinsp_chisel* ch)
 {
 	ASSERT(rawval != NULL);
 	ASSERT(finfo != NULL);
@@ -116,9 +117,12 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 			}
 			else
 			{
-				lua_getglobal(ls, "sichisel");
-				sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
-				lua_pop(ls, 1);
+				if(ch == NULL)
+				{
+					lua_getglobal(ls, "sichisel");
+					ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+					lua_pop(ls, 1);
+				}
 
 				uint32_t max_len = len < sizeof(ch->m_lua_fld_storage) ?
 					len : sizeof(ch->m_lua_fld_storage) - 1;
@@ -139,9 +143,12 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 			return 1;
 		case PT_IPV4ADDR:
 			{
-				lua_getglobal(ls, "sichisel");
-				sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
-				lua_pop(ls, 1);
+				if(ch == NULL)
+				{
+					lua_getglobal(ls, "sichisel");
+					ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+					lua_pop(ls, 1);
+				}
 
 				snprintf(ch->m_lua_fld_storage,
 							sizeof(ch->m_lua_fld_storage),
@@ -162,11 +169,43 @@ uint32_t lua_cbacks::rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const f
 	}
 }
 
+//
+// Push a value of a native table row. Like in the csysdig views, averages
+// are divided by their number of entries, and time averages are turned into
+// per second values. As there, samples shorter than a second are not scaled.
+//
+uint32_t lua_cbacks::table_field_to_lua_stack(lua_State *ls, sinsp_table_field* fld, const filtercheck_field_info* finfo, sinsp_field_aggregation aggregation, uint64_t time_delta)
+{
+	uint32_t res = rawval_to_lua_stack(ls, fld->m_val, finfo, fld->m_len);
+
+	if(res == 1 && lua_type(ls, -1) == LUA_TNUMBER)
+	{
+		double val = lua_tonumber(ls, -1);
+		double div = 1;
+
+		if(aggregation == A_TIME_AVG && time_delta != 0)
+		{
+			div = (double)time_delta / ONE_SECOND_IN_NS;
+		}
+		else if(fld->m_cnt > 1)
+		{
+			div = fld->m_cnt;
+		}
+
+		if(div > 1)
+		{
+			lua_pop(ls, 1);
+			lua_pushnumber(ls, val / div);
+		}
+	}
+
+	return res;
+}
+
 int lua_cbacks::get_num(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
 
 	if(evt == NULL)
 	{
@@ -181,9 +220,8 @@ int lua_cbacks::get_num(lua_State *ls)
 
 int lua_cbacks::get_ts(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
 
 	if(evt == NULL)
 	{
@@ -201,9 +239,8 @@ int lua_cbacks::get_ts(lua_State *ls)
 
 int lua_cbacks::get_type(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
 
 	if(evt == NULL)
 	{
@@ -235,9 +272,8 @@ int lua_cbacks::get_type(lua_State *ls)
 
 int lua_cbacks::get_cpuid(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
 
 	if(evt == NULL)
 	{
@@ -282,6 +318,7 @@ int lua_cbacks::request_field(lua_State *ls)
 	}
 
 	chk->parse_field_name(fld, true);
+	chk->m_cache_key = fld;
 
 	lua_pushlightuserdata(ls, chk);
 
@@ -292,9 +329,8 @@ int lua_cbacks::request_field(lua_State *ls)
 
 int lua_cbacks::field(lua_State *ls) 
 {
-	lua_getglobal(ls, "sievt");
-	sinsp_evt* evt = (sinsp_evt*)lua_touserdata(ls, -1);
-	lua_pop(ls, 1);
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
 
 	if(evt == NULL)
 	{
@@ -315,11 +351,11 @@ int lua_cbacks::field(lua_State *ls)
 	}
 
 	uint32_t vlen;
-	uint8_t* rawval = chk->extract(evt, &vlen);
+	uint8_t* rawval = chk->extract_cached(evt, &vlen);
 
 	if(rawval != NULL)
 	{
-		return rawval_to_lua_stack(ls, rawval, chk->get_field_info(), vlen);
+		return rawval_to_lua_stack(ls, rawval, chk->get_field_info(), vlen, ch);
 	}
 	else
 	{
@@ -328,6 +364,47 @@ int lua_cbacks::field(lua_State *ls)
 	}
 }
 
+//
+// Like field(), but for any number of fields at once, e.g.
+// local pid, name = evt.fields(fpid, fname)
+// Returns one value per field, nil for the ones that are not available.
+//
+int lua_cbacks::fields(lua_State *ls) 
+{
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, lua_upvalueindex(1));
+	sinsp_evt* evt = ch->m_lua_evt;
+
+	if(evt == NULL)
+	{
+		string err = "invalid call to evt.fields()";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	int nflds = lua_gettop(ls);
+
+	luaL_checkstack(ls, nflds, "too many fields in evt.fields()");
+
+	for(int j = 1; j <= nflds; j++)
+	{
+		sinsp_filter_check* chk = (sinsp_filter_check*)lua_topointer(ls, j);
+		uint8_t* rawval = NULL;
+		uint32_t vlen = 0;
+
+		if(chk != NULL)
+		{
+			rawval = chk->extract_cached(evt, &vlen);
+		}
+
+		if(rawval == NULL || rawval_to_lua_stack(ls, rawval, chk->get_field_info(), vlen, ch) == 0)
+		{
+			lua_pushnil(ls);
+		}
+	}
+
+	return nflds;
+}
+
 int lua_cbacks::set_global_filter(lua_State *ls) 
 {
 	lua_getglobal(ls, "sichisel");
@@ -1172,6 +1249,155 @@ int lua_cbacks::set_interval_s(lua_State *ls)
 	return 0;
 }
 
+int lua_cbacks::set_table(lua_State *ls) 
+{
+	lua_getglobal(ls, "sichisel");
+
+	sinsp_chisel* ch = (sinsp_chisel*)lua_touserdata(ls, -1);
+	lua_pop(ls, 1);
+
+	ASSERT(ch);
+	ASSERT(ch->m_lua_cinfo);
+
+	if(!lua_istable(ls, 1))
+	{
+		string err = "chisel.set_table() in chisel " + ch->m_filename + " requires a table argument";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	if(ch->m_lua_table != NULL)
+	{
+		string err = "chisel " + ch->m_filename + " can only call chisel.set_table() once";
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	vector<sinsp_view_column_info> columns;
+	string filter;
+	uint32_t top_number = 0;
+	sinsp_table* table = NULL;
+
+	try
+	{
+		//
+		// The table definition has the same format as the columns and the
+		// filter of a csysdig view, plus the number of rows to return
+		//
+		lua_pushnil(ls);
+
+		while(lua_next(ls, 1) != 0)
+		{
+			string fldname = lua_tostring(ls, -2);
+
+			if(fldname == "columns")
+			{
+				if(!lua_istable(ls, -1))
+				{
+					throw sinsp_exception("columns is not a table");
+				}
+
+				sinsp_chisel::parse_view_columns(ls, NULL, &columns);
+			}
+			else if(fldname == "filter")
+			{
+				if(!lua_isstring(ls, -1))
+				{
+					throw sinsp_exception("filter must be a string");
+				}
+
+				filter = lua_tostring(ls, -1);
+			}
+			else if(fldname == "top_number")
+			{
+				if(!lua_isnumber(ls, -1))
+				{
+					throw sinsp_exception("top_number must be a number");
+				}
+
+				top_number = (uint32_t)lua_tonumber(ls, -1);
+			}
+
+			lua_pop(ls, 1);
+		}
+
+		//
+		// Rows are returned with the columns in the order in which they are
+		// declared, while the table moves the key in front of the others
+		//
+		int32_t keycol = -1;
+
+		for(uint32_t j = 0; j < columns.size(); j++)
+		{
+			if((columns[j].m_flags & TEF_IS_GROUPBY_KEY) != 0)
+			{
+				throw sinsp_exception("group by is not supported in chisel tables");
+			}
+
+			if((columns[j].m_flags & TEF_IS_KEY) != 0 && keycol == -1)
+			{
+				keycol = j;
+			}
+		}
+
+		sinsp_view_info vinfo(sinsp_view_info::T_TABLE,
+			ch->m_filename,
+			ch->m_filename,
+			"",
+			vector<string>(),
+			vector<string>(),
+			columns,
+			vector<string>(),
+			filter,
+			"",
+			false,
+			false);
+
+		table = new sinsp_table(ch->m_inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS, false);
+		table->configure(&vinfo.m_columns, filter, false);
+		table->set_sorting_col(vinfo.m_sortingcol);
+		table->set_topk(top_number);
+		table->set_include_proctable(false);
+
+		ch->m_lua_table_cols.clear();
+		ch->m_lua_table_aggregations.clear();
+
+		for(uint32_t j = 0; j < columns.size(); j++)
+		{
+			if((int32_t)j == keycol)
+			{
+				ch->m_lua_table_cols.push_back(0);
+			}
+			else if((int32_t)j < keycol)
+			{
+				ch->m_lua_table_cols.push_back(j + 1);
+			}
+			else
+			{
+				ch->m_lua_table_cols.push_back(j);
+			}
+
+			ch->m_lua_table_aggregations.push_back(columns[j].m_aggregation);
+		}
+	}
+	catch(sinsp_exception& e)
+	{
+		if(table != NULL)
+		{
+			delete table;
+		}
+
+		string err = "invalid table in chisel " + ch->m_filename + ": " + e.what();
+		fprintf(stderr, "%s\n", err.c_str());
+		throw sinsp_exception("chisel error");
+	}
+
+	ch->m_lua_table = table;
+	ch->m_lua_table_top_number = top_number;
+
+	return 0;
+}
+
 int lua_cbacks::exec(lua_State *ls) 
 {
 	lua_getglobal(ls, "sichisel");
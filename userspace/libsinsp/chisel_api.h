@@ -20,10 +20,13 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #ifdef HAS_CHISELS
 
+class sinsp_table_field;
+
 class lua_cbacks
 {
 public:
-	static uint32_t rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len);
+	static uint32_t rawval_to_lua_stack(lua_State *ls, uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len, sinsp_chisel* ch = NULL);
+	static uint32_t table_field_to_lua_stack(lua_State *ls, sinsp_table_field* fld, const filtercheck_field_info* finfo, sinsp_field_aggregation aggregation, uint64_t time_delta);
 
 	static int get_num(lua_State *ls); 
 	static int get_ts(lua_State *ls);
@@ -31,6 +34,7 @@ public:
 	static int get_cpuid(lua_State *ls);
 	static int request_field(lua_State *ls);
 	static int field(lua_State *ls);
+	static int fields(lua_State *ls);
 	static int set_global_filter(lua_State *ls);
 	static int set_filter(lua_State *ls);
 	static int set_snaplen(lua_State *ls);
@@ -52,6 +56,7 @@ public:
 	static int set_event_formatter(lua_State *ls);
 	static int set_interval_ns(lua_State *ls);
 	static int set_interval_s(lua_State *ls);
+	static int set_table(lua_State *ls);
 	static int exec(lua_State *ls);
 	static int log(lua_State *ls);
 #ifdef HAS_ANALYZER
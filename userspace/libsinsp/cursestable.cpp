@@ -52,6 +52,8 @@ using namespace std;
 curses_table::curses_table(sinsp_cursesui* parent, sinsp* inspector, sinsp_table::tabletype type)
 {
 	m_tblwin = NULL;
+	m_framewin = NULL;
+	m_full_render_needed = true;
 	m_data = NULL;
 	m_table = NULL;
 	m_table_x_start = 0;
@@ -61,6 +63,7 @@ curses_table::curses_table(sinsp_cursesui* parent, sinsp* inspector, sinsp_table
 	m_parent = parent;
 	m_inspector = inspector;
 	m_type = type;
+	m_show_trends = false;
 
 	m_converter = new sinsp_filter_check_reference();
 
@@ -122,6 +125,7 @@ curses_table::curses_table(sinsp_cursesui* parent, sinsp* inspector, sinsp_table
 	//
 	refresh();
 	m_tblwin = newwin(m_h, m_w, m_table_y_start, 0);
+	m_drawwin = m_tblwin;
 }
 
 curses_table::~curses_table()
@@ -131,6 +135,11 @@ curses_table::~curses_table()
 		delwin(m_tblwin);
 	}
 
+	if(m_framewin)
+	{
+		delwin(m_framewin);
+	}
+
 	delete m_converter;
 }
 
@@ -264,9 +273,9 @@ void curses_table::print_wait()
 		}
 	}
 
-	wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
+	wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
 
-	mvwprintw(m_tblwin, 
+	mvwprintw(m_drawwin, 
 		m_parent->m_screenh / 2,
 		m_parent->m_screenw / 2 - wstr.size() / 2, 
 		wstr.c_str());	
@@ -274,19 +283,49 @@ void curses_table::print_wait()
 
 void curses_table::print_error(string wstr)
 {
-	wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::FAILED_SEARCH]);
+	wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::FAILED_SEARCH]);
 
-	mvwprintw(m_tblwin, 
+	mvwprintw(m_drawwin, 
 		m_parent->m_screenh / 2,
 		m_parent->m_screenw / 2 - wstr.size() / 2, 
 		wstr.c_str());	
 }
 
-void curses_table::render(bool data_changed)
+void curses_table::render(bool data_changed, bool incremental)
 {
 	uint32_t j, k;
 	int32_t l, m;
-	wclear(m_tblwin);
+
+	//
+	// Only the part of the lines that can be scrolled into view is painted
+	//
+	uint32_t fillw = MIN(m_w, m_parent->m_screenw + m_scrolloff_x);
+
+	//
+	// An incremental render draws the new frame off screen, and then copies
+	// the cells that changed to the table window, which still contains the
+	// previous frame. A full render clears the window, and with it the screen,
+	// and draws everything again.
+	//
+	if(incremental && data_changed && !m_full_render_needed)
+	{
+		int32_t h, w;
+		getmaxyx(m_tblwin, h, w);
+
+		if(m_framewin == NULL)
+		{
+			m_framewin = newpad(h, w);
+		}
+
+		m_drawwin = m_framewin;
+		werase(m_drawwin);
+	}
+	else
+	{
+		m_drawwin = m_tblwin;
+		wclear(m_drawwin);
+		m_full_render_needed = false;
+	}
 
 	//
 	// Clear the screen
@@ -329,24 +368,24 @@ void curses_table::render(bool data_changed)
 			m_selct = (int32_t)m_data->size() - 1;
 		}
 
-		wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
+		wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
 
 		//
 		// Render the column headers
 		//
-		wmove(m_tblwin, 0, 0);
-		for(j = 0; j < m_w; j++)
+		wmove(m_drawwin, 0, 0);
+		for(j = 0; j < fillw; j++)
 		{
 			if(m_type == sinsp_table::TT_TABLE)
 			{
-				wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
+				wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
 			}
 			else
 			{
-				wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_FOCUS]);
+				wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_FOCUS]);
 			}
 
-			waddch(m_tblwin, ' ');
+			waddch(m_drawwin, ' ');
 		}
 
 		for(j = 0, k = 0; j < m_legend.size(); j++)
@@ -355,22 +394,22 @@ void curses_table::render(bool data_changed)
 			{
 				if(m_type == sinsp_table::TT_TABLE)
 				{
-					wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
+					wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
 				}
 				else
 				{
-					wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_HIGHLIGHT]);					
+					wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_HIGHLIGHT]);					
 				}
 			}
 			else
 			{
 				if(m_type == sinsp_table::TT_TABLE)
 				{
-					wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
+					wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_FOCUS]);
 				}
 				else
 				{
-					wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_FOCUS]);
+					wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HEADER_LIST_FOCUS]);
 				}
 			}
 			
@@ -382,19 +421,17 @@ void curses_table::render(bool data_changed)
 				coltext = coltext.substr(0, m_legend[j].m_size - 1);
 			}
 
-			uint32_t tindex = m_table->m_do_merging? j + 2 : j + 1;
-
-			curses_table::alignment al = get_field_alignment(m_table->m_types->at(tindex));
+			curses_table::alignment al = get_field_alignment(m_legend[j].m_info.m_type);
 			if(al == curses_table::ALIGN_RIGHT)
 			{
 				coltext.insert(0, m_legend[j].m_size - coltext.size() - 1, ' ');
 			}
 
-			mvwaddnstr(m_tblwin, 0, k, coltext.c_str(), m_legend[j].m_size - 1);
+			mvwaddnstr(m_drawwin, 0, k, coltext.c_str(), m_legend[j].m_size - 1);
 
 			for(l = strlen(m_legend[j].m_name.c_str()); l < m_legend[j].m_size; l++)
 			{
-				waddch(m_tblwin, ' ');
+				waddch(m_drawwin, ' ');
 			}
 
 			k += m_legend[j].m_size;
@@ -412,6 +449,14 @@ void curses_table::render(bool data_changed)
 			}
 		}
 
+		//
+		// The table only sorts the top rows of the sample. Make sure that the
+		// visible ones are sorted, and that the next samples sort enough rows
+		// to cover them.
+		//
+		m_table->set_topk(m_firstrow + m_h);
+		m_table->extend_sort(m_firstrow + m_h);
+
 		//
 		// Render the rows
 		//
@@ -431,20 +476,20 @@ void curses_table::render(bool data_changed)
 			//
 			if(l == m_selct - (int32_t)m_firstrow)
 			{
-				wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
+				wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
 			}
 			else
 			{
-				wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
+				wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
 			}
 
 			//
 			// Render the row
 			//
-			wmove(m_tblwin, l + 1, 0);
-			for(j = 0; j < m_w; j++)
+			wmove(m_drawwin, l + 1, 0);
+			for(j = 0; j < fillw; j++)
 			{
-				waddch(m_tblwin, ' ');
+				waddch(m_drawwin, ' ');
 			}
 
 			for(j = 0, k = 0; j < m_legend.size(); j++)
@@ -474,7 +519,7 @@ void curses_table::render(bool data_changed)
 					size = m_w - k - 1;
 				}
 
-				mvwaddnstr(m_tblwin,
+				mvwaddnstr(m_drawwin,
 					l + 1,
 					k,
 					m_converter->tostring_nice(NULL, size, td),
@@ -484,17 +529,22 @@ void curses_table::render(bool data_changed)
 			}
 		}
 
-		wattrset(m_tblwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
+		if(m_show_trends)
+		{
+			render_trends(l);
+		}
+
+		wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PROCESS]);
 
 		if(l < (int32_t)m_h - 1)
 		{
 			for(m = l; m < (int32_t)m_h - 1; m++)
 			{
-				wmove(m_tblwin, m + 1, 0);
+				wmove(m_drawwin, m + 1, 0);
 
-				for(j = 0; j < m_w; j++)
+				for(j = 0; j < fillw; j++)
 				{
-					waddch(m_tblwin, ' ');
+					waddch(m_drawwin, ' ');
 				}
 			}
 		}
@@ -519,16 +569,156 @@ render_end:
 		chtype chstr[m_w];
 		for(j = 0; j < m_h; j++)
 		{
-			mvwinchnstr(m_tblwin, j, 0, chstr, m_parent->m_screenw + m_scrolloff_x);
-			mvwaddchnstr(m_tblwin, j, 0, chstr + m_scrolloff_x, m_parent->m_screenw);
+			mvwinchnstr(m_drawwin, j, 0, chstr, m_parent->m_screenw + m_scrolloff_x);
+			mvwaddchnstr(m_drawwin, j, 0, chstr + m_scrolloff_x, m_parent->m_screenw);
 		}
 	}
 
+	if(m_drawwin == m_framewin)
+	{
+		copy_changed_cells();
+	}
+
 	wrefresh(m_tblwin);
 	m_parent->render();
 	refresh();
 }
+
+//
+// Copy to the table window the runs of cells of the new frame that differ
+// from what is on the screen. Comparing with the screen, and not with the
+// previous content of the window, also removes whatever has been printed over
+// the table in the meantime, like the progress or the search messages.
+//
+void curses_table::copy_changed_cells()
+{
+	int32_t h, w;
+	int32_t by, bx;
+	int32_t x, y;
+
+	getmaxyx(m_tblwin, h, w);
+	getbegyx(m_tblwin, by, bx);
+
+	h = MIN(h, (int32_t)m_parent->m_screenh - by);
+	w = MIN(w, (int32_t)m_parent->m_screenw - bx);
+
+	if(h <= 0 || w <= 0)
+	{
+		return;
+	}
+
+	m_frame_line.resize(w + 1);
+	m_screen_line.resize(w + 1);
+
+	for(y = 0; y < h; y++)
+	{
+		mvwinchnstr(m_framewin, y, 0, &m_frame_line[0], w);
+		mvwinchnstr(curscr, y + by, bx, &m_screen_line[0], w);
+
+		for(x = 0; x < w;)
+		{
+			if(m_frame_line[x] == m_screen_line[x])
+			{
+				x++;
+				continue;
+			}
+
+			int32_t start = x;
+
+			while(x < w && m_frame_line[x] != m_screen_line[x])
+			{
+				x++;
+			}
+
+			mvwaddchnstr(m_tblwin, y, start, &m_frame_line[start], x - start);
+		}
+	}
+}
 	
+//
+// Draw, at the right of the visible part of the first nrows rows, a
+// sparkline with the recent values of the sorting column. Every line is
+// scaled to its own maximum.
+//
+void curses_table::render_trends(int32_t nrows)
+{
+	static const char levels[] = " .:-=+*#";
+	vector<sinsp_table_field*> keys;
+	vector<vector<double>> series;
+	int32_t l;
+	uint32_t j;
+
+	int32_t x = (int32_t)m_parent->m_screenw - m_table_x_start + (int32_t)m_scrolloff_x - CURSES_TABLE_TREND_WIDTH - 1;
+
+	if(x <= 0)
+	{
+		return;
+	}
+
+	for(l = 0; l < nrows; l++)
+	{
+		keys.push_back(&m_data->at(l + m_firstrow).m_key);
+	}
+
+	if(!m_table->get_history_series(&keys, m_table->get_sorting_col() - 1, CURSES_TABLE_TREND_WIDTH, &series))
+	{
+		return;
+	}
+
+	wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
+	mvwprintw(m_drawwin, 0, x - 1, " %-*s", CURSES_TABLE_TREND_WIDTH, "TREND");
+
+	for(l = 0; l < nrows; l++)
+	{
+		vector<double>* vals = &series[l];
+		double max = 0;
+		char line[CURSES_TABLE_TREND_WIDTH + 1];
+
+		for(j = 0; j < vals->size(); j++)
+		{
+			if(vals->at(j) > max)
+			{
+				max = vals->at(j);
+			}
+		}
+
+		//
+		// The trend ends at the right border, even if the history is short
+		//
+		uint32_t start = CURSES_TABLE_TREND_WIDTH - (uint32_t)vals->size();
+
+		for(j = 0; j < CURSES_TABLE_TREND_WIDTH; j++)
+		{
+			uint32_t level = 0;
+
+			if(j >= start && max > 0 && vals->at(j - start) > 0)
+			{
+				level = (uint32_t)(vals->at(j - start) / max * (sizeof(levels) - 2) + 0.5);
+
+				if(level == 0)
+				{
+					level = 1;
+				}
+			}
+
+			line[j] = levels[level];
+		}
+
+		line[CURSES_TABLE_TREND_WIDTH] = 0;
+
+		if(l == m_selct - (int32_t)m_firstrow)
+		{
+			wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PANEL_HIGHLIGHT_FOCUS]);
+		}
+		else
+		{
+			wattrset(m_drawwin, m_parent->m_colors[sinsp_cursesui::PROCESS_MEGABYTES]);
+		}
+
+		mvwprintw(m_drawwin, l + 1, x - 1, " %s", line);
+	}
+}
+
 //
 // Return false if the user wants us to exit
 //
@@ -687,6 +877,14 @@ sysdig_table_action curses_table::handle_input(int ch)
 				}
 			}
 			break;
+		case 't':
+			if(m_type == sinsp_table::TT_TABLE && m_table->has_history())
+			{
+				m_show_trends = !m_show_trends;
+				render(true);
+				return STA_NONE;
+			}
+			break;
 		case 'c':
 		case KEY_DC:
 			if(m_type == sinsp_table::TT_LIST)
@@ -729,6 +927,15 @@ void curses_table::recreate_win(int h)
 	delwin(m_tblwin);
 	m_h = h;
 	m_tblwin = newwin(m_h, 500, m_table_y_start, m_table_x_start);
+	m_drawwin = m_tblwin;
+
+	if(m_framewin)
+	{
+		delwin(m_framewin);
+		m_framewin = NULL;
+	}
+
+	m_full_render_needed = true;
 	render(true);
 }
 
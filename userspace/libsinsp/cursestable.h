@@ -19,6 +19,11 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef CSYSDIG
 #ifndef NOCURSESUI
 
+//
+// Number of samples in the trend that is shown next to every row
+//
+#define CURSES_TABLE_TREND_WIDTH 20
+
 class curses_table : 
 	public curses_scrollable_list,
 	public sinsp_chart
@@ -36,7 +41,12 @@ public:
 	void configure(sinsp_table* table, 
 		vector<int32_t>* colsizes, vector<string>* colnames);
 	void update_data(vector<sinsp_sample_row>* data, bool force_selection_change = false);
-	void render(bool data_changed);
+	//
+	// If incremental is true, only the cells that changed since the previous
+	// frame are sent to the terminal. This assumes that nothing else has been
+	// drawn over the table since then.
+	//
+	void render(bool data_changed, bool incremental = false);
 	sysdig_table_action handle_input(int ch);
 	void set_x_start(uint32_t x)
 	{
@@ -57,9 +67,16 @@ private:
 	alignment get_field_alignment(ppm_param_type type);
 	void print_error(string wstr);
 	void print_wait();
+	void render_trends(int32_t nrows);
+	void copy_changed_cells();
 
 	sinsp* m_inspector;
 	WINDOW* m_tblwin;
+	WINDOW* m_framewin; // Where the incremental renders draw the new frame
+	WINDOW* m_drawwin; // The window that the current render draws into
+	bool m_full_render_needed;
+	vector<chtype> m_frame_line;
+	vector<chtype> m_screen_line;
 	sinsp_cursesui* m_parent;
 	sinsp_table* m_table;
 	int32_t m_table_x_start;
@@ -72,6 +89,7 @@ private:
 	vector<uint32_t> m_column_startx;
 	char alignbuf[64];
 	sinsp_table::tabletype m_type;
+	bool m_show_trends;
 
 	friend class curses_table_sidemenu;
 };
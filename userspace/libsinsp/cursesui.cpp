@@ -21,6 +21,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "../../driver/ppm_ringbuffer.h"
 #include "filter.h"
 #include "filterchecks.h"
+#include <algorithm>
 
 #ifdef CSYSDIG
 
@@ -62,7 +63,6 @@ sinsp_cursesui::sinsp_cursesui(sinsp* inspector,
 	m_is_filter_sysdig = false;
 	m_eof = 0;
 	m_offline_replay = false;
-	m_last_progress_evt = 0;
 	m_input_check_period_ns = UI_USER_INPUT_CHECK_PERIOD_NS;
 	m_search_nomatch = false;
 	m_chart = NULL;
@@ -75,6 +75,12 @@ sinsp_cursesui::sinsp_cursesui(sinsp* inspector,
 	m_print_containers = print_containers;
 	m_raw_output = raw_output;
 	m_truncated_input = false;
+	m_incremental_render = true;
+	m_render_benchmark_out = NULL;
+	m_render_benchmark_nframes = 0;
+	m_render_benchmark_bytes = 0;
+	m_render_benchmark_max_bytes = 0;
+	m_render_benchmark_time_ns = 0;
 #ifndef NOCURSESUI
 	m_spybox_text_format = sinsp_evt::PF_NORMAL;
 	m_sidemenu = NULL;
@@ -179,6 +185,11 @@ sinsp_cursesui::sinsp_cursesui(sinsp* inspector,
 		// Get screen dimensions
 		//
 		getmaxyx(stdscr, m_screenh, m_screenw);
+
+		//
+		// When reading a file, the inspector tells us how far it got
+		//
+		m_inspector->set_progress_callback(on_read_progress, this, UI_PROGRESS_INTERVAL_NS);
 	}
 #endif
 }
@@ -190,6 +201,11 @@ sinsp_cursesui::~sinsp_cursesui()
 		delete m_datatable;
 	}
 
+	for(auto it = m_background_tables.begin(); it != m_background_tables.end(); ++it)
+	{
+		delete it->m_table;
+	}
+
 #ifndef NOCURSESUI
 	if(!m_raw_output)
 	{
@@ -221,6 +237,13 @@ sinsp_cursesui::~sinsp_cursesui()
 #endif
 
 	delete m_timedelta_formatter;
+
+#ifndef NOCURSESUI
+	if(!m_raw_output)
+	{
+		m_inspector->set_progress_callback(NULL, NULL, 0);
+	}
+#endif
 }
 
 void sinsp_cursesui::configure(sinsp_view_manager* views)
@@ -243,6 +266,155 @@ void sinsp_cursesui::configure(sinsp_view_manager* views)
 	m_selected_sidemenu_entry = m_selected_view;
 }
 
+void sinsp_cursesui::set_concurrent_views(string viewids)
+{
+	vector<string> ids = sinsp_split(viewids, ',');
+	uint32_t j;
+
+	m_concurrent_views.clear();
+
+	for(auto it = ids.begin(); it != ids.end(); ++it)
+	{
+		if(*it == "all")
+		{
+			continue;
+		}
+
+		for(j = 0; j < m_views.size(); j++)
+		{
+			if(m_views.at(j)->m_id == *it)
+			{
+				break;
+			}
+		}
+
+		if(j == m_views.size() || m_views.at(j)->m_type != sinsp_view_info::T_TABLE)
+		{
+			throw sinsp_exception("view " + *it + " not found or not a table view");
+		}
+	}
+
+	for(j = 0; j < m_views.size(); j++)
+	{
+		sinsp_view_info* wi = m_views.at(j);
+
+		if(wi->m_type != sinsp_view_info::T_TABLE)
+		{
+			continue;
+		}
+
+		if(viewids == "all" || find(ids.begin(), ids.end(), wi->m_id) != ids.end())
+		{
+			m_concurrent_views.push_back(j);
+		}
+	}
+}
+
+string sinsp_cursesui::get_background_filter(uint32_t view_num)
+{
+	//
+	// Background tables only serve the top of the selection hierarchy
+	//
+	return combine_filters(m_cmdline_capture_filter, m_views.at(view_num)->m_filter);
+}
+
+int32_t sinsp_cursesui::find_background_table(int32_t view_num, string filter)
+{
+	for(uint32_t j = 0; j < m_background_tables.size(); j++)
+	{
+		if(m_background_tables[j].m_view_num == view_num &&
+			m_background_tables[j].m_filter == filter)
+		{
+			return j;
+		}
+	}
+
+	return -1;
+}
+
+//
+// Create a table for each concurrent view, except the one that is already
+// displayed with the same filter. Used when the capture starts or restarts,
+// since the tables need to see the events from the beginning.
+//
+void sinsp_cursesui::reset_background_tables()
+{
+	for(auto it = m_background_tables.begin(); it != m_background_tables.end(); ++it)
+	{
+		delete it->m_table;
+	}
+
+	m_background_tables.clear();
+
+	if(m_raw_output)
+	{
+		return;
+	}
+
+	for(auto it = m_concurrent_views.begin(); it != m_concurrent_views.end(); ++it)
+	{
+		sinsp_view_info* wi = m_views.at(*it);
+		sinsp_background_table bt;
+
+		bt.m_view_num = *it;
+		bt.m_filter = get_background_filter(*it);
+
+		if(bt.m_view_num == m_selected_view && m_datatable != NULL && 
+			bt.m_filter == m_complete_filter)
+		{
+			continue;
+		}
+
+		bt.m_table = new sinsp_table(m_inspector, sinsp_table::TT_TABLE, m_refresh_interval_ns, false);
+
+		try
+		{
+			bt.m_table->configure(&wi->m_columns, bt.m_filter, wi->m_use_defaults);
+			bt.m_table->set_sorting_col(wi->m_sortingcol);
+			bt.m_table->set_history_size(SINSP_TABLE_DEFAULT_HISTORY_SIZE);
+		}
+		catch(sinsp_exception& e)
+		{
+			g_logger.format("can't run view %s in the background: %s", wi->m_id.c_str(), e.what());
+			delete bt.m_table;
+			continue;
+		}
+
+		m_background_tables.push_back(bt);
+	}
+}
+
+//
+// If the view that is about to be started has a table aggregating in the
+// background, start it with that table and return true. Otherwise the
+// caller needs to start the view, and possibly restart the capture.
+//
+bool sinsp_cursesui::start_from_background(bool is_spy_switch)
+{
+	if(m_selected_view < 0 || m_background_tables.size() == 0)
+	{
+		return false;
+	}
+
+	string prev_filter = m_complete_filter;
+	create_complete_filter();
+	string filter = m_complete_filter;
+	m_complete_filter = prev_filter;
+
+	if(find_background_table(m_selected_view, filter) == -1)
+	{
+		return false;
+	}
+
+	if(m_paused)
+	{
+		pause();
+	}
+
+	start(true, is_spy_switch);
+	return true;
+}
+
 void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 {
 	//
@@ -265,11 +437,32 @@ void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 	}
 
 	//
-	// Delete the previous table and visualizations
+	// Delete the previous table and visualizations. If the table belongs to
+	// one of the concurrent views, keep it aggregating in the background
+	// instead.
 	//
 	if(m_datatable != NULL)
 	{
-		delete m_datatable;
+		if(m_prev_selected_view >= 0 &&
+			find(m_concurrent_views.begin(), m_concurrent_views.end(), (uint32_t)m_prev_selected_view) != m_concurrent_views.end() &&
+			m_complete_filter == get_background_filter(m_prev_selected_view) &&
+			find_background_table(m_prev_selected_view, m_complete_filter) == -1)
+		{
+			sinsp_background_table bt;
+
+			bt.m_view_num = m_prev_selected_view;
+			bt.m_filter = m_complete_filter;
+			bt.m_table = m_datatable;
+			bt.m_table->set_freetext_filter("");
+			bt.m_table->set_paused(false);
+			bt.m_table->rewind(-(int32_t)bt.m_table->get_rewind_distance());
+			m_background_tables.push_back(bt);
+		}
+		else
+		{
+			delete m_datatable;
+		}
+
 		m_datatable = NULL;
 	}
 
@@ -302,6 +495,7 @@ void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 	//
 	sinsp_view_info* wi = NULL;
 	sinsp_table::tabletype ty = sinsp_table::TT_NONE;
+	bool from_background = false;
 
 	if(m_selected_view >= 0)
 	{
@@ -320,22 +514,47 @@ void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 			ASSERT(false);
 		}
 
-		m_datatable = new sinsp_table(m_inspector, ty, m_refresh_interval_ns, m_raw_output);
+		int32_t bgid = find_background_table(m_selected_view, m_complete_filter);
 
-		try
+		if(bgid != -1)
 		{
-			m_datatable->configure(&wi->m_columns, 
-				m_complete_filter,
-				wi->m_use_defaults);
+			//
+			// The table of this view has been aggregating in the background,
+			// pick it up
+			//
+			m_datatable = m_background_tables[bgid].m_table;
+			m_background_tables.erase(m_background_tables.begin() + bgid);
+			from_background = true;
+
+			if(m_datatable->get_sorting_col() != wi->m_sortingcol)
+			{
+				m_datatable->set_sorting_col(wi->m_sortingcol);
+			}
 		}
-		catch(...)
+		else
 		{
-			delete m_datatable;
-			m_datatable = NULL;
-			throw;
-		}
+			m_datatable = new sinsp_table(m_inspector, ty, m_refresh_interval_ns, m_raw_output);
 
-		m_datatable->set_sorting_col(wi->m_sortingcol);
+			try
+			{
+				m_datatable->configure(&wi->m_columns, 
+					m_complete_filter,
+					wi->m_use_defaults);
+			}
+			catch(...)
+			{
+				delete m_datatable;
+				m_datatable = NULL;
+				throw;
+			}
+
+			m_datatable->set_sorting_col(wi->m_sortingcol);
+
+			if(!m_raw_output)
+			{
+				m_datatable->set_history_size(SINSP_TABLE_DEFAULT_HISTORY_SIZE);
+			}
+		}
 	}
 #ifndef NOCURSESUI
 	else
@@ -353,7 +572,14 @@ void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 		m_chart = m_spy_box;
 		m_spy_box->set_filter(m_complete_filter);
 	}
+#endif
+
+	if(!is_drilldown)
+	{
+		reset_background_tables();
+	}
 
+#ifndef NOCURSESUI
 	if(m_raw_output)
 	{
 		return;
@@ -376,6 +602,15 @@ void sinsp_cursesui::start(bool is_drilldown, bool is_spy_switch)
 		wi->get_col_names_and_sizes(&colnames, &colsizes);
 
 		m_viz->configure(m_datatable, &colsizes, &colnames);
+
+		//
+		// A table that comes from the background already has a sample
+		//
+		if(from_background)
+		{
+			m_viz->update_data(m_datatable->get_sample(get_time_delta()));
+		}
+
 		if(!is_drilldown)
 		{
 			populate_sidemenu("", &m_sidemenu_viewlist);
@@ -463,9 +698,36 @@ void sinsp_cursesui::render_header()
 
 	mvaddstr(0, k, vs.c_str());
 
+	string wstr;
+
 	if(m_paused)
 	{
-		string wstr = "PAUSED";
+		wstr = "PAUSED";
+	}
+
+	//
+	// If the table is showing an old sample, say how old
+	//
+	if(m_datatable != NULL && m_datatable->get_rewind_distance() != 0)
+	{
+		uint64_t delta = m_datatable->get_rewind_distance() * m_refresh_interval_ns;
+
+		m_timedelta_formatter->set_val(PT_RELTIME, 
+			(uint8_t*)&delta,
+			8,
+			0,
+			ppm_print_format::PF_DEC);
+
+		if(wstr != "")
+		{
+			wstr += " ";
+		}
+
+		wstr += string("HISTORY -") + m_timedelta_formatter->tostring_nice(NULL, 0, 0);
+	}
+
+	if(wstr != "")
+	{
 		attrset(m_colors[sinsp_cursesui::LARGE_NUMBER]);
 		mvprintw(0,
 			m_screenw / 2 - wstr.size() / 2, 
@@ -946,6 +1208,16 @@ void sinsp_cursesui::handle_end_of_sample(sinsp_evt* evt, int32_t next_res)
 {
 	m_datatable->flush(evt);
 
+	//
+	// Emit a sample for the background tables too, so that they are ready
+	// when the user switches to them
+	//
+	for(auto it = m_background_tables.begin(); it != m_background_tables.end(); ++it)
+	{
+		it->m_table->flush(evt);
+		it->m_table->get_sample(get_time_delta());
+	}
+
 	//
 	// It's time to refresh the data for this chart.
 	// First of all, create the data for the chart
@@ -964,8 +1236,17 @@ void sinsp_cursesui::handle_end_of_sample(sinsp_evt* evt, int32_t next_res)
 			return;
 		}
 
+		uint64_t render_start_ns = 0;
+
+		if(m_render_benchmark_out != NULL)
+		{
+			render_start_ns = sinsp_utils::get_current_time_ns();
+		}
+
 		//
 		// Now refresh the UI.
+		// Nothing else is drawn over the table between two samples, so only
+		// the cells that changed need to be repainted.
 		//
 		if(m_viz && !m_paused)
 		{
@@ -976,10 +1257,28 @@ void sinsp_cursesui::handle_end_of_sample(sinsp_evt* evt, int32_t next_res)
 				m_viz->follow_end();
 			}
 
-			m_viz->render(true);
+			m_viz->render(true, m_incremental_render);
 		}
 
 		render();
+
+		if(m_render_benchmark_out != NULL)
+		{
+			refresh();
+
+			//
+			// The output file is rewound after every refresh, so its size is
+			// what this refresh wrote
+			//
+			fflush(m_render_benchmark_out);
+			uint64_t nbytes = (uint64_t)ftell(m_render_benchmark_out);
+			rewind(m_render_benchmark_out);
+
+			m_render_benchmark_nframes++;
+			m_render_benchmark_bytes += nbytes;
+			m_render_benchmark_max_bytes = max(m_render_benchmark_max_bytes, nbytes);
+			m_render_benchmark_time_ns += sinsp_utils::get_current_time_ns() - render_start_ns;
+		}
 	}
 #endif
 	//
@@ -1004,10 +1303,38 @@ void sinsp_cursesui::handle_end_of_sample(sinsp_evt* evt, int32_t next_res)
 	}
 }
 
+#ifndef NOCURSESUI
+void sinsp_cursesui::set_render_benchmark(FILE* out, bool incremental)
+{
+	m_render_benchmark_out = out;
+	m_incremental_render = incremental;
+}
+
+void sinsp_cursesui::print_render_benchmark()
+{
+	printf("%s rendering, %" PRIu64 " refreshes\n",
+		m_incremental_render? "incremental" : "full",
+		m_render_benchmark_nframes);
+
+	if(m_render_benchmark_nframes == 0)
+	{
+		return;
+	}
+
+	printf("bytes: %" PRIu64 " total, %" PRIu64 " per refresh, %" PRIu64 " max\n",
+		m_render_benchmark_bytes,
+		m_render_benchmark_bytes / m_render_benchmark_nframes,
+		m_render_benchmark_max_bytes);
+	printf("time per refresh: %.3lfms\n",
+		(double)m_render_benchmark_time_ns / m_render_benchmark_nframes / 1000000);
+}
+#endif
+
 void sinsp_cursesui::restart_capture(bool is_spy_switch)
 {
 	m_inspector->close();
 	start(true, is_spy_switch);
+	reset_background_tables();
 	m_inspector->open(m_event_source_name);
 }
 
@@ -1077,34 +1404,37 @@ void sinsp_cursesui::switch_view(bool is_spy_switch)
 	}
 
 	//
-	// If this is a file, we need to restart the capture.
+	// If the view has been aggregating in the background, just show it.
+	// Otherwise, if this is a file, we need to restart the capture.
 	// If it's a live capture, we restart only if start() fails, which usually
 	// happens in case one of the filter fields requested thread state.
 	//
-	if(!m_inspector->is_live())
-	{
-		m_eof = 0;
-		m_last_progress_evt = 0;
-		restart_capture(is_spy_switch);
-	}
-	else
+	if(!start_from_background(is_spy_switch))
 	{
-		//
-		// When live, also make sure to unpause the viz, otherwise the screen 
-		// will stay empty.
-		//
-		if(m_paused)
-		{
-			pause();
-		}
-
-		try
+		if(!m_inspector->is_live())
 		{
-			start(true, is_spy_switch);
+			m_eof = 0;
+			restart_capture(is_spy_switch);
 		}
-		catch(...)
+		else
 		{
-			restart_capture(is_spy_switch);
+			//
+			// When live, also make sure to unpause the viz, otherwise the screen 
+			// will stay empty.
+			//
+			if(m_paused)
+			{
+				pause();
+			}
+
+			try
+			{
+				start(true, is_spy_switch);
+			}
+			catch(...)
+			{
+				restart_capture(is_spy_switch);
+			}
 		}
 	}
 
@@ -1164,7 +1494,6 @@ void sinsp_cursesui::spy_selection(string field, string val, bool is_dig)
 	if(!m_inspector->is_live())
 	{
 		m_eof = 0;
-		m_last_progress_evt = 0;
 		restart_capture(false);
 	}
 	else
@@ -1238,7 +1567,6 @@ bool sinsp_cursesui::do_drilldown(string field, string val, uint32_t new_view_nu
 	if(!m_inspector->is_live())
 	{
 		m_eof = 0;
-		m_last_progress_evt = 0;
 		restart_capture(false);
 	}
 	else
@@ -1334,21 +1662,23 @@ bool sinsp_cursesui::drillup()
 		//m_views[m_selected_view].m_filter = m_sel_hierarchy.tofilter();
 
 
-		if(!m_inspector->is_live())
+		if(!start_from_background(false))
 		{
-			m_eof = 0;
-			m_last_progress_evt = 0;
-			restart_capture(false);
-		}
-		else
-		{
-			try
+			if(!m_inspector->is_live())
 			{
-				start(true, false);
+				m_eof = 0;
+				restart_capture(false);
 			}
-			catch(...)
+			else
 			{
-				restart_capture(false);
+				try
+				{
+					start(true, false);
+				}
+				catch(...)
+				{
+					restart_capture(false);
+				}
 			}
 		}
 #ifndef NOCURSESUI
@@ -1432,6 +1762,11 @@ void sinsp_cursesui::print_progress(double progress)
 	refresh();
 }
 
+void sinsp_cursesui::on_read_progress(double progress_pct, void* context)
+{
+	((sinsp_cursesui*)context)->print_progress(progress_pct);
+}
+
 sysdig_table_action sinsp_cursesui::handle_textbox_input(int ch)
 {
 	bool closing = false;
@@ -1829,6 +2164,18 @@ sysdig_table_action sinsp_cursesui::handle_input(int ch)
 		case 'p':
 			pause();
 			break;
+		case '[':
+		case ']':
+			if(m_datatable == NULL || m_viz == NULL || !m_datatable->has_history())
+			{
+				return STA_NONE;
+			}
+
+			m_datatable->rewind((ch == '[')? 1 : -1);
+			m_viz->update_data(m_datatable->get_sample(get_time_delta()), true);
+			m_viz->render(true);
+			render();
+			break;
 		case KEY_F(2):
 			if(m_sidemenu == NULL)
 			{
@@ -23,6 +23,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #endif
 
 #define UI_USER_INPUT_CHECK_PERIOD_NS 10000000
+#define UI_PROGRESS_INTERVAL_NS 100000000
 #define SIDEMENU_WIDTH 20
 #define VIEW_ID_SPY -1
 #define VIEW_ID_DIG -2
@@ -260,6 +261,19 @@ public:
 	vector<sinsp_mouse_to_key_list_entry> m_list;
 };
 
+//
+// The table of a view that is fed every event even when the view is not
+// displayed, so that switching to the view doesn't require restarting the
+// capture
+//
+class sinsp_background_table
+{
+public:
+	int32_t m_view_num;
+	string m_filter;
+	sinsp_table* m_table;
+};
+
 class sinsp_cursesui
 {
 public:
@@ -337,6 +351,24 @@ public:
 		bool print_containers, bool raw_output);
 	~sinsp_cursesui();
 	void configure(sinsp_view_manager* views);
+	//
+	// Keep the tables of the given views (a comma separated list of view IDs,
+	// or "all" for all the table views) aggregating in the background. Must
+	// be called after configure() and before start().
+	//
+	void set_concurrent_views(string viewids);
+#ifndef NOCURSESUI
+	//
+	// Render every sample of a trace file, without waiting for the user, and
+	// measure the bytes that curses writes to the terminal on every refresh.
+	// out must be the output file of the curses screen, which is rewound
+	// after every refresh. If incremental is false, the table is fully
+	// repainted on every refresh, like when the incremental rendering didn't
+	// exist, which is useful for comparisons.
+	//
+	void set_render_benchmark(FILE* out, bool incremental);
+	void print_render_benchmark();
+#endif
 	void start(bool is_drilldown, bool is_spy_switch);
 	sinsp_view_info* get_selected_view();
 	void pause();
@@ -381,20 +413,6 @@ public:
 		{
 			uint32_t ninputs = 0;
 
-			uint64_t evtnum = evt->get_num();
-
-			//
-			// If this is a file, print the progress once in a while
-			//
-			if(!m_inspector->is_live())
-			{
-				if(evtnum - m_last_progress_evt > 30000)
-				{
-					print_progress(m_inspector->get_read_progress());
-					m_last_progress_evt = evtnum;
-				}
-			}
-
 			//
 			// If we have more than one event in the queue, consume all of them
 			//
@@ -488,7 +506,7 @@ public:
 #ifndef NOCURSESUI
 			usleep(10000);
 #endif
-			if(m_raw_output)
+			if(m_raw_output || m_render_benchmark_out != NULL)
 			{
 				return true;
 			}
@@ -518,6 +536,14 @@ public:
 			{
 				end_of_sample = (evt == NULL || ts > m_datatable->m_next_flush_time_ns);
 			}
+			else if(m_render_benchmark_out != NULL)
+			{
+				//
+				// Render the file one sample at a time, like a live capture,
+				// and the last sample at the end of the file
+				//
+				end_of_sample = (next_res == SCAP_EOF || ts > m_datatable->m_next_flush_time_ns);
+			}
 			else
 			{
 				//
@@ -549,6 +575,11 @@ public:
 			}
 
 			m_datatable->process_event(evt);
+
+			for(auto it = m_background_tables.begin(); it != m_background_tables.end(); ++it)
+			{
+				it->m_table->process_event(evt);
+			}
 		}
 
 		return false;
@@ -587,6 +618,10 @@ private:
 	// returns false if we are already at the top of the hierarchy
 	bool drillup();
 	void create_complete_filter();
+	string get_background_filter(uint32_t view_num);
+	int32_t find_background_table(int32_t view_num, string filter);
+	void reset_background_tables();
+	bool start_from_background(bool is_spy_switch);
 
 #ifndef NOCURSESUI
 	void render_header();
@@ -600,6 +635,7 @@ private:
 	sysdig_table_action handle_input(int ch);
 	void populate_sidemenu(string field, vector<sidemenu_list_entry>* viewlist);
 	void print_progress(double progress);
+	static void on_read_progress(double progress_pct, void* context);
 	void show_selected_view_info();
 #endif
 
@@ -618,7 +654,6 @@ private:
 	uint32_t m_cursor_pos;
 	bool m_is_filter_sysdig;
 	bool m_offline_replay;
-	uint64_t m_last_progress_evt;
 	vector<sidemenu_list_entry> m_sidemenu_viewlist;
 	sinsp_chart* m_chart;
 	search_caller_interface* m_search_caller_interface;
@@ -635,6 +670,14 @@ private:
 	string m_search_header_text;
 	bool m_raw_output;
 	bool m_truncated_input;
+	vector<uint32_t> m_concurrent_views;
+	vector<sinsp_background_table> m_background_tables;
+	bool m_incremental_render;
+	FILE* m_render_benchmark_out;
+	uint64_t m_render_benchmark_nframes;
+	uint64_t m_render_benchmark_bytes;
+	uint64_t m_render_benchmark_max_bytes;
+	uint64_t m_render_benchmark_time_ns;
 };
 
 #endif // CSYSDIG
\ No newline at end of file
@@ -44,7 +44,7 @@ void sinsp_dumper::open(const string& filename, bool compress)
 
 	if(compress)
 	{
-		m_dumper = scap_dump_open(m_inspector->m_h, filename.c_str(), SCAP_COMPRESSION_GZIP);
+		m_dumper = scap_dump_open(m_inspector->m_h, filename.c_str(), m_inspector->m_compression_mode);
 	}
 	else
 	{
@@ -59,6 +59,22 @@ void sinsp_dumper::open(const string& filename, bool compress)
 	m_inspector->m_container_manager.dump_containers(m_dumper);
 }
 
+void sinsp_dumper::close()
+{
+	if(m_dumper == NULL)
+	{
+		throw sinsp_exception("dumper not opened yet");
+	}
+
+	int32_t res = scap_dump_close(m_dumper);
+	m_dumper = NULL;
+
+	if(res != SCAP_SUCCESS)
+	{
+		throw sinsp_exception("error writing the trace file");
+	}
+}
+
 void sinsp_dumper::dump(sinsp_evt* evt)
 {
 	if(m_dumper == NULL)
@@ -98,5 +114,8 @@ void sinsp_dumper::flush()
 		throw sinsp_exception("dumper not opened yet");
 	}
 
-	scap_dump_flush(m_dumper);
+	if(scap_dump_flush(m_dumper) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception("error writing the trace file");
+	}
 }
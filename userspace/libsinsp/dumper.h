@@ -49,11 +49,18 @@ public:
 
 	  \param compress true to save the tracefile in a compressed format.
 
-	  \note There's no close() because the file is closed when the dumper is
-	   destroyed.
+	  \note If close() is not called, the file is closed when the dumper is
+	   destroyed, but write errors are not reported.
 	*/
 	void open(const string& filename, bool compress);
 
+	/*!
+	  \brief Writes the pending events and closes the dump file.
+
+	  \note Throws a sinsp_exception if the events couldn't be written.
+	*/
+	void close();
+
 	/*!
 	  \brief Return the current size of a tracefile.
 
@@ -29,29 +29,55 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "sinsp.h"
 #include "sinsp_int.h"
+#include "json_writer.h"
 
 #include "../libscap/scap.h"
 
 extern sinsp_evttables g_infotables;
 
-#define SET_NUMERIC_FORMAT(resfmt, fmt, ustr, xstr) do {        \
-	if(fmt == ppm_print_format::PF_DEC)                     \
-	{                                                       \
-		resfmt = (char*)"%" ustr;                       \
-	}                                                       \
-	else if(fmt == ppm_print_format::PF_10_PADDED_DEC)      \
-	{                                                       \
-		resfmt = (char*)"%09" ustr;                     \
-	}                                                       \
-	else if(fmt == ppm_print_format::PF_HEX)                \
-	{                                                       \
-		resfmt = (char*)"%" xstr;                       \
-	}                                                       \
-	else                                                    \
-	{                                                       \
-		resfmt = (char*)"%" ustr;                       \
-	}                                                       \
-} while(0)
+//
+// Render an integer parameter exactly like printf would with the "%d",
+// "%09d" or "%X" conversion selected by its print format, without going
+// through format string parsing. The C type is picked by the caller based
+// on the ppm_param_type. dst must have room for 24 characters.
+//
+template<typename T>
+static inline void render_numeric_param(char* dst, T val, ppm_print_format fmt)
+{
+	bool is_signed = std::numeric_limits<T>::is_signed;
+
+	if(fmt == PF_HEX)
+	{
+		//
+		// Like printf, the smaller types are promoted to (unsigned) int
+		//
+		if(sizeof(T) == sizeof(uint64_t))
+		{
+			sinsp_json_writer::write_hex(dst, (uint64_t)val);
+		}
+		else
+		{
+			sinsp_json_writer::write_hex(dst, (uint32_t)(int64_t)val);
+		}
+	}
+	else if(is_signed)
+	{
+		int64_t sval = (int64_t)val;
+		uint32_t min_digits = 1;
+
+		if(fmt == PF_10_PADDED_DEC)
+		{
+			// The sign is part of the field width
+			min_digits = (sval < 0)? 8 : 9;
+		}
+
+		sinsp_json_writer::write_int(dst, sval, min_digits);
+	}
+	else
+	{
+		sinsp_json_writer::write_uint(dst, (uint64_t)val, (fmt == PF_10_PADDED_DEC)? 9 : 1);
+	}
+}
 
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_evt implementation
@@ -63,6 +89,9 @@ sinsp_evt::sinsp_evt() :
 	m_tinfo = NULL;
 #ifdef _DEBUG
 	m_filtered_out = false;
+#endif
+#ifdef HAS_FILTERING
+	m_extraction_cache = NULL;
 #endif
 	m_event_info_table = g_infotables.m_event_info;
 }
@@ -75,6 +104,9 @@ sinsp_evt::sinsp_evt(sinsp *inspector) :
 	m_tinfo = NULL;
 #ifdef _DEBUG
 	m_filtered_out = false;
+#endif
+#ifdef HAS_FILTERING
+	m_extraction_cache = NULL;
 #endif
 	m_event_info_table = g_infotables.m_event_info;
 }
@@ -524,15 +556,14 @@ uint32_t strcpy_sanitized(char *dest, char *src, uint32_t dstsize)
 	return dstsize;
 }
 
-int sinsp_evt::render_fd_json(Json::Value *ret, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt)
+void sinsp_evt::render_fd_json(string* res, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt)
 {
+	//
+	// Members are written in name order, like Json::FastWriter does
+	//
 	sinsp_threadinfo* tinfo = get_thread_info();
-	if(tinfo == NULL)
-	{
-		return 0;
-	}
 
-	if(fd >= 0)
+	if(tinfo != NULL && fd >= 0)
 	{
 		sinsp_fdinfo_t *fdinfo = tinfo->get_fd(fd);
 		if(fdinfo)
@@ -580,24 +611,36 @@ int sinsp_evt::render_fd_json(Json::Value *ret, int64_t fd, const char** resolve
 
 			sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
 
-			(*ret)["typechar"] = typestr;
-			(*ret)["name"] = sanitized_str;
+			res->append("{\"name\":");
+			sinsp_json_writer::append_string(res, sanitized_str);
+			res->append(",\"num\":");
+			sinsp_json_writer::append_uint(res, (uint64_t)fd);
+			res->append(",\"typechar\":");
+			sinsp_json_writer::append_string(res, typestr);
+			res->push_back('}');
+			return;
 		}
 	}
-	else
+	else if(tinfo != NULL)
 	{
 		//
 		// Resolve this as an errno
 		//
-		string errstr(sinsp_utils::errno_to_str((int32_t)fd));
-		if(errstr != "")
+		const char* errstr = sinsp_utils::errno_to_str((int32_t)fd);
+		if(errstr[0] != 0)
 		{
-			(*ret)["error"] = errstr;
-			return 0;
+			res->append("{\"error\":");
+			sinsp_json_writer::append_string(res, errstr);
+			res->append(",\"num\":");
+			sinsp_json_writer::append_uint(res, (uint64_t)fd);
+			res->push_back('}');
+			return;
 		}
 	}
 
-	return 1;
+	res->append("{\"num\":");
+	sinsp_json_writer::append_uint(res, (uint64_t)fd);
+	res->push_back('}');
 }
 
 char* sinsp_evt::render_fd(int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt)
@@ -605,9 +648,7 @@ char* sinsp_evt::render_fd(int64_t fd, const char** resolved_str, sinsp_evt::par
 	//
 	// Add the fd number
 	//
-	snprintf(&m_paramstr_storage[0],
-		        m_paramstr_storage.size(),
-		        "%" PRId64, fd);
+	sinsp_json_writer::write_int(&m_paramstr_storage[0], fd);
 
 	sinsp_threadinfo* tinfo = get_thread_info();
 	if(tinfo == NULL)
@@ -660,23 +701,56 @@ char* sinsp_evt::render_fd(int64_t fd, const char** resolved_str, sinsp_evt::par
 			};
 
 			//
-			// Make sure we remove invalid characters from the resolved name
+			// Render "<typestr>name", removing the invalid characters from the
+			// name. This is done in place, without temporary strings, because
+			// it happens for almost every event.
 			//
-			string sanitized_str = fdinfo->m_name;
+			const string& name = fdinfo->m_name;
+			g_invalidchar ic;
+			uint32_t sanitized_len = 0;
+			uint32_t k;
 
-			sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
+			for(k = 0; k < name.size(); k++)
+			{
+				if(!ic(name[k]))
+				{
+					sanitized_len++;
+				}
+			}
 
 			//
 			// Make sure the string will fit
 			//
-			if(sanitized_str.size() >= m_resolved_paramstr_storage.size())
+			if(sanitized_len >= m_resolved_paramstr_storage.size())
 			{
-				m_resolved_paramstr_storage.resize(sanitized_str.size() + 1);
+				m_resolved_paramstr_storage.resize(sanitized_len + 1);
 			}
 
-			snprintf(&m_resolved_paramstr_storage[0],
-				m_resolved_paramstr_storage.size(),
-				"<%s>%s", typestr, sanitized_str.c_str());
+			char* dst = &m_resolved_paramstr_storage[0];
+			char* dstend = dst + m_resolved_paramstr_storage.size() - 1;
+			const char* t;
+
+			*dst++ = '<';
+
+			for(t = typestr; *t != 0 && dst < dstend; t++)
+			{
+				*dst++ = *t;
+			}
+
+			if(dst < dstend)
+			{
+				*dst++ = '>';
+			}
+
+			for(k = 0; k < name.size() && dst < dstend; k++)
+			{
+				if(!ic(name[k]))
+				{
+					*dst++ = name[k];
+				}
+			}
+
+			*dst = 0;
 
 /* XXX
 			if(sanitized_str.length() == 0)
@@ -699,25 +773,40 @@ char* sinsp_evt::render_fd(int64_t fd, const char** resolved_str, sinsp_evt::par
 		//
 		// Resolve this as an errno
 		//
-		string errstr(sinsp_utils::errno_to_str((int32_t)fd));
-		if(errstr != "")
+		const char* errstr = sinsp_utils::errno_to_str((int32_t)fd);
+		if(errstr[0] != 0)
 		{
-			snprintf(&m_resolved_paramstr_storage[0],
-				        m_resolved_paramstr_storage.size(),
-				        "%s", errstr.c_str());
+			copy_resolved_str(errstr);
 		}
 	}
 
 	return &m_paramstr_storage[0];
 }
 
-Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_str, sinsp_evt::param_fmt fmt)
+//
+// Append {"addr":"a.b.c.d","port":n}
+//
+static void append_ipv4_endpoint_json(string* res, const uint8_t* addr, uint16_t port)
+{
+	res->append("{\"addr\":\"");
+	sinsp_json_writer::append_uint(res, addr[0]);
+	res->push_back('.');
+	sinsp_json_writer::append_uint(res, addr[1]);
+	res->push_back('.');
+	sinsp_json_writer::append_uint(res, addr[2]);
+	res->push_back('.');
+	sinsp_json_writer::append_uint(res, addr[3]);
+	res->append("\",\"port\":");
+	sinsp_json_writer::append_uint(res, port);
+	res->push_back('}');
+}
+
+void sinsp_evt::get_param_as_json(uint32_t id, OUT string* res, OUT const char** resolved_str, sinsp_evt::param_fmt fmt)
 {
 	ASSERT(id < m_info->nparams);
 	const ppm_param_info* param_info;
 	char* payload;
 	uint16_t payload_len;
-	Json::Value ret;
 
 	//
 	// Make sure the params are actually loaded
@@ -763,48 +852,48 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 	{
 	case PT_INT8:
 		ASSERT(payload_len == sizeof(int8_t));
-		ret = *(int8_t *)payload;
+		sinsp_json_writer::append_int(res, *(int8_t *)payload);
 		break;
 
 	case PT_INT16:
 		ASSERT(payload_len == sizeof(int16_t));
-		ret = *(int16_t *)payload;
+		sinsp_json_writer::append_int(res, *(int16_t *)payload);
 		break;
 
 	case PT_INT32:
 		ASSERT(payload_len == sizeof(int32_t));
-		ret = *(int32_t *)payload;
+		sinsp_json_writer::append_int(res, *(int32_t *)payload);
 		break;
 
 	case PT_INT64:
 		ASSERT(payload_len == sizeof(int64_t));
-		ret = (Json::Value::Int64)*(int64_t *)payload;
+		sinsp_json_writer::append_int(res, *(int64_t *)payload);
 		break;
 
 	case PT_UINT8:
 		ASSERT(payload_len == sizeof(uint8_t));
-		ret = *(uint8_t *)payload;
+		sinsp_json_writer::append_uint(res, *(uint8_t *)payload);
 		break;
 
 	case PT_UINT16:
 		ASSERT(payload_len == sizeof(uint16_t));
-		ret = *(uint16_t *)payload;
+		sinsp_json_writer::append_uint(res, *(uint16_t *)payload);
 		break;
 
 	case PT_UINT32:
 		ASSERT(payload_len == sizeof(uint32_t));
-		ret = *(uint32_t *)payload;
+		sinsp_json_writer::append_uint(res, *(uint32_t *)payload);
 		break;
 
 	case PT_UINT64:
 		ASSERT(payload_len == sizeof(uint64_t));
-		ret = (Json::Value::UInt64)*(int64_t *)payload;
+		sinsp_json_writer::append_uint(res, *(uint64_t *)payload);
 		break;
 
 	case PT_PID:
 		{
 			ASSERT(payload_len == sizeof(int64_t));
-			ret = (Json::Value::UInt64)*(int64_t *)payload;
+			sinsp_json_writer::append_uint(res, *(uint64_t *)payload);
 
 			sinsp_threadinfo* atinfo = m_inspector->get_thread(*(int64_t *)payload, false, true);
 			if(atinfo != NULL)
@@ -836,45 +925,35 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 		//
 		// Resolve this as an errno
 		//
-		string errstr;
-
 		if(val < 0)
 		{
-			errstr = sinsp_utils::errno_to_str((int32_t)val);
+			const char* errstr = sinsp_utils::errno_to_str((int32_t)val);
 
-			if(errstr != "")
+			if(errstr[0] != 0)
 			{
-				snprintf(&m_resolved_paramstr_storage[0],
-				         m_resolved_paramstr_storage.size(),
-				         "%s", errstr.c_str());
+				copy_resolved_str(errstr);
 			}
-		} 
-		ret = (Json::Value::Int64)val;
+		}
+		sinsp_json_writer::append_int(res, val);
 	}
 	break;
 
 	case PT_FD:
-		{
-			// We use the string extractor to get 
-			// the resolved path, but use our routine
-			// to get the actual value to return
-			ASSERT(payload_len == sizeof(int64_t));
-			int64_t fd = *(int64_t*)payload;
-			render_fd_json(&ret, fd, resolved_str, fmt);
-			ret["num"] = (Json::Value::UInt64)*(int64_t *)payload;
-			break;
-		}
+		ASSERT(payload_len == sizeof(int64_t));
+		render_fd_json(res, *(int64_t*)payload, resolved_str, fmt);
+		break;
 
 	case PT_CHARBUF:
 	case PT_FSPATH:
 	case PT_BYTEBUF:
-		ret = get_param_as_str(id, resolved_str, fmt);
+	case PT_FDLIST:
+		sinsp_json_writer::append_string(res, get_param_as_str(id, resolved_str, fmt));
 		break;
 
 	case PT_SOCKADDR:
 		if(payload_len == 0)
 		{
-			ret = Json::Value::nullRef;
+			sinsp_json_writer::append_null(res);
 			break;
 		}
 		else if(payload[0] == AF_UNIX)
@@ -884,46 +963,35 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 			//
 			// Sanitize the file string.
 			//
-            string sanitized_str = payload + 1;
-            sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
+			string sanitized_str = payload + 1;
+			sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
 
-			ret = sanitized_str;
+			sinsp_json_writer::append_string(res, sanitized_str);
 		}
 		else if(payload[0] == PPM_AF_INET)
 		{
 			if(payload_len == 1 + 4 + 2)
 			{
-				const int ipv4_len = (3 + 1) * 4 + 1;
-				char ipv4_addr[ ipv4_len ];
-
-				snprintf(
-					ipv4_addr,
-					ipv4_len,
-						"%u.%u.%u.%u",
-						(unsigned int)(uint8_t)payload[1],
-						(unsigned int)(uint8_t)payload[2],
-						(unsigned int)(uint8_t)payload[3],
-						(unsigned int)(uint8_t)payload[4]
-				);
-				ret["addr"] = string(ipv4_addr);
-				ret["port"] = *(uint16_t*)(payload + 5);
+				append_ipv4_endpoint_json(res, (uint8_t*)payload + 1, *(uint16_t*)(payload + 5));
 			}
 			else
 			{
 				ASSERT(false);
-				ret = "INVALID IPv4";
+				sinsp_json_writer::append_string(res, "INVALID IPv4");
 			}
 		}
 		else
 		{
-			ret["family"] = (int)payload[0];
+			res->append("{\"family\":");
+			sinsp_json_writer::append_int(res, payload[0]);
+			res->push_back('}');
 		}
 		break;
 
 	case PT_SOCKTUPLE:
 		if(payload_len == 0)
 		{
-			ret = Json::Value::nullRef;
+			sinsp_json_writer::append_null(res);
 			break;
 		}
 
@@ -931,46 +999,16 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 		{
 			if(payload_len == 1 + 4 + 2 + 4 + 2)
 			{
-				Json::Value source;
-				Json::Value dest;
-
-				const int ipv4_len = (3 + 1) * 4 + 1;
-				char ipv4_addr[ ipv4_len ];
-
-				snprintf(
-					ipv4_addr,
-					ipv4_len,
-						"%u.%u.%u.%u",
-						(unsigned int)(uint8_t)payload[1],
-						(unsigned int)(uint8_t)payload[2],
-						(unsigned int)(uint8_t)payload[3],
-						(unsigned int)(uint8_t)payload[4]
-				);
-
-				source["addr"] = string(ipv4_addr);
-				source["port"] = *(uint16_t*)(payload + 5);
-
-				snprintf(
-					ipv4_addr,
-					ipv4_len,
-				         "%u.%u.%u.%u",
-				         (unsigned int)(uint8_t)payload[7],
-				         (unsigned int)(uint8_t)payload[8],
-				         (unsigned int)(uint8_t)payload[9],
-				         (unsigned int)(uint8_t)payload[10]
-				);
-
-
-				dest["addr"] = string(ipv4_addr);
-				dest["port"] = *(uint16_t*)(payload + 11);
-
-				ret["src"] = source;
-				ret["dst"] = dest;
+				res->append("{\"dst\":");
+				append_ipv4_endpoint_json(res, (uint8_t*)payload + 7, *(uint16_t*)(payload + 11));
+				res->append(",\"src\":");
+				append_ipv4_endpoint_json(res, (uint8_t*)payload + 1, *(uint16_t*)(payload + 5));
+				res->push_back('}');
 			}
 			else
 			{
 				ASSERT(false);
-				ret = "INVALID IPv4";
+				sinsp_json_writer::append_string(res, "INVALID IPv4");
 			}
 		}
 		else if(payload[0] == PPM_AF_INET6)
@@ -984,41 +1022,11 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 
 				if(sinsp_utils::is_ipv4_mapped_ipv6(sip6) && sinsp_utils::is_ipv4_mapped_ipv6(dip6))
 				{
-					Json::Value source;
-					Json::Value dest;
-
-					const int ipv4_len = (3 + 1) * 4 + 1;
-					char ipv4_addr[ ipv4_len ];
-
-					snprintf(
-						ipv4_addr,
-						ipv4_len,
-							"%u.%u.%u.%u",
-							(unsigned int)sip[0],
-							(unsigned int)sip[1],
-							(unsigned int)sip[2],
-							(unsigned int)sip[3]
-					);
-
-					source["addr"] = string(ipv4_addr);
-					source["port"] = (unsigned int)*(uint16_t*)(payload + 17);
-
-					snprintf(
-						ipv4_addr,
-						ipv4_len,
-							"%u.%u.%u.%u",
-							(unsigned int)dip[0],
-							(unsigned int)dip[1],
-							(unsigned int)dip[2],
-							(unsigned int)dip[3]
-				 	);
-
-					dest["addr"] = string(ipv4_addr);
-					dest["port"] = (unsigned int)*(uint16_t*)(payload + 35);
-
-					ret["src"] = source;
-					ret["dst"] = dest;
-
+					res->append("{\"dst\":");
+					append_ipv4_endpoint_json(res, dip, *(uint16_t*)(payload + 35));
+					res->append(",\"src\":");
+					append_ipv4_endpoint_json(res, sip, *(uint16_t*)(payload + 17));
+					res->push_back('}');
 					break;
 				}
 				else
@@ -1029,25 +1037,21 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 					if(inet_ntop(AF_INET6, sip6, srcstr, sizeof(srcstr)) &&
 						inet_ntop(AF_INET6, sip6, dststr, sizeof(dststr)))
 					{
-						Json::Value source;
-						Json::Value dest;
-
-						source["addr"] = srcstr;
-						source["port"] = (unsigned int)*(uint16_t*)(payload + 17);
-
-						dest["addr"] = dststr;
-						dest["port"] = (unsigned int)*(uint16_t*)(payload + 35);
-
-						ret["src"] = source;
-						ret["dst"] = dest;
-
+						res->append("{\"dst\":{\"addr\":");
+						sinsp_json_writer::append_string(res, dststr);
+						res->append(",\"port\":");
+						sinsp_json_writer::append_uint(res, *(uint16_t*)(payload + 35));
+						res->append("},\"src\":{\"addr\":");
+						sinsp_json_writer::append_string(res, srcstr);
+						res->append(",\"port\":");
+						sinsp_json_writer::append_uint(res, *(uint16_t*)(payload + 17));
+						res->append("}}");
 						break;
 					}
 				}
 			}
 			ASSERT(false);
-			ret = "INVALID IPv6";
-
+			sinsp_json_writer::append_string(res, "INVALID IPv6");
 		}
 		else if(payload[0] == AF_UNIX)
 		{
@@ -1056,8 +1060,8 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 			//
 			// Sanitize the file string.
 			//
-            string sanitized_str = payload + 17;
-            sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
+			string sanitized_str = payload + 17;
+			sanitized_str.erase(remove_if(sanitized_str.begin(), sanitized_str.end(), g_invalidchar()), sanitized_str.end());
 
 			snprintf(&m_paramstr_storage[0],
 				m_paramstr_storage.size(),
@@ -1065,15 +1069,16 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 				*(uint64_t*)(payload + 1),
 				*(uint64_t*)(payload + 9),
 				sanitized_str.c_str());
+
+			sinsp_json_writer::append_null(res);
 		}
 		else
 		{
-			ret["family"] = (int)payload[0];
+			res->append("{\"family\":");
+			sinsp_json_writer::append_int(res, payload[0]);
+			res->push_back('}');
 		}
 		break;
-	case PT_FDLIST:
-		ret = get_param_as_str(id, resolved_str, fmt);
-		break;
 
 	case PT_SYSCALLID:
 		{
@@ -1084,12 +1089,13 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 				snprintf(&m_resolved_paramstr_storage[0],
 						 m_resolved_paramstr_storage.size(),
 						 "<unknown syscall>");
+				sinsp_json_writer::append_null(res);
 				break;
 			}
 
 			const struct ppm_syscall_desc* desc = &(g_infotables.m_syscall_info_table[scid]);
 
-			ret = scid;
+			sinsp_json_writer::append_uint(res, scid);
 
 			snprintf(&m_resolved_paramstr_storage[0],
 				m_resolved_paramstr_storage.size(),
@@ -1105,7 +1111,7 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 			uint8_t val = *(uint8_t *)payload;
 
 			sigstr = sinsp_utils::signal_to_str(val);
-			ret = val;
+			sinsp_json_writer::append_uint(res, val);
 
 			if(sigstr)
 			{
@@ -1119,7 +1125,7 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 		{
 			ASSERT(payload_len == sizeof(uint64_t));
 			uint64_t val = *(uint64_t *)payload;
-			ret = (Json::Value::Int64)val;
+			sinsp_json_writer::append_int(res, (int64_t)val);
 
 			snprintf(&m_resolved_paramstr_storage[0],
 						m_resolved_paramstr_storage.size(),
@@ -1132,8 +1138,9 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 	case PT_FLAGS32:
 		{
 			uint32_t val = *(uint32_t *)payload & (((uint64_t)1 << payload_len * 8) - 1);
-			ret["val"] = val;
-			ret["flags"] = Json::arrayValue;
+			bool first = true;
+
+			res->append("{\"flags\":[");
 
 			const struct ppm_name_value *flags = (const struct ppm_name_value *)m_info->params[id].info;
 			uint32_t initial_val = val;
@@ -1142,7 +1149,13 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 			{
 				if((val & flags->value) == flags->value && val != 0)
 				{
-					ret["flags"].append(flags->name);
+					if(!first)
+					{
+						res->push_back(',');
+					}
+
+					sinsp_json_writer::append_string(res, flags->name);
+					first = false;
 
 					// We remove current flags value to avoid duplicate flags e.g. PPM_O_RDWR, PPM_O_RDONLY, PPM_O_WRONLY
 					val &= ~flags->value;
@@ -1153,9 +1166,17 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 
 			if(flags != NULL && flags->name != NULL)
 			{
-				ret["flags"].append(flags->name);
+				if(!first)
+				{
+					res->push_back(',');
+				}
+
+				sinsp_json_writer::append_string(res, flags->name);
 			}
 
+			res->append("],\"val\":");
+			sinsp_json_writer::append_uint(res, initial_val);
+			res->push_back('}');
 			break;
 		}
 	case PT_UID:
@@ -1165,11 +1186,11 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 		uint32_t val = *(uint32_t *)payload;
 		if(val < std::numeric_limits<uint32_t>::max() )
 		{
-			ret = val;
+			sinsp_json_writer::append_uint(res, val);
 		}
 		else
 		{
-			ret = -1;
+			sinsp_json_writer::append_int(res, -1);
 		}
 		break;
 	}
@@ -1183,23 +1204,61 @@ Json::Value sinsp_evt::get_param_as_json(uint32_t id, OUT const char** resolved_
 		snprintf(&m_paramstr_storage[0],
 		         m_paramstr_storage.size(),
 		         "INVALID DYNAMIC PARAMETER");
+		sinsp_json_writer::append_null(res);
 		break;
 	default:
 		ASSERT(false);
 		snprintf(&m_paramstr_storage[0],
 		         m_paramstr_storage.size(),
 		         "(n.a.)");
+		sinsp_json_writer::append_null(res);
 		break;
 	}
 
 	*resolved_str = &m_resolved_paramstr_storage[0];
+}
+
+//
+// Render the names of the flags set in val, separated by '|'
+//
+static string render_flags(const struct ppm_name_value* flags, uint32_t val)
+{
+	string res;
+	uint32_t initial_val = val;
+
+	while(flags != NULL && flags->name != NULL && flags->value != initial_val)
+	{
+		if((val & flags->value) == flags->value && val != 0)
+		{
+			if(!res.empty())
+			{
+				res += '|';
+			}
 
-	return ret;
+			res += flags->name;
+
+			// We remove current flags value to avoid duplicate flags e.g. PPM_O_RDWR, PPM_O_RDONLY, PPM_O_WRONLY
+			val &= ~flags->value;
+		}
+
+		flags++;
+	}
+
+	if(flags != NULL && flags->name != NULL)
+	{
+		if(!res.empty())
+		{
+			res += '|';
+		}
+
+		res += flags->name;
+	}
+
+	return res;
 }
 
 const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_str, sinsp_evt::param_fmt fmt)
 {
-	char* prfmt;
 	const ppm_param_info* param_info;
 	char* payload;
 	uint32_t j;
@@ -1252,35 +1311,19 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 	{
 	case PT_INT8:
 		ASSERT(payload_len == sizeof(int8_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRId8, PRIX8);
-
-		snprintf(&m_paramstr_storage[0],
-			m_paramstr_storage.size(),
-			prfmt, *(int8_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(int8_t *)payload, param_fmt);
 		break;
 	case PT_INT16:
 		ASSERT(payload_len == sizeof(int16_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRId16, PRIX16);
-
-		snprintf(&m_paramstr_storage[0],
-			m_paramstr_storage.size(),
-			prfmt, *(int16_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(int16_t *)payload, param_fmt);
 		break;
 	case PT_INT32:
 		ASSERT(payload_len == sizeof(int32_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRId32, PRIX32);
-
-		snprintf(&m_paramstr_storage[0],
-			m_paramstr_storage.size(),
-			prfmt, *(int32_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(int32_t *)payload, param_fmt);
 		break;
 	case PT_INT64:
 		ASSERT(payload_len == sizeof(int64_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRId64, PRIX64);
-
-		snprintf(&m_paramstr_storage[0],
-			m_paramstr_storage.size(),
-			prfmt, *(int64_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(int64_t *)payload, param_fmt);
 		break;
 	case PT_FD:
 		{
@@ -1293,10 +1336,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 		{
 			ASSERT(payload_len == sizeof(int64_t));
 
-			snprintf(&m_paramstr_storage[0],
-					 m_paramstr_storage.size(),
-					 "%" PRId64, *(int64_t *)payload);
-
+			sinsp_json_writer::write_int(&m_paramstr_storage[0], *(int64_t *)payload);
 
 			sinsp_threadinfo* atinfo = m_inspector->get_thread(*(int64_t *)payload, false, true);
 			if(atinfo != NULL)
@@ -1320,27 +1360,15 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 		break;
 	case PT_UINT8:
 		ASSERT(payload_len == sizeof(uint8_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRIu8, PRIX8);
-
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         prfmt, *(uint8_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(uint8_t *)payload, param_fmt);
 		break;
 	case PT_UINT16:
 		ASSERT(payload_len == sizeof(uint16_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRIu16, PRIX16);
-
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         prfmt, *(uint16_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(uint16_t *)payload, param_fmt);
 		break;
 	case PT_UINT32:
 		ASSERT(payload_len == sizeof(uint32_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRIu32, PRIX32);
-
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         prfmt, *(uint32_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(uint32_t *)payload, param_fmt);
 		break;
 	case PT_ERRNO:
 	{
@@ -1348,49 +1376,41 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 
 		int64_t val = *(int64_t *)payload;
 
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         "%" PRId64, val);
+		sinsp_json_writer::write_int(&m_paramstr_storage[0], val);
 
 		//
 		// Resolve this as an errno
 		//
-		string errstr;
-
 		if(val < 0)
 		{
-			errstr = sinsp_utils::errno_to_str((int32_t)val);
+			const char* errstr = sinsp_utils::errno_to_str((int32_t)val);
 
-			if(errstr != "")
+			if(errstr[0] != 0)
 			{
-				snprintf(&m_resolved_paramstr_storage[0],
-				         m_resolved_paramstr_storage.size(),
-				         "%s", errstr.c_str());
+				copy_resolved_str(errstr);
 			}
 		}
 	}
 	break;
 	case PT_UINT64:
 		ASSERT(payload_len == sizeof(uint64_t));
-		SET_NUMERIC_FORMAT(prfmt, param_fmt, PRIu64, PRIX64);
-
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         prfmt, *(int64_t *)payload);
+		render_numeric_param(&m_paramstr_storage[0], *(uint64_t *)payload, param_fmt);
 
 		break;
 	case PT_CHARBUF:
-		//
-		// Make sure the string will fit
-		//
-		if(payload_len > m_paramstr_storage.size())
 		{
-			m_paramstr_storage.resize(payload_len);
-		}
+			//
+			// Make sure the string will fit
+			//
+			if(payload_len > m_paramstr_storage.size())
+			{
+				m_paramstr_storage.resize(payload_len);
+			}
 
-		snprintf(&m_paramstr_storage[0],
-		         m_paramstr_storage.size(),
-		         "%s", payload);
+			size_t slen = strnlen(payload, m_paramstr_storage.size() - 1);
+			memcpy(&m_paramstr_storage[0], payload, slen);
+			m_paramstr_storage[slen] = 0;
+		}
 		break;
 	case PT_FSPATH:
 	{
@@ -1703,15 +1723,8 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 
 			const struct ppm_syscall_desc* desc = &(g_infotables.m_syscall_info_table[scid]);
 
-			snprintf(&m_paramstr_storage[0],
-				m_paramstr_storage.size(),
-				"%" PRIu16,
-				scid);
-
-			snprintf(&m_resolved_paramstr_storage[0],
-				m_resolved_paramstr_storage.size(),
-				"%s",
-				desc->name);
+			sinsp_json_writer::write_uint(&m_paramstr_storage[0], scid);
+			copy_resolved_str(desc->name);
 		}
 		break;
 	case PT_SIGTYPE:
@@ -1723,15 +1736,11 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 
 			sigstr = sinsp_utils::signal_to_str(val);
 
-			snprintf(&m_paramstr_storage[0],
-					 m_paramstr_storage.size(),
-					 "%" PRIu8, val);
+			sinsp_json_writer::write_uint(&m_paramstr_storage[0], val);
 
 			if(sigstr)
 			{
-				snprintf(&m_resolved_paramstr_storage[0],
-							m_resolved_paramstr_storage.size(),
-							"%s", sigstr);
+				copy_resolved_str(sigstr);
 			}
 		}
 		break;
@@ -1742,9 +1751,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 			ASSERT(payload_len == sizeof(uint64_t));
 			uint64_t val = *(uint64_t *)payload;
 
-			snprintf(&m_paramstr_storage[0],
-					 m_paramstr_storage.size(),
-					 "%" PRIu64, val);
+			sinsp_json_writer::write_uint(&m_paramstr_storage[0], val);
 
 			snprintf(&m_resolved_paramstr_storage[0],
 						m_resolved_paramstr_storage.size(),
@@ -1757,47 +1764,33 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 	case PT_FLAGS32:
 		{
 			uint32_t val = *(uint32_t *)payload & (((uint64_t)1 << payload_len * 8) - 1);
-			snprintf(&m_paramstr_storage[0],
-				     m_paramstr_storage.size(),
-				     "%" PRIu32, val);
+			sinsp_json_writer::write_uint(&m_paramstr_storage[0], val);
 
-			const struct ppm_name_value *flags = (const struct ppm_name_value *)m_info->params[id].info;
-			const char *separator = "";
-			uint32_t initial_val = val;
-			uint32_t j = 0;
+			//
+			// The flag names only depend on the event type, the parameter and
+			// the value, and the same few values keep coming up, so each
+			// rendering is done once and then reused
+			//
+			uint64_t key = ((uint64_t)get_type() << 40) | ((uint64_t)id << 32) | val;
+			unordered_map<uint64_t, string>::iterator it = m_flags_strs.find(key);
 
-			while(flags != NULL && flags->name != NULL && flags->value != initial_val)
+			if(it == m_flags_strs.end())
 			{
-				if((val & flags->value) == flags->value && val != 0)
+				if(m_flags_strs.size() >= MAX_FLAGS_STRS)
 				{
-					if(m_resolved_paramstr_storage.size() < j + strlen(separator) + strlen(flags->name))
-					{
-						m_resolved_paramstr_storage.resize(m_resolved_paramstr_storage.size() * 2);
-					}
-
-					j += snprintf(&m_resolved_paramstr_storage[j],
-								  m_resolved_paramstr_storage.size(),
-							 	  "%s%s",
-							 	  separator,
-							 	  flags->name);
-
-					separator = "|";
-					// We remove current flags value to avoid duplicate flags e.g. PPM_O_RDWR, PPM_O_RDONLY, PPM_O_WRONLY
-					val &= ~flags->value;
+					m_flags_strs.clear();
 				}
 
-				flags++;
+				it = m_flags_strs.insert(pair<uint64_t, string>(key,
+					render_flags((const struct ppm_name_value *)m_info->params[id].info, val))).first;
 			}
 
-			if(flags != NULL && flags->name != NULL)
+			if(it->second.size() >= m_resolved_paramstr_storage.size())
 			{
-				j += snprintf(&m_resolved_paramstr_storage[j],
-							  m_resolved_paramstr_storage.size(),
-							  "%s%s",
-							  separator,
-							  flags->name);
+				m_resolved_paramstr_storage.resize(it->second.size() + 1);
 			}
 
+			memcpy(&m_resolved_paramstr_storage[0], it->second.c_str(), it->second.size() + 1);
 			break;
 		}
 	case PT_ABSTIME:
@@ -1816,9 +1809,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 		uint32_t val = *(uint32_t *)payload;
 		if (val < std::numeric_limits<uint32_t>::max())
 		{
-			snprintf(&m_paramstr_storage[0],
-					 m_paramstr_storage.size(),
-					 "%d", val);
+			sinsp_json_writer::write_int(&m_paramstr_storage[0], (int32_t)val);
 			auto find_it = m_inspector->get_userlist()->find(val);
 			if (find_it != m_inspector->get_userlist()->end())
 			{
@@ -1849,9 +1840,7 @@ const char* sinsp_evt::get_param_as_str(uint32_t id, OUT const char** resolved_s
 		uint32_t val = *(uint32_t *)payload;
 		if (val < std::numeric_limits<uint32_t>::max())
 		{
-			snprintf(&m_paramstr_storage[0],
-					 m_paramstr_storage.size(),
-					 "%d", val);
+			sinsp_json_writer::write_int(&m_paramstr_storage[0], (int32_t)val);
 			auto find_it = m_inspector->get_grouplist()->find(val);
 			if (find_it != m_inspector->get_grouplist()->end())
 			{
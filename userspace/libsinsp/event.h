@@ -25,6 +25,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef class sinsp sinsp;
 typedef class sinsp_threadinfo sinsp_threadinfo;
+class sinsp_extraction_cache;
 
 ///////////////////////////////////////////////////////////////////////////////
 // Event arguments
@@ -230,6 +231,15 @@ public:
 	*/
 	int64_t get_fd_num();
 
+	/*!
+	  \brief If this event is the exit of a failed system call, return the
+	   call's error code (e.g. ENOENT), otherwise return 0.
+	*/
+	inline int32_t get_errorcode()
+	{
+		return m_errorcode;
+	}
+
 	/*!
 	  \brief Return the number of parameters that this event has.
 	*/
@@ -298,7 +308,7 @@ private:
 	void set_iosize(uint32_t size);
 	uint32_t get_iosize();
 	const char* get_param_as_str(uint32_t id, OUT const char** resolved_str, param_fmt fmt = PF_NORMAL);
-	Json::Value get_param_as_json(uint32_t id, OUT const char** resolved_str, param_fmt fmt = PF_NORMAL);
+	void get_param_as_json(uint32_t id, OUT string* res, OUT const char** resolved_str, param_fmt fmt = PF_NORMAL);
 
 	const char* get_param_value_str(const char* name, OUT const char** resolved_str, param_fmt fmt = PF_NORMAL);
 
@@ -342,7 +352,17 @@ private:
 	string get_param_value_str(uint32_t id, bool resolved);
 	string get_param_value_str(const char* name, bool resolved = true);
 	char* render_fd(int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt);
-	int render_fd_json(Json::Value *ret, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt);
+	//
+	// Copy str into m_resolved_paramstr_storage, truncating it if needed
+	//
+	inline void copy_resolved_str(const char* str)
+	{
+		size_t len = strnlen(str, m_resolved_paramstr_storage.size() - 1);
+
+		memcpy(&m_resolved_paramstr_storage[0], str, len);
+		m_resolved_paramstr_storage[len] = 0;
+	}
+	void render_fd_json(string* res, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt);
 	uint32_t get_dump_flags();
 
 VISIBILITY_PRIVATE
@@ -357,6 +377,8 @@ VISIBILITY_PRIVATE
 
 	vector<char> m_paramstr_storage;
 	vector<char> m_resolved_paramstr_storage;
+	// Rendered flag names, keyed by event type, parameter id and value
+	unordered_map<uint64_t, string> m_flags_strs;
 
 	sinsp_threadinfo* m_tinfo;
 	sinsp_fdinfo_t* m_fdinfo;
@@ -365,6 +387,8 @@ VISIBILITY_PRIVATE
 	int32_t m_rawbuf_str_len;
 #ifdef HAS_FILTERING
 	bool m_filtered_out;
+	// Shared by the checks that extract fields from this event, if enabled
+	sinsp_extraction_cache* m_extraction_cache;
 #endif
 	const struct ppm_event_info* m_event_info_table;
 
@@ -372,6 +396,7 @@ VISIBILITY_PRIVATE
 	friend class sinsp_parser;
 	friend class sinsp_threadinfo;
 	friend class sinsp_analyzer;
+	friend class sinsp_filter_check;
 	friend class sinsp_filter_check_event;
 	friend class sinsp_filter_check_thread;
 	friend class sinsp_dumper;
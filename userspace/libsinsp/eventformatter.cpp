@@ -21,6 +21,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "filter.h"
 #include "filterchecks.h"
 #include "eventformatter.h"
+#include "json_writer.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // rawstring_check implementation
@@ -32,6 +33,7 @@ sinsp_evt_formatter::sinsp_evt_formatter(sinsp* inspector, const string& fmt)
 {
 	m_inspector = inspector;
 	m_first = true;
+	m_binary = false;
 	set_format(fmt);
 }
 
@@ -76,6 +78,8 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 	const char* cfmt = lfmt.c_str();
 
 	m_tokens.clear();
+	m_tokenlens.clear();
+	m_ops.clear();
 	uint32_t lfmtlen = (uint32_t)lfmt.length();
 
 	for(j = 0; j < lfmtlen; j++)
@@ -86,10 +90,7 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 			if(last_nontoken_str_start != j)
 			{
-				rawstring_check* newtkn = new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
-				m_tokens.push_back(newtkn);
-				m_tokenlens.push_back(0);
-				m_chks_to_free.push_back(newtkn);
+				add_literal(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
 			}
 
 			if(j == lfmtlen - 1)
@@ -139,32 +140,168 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 
 			m_chks_to_free.push_back(chk);
 
-			j += chk->parse_field_name(cfmt + j + 1, true);
+			int32_t fldlen = chk->parse_field_name(cfmt + j + 1, true);
+			chk->m_cache_key = string(cfmt + j + 1, fldlen);
+
+			j += fldlen;
 			ASSERT(j <= lfmt.length());
 
 			m_tokens.push_back(chk);
 			m_tokenlens.push_back(toklen);
 
+			emit_op op;
+			op.m_chk = chk;
+			op.m_text = NULL;
+			op.m_width = toklen;
+			m_ops.push_back(op);
+
 			last_nontoken_str_start = j + 1;
 		}
 	}
 
 	if(last_nontoken_str_start != j)
 	{
-		m_tokens.push_back(new rawstring_check(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start)));
-		m_tokenlens.push_back(0);
+		add_literal(lfmt.substr(last_nontoken_str_start, j - last_nontoken_str_start));
 	}
+
+	compile_json_layout();
+	compile_binary_schema();
+}
+
+void sinsp_evt_formatter::compile_json_layout()
+{
+	uint32_t j;
+	map<string, uint32_t> members;
+	map<string, uint32_t>::iterator it;
+
+	//
+	// The JSON rendering is an object with one member per field name, the
+	// last token winning when a name repeats, and with the members sorted
+	// by name. Figure out the layout now, so that rendering an event is
+	// just a matter of filling the member values.
+	//
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		const filtercheck_field_info* fi = m_tokens[j]->get_field_info();
+
+		if(fi != NULL)
+		{
+			members[fi->m_name] = 0;
+		}
+	}
+
+	m_json_keys.clear();
+	m_json_vals.clear();
+	m_json_members.clear();
+
+	for(it = members.begin(); it != members.end(); ++it)
+	{
+		it->second = (uint32_t)m_json_keys.size();
+		m_json_keys.push_back(string(m_json_keys.size() == 0 ? "{" : ",") +
+			sinsp_json_writer::quote_key(it->first));
+	}
+
+	m_json_vals.resize(m_json_keys.size());
+
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		const filtercheck_field_info* fi = m_tokens[j]->get_field_info();
+
+		if(fi != NULL)
+		{
+			m_json_members.push_back(members[fi->m_name]);
+		}
+		else
+		{
+			m_json_members.push_back(-1);
+		}
+	}
+}
+
+//
+// Binary output format, see sinsp_evt_formatter::set_binary_output()
+//
+#define BINARY_OUTPUT_MAGIC "SYSB"
+#define BINARY_OUTPUT_VERSION 1
+#define BINARY_OUTPUT_NO_VALUE 0xffffffff
+
+static inline void append_binary(string* res, const void* val, uint32_t len)
+{
+	res->append((const char*)val, len);
+}
+
+static inline void append_binary_u16(string* res, uint16_t val)
+{
+	append_binary(res, &val, sizeof(val));
+}
+
+static inline void append_binary_u32(string* res, uint32_t val)
+{
+	append_binary(res, &val, sizeof(val));
+}
+
+void sinsp_evt_formatter::compile_binary_schema()
+{
+	uint16_t nfields = 0;
+	string fields;
+
+	for(vector<emit_op>::iterator it = m_ops.begin(); it != m_ops.end(); ++it)
+	{
+		if(it->m_chk == NULL)
+		{
+			continue;
+		}
+
+		const filtercheck_field_info* fi = it->m_chk->get_field_info();
+		const string& name = it->m_chk->m_cache_key;
+
+		append_binary_u16(&fields, (uint16_t)fi->m_type);
+		append_binary_u16(&fields, (uint16_t)fi->m_print_format);
+		append_binary_u16(&fields, (uint16_t)name.size());
+		fields.append(name);
+		nfields++;
+	}
+
+	m_binary_schema = BINARY_OUTPUT_MAGIC;
+	append_binary_u16(&m_binary_schema, BINARY_OUTPUT_VERSION);
+	append_binary_u16(&m_binary_schema, nfields);
+	m_binary_schema.append(fields);
+}
+
+void sinsp_evt_formatter::set_binary_output(bool enable)
+{
+	m_binary = enable;
+}
+
+void sinsp_evt_formatter::add_literal(const string& text)
+{
+	rawstring_check* newtkn = new rawstring_check(text);
+	m_tokens.push_back(newtkn);
+	m_tokenlens.push_back(0);
+	m_chks_to_free.push_back(newtkn);
+
+	emit_op op;
+	op.m_chk = NULL;
+	op.m_text = &newtkn->m_text;
+	op.m_width = 0;
+	m_ops.push_back(op);
+}
+
+bool sinsp_evt_formatter::is_json_format()
+{
+	sinsp_evt::param_fmt fmt = m_inspector->get_buffer_format();
+
+	return fmt == sinsp_evt::PF_JSON ||
+		fmt == sinsp_evt::PF_JSONEOLS ||
+		fmt == sinsp_evt::PF_JSONHEX ||
+		fmt == sinsp_evt::PF_JSONHEXASCII ||
+		fmt == sinsp_evt::PF_JSONBASE64;
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT string* res)
 {
 	res->clear();
-	if(!m_first &&
-		(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-		|| m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64))
+	if(!m_first && !m_binary && is_json_format())
 	{
 		(*res) = ']';
 	}
@@ -172,103 +309,190 @@ bool sinsp_evt_formatter::on_capture_end(OUT string* res)
 	return res->size() > 0;
 }
 
-bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
+bool sinsp_evt_formatter::tostring_binary(sinsp_evt* evt, OUT string* res)
 {
 	bool retval = true;
-	const filtercheck_field_info* fi;
 
-	uint32_t j = 0;
-	vector<sinsp_filter_check*>::iterator it;
-	res->clear();
-
-	ASSERT(m_tokenlens.size() == m_tokens.size());
+	//
+	// Leave room for the record length, which is known at the end
+	//
+	append_binary_u32(res, 0);
 
-	for(j = 0; j < m_tokens.size(); j++)
+	for(vector<emit_op>::iterator it = m_ops.begin(); it != m_ops.end(); ++it)
 	{
-		if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
+		if(it->m_chk == NULL)
 		{
-			Json::Value json_value = m_tokens[j]->tojson(evt);
+			continue;
+		}
 
-			if(retval == false)
-			{
-				continue;
-			}
+		uint32_t len = 0;
+		uint8_t* rawval = it->m_chk->extract_cached(evt, &len);
+
+		if(retval == false)
+		{
+			continue;
+		}
 
-			if(json_value == Json::Value::nullRef && m_require_all_values)
+		if(rawval == NULL)
+		{
+			if(m_require_all_values)
 			{
 				retval = false;
 				continue;
 			}
 
-			fi = m_tokens[j]->get_field_info();
+			append_binary_u32(res, BINARY_OUTPUT_NO_VALUE);
+			continue;
+		}
 
-			if(fi && fi->m_name) 
-			{
-				m_root[fi->m_name] = m_tokens[j]->tojson(evt);
-			} 
-		} 
-		else 
-		{
-			char* str = m_tokens[j]->tostring(evt);
+		len = sinsp_filter_check::rawval_len(it->m_chk->get_field_info(), rawval, len);
+		append_binary_u32(res, len);
+		append_binary(res, rawval, len);
+	}
 
-			if(retval == false)
+	uint32_t reclen = (uint32_t)(res->size() - sizeof(uint32_t));
+	memcpy(&(*res)[0], &reclen, sizeof(reclen));
+
+	if(retval && m_first)
+	{
+		res->insert(0, m_binary_schema);
+		m_first = false;
+	}
+
+	return retval;
+}
+
+bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
+{
+	bool retval = true;
+
+	uint32_t j = 0;
+	res->clear();
+
+	ASSERT(m_tokenlens.size() == m_tokens.size());
+
+	if(m_binary)
+	{
+		return tostring_binary(evt, res);
+	}
+
+	if(is_json_format())
+	{
+		for(j = 0; j < m_tokens.size(); j++)
+		{
+			if(retval == false || m_json_members[j] < 0)
 			{
+				//
+				// Nothing to render, but extract the field anyway, because
+				// some checks keep state across events
+				//
+				uint32_t len;
+				m_tokens[j]->extract_cached(evt, &len);
 				continue;
 			}
 
-			if(str == NULL) 
+			string* val = &m_json_vals[m_json_members[j]];
+			val->clear();
+
+			if(!m_tokens[j]->tojson_append(evt, val))
 			{
 				if(m_require_all_values)
 				{
 					retval = false;
 					continue;
 				}
-				else 
-				{
-					str = (char*)"<NA>";
-				}
-			}
-
-			uint32_t tks = m_tokenlens[j];
 
-			if(tks != 0)
-			{
-				string sstr(str);
-				sstr.resize(tks, ' ');
-				(*res) += sstr;
-			}
-			else
-			{
-				(*res) += str;
+				sinsp_json_writer::append_null(val);
 			}
 		}
-	}
 
-	if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
-	{
-		if(m_first) 
+		if(!retval)
+		{
+			//
+			// The event is not printed, so it can't open the JSON array
+			//
+			return false;
+		}
+
+		if(m_first)
 		{
 			// Give it the opening stanza of a JSON array
 			(*res) = '[';
 			m_first = false;
-		} 
-		else 
+		}
+		else
 		{
 			// Otherwise say this is another object in an
 			// existing JSON array
 			(*res) = ",\n";
 		}
 
-		(*res) += m_writer.write( m_root );
-		(*res) = res->substr(0, res->size() - 1);
+		if(m_json_keys.size() == 0)
+		{
+			sinsp_json_writer::append_null(res);
+			return retval;
+		}
+
+		for(j = 0; j < m_json_keys.size(); j++)
+		{
+			res->append(m_json_keys[j]);
+			res->append(m_json_vals[j]);
+		}
+
+		res->push_back('}');
+
+		return retval;
+	}
+
+	//
+	// Run the compiled format. Everything is rendered directly into res,
+	// which keeps its capacity across events.
+	//
+	for(vector<emit_op>::iterator it = m_ops.begin(); it != m_ops.end(); ++it)
+	{
+		if(it->m_chk == NULL)
+		{
+			res->append(*it->m_text);
+			continue;
+		}
+
+		if(retval == false)
+		{
+			//
+			// The result will be discarded, but the field still needs to be
+			// extracted, because some checks keep state across events
+			//
+			uint32_t len;
+			it->m_chk->extract_cached(evt, &len);
+			continue;
+		}
+
+		size_t start = res->size();
+
+		if(!it->m_chk->tostring_append(evt, res))
+		{
+			if(m_require_all_values)
+			{
+				retval = false;
+				continue;
+			}
+
+			res->append("<NA>");
+		}
+
+		if(it->m_width != 0)
+		{
+			size_t rlen = res->size() - start;
+
+			if(rlen < it->m_width)
+			{
+				res->append(it->m_width - rlen, ' ');
+			}
+			else
+			{
+				res->resize(start + it->m_width);
+			}
+		}
 	}
 
 	return retval;
@@ -290,4 +514,9 @@ bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
 	return false;
 }
+
+void sinsp_evt_formatter::set_binary_output(bool enable)
+{
+	throw sinsp_exception("sinsp_evt_formatter unvavailable because it was not compiled in the library");
+}
 #endif // HAS_FILTERING
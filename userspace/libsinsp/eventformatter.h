@@ -66,18 +66,68 @@ public:
 	*/
 	bool on_capture_end(OUT string* res);
 
+	/*!
+	  \brief Makes tostring() produce binary records, meant to be consumed by
+	   other programs without any parsing, instead of text or JSON.
+
+	  The literal text in the format and the field length modifiers are
+	   ignored. The first record is preceded by a schema header:
+	   - the "SYSB" magic, a uint16_t version (1) and a uint16_t field count
+	   - for each field of the format, in order, its ppm_param_type and
+	     ppm_print_format as uint16_t, then its name as it appears in the
+	     format (e.g. "evt.arg.fd"), as a uint16_t length and the characters.
+
+	  Each record is a uint32_t length followed by that many bytes, which
+	   contain, for each field, a uint32_t value length and the value in the
+	   native encoding of the field type, e.g. 8 bytes for a PT_UINT64 or the
+	   characters, without terminator, of a PT_CHARBUF. A length of 0xffffffff
+	   and no value bytes mean the field has no value for the event. All
+	   integers are in host byte order.
+
+	  \param enable true to emit binary records, false to go back to the
+	   normal output.
+	*/
+	void set_binary_output(bool enable);
+
 private:
+	//
+	// One step of the compiled format: either copy some literal text or
+	// render a field, padded or truncated to m_width if it's not 0
+	//
+	struct emit_op
+	{
+		sinsp_filter_check* m_chk; // NULL for literal text
+		const string* m_text;
+		uint32_t m_width;
+	};
+
 	void set_format(const string& fmt);
+	void add_literal(const string& text);
+	void compile_json_layout();
+	void compile_binary_schema();
+	bool tostring_binary(sinsp_evt* evt, OUT string* res);
+	bool is_json_format();
 	vector<sinsp_filter_check*> m_tokens;
 	vector<uint32_t> m_tokenlens;
+	vector<emit_op> m_ops;
 	sinsp* m_inspector;
 	bool m_require_all_values;
 	vector<sinsp_filter_check*> m_chks_to_free;
 
+	//
+	// JSON layout: the pre-quoted member names, in output order, the
+	// rendered value of each member, and the member each token fills
+	// (-1 for none)
+	//
+	vector<string> m_json_keys;
+	vector<string> m_json_vals;
+	vector<int32_t> m_json_members;
+
+	bool m_binary;
+	string m_binary_schema;
+
 	// Is this the first to_string call?
 	bool m_first;
-	Json::Value m_root;
-	Json::FastWriter m_writer;
 };
 
 /*@}*/
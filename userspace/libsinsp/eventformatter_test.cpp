@@ -0,0 +1,324 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest.h>
+#define VISIBILITY_PRIVATE
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "parsers.h"
+#include "eventformatter.h"
+#include "../../driver/ppm_events_public.h"
+
+#define TEST_FORMAT "*%evt.num %evt.cpu %proc.name %proc.pid %evt.type %fd.name"
+
+//
+// The events of the test, built in memory and parsed by the inspector as if
+// they came from the driver
+//
+static void fill_event(vector<char>* buf, uint64_t num, uint16_t type, int64_t tid, const vector<string>& params)
+{
+	uint32_t len = sizeof(scap_evt) + params.size() * sizeof(uint16_t);
+	for(uint32_t j = 0; j < params.size(); j++)
+	{
+		len += params[j].size();
+	}
+
+	buf->resize(len);
+	scap_evt* pevt = (scap_evt*)&(*buf)[0];
+	pevt->ts = num;
+	pevt->tid = tid;
+	pevt->len = len;
+	pevt->type = type;
+
+	uint16_t* lens = (uint16_t*)(&(*buf)[0] + sizeof(scap_evt));
+	char* data = (char*)(lens + params.size());
+	for(uint32_t j = 0; j < params.size(); j++)
+	{
+		lens[j] = params[j].size();
+		memcpy(data, params[j].data(), params[j].size());
+		data += params[j].size();
+	}
+}
+
+//
+// Decoder of the --binary output, see sinsp_evt_formatter::set_binary_output()
+//
+class binary_reader
+{
+public:
+	binary_reader(const string& data)
+	{
+		m_data = data;
+		m_pos = 0;
+	}
+
+	bool at_end()
+	{
+		return m_pos == m_data.size();
+	}
+
+	void get(void* dst, uint32_t len)
+	{
+		ASSERT_LE(m_pos + len, m_data.size());
+		memcpy(dst, m_data.data() + m_pos, len);
+		m_pos += len;
+	}
+
+	string get_bytes(uint32_t len)
+	{
+		string res;
+		if(m_pos + len <= m_data.size())
+		{
+			res = m_data.substr(m_pos, len);
+		}
+		m_pos += len;
+		return res;
+	}
+
+	uint16_t get_u16()
+	{
+		uint16_t res = 0;
+		get(&res, sizeof(res));
+		return res;
+	}
+
+	uint32_t get_u32()
+	{
+		uint32_t res = 0;
+		get(&res, sizeof(res));
+		return res;
+	}
+
+	string m_data;
+	size_t m_pos;
+};
+
+struct binary_field
+{
+	uint16_t m_type;
+	string m_name;
+};
+
+//
+// Render a decoded value like the text output does for the types in
+// TEST_FORMAT
+//
+static string binary_value_to_string(uint16_t type, const string& val)
+{
+	char buf[64];
+
+	switch(type)
+	{
+	case PT_INT16:
+		EXPECT_EQ(sizeof(int16_t), val.size());
+		snprintf(buf, sizeof(buf), "%d", (int)*(int16_t*)val.data());
+		return buf;
+	case PT_INT64:
+		EXPECT_EQ(sizeof(int64_t), val.size());
+		snprintf(buf, sizeof(buf), "%" PRId64, *(int64_t*)val.data());
+		return buf;
+	case PT_UINT64:
+		EXPECT_EQ(sizeof(uint64_t), val.size());
+		snprintf(buf, sizeof(buf), "%" PRIu64, *(uint64_t*)val.data());
+		return buf;
+	case PT_CHARBUF:
+		return val;
+	default:
+		ADD_FAILURE() << "unexpected type " << type;
+		return "";
+	}
+}
+
+class binary_output_test : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		m_inspector.m_islive = true;
+
+		sinsp_threadinfo tinfo(&m_inspector);
+		tinfo.m_tid = 100;
+		tinfo.m_pid = 100;
+		tinfo.m_ptid = 1;
+		tinfo.m_comm = "cat";
+		tinfo.m_exe = "cat";
+		m_inspector.m_thread_manager->add_thread(tinfo, true);
+
+		sinsp_fdinfo_t fdinfo;
+		fdinfo.m_type = SCAP_FD_FILE;
+		fdinfo.m_name = "/etc/passwd";
+		m_inspector.get_thread(100, false, true)->add_fd(3, &fdinfo);
+	}
+
+	//
+	// Run the events through a text and a binary formatter, returning the
+	// text lines and the binary stream
+	//
+	void format_events(OUT vector<string>* lines, OUT string* binary)
+	{
+		sinsp_evt_formatter text_formatter(&m_inspector, TEST_FORMAT);
+		sinsp_evt_formatter binary_formatter(&m_inspector, TEST_FORMAT);
+		binary_formatter.set_binary_output(true);
+
+		vector<string> read_params;
+		int64_t fd = 3;
+		uint32_t size = 100;
+		read_params.push_back(string((char*)&fd, sizeof(fd)));
+		read_params.push_back(string((char*)&size, sizeof(size)));
+
+		vector<char> bufs[2];
+		fill_event(&bufs[0], 1, PPME_SYSCALL_READ_E, 100, read_params);
+		fill_event(&bufs[1], 2, PPME_SYSCALL_OPEN_E, 100, vector<string>());
+
+		for(uint32_t j = 0; j < 2; j++)
+		{
+			sinsp_evt evt(&m_inspector);
+			evt.m_pevt = (scap_evt*)&bufs[j][0];
+			evt.m_cpuid = 2;
+			evt.m_evtnum = j + 1;
+			m_inspector.m_parser->process_event(&evt);
+
+			string line;
+			ASSERT_TRUE(text_formatter.tostring(&evt, &line));
+			lines->push_back(line);
+
+			string rec;
+			ASSERT_TRUE(binary_formatter.tostring(&evt, &rec));
+			binary->append(rec);
+		}
+	}
+
+	sinsp m_inspector;
+};
+
+TEST_F(binary_output_test, matches_text_output)
+{
+	vector<string> lines;
+	string binary;
+	format_events(&lines, &binary);
+
+	ASSERT_EQ(2u, lines.size());
+	EXPECT_EQ("1 2 cat 100 read /etc/passwd", lines[0]);
+	EXPECT_EQ("2 2 cat 100 open <NA>", lines[1]);
+
+	binary_reader r(binary);
+
+	//
+	// Schema header, with the fields in the order of the format
+	//
+	EXPECT_EQ("SYSB", r.get_bytes(4));
+	EXPECT_EQ(1, r.get_u16());
+	uint16_t nfields = r.get_u16();
+	ASSERT_EQ(6, nfields);
+
+	const char* names[] = {"evt.num", "evt.cpu", "proc.name", "proc.pid", "evt.type", "fd.name"};
+	vector<binary_field> fields;
+
+	for(uint32_t j = 0; j < nfields; j++)
+	{
+		binary_field f;
+		f.m_type = r.get_u16();
+		r.get_u16();
+		f.m_name = r.get_bytes(r.get_u16());
+		EXPECT_EQ(names[j], f.m_name);
+		fields.push_back(f);
+	}
+
+	//
+	// One record per event, each one rendering like the text line
+	//
+	for(uint32_t j = 0; j < lines.size(); j++)
+	{
+		uint32_t reclen = r.get_u32();
+		size_t recend = r.m_pos + reclen;
+		ASSERT_LE(recend, binary.size());
+
+		string line;
+		for(uint32_t k = 0; k < fields.size(); k++)
+		{
+			uint32_t len = r.get_u32();
+
+			if(k != 0)
+			{
+				line += ' ';
+			}
+
+			if(len == 0xffffffff)
+			{
+				line += "<NA>";
+			}
+			else
+			{
+				line += binary_value_to_string(fields[k].m_type, r.get_bytes(len));
+			}
+		}
+
+		EXPECT_EQ(recend, r.m_pos);
+		EXPECT_EQ(lines[j], line);
+	}
+
+	EXPECT_TRUE(r.at_end());
+}
+
+class json_output_test : public binary_output_test
+{
+};
+
+TEST_F(json_output_test, dropped_first_event_keeps_array_open)
+{
+	m_inspector.set_buffer_format(sinsp_evt::PF_JSON);
+
+	//
+	// No '*', so the open event, that has no fd, is not printed
+	//
+	sinsp_evt_formatter formatter(&m_inspector, "%evt.num %fd.name");
+
+	vector<string> read_params;
+	int64_t fd = 3;
+	uint32_t size = 100;
+	read_params.push_back(string((char*)&fd, sizeof(fd)));
+	read_params.push_back(string((char*)&size, sizeof(size)));
+
+	vector<char> bufs[3];
+	fill_event(&bufs[0], 1, PPME_SYSCALL_OPEN_E, 100, vector<string>());
+	fill_event(&bufs[1], 2, PPME_SYSCALL_READ_E, 100, read_params);
+	fill_event(&bufs[2], 3, PPME_SYSCALL_READ_E, 100, read_params);
+
+	string out;
+	for(uint32_t j = 0; j < 3; j++)
+	{
+		sinsp_evt evt(&m_inspector);
+		evt.m_pevt = (scap_evt*)&bufs[j][0];
+		evt.m_cpuid = 2;
+		evt.m_evtnum = j + 1;
+		m_inspector.m_parser->process_event(&evt);
+
+		string line;
+		if(formatter.tostring(&evt, &line))
+		{
+			out += line;
+		}
+	}
+
+	string end;
+	ASSERT_TRUE(formatter.on_capture_end(&end));
+	out += end;
+
+	EXPECT_EQ("[{\"evt.num\":2,\"fd.name\":\"/etc/passwd\"},\n"
+		"{\"evt.num\":3,\"fd.name\":\"/etc/passwd\"}]", out);
+}
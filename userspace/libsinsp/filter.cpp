@@ -32,6 +32,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef HAS_FILTERING
 #include "filter.h"
 #include "filterchecks.h"
+#include "json_writer.h"
 
 #ifndef _GNU_SOURCE
 //
@@ -440,6 +441,8 @@ sinsp_filter_check::sinsp_filter_check() :
 	m_val_storage_len = 0;
 	m_aggregation = A_NONE;
 	m_merge_aggregation = A_NONE;
+	m_extraction_cache = NULL;
+	m_cache_slot = EXTRACTION_CACHE_NO_SLOT;
 }
 
 void sinsp_filter_check::set_inspector(sinsp* inspector)
@@ -932,7 +935,7 @@ void sinsp_filter_check::string_to_rawval(const char* str, uint32_t len, ppm_par
 char* sinsp_filter_check::tostring(sinsp_evt* evt)
 {
 	uint32_t len;
-	uint8_t* rawval = extract(evt, &len);
+	uint8_t* rawval = extract_cached(evt, &len);
 
 	if(rawval == NULL)
 	{
@@ -942,6 +945,129 @@ char* sinsp_filter_check::tostring(sinsp_evt* evt)
 	return rawval_to_string(rawval, m_field, len);
 }
 
+bool sinsp_filter_check::tostring_append(sinsp_evt* evt, OUT string* res)
+{
+	uint32_t len;
+	uint8_t* rawval = extract_cached(evt, &len);
+
+	if(rawval == NULL)
+	{
+		return false;
+	}
+
+	bool dec = (m_field->m_print_format == PF_DEC || m_field->m_print_format == PF_ID);
+
+	//
+	// Keep in sync with rawval_to_string(), which handles everything that is
+	// not covered here
+	//
+	switch(m_field->m_type)
+	{
+	case PT_INT8:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT16:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT32:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT64:
+	case PT_PID:
+	case PT_ERRNO:
+		if(m_field->m_print_format == PF_HEX)
+		{
+			sinsp_json_writer::append_hex(res, *(uint64_t*)rawval);
+		}
+		else if(m_field->m_print_format == PF_10_PADDED_DEC)
+		{
+			if(*(int64_t*)rawval < 0)
+			{
+				break;
+			}
+
+			sinsp_json_writer::append_uint(res, *(uint64_t*)rawval, 9);
+		}
+		else
+		{
+			sinsp_json_writer::append_int(res, *(int64_t*)rawval);
+		}
+		return true;
+	case PT_L4PROTO:
+	case PT_UINT8:
+		if(dec || m_field->m_print_format == PF_HEX)
+		{
+			sinsp_json_writer::append_uint(res, *(uint8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_PORT:
+	case PT_UINT16:
+		if(dec || m_field->m_print_format == PF_HEX)
+		{
+			sinsp_json_writer::append_uint(res, *(uint16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT32:
+		if(dec || m_field->m_print_format == PF_HEX)
+		{
+			sinsp_json_writer::append_uint(res, *(uint32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(dec)
+		{
+			sinsp_json_writer::append_uint(res, *(uint64_t*)rawval);
+			return true;
+		}
+		else if(m_field->m_print_format == PF_10_PADDED_DEC)
+		{
+			sinsp_json_writer::append_uint(res, *(uint64_t*)rawval, 9);
+			return true;
+		}
+		else if(m_field->m_print_format == PF_HEX)
+		{
+			sinsp_json_writer::append_hex(res, *(uint64_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_CHARBUF:
+		res->append((char*)rawval);
+		return true;
+	case PT_BOOL:
+		res->append((*(uint32_t*)rawval != 0) ? "true" : "false");
+		return true;
+	default:
+		break;
+	}
+
+	char* str = rawval_to_string(rawval, m_field, len);
+
+	if(str == NULL)
+	{
+		return false;
+	}
+
+	res->append(str);
+	return true;
+}
+
 Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 {
 	uint32_t len;
@@ -949,7 +1075,7 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 
 	if(jsonval == Json::Value::nullRef)
 	{
-		uint8_t* rawval = extract(evt, &len);
+		uint8_t* rawval = extract_cached(evt, &len);
 		if(rawval == NULL)
 		{
 			return Json::Value::nullRef
@@ -961,6 +1087,133 @@ Json::Value sinsp_filter_check::tojson(sinsp_evt* evt)
 	return jsonval;
 }
 
+bool sinsp_filter_check::tojson_append(sinsp_evt* evt, OUT string* res)
+{
+	uint32_t len;
+	Json::Value jsonval = extract_as_js(evt, &len);
+
+	if(jsonval != Json::Value::nullRef)
+	{
+		sinsp_json_writer::append_value(res, jsonval);
+		return true;
+	}
+
+	uint8_t* rawval = extract_cached(evt, &len);
+	if(rawval == NULL)
+	{
+		return false;
+	}
+
+	//
+	// This mirrors rawval_to_json()
+	//
+	bool dec = (m_field->m_print_format == PF_DEC || m_field->m_print_format == PF_ID);
+	bool as_string = (m_field->m_print_format == PF_HEX);
+
+	switch(m_field->m_type)
+	{
+	case PT_INT8:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT16:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT32:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_INT64:
+	case PT_PID:
+		if(dec)
+		{
+			sinsp_json_writer::append_int(res, *(int64_t*)rawval);
+			return true;
+		}
+		as_string = true;
+		break;
+	case PT_L4PROTO:
+	case PT_UINT8:
+		if(dec)
+		{
+			sinsp_json_writer::append_uint(res, *(uint8_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_PORT:
+	case PT_UINT16:
+		if(dec)
+		{
+			sinsp_json_writer::append_uint(res, *(uint16_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT32:
+		if(dec)
+		{
+			sinsp_json_writer::append_uint(res, *(uint32_t*)rawval);
+			return true;
+		}
+		break;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		if(dec)
+		{
+			sinsp_json_writer::append_uint(res, *(uint64_t*)rawval);
+			return true;
+		}
+		as_string = as_string || m_field->m_print_format == PF_10_PADDED_DEC;
+		break;
+	case PT_SOCKADDR:
+	case PT_SOCKFAMILY:
+		ASSERT(false);
+		return false;
+	case PT_BOOL:
+		sinsp_json_writer::append_bool(res, *(uint32_t*)rawval != 0);
+		return true;
+	case PT_CHARBUF:
+		sinsp_json_writer::append_string(res, (char*)rawval);
+		return true;
+	case PT_BYTEBUF:
+	case PT_IPV4ADDR:
+		as_string = true;
+		break;
+	default:
+		ASSERT(false);
+		throw sinsp_exception("wrong event type " + to_string((long long) m_field->m_type));
+	}
+
+	//
+	// Everything else is rendered as a string, like the text output does
+	//
+	if(!as_string)
+	{
+		ASSERT(false);
+		return false;
+	}
+
+	char* str = rawval_to_string(rawval, m_field, len);
+
+	if(str == NULL)
+	{
+		return false;
+	}
+
+	sinsp_json_writer::append_string(res, str);
+	return true;
+}
+
 int32_t sinsp_filter_check::parse_field_name(const char* str, bool alloc_state)
 {
 	int32_t j;
@@ -1005,7 +1258,7 @@ const filtercheck_field_info* sinsp_filter_check::get_field_info()
 bool sinsp_filter_check::compare(sinsp_evt *evt)
 {
 	uint32_t len;
-	uint8_t* extracted_val = extract(evt, &len);
+	uint8_t* extracted_val = extract_cached(evt, &len);
 
 	if(extracted_val == NULL)
 	{
@@ -1020,6 +1273,25 @@ bool sinsp_filter_check::compare(sinsp_evt *evt)
 		m_val_storage_len);
 }
 
+bool sinsp_filter_check::is_cacheable()
+{
+	return true;
+}
+
+void sinsp_filter_check::bind_extraction_cache(sinsp_extraction_cache* cache)
+{
+	m_extraction_cache = cache;
+
+	if(m_cache_key.empty() || !is_cacheable())
+	{
+		m_cache_slot = EXTRACTION_CACHE_NO_SLOT;
+	}
+	else
+	{
+		m_cache_slot = cache->get_slot(m_cache_key);
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_expression implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -1466,6 +1738,7 @@ void sinsp_filter::parse_check(sinsp_filter_expression* parent_expr, boolop op)
 	chk->m_cmpop = co;
 
 	chk->parse_field_name((char *)&operand1[0], true);
+	chk->m_cache_key = str_operand1;
 
 	//
 	// In this case we need to create '(field=value1 or field=value2 ...)'
@@ -1716,4 +1989,80 @@ bool sinsp_filter::run(sinsp_evt *evt)
 	return m_filter->compare(evt);
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_extraction_cache implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_extraction_cache::sinsp_extraction_cache()
+{
+	m_gen = 0;
+}
+
+uint32_t sinsp_extraction_cache::get_slot(const string& field)
+{
+	unordered_map<string, uint32_t>::iterator it = m_slots.find(field);
+
+	if(it != m_slots.end())
+	{
+		return it->second;
+	}
+
+	entry e;
+	e.m_gen = m_gen - 1;
+	e.m_val = NULL;
+	e.m_len = 0;
+
+	m_entries.push_back(e);
+	m_slots[field] = (uint32_t)m_entries.size() - 1;
+
+	return (uint32_t)m_entries.size() - 1;
+}
+
+uint8_t* sinsp_extraction_cache::store(uint32_t slot, const filtercheck_field_info* finfo, uint8_t* val, uint32_t* len)
+{
+	entry* e = &m_entries[slot];
+
+	e->m_gen = m_gen;
+
+	if(val == NULL)
+	{
+		e->m_val = NULL;
+		e->m_len = 0;
+		*len = 0;
+		return NULL;
+	}
+
+	uint32_t size = sinsp_filter_check::rawval_len(finfo, val, *len);
+
+	e->m_len = size;
+	*len = size;
+
+	//
+	// Keep the terminator of the strings. The consumers of the buffers look
+	// at the byte that follows them to see if they can be printed as strings,
+	// so that one is copied too.
+	//
+	if(finfo->m_type == PT_CHARBUF || finfo->m_type == PT_FSPATH ||
+		finfo->m_type == PT_BYTEBUF)
+	{
+		size++;
+	}
+
+	if(e->m_storage.size() < size)
+	{
+		e->m_storage.resize(size);
+	}
+
+	if(size != 0)
+	{
+		memcpy(&e->m_storage[0], val, size);
+		e->m_val = &e->m_storage[0];
+	}
+	else
+	{
+		e->m_val = val;
+	}
+
+	return e->m_val;
+}
+
 #endif // HAS_FILTERING
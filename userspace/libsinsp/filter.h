@@ -37,6 +37,71 @@ enum boolop
  *  @{
  */
 
+//
+// Slot of the checks that don't use the extraction cache
+//
+#define EXTRACTION_CACHE_NO_SLOT ((uint32_t)-1)
+
+/*!
+  \brief Per-event cache of the extracted field values.
+  When enabled with \ref sinsp::set_extraction_cache_enabled(), the inspector
+  attaches it to the events it returns, and the filters, formatters, chisels
+  and views that extract a field already extracted from the same event get
+  the cached value instead of extracting it again. The values are valid until
+  \ref sinsp::next() returns the next event.
+*/
+class SINSP_PUBLIC sinsp_extraction_cache
+{
+public:
+	sinsp_extraction_cache();
+
+	/*!
+	  \brief Returns the slot where the values of the given field are stored,
+	   allocating it if this is the first time the field is seen.
+
+	  \param field the full field name, including its argument if it has
+	   one, e.g. "proc.name" or "evt.arg.fd". Since the name identifies the
+	   check class, the field id and the argument, checks parsed from the same
+	   name share the slot.
+	*/
+	uint32_t get_slot(const string& field);
+
+	/*!
+	  \brief Drops all the cached values.
+	*/
+	inline void invalidate()
+	{
+		m_gen++;
+	}
+
+	/*!
+	  \brief Copies a value returned by extract() into the given slot and
+	   returns the copy, which stays valid even if the check that extracted
+	   it is deleted or extracts something else.
+
+	  \param len on input, the length returned by extract(), which many
+	   extractors leave unset for the fixed size types. On output, the real
+	   length of the value, which is also the one returned to the following
+	   consumers.
+	*/
+	uint8_t* store(uint32_t slot, const filtercheck_field_info* finfo, uint8_t* val, uint32_t* len);
+
+	struct entry
+	{
+		uint64_t m_gen;
+		uint8_t* m_val;
+		uint32_t m_len;
+		vector<uint8_t> m_storage;
+	};
+
+	vector<entry> m_entries;
+	// Entries whose generation is different are stale
+	uint64_t m_gen;
+
+private:
+	unordered_map<string, uint32_t> m_slots;
+};
+
 /*!
   \brief This is the class that compiles and runs sysdig-type filters.
 */
@@ -0,0 +1,179 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest.h>
+#define VISIBILITY_PRIVATE
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+
+extern sinsp_filter_check_list g_filterlist;
+
+//
+// Two consumers of the same field, like a chisel and a view, extracting from
+// a sequence of events with the extraction cache on or off. The first
+// consumer extracts from every event, the second one only from the events
+// selected by mask.
+//
+class extraction_cache_test : public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		m_chk1 = new_check("util.cnt");
+		m_chk2 = new_check("util.cnt");
+	}
+
+	virtual void TearDown()
+	{
+		delete m_chk1;
+		delete m_chk2;
+	}
+
+	sinsp_filter_check* new_check(const char* fld)
+	{
+		sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(fld,
+			&m_inspector,
+			false);
+		chk->parse_field_name(fld, true);
+		chk->m_cache_key = fld;
+		return chk;
+	}
+
+	void run(bool use_cache, uint32_t nevts, const vector<bool>& mask,
+		OUT vector<string>* vals1, OUT vector<string>* vals2)
+	{
+		scap_evt hdr;
+		sinsp_evt evt(&m_inspector);
+		memset(&hdr, 0, sizeof(hdr));
+		evt.m_pevt = &hdr;
+		evt.m_cpuid = 3;
+		evt.m_extraction_cache = use_cache? &m_cache : NULL;
+
+		for(uint32_t j = 0; j < nevts; j++)
+		{
+			evt.m_evtnum = j + 1;
+			m_cache.invalidate();
+
+			vals1->push_back(m_chk1->tostring(&evt));
+
+			if(mask[j])
+			{
+				vals2->push_back(m_chk2->tostring(&evt));
+			}
+		}
+	}
+
+	sinsp m_inspector;
+	sinsp_extraction_cache m_cache;
+	sinsp_filter_check* m_chk1;
+	sinsp_filter_check* m_chk2;
+};
+
+TEST_F(extraction_cache_test, stateful_field_is_not_shared)
+{
+	vector<bool> mask;
+	mask.push_back(false);
+	mask.push_back(true);
+	mask.push_back(false);
+	mask.push_back(true);
+
+	vector<string> nocache1, nocache2;
+	run(false, 4, mask, &nocache1, &nocache2);
+
+	delete m_chk1;
+	delete m_chk2;
+	m_chk1 = new_check("util.cnt");
+	m_chk2 = new_check("util.cnt");
+
+	vector<string> cache1, cache2;
+	run(true, 4, mask, &cache1, &cache2);
+
+	//
+	// Each consumer counts its own extractions
+	//
+	ASSERT_EQ(2u, nocache2.size());
+	EXPECT_EQ("1", nocache2[0]);
+	EXPECT_EQ("2", nocache2[1]);
+	EXPECT_EQ(nocache1, cache1);
+	EXPECT_EQ(nocache2, cache2);
+}
+
+TEST_F(extraction_cache_test, stateless_field_is_shared)
+{
+	delete m_chk1;
+	delete m_chk2;
+	m_chk1 = new_check("evt.num");
+	m_chk2 = new_check("evt.num");
+
+	vector<bool> mask(3, true);
+	vector<string> nocache1, nocache2;
+	run(false, 3, mask, &nocache1, &nocache2);
+
+	vector<string> cache1, cache2;
+	run(true, 3, mask, &cache1, &cache2);
+
+	EXPECT_EQ(nocache1, cache1);
+	EXPECT_EQ(nocache2, cache2);
+	EXPECT_EQ("3", cache2[2]);
+
+	//
+	// The second consumer gets the value stored by the first one
+	//
+	uint32_t slot = m_cache.get_slot("evt.num");
+	EXPECT_EQ(m_cache.m_gen, m_cache.m_entries[slot].m_gen);
+}
+
+TEST_F(extraction_cache_test, cached_length_is_real_length)
+{
+	const char* flds[] = {"evt.num", "evt.cpu"};
+	uint32_t lens[] = {sizeof(uint64_t), sizeof(uint16_t)};
+
+	for(uint32_t j = 0; j < sizeof(flds) / sizeof(flds[0]); j++)
+	{
+		sinsp_filter_check* chk1 = new_check(flds[j]);
+		sinsp_filter_check* chk2 = new_check(flds[j]);
+
+		scap_evt hdr;
+		sinsp_evt evt(&m_inspector);
+		memset(&hdr, 0, sizeof(hdr));
+		evt.m_pevt = &hdr;
+		evt.m_evtnum = 42;
+		evt.m_cpuid = 3;
+		evt.m_extraction_cache = &m_cache;
+		m_cache.invalidate();
+
+		//
+		// These extractors don't set the length, so start from garbage
+		//
+		uint32_t len1 = 0xdeadbeef;
+		uint32_t len2 = 0xdeadbeef;
+		uint8_t* val1 = chk1->extract_cached(&evt, &len1);
+		uint8_t* val2 = chk2->extract_cached(&evt, &len2);
+
+		ASSERT_TRUE(val1 != NULL);
+		ASSERT_TRUE(val2 != NULL);
+		EXPECT_EQ(lens[j], len1);
+		EXPECT_EQ(lens[j], len2);
+		EXPECT_EQ(0, memcmp(val1, val2, lens[j]));
+
+		delete chk1;
+		delete chk2;
+	}
+}
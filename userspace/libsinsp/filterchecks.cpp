@@ -962,7 +962,7 @@ bool sinsp_filter_check_fd::compare(sinsp_evt *evt)
 	// Standard extract-based fields
 	//
 	uint32_t len;
-	uint8_t* extracted_val = extract(evt, &len);
+	uint8_t* extracted_val = extract_cached(evt, &len);
 
 	if(extracted_val == NULL)
 	{
@@ -1841,6 +1841,24 @@ bool sinsp_filter_check_thread::compare(sinsp_evt *evt)
 	return sinsp_filter_check::compare(evt);
 }
 
+bool sinsp_filter_check_thread::is_cacheable()
+{
+	switch(m_field_id)
+	{
+	//
+	// These update state kept by this very check every time they're extracted
+	//
+	case TYPE_EXECTIME:
+	case TYPE_TOTEXECTIME:
+	case TYPE_THREAD_CPU:
+	case TYPE_THREAD_CPU_USER:
+	case TYPE_THREAD_CPU_SYSTEM:
+		return false;
+	default:
+		return true;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_event implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -2844,7 +2862,9 @@ uint8_t* sinsp_filter_check_event::extract(sinsp_evt *evt, OUT uint32_t* len)
 					m_strstorage += evt->get_param_name(j);
 					m_strstorage += '=';
 					m_strstorage += argstr;
-					m_strstorage += string("(") + resolved_argstr + ") ";
+					m_strstorage += '(';
+					m_strstorage += resolved_argstr;
+					m_strstorage += ") ";
 				}
 			}
 
@@ -3398,6 +3418,29 @@ bool sinsp_filter_check_event::compare(sinsp_evt *evt)
 	return res;
 }
 
+bool sinsp_filter_check_event::is_cacheable()
+{
+	switch(m_field_id)
+	{
+	//
+	// The buffer is extracted differently when comparing and when printing
+	//
+	case TYPE_BUFFER:
+	//
+	// These depend on the previous extractions done by this very check
+	//
+	case TYPE_RELTS:
+	case TYPE_RELTS_S:
+	case TYPE_RELTS_NS:
+	case TYPE_DELTA:
+	case TYPE_DELTA_S:
+	case TYPE_DELTA_NS:
+		return false;
+	default:
+		return true;
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_user implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -3781,6 +3824,14 @@ uint8_t* sinsp_filter_check_reference::extract(sinsp_evt *evt, OUT uint32_t* len
 	return m_val;
 }
 
+bool sinsp_filter_check_reference::is_cacheable()
+{
+	//
+	// The value is the one set by set_val(), not something coming from the event
+	//
+	return false;
+}
+
 //
 // convert a number into a byte representation.
 // E.g. 1230 becomes 1.23K
@@ -4117,6 +4168,14 @@ uint8_t* sinsp_filter_check_utils::extract(sinsp_evt *evt, OUT uint32_t* len)
 	return NULL;
 }
 
+bool sinsp_filter_check_utils::is_cacheable()
+{
+	//
+	// util.cnt counts the extractions done by this very check
+	//
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_check_fdlist implementation
 ///////////////////////////////////////////////////////////////////////////////
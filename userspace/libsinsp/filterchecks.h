@@ -110,17 +110,126 @@ public:
 	//
 	virtual char* tostring(sinsp_evt* evt);
 
+	//
+	// Extract the value from the event and append its string rendering to res.
+	// Produces the same text as tostring(), but renders the most common types
+	// without going through snprintf and intermediate buffers.
+	// Returns false if the field has no value for this event.
+	//
+	bool tostring_append(sinsp_evt* evt, OUT string* res);
+
 	//
 	// Extract the value from the event and convert it into a Json value
 	// or object
 	//
 	virtual Json::Value tojson(sinsp_evt* evt);
 
+	//
+	// Extract the value from the event and append its JSON rendering to res,
+	// exactly as Json::FastWriter would serialize the result of tojson().
+	// Returns false, leaving res untouched, if the value is null.
+	//
+	bool tojson_append(sinsp_evt* evt, OUT string* res);
+
+	//
+	// Return false if the values of this field can't be shared with other
+	// checks through the event extraction cache, typically because their
+	// extraction depends on state kept by the check itself
+	//
+	virtual bool is_cacheable();
+
+	//
+	// Extract the field, reusing the value extracted from the same event by
+	// another check for the same field, if the event carries an extraction
+	// cache. Only checks whose m_cache_key has been set take part.
+	// evt can be NULL for the checks that don't extract from events, like
+	// sinsp_filter_check_reference.
+	//
+	inline uint8_t* extract_cached(sinsp_evt *evt, OUT uint32_t* len)
+	{
+		if(evt == NULL || evt->m_extraction_cache == NULL)
+		{
+			return extract(evt, len);
+		}
+
+		sinsp_extraction_cache* cache = evt->m_extraction_cache;
+
+		if(cache != m_extraction_cache)
+		{
+			bind_extraction_cache(cache);
+		}
+
+		if(m_cache_slot == EXTRACTION_CACHE_NO_SLOT)
+		{
+			return extract(evt, len);
+		}
+
+		sinsp_extraction_cache::entry* e = &cache->m_entries[m_cache_slot];
+
+		if(e->m_gen != cache->m_gen)
+		{
+			uint8_t* val = extract(evt, len);
+			return cache->store(m_cache_slot, get_field_info(), val, len);
+		}
+
+		*len = e->m_len;
+		return e->m_val;
+	}
+
+	//
+	// Size of a value returned by extract(). Most extractors only set len for
+	// variable size types, so the size of the others comes from the type.
+	//
+	static inline uint32_t rawval_len(const filtercheck_field_info* finfo, uint8_t* rawval, uint32_t len)
+	{
+		switch(finfo->m_type)
+		{
+		case PT_INT8:
+		case PT_UINT8:
+		case PT_FLAGS8:
+		case PT_SIGTYPE:
+		case PT_L4PROTO:
+		case PT_SOCKFAMILY:
+			return 1;
+		case PT_INT16:
+		case PT_UINT16:
+		case PT_FLAGS16:
+		case PT_PORT:
+		case PT_SYSCALLID:
+			return 2;
+		case PT_INT32:
+		case PT_UINT32:
+		case PT_FLAGS32:
+		case PT_UID:
+		case PT_GID:
+		case PT_BOOL:
+		case PT_IPV4ADDR:
+			return 4;
+		case PT_INT64:
+		case PT_UINT64:
+		case PT_ERRNO:
+		case PT_FD:
+		case PT_PID:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+		case PT_DOUBLE:
+			return 8;
+		case PT_CHARBUF:
+		case PT_FSPATH:
+			return (uint32_t)strlen((char*)rawval);
+		default:
+			return len;
+		}
+	}
+
 	sinsp* m_inspector;
 	boolop m_boolop;
 	ppm_cmp_operator m_cmpop;
 	sinsp_field_aggregation m_aggregation;
 	sinsp_field_aggregation m_merge_aggregation;
+	// The full name of the field, argument included, used to match the
+	// checks that share an extraction cache
+	string m_cache_key;
 
 protected:
 	char* rawval_to_string(uint8_t* rawval, const filtercheck_field_info* finfo, uint32_t len);
@@ -134,9 +243,13 @@ protected:
 	uint32_t m_field_id;
 	uint32_t m_th_state_id;
 	uint32_t m_val_storage_len;
+	// The extraction cache m_cache_slot refers to
+	sinsp_extraction_cache* m_extraction_cache;
+	uint32_t m_cache_slot;
 
 private:
 	void set_inspector(sinsp* inspector);
+	void bind_extraction_cache(sinsp_extraction_cache* cache);
 
 friend class sinsp_filter_check_list;
 };
@@ -331,6 +444,7 @@ public:
 	int32_t parse_field_name(const char* str, bool alloc_state);
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
 	bool compare(sinsp_evt *evt);
+	bool is_cacheable();
 
 private:
 	uint64_t extract_exectime(sinsp_evt *evt);
@@ -426,6 +540,7 @@ public:
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
 	Json::Value extract_as_js(sinsp_evt *evt, OUT uint32_t* len);
 	bool compare(sinsp_evt *evt);
+	bool is_cacheable();
 
 	uint64_t m_first_ts;
 	uint64_t m_u64val;
@@ -591,6 +706,7 @@ public:
 	int32_t parse_field_name(const char* str, bool alloc_state);
 	void parse_filter_value(const char* str, uint32_t len);
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
+	bool is_cacheable();
 	char* tostring_nice(sinsp_evt* evt, uint32_t str_len, uint64_t time_delta);
 
 private:
@@ -620,6 +736,7 @@ public:
 	sinsp_filter_check_utils();
 	sinsp_filter_check* allocate_new();
 	uint8_t* extract(sinsp_evt *evt, OUT uint32_t* len);
+	bool is_cacheable();
 
 private:
 	uint64_t m_cnt;
@@ -0,0 +1,177 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "json_writer.h"
+
+//
+// Two digit decimal and hex lookup tables used to render integers
+//
+const char sinsp_json_writer::m_dec_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+const char sinsp_json_writer::m_hex_digits[] = "0123456789ABCDEF";
+
+void sinsp_json_writer::append_escaped_char(string* res, char c)
+{
+	switch(c)
+	{
+	case '"':
+		res->append("\\\"");
+		break;
+	case '\\':
+		res->append("\\\\");
+		break;
+	case '\b':
+		res->append("\\b");
+		break;
+	case '\f':
+		res->append("\\f");
+		break;
+	case '\n':
+		res->append("\\n");
+		break;
+	case '\r':
+		res->append("\\r");
+		break;
+	case '\t':
+		res->append("\\t");
+		break;
+	default:
+		res->append("\\u00");
+		res->push_back(m_hex_digits[(c >> 4) & 0xf]);
+		res->push_back(m_hex_digits[c & 0xf]);
+		break;
+	}
+}
+
+void sinsp_json_writer::append_string(string* res, const char* str, uint32_t len)
+{
+	const char* start = str;
+	const char* end = str + len;
+	const char* p;
+
+	res->push_back('"');
+
+	for(p = str; p < end; p++)
+	{
+		unsigned char c = (unsigned char)*p;
+
+		if(c >= 0x20 && c != '"' && c != '\\')
+		{
+			continue;
+		}
+
+		res->append(start, p - start);
+		append_escaped_char(res, (char)c);
+		start = p + 1;
+	}
+
+	res->append(start, end - start);
+	res->push_back('"');
+}
+
+string sinsp_json_writer::quote_key(const string& name)
+{
+	string res;
+
+	append_string(&res, name.c_str(), (uint32_t)name.size());
+	res.push_back(':');
+
+	return res;
+}
+
+void sinsp_json_writer::append_value(string* res, const Json::Value& val)
+{
+	switch(val.type())
+	{
+	case Json::nullValue:
+		append_null(res);
+		break;
+	case Json::intValue:
+		append_int(res, val.asLargestInt());
+		break;
+	case Json::uintValue:
+		append_uint(res, val.asLargestUInt());
+		break;
+	case Json::realValue:
+		res->append(Json::valueToString(val.asDouble()));
+		break;
+	case Json::stringValue:
+		{
+			const char* str;
+			const char* end;
+
+			if(val.getString(&str, &end))
+			{
+				append_string(res, str, (uint32_t)(end - str));
+			}
+		}
+		break;
+	case Json::booleanValue:
+		append_bool(res, val.asBool());
+		break;
+	case Json::arrayValue:
+		{
+			res->push_back('[');
+
+			for(Json::ArrayIndex j = 0; j < val.size(); j++)
+			{
+				if(j > 0)
+				{
+					res->push_back(',');
+				}
+
+				append_value(res, val[j]);
+			}
+
+			res->push_back(']');
+		}
+		break;
+	case Json::objectValue:
+		{
+			Json::Value::Members members = val.getMemberNames();
+
+			res->push_back('{');
+
+			for(Json::Value::Members::iterator it = members.begin(); it != members.end(); ++it)
+			{
+				if(it != members.begin())
+				{
+					res->push_back(',');
+				}
+
+				res->append(quote_key(*it));
+				append_value(res, val[*it]);
+			}
+
+			res->push_back('}');
+		}
+		break;
+	}
+}
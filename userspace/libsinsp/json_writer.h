@@ -0,0 +1,220 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <json/json.h>
+
+//
+// Streaming writer for numbers and JSON tokens. Everything is appended
+// directly to the destination string, and the JSON output is byte for byte
+// the same that Json::FastWriter generates for the equivalent Json::Value,
+// so the hot output paths don't need to build and serialize value trees.
+//
+class SINSP_PUBLIC sinsp_json_writer
+{
+public:
+	static inline void append_uint(string* res, uint64_t val, uint32_t min_digits = 1)
+	{
+		char buf[24];
+		char* p = render_uint(buf + sizeof(buf), val, min_digits);
+
+		res->append(p, buf + sizeof(buf) - p);
+	}
+
+	static inline void append_int(string* res, int64_t val)
+	{
+		if(val < 0)
+		{
+			res->push_back('-');
+			append_uint(res, 0 - (uint64_t)val);
+		}
+		else
+		{
+			append_uint(res, (uint64_t)val);
+		}
+	}
+
+	//
+	// Uppercase, no prefix, like the "%X" printf conversion
+	//
+	static inline void append_hex(string* res, uint64_t val)
+	{
+		char buf[16];
+		char* p = render_hex(buf + sizeof(buf), val);
+
+		res->append(p, buf + sizeof(buf) - p);
+	}
+
+	//
+	// Variants of the above that write a NUL terminated string to dst,
+	// which must have room for 24 characters, and return its length
+	//
+	static inline uint32_t write_uint(char* dst, uint64_t val, uint32_t min_digits = 1)
+	{
+		char buf[24];
+		char* p = render_uint(buf + sizeof(buf), val, min_digits);
+		uint32_t len = (uint32_t)(buf + sizeof(buf) - p);
+
+		memcpy(dst, p, len);
+		dst[len] = 0;
+		return len;
+	}
+
+	static inline uint32_t write_int(char* dst, int64_t val, uint32_t min_digits = 1)
+	{
+		if(val < 0)
+		{
+			*dst = '-';
+			return 1 + write_uint(dst + 1, 0 - (uint64_t)val, min_digits);
+		}
+
+		return write_uint(dst, (uint64_t)val, min_digits);
+	}
+
+	static inline uint32_t write_hex(char* dst, uint64_t val)
+	{
+		char buf[16];
+		char* p = render_hex(buf + sizeof(buf), val);
+		uint32_t len = (uint32_t)(buf + sizeof(buf) - p);
+
+		memcpy(dst, p, len);
+		dst[len] = 0;
+		return len;
+	}
+
+	static inline void append_bool(string* res, bool val)
+	{
+		res->append(val ? "true" : "false");
+	}
+
+	static inline void append_null(string* res)
+	{
+		res->append("null");
+	}
+
+	//
+	// Append str as a quoted JSON string. Strings without characters to
+	// escape, i.e. almost all of them, are copied in a single append.
+	//
+	static inline void append_string(string* res, const char* str)
+	{
+		const char* start = str;
+		const char* p = str;
+
+		res->push_back('"');
+
+		while(true)
+		{
+			unsigned char c = (unsigned char)*p;
+
+			if(c >= 0x20 && c != '"' && c != '\\')
+			{
+				p++;
+				continue;
+			}
+
+			res->append(start, p - start);
+
+			if(c == 0)
+			{
+				break;
+			}
+
+			append_escaped_char(res, (char)c);
+			start = ++p;
+		}
+
+		res->push_back('"');
+	}
+
+	static inline void append_string(string* res, const string& str)
+	{
+		append_string(res, str.c_str());
+	}
+
+	//
+	// Same as above, for buffers that can contain NUL characters
+	//
+	static void append_string(string* res, const char* str, uint32_t len);
+
+	//
+	// Return the quoted name followed by the colon, ready to be prepended to
+	// a member value. Meant to be done once, when a format is compiled.
+	//
+	static string quote_key(const string& name);
+
+	//
+	// Serialize an arbitrary Json::Value
+	//
+	static void append_value(string* res, const Json::Value& val);
+
+	static const char m_dec_digit_pairs[];
+	static const char m_hex_digits[];
+
+private:
+	//
+	// Render the number backwards, ending at end, and return its start
+	//
+	static inline char* render_uint(char* end, uint64_t val, uint32_t min_digits)
+	{
+		char* p = end;
+
+		while(val >= 100)
+		{
+			const char* pair = m_dec_digit_pairs + (val % 100) * 2;
+			val /= 100;
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+
+		if(val >= 10)
+		{
+			const char* pair = m_dec_digit_pairs + val * 2;
+			*--p = pair[1];
+			*--p = pair[0];
+		}
+		else
+		{
+			*--p = (char)('0' + val);
+		}
+
+		while(end - p < (int32_t)min_digits)
+		{
+			*--p = '0';
+		}
+
+		return p;
+	}
+
+	static inline char* render_hex(char* end, uint64_t val)
+	{
+		char* p = end;
+
+		do
+		{
+			*--p = m_hex_digits[val & 0xf];
+			val >>= 4;
+		}
+		while(val != 0);
+
+		return p;
+	}
+
+	static void append_escaped_char(string* res, char c);
+};
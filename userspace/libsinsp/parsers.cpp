@@ -84,20 +84,10 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	// When debug mode is not enabled, filter out events about sysdig itself
 	//
 #if defined(HAS_CAPTURE)
-	if(is_live && !m_inspector->is_debug_enabled())
+	if(is_live && is_sysdig_event(evt, etype))
 	{
-		if(evt->get_tid() == m_inspector->m_sysdig_pid && 
-			etype != PPME_SCHEDSWITCH_1_E && 
-			etype != PPME_SCHEDSWITCH_6_E &&
-			etype != PPME_DROP_E &&
-			etype != PPME_DROP_X &&
-			etype != PPME_SYSDIGEVENT_E &&
-			etype != PPME_PROCINFO_E &&
-			m_inspector->m_sysdig_pid)
-		{
-			evt->m_filtered_out = true;
-			return;
-		}
+		evt->m_filtered_out = true;
+		return;
 	}
 #endif
 
@@ -345,6 +335,54 @@ void sinsp_parser::process_event(sinsp_evt *evt)
 	}
 }
 
+//
+// Lightweight processing for the events that are only going to be written to
+// a trace file. The dumper only needs the thread table, and the container
+// information that comes with it, to be current, so only the events that
+// create or terminate processes go through the state engine. Everything
+// else, e.g. fd tracking, is skipped.
+//
+void sinsp_parser::process_event_dump_only(sinsp_evt *evt)
+{
+	evt->init();
+
+	if(evt->get_category() & EC_PROCESS)
+	{
+		process_event(evt);
+		return;
+	}
+
+#if defined(HAS_FILTERING) && defined(HAS_CAPTURE_FILTERING)
+	evt->m_filtered_out = false;
+#endif
+
+#if defined(HAS_CAPTURE)
+	if(m_inspector->m_islive && is_sysdig_event(evt, evt->get_type()))
+	{
+		evt->m_filtered_out = true;
+	}
+#endif
+}
+
+#if defined(HAS_CAPTURE)
+//
+// Return true if the event was generated by sysdig itself and debug mode is
+// not enabled
+//
+bool sinsp_parser::is_sysdig_event(sinsp_evt *evt, uint16_t etype)
+{
+	return !m_inspector->is_debug_enabled() &&
+		evt->get_tid() == m_inspector->m_sysdig_pid &&
+		etype != PPME_SCHEDSWITCH_1_E &&
+		etype != PPME_SCHEDSWITCH_6_E &&
+		etype != PPME_DROP_E &&
+		etype != PPME_DROP_X &&
+		etype != PPME_SYSDIGEVENT_E &&
+		etype != PPME_PROCINFO_E &&
+		m_inspector->m_sysdig_pid;
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////
 // HELPERS
 ///////////////////////////////////////////////////////////////////////////////
@@ -1005,6 +1043,16 @@ void sinsp_parser::parse_clone_exit(sinsp_evt *evt)
 		// referring to an element in the parent's table.
 		//
 		tinfo.m_fdtable.reset_cache();
+
+		//
+		// If the parent's fds were never loaded from /proc, the child's ones are
+		// loaded lazily too
+		//
+		sinsp_threadinfo* proot = ptinfo->get_fd_table_root();
+		if(proot != NULL && (proot->m_flags & PPM_CL_FDS_NOT_LOADED))
+		{
+			tinfo.m_flags |= PPM_CL_FDS_NOT_LOADED;
+		}
 	}
 	//if((tinfo.m_flags & (PPM_CL_CLONE_FILES)))
 	//{
@@ -1363,10 +1411,12 @@ void sinsp_parser::parse_execve_exit(sinsp_evt *evt)
 	//  scap_fd_free_table(handle, tinfo);
 
 	//
-	// Clear the flags for this thread, making sure to propagate the inverted flag
+	// Clear the flags for this thread, making sure to propagate the inverted flag.
+	// exec doesn't close the fds, so if they were never loaded from /proc they
+	// still need to be.
 	//
 	bool inverted = ((evt->m_tinfo->m_flags & PPM_CL_CLONE_INVERTED) != 0);
-	evt->m_tinfo->m_flags = PPM_CL_ACTIVE;
+	evt->m_tinfo->m_flags = PPM_CL_ACTIVE | (evt->m_tinfo->m_flags & PPM_CL_FDS_NOT_LOADED);
 	if(inverted)
 	{
 		evt->m_tinfo->m_flags |= PPM_CL_CLONE_INVERTED;
@@ -33,6 +33,7 @@ public:
 	// Processing entry point
 	//
 	void process_event(sinsp_evt* evt);
+	void process_event_dump_only(sinsp_evt* evt);
 	void erase_fd(erase_fd_params* params);
 
 	//
@@ -63,6 +64,9 @@ private:
 	//
 	bool reset(sinsp_evt *evt);
 	void store_event(sinsp_evt* evt);
+#if defined(HAS_CAPTURE)
+	bool is_sysdig_event(sinsp_evt *evt, uint16_t etype);
+#endif
 
 	//
 	// Parsers
@@ -60,6 +60,17 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 //
 #define MAX_FD_TABLE_SIZE 2048
 
+//
+// Max number of flags parameter renderings that an event object caches
+//
+#define MAX_FLAGS_STRS 4096
+
+//
+// Number of events between two checks of the time elapsed since the last call
+// to the progress callback. Must be a power of 2.
+//
+#define PROGRESS_CHECK_EVTS 1024
+
 //
 // The time after an inactive thread is removed.
 //
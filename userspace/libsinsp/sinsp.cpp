@@ -76,6 +76,8 @@ sinsp::sinsp() :
 
 #ifdef HAS_FILTERING
 	m_filter = NULL;
+	m_extraction_cache = NULL;
+	m_extraction_cache_enabled = false;
 #endif
 
 	m_fds_to_remove = new vector<int64_t>;
@@ -94,6 +96,9 @@ sinsp::sinsp() :
 	m_max_evt_output_len = 0;
 	m_filesize = -1;
 	m_import_users = true;
+	m_lazy_fds = false;
+	m_dump_only_mode = false;
+	m_compression_mode = SCAP_COMPRESSION_GZIP;
 	m_meta_evt_buf = new char[SP_EVT_BUF_SIZE];
 	m_meta_evt.m_pevt = (scap_evt*) m_meta_evt_buf;
 	m_meta_evt_pending = false;
@@ -126,6 +131,11 @@ sinsp::sinsp() :
 	m_meinfo.m_pievt.m_fdinfo = NULL;
 	m_meinfo.m_n_procinfo_evts = 0;
 	m_meta_event_callback = NULL;
+
+	m_progress_callback = NULL;
+	m_progress_callback_context = NULL;
+	m_progress_interval_ns = 0;
+	m_next_progress_tod = 0;
 }
 
 sinsp::~sinsp()
@@ -165,6 +175,14 @@ sinsp::~sinsp()
 	{
 		delete[] m_meinfo.m_piscapevt;
 	}
+
+#ifdef HAS_FILTERING
+	if(m_extraction_cache)
+	{
+		delete m_extraction_cache;
+		m_extraction_cache = NULL;
+	}
+#endif
 }
 
 void sinsp::add_protodecoders()
@@ -222,11 +240,6 @@ void sinsp::init()
 	m_n_proc_lookups = 0;
 	m_n_proc_lookups_duration_ns = 0;
 
-	if(m_islive == false)
-	{
-		import_thread_table();
-	}
-
 	import_ifaddr_list();
 
 	import_user_list();
@@ -275,6 +288,21 @@ void sinsp::set_import_users(bool import_users)
 	m_import_users = import_users;
 }
 
+void sinsp::set_compression_mode(compression_mode mode)
+{
+	m_compression_mode = mode;
+}
+
+void sinsp::set_lazy_fds(bool lazy_fds)
+{
+	m_lazy_fds = lazy_fds;
+}
+
+void sinsp::set_dump_only_mode(bool enable)
+{
+	m_dump_only_mode = enable;
+}
+
 void sinsp::open(uint32_t timeout_ms)
 {
 	char error[SCAP_LASTERR_SIZE];
@@ -296,6 +324,7 @@ void sinsp::open(uint32_t timeout_ms)
 	oargs.proc_callback = ::on_new_entry_from_proc;
 	oargs.proc_callback_context = this;
 	oargs.import_users = m_import_users;
+	oargs.lazy_fds = m_lazy_fds;
 
 	m_h = scap_open(oargs, error);
 
@@ -328,14 +357,24 @@ void sinsp::open(string filename)
 	//
 	m_thread_manager->clear();
 
+	//
+	// The process and fd tables are added to the thread table block by block
+	// while scap reads the file headers, and the decoders need to see the fds
+	// as they arrive
+	//
+#ifndef HAS_ANALYZER
+	add_protodecoders();
+#endif
+
 	//
 	// Start the capture
 	//
 	scap_open_args oargs;
 	oargs.fname = filename.c_str();
-	oargs.proc_callback = NULL;
-	oargs.proc_callback_context = NULL;
+	oargs.proc_callback = ::on_new_entry_from_proc;
+	oargs.proc_callback_context = this;
 	oargs.import_users = m_import_users;
+	oargs.lazy_fds = false;
 
 	m_h = scap_open(oargs, error);
 
@@ -399,7 +438,7 @@ void sinsp::autodump_start(const string& dump_filename, bool compress)
 
 	if(compress)
 	{
-		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_GZIP);
+		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), m_compression_mode);
 	}
 	else
 	{
@@ -429,8 +468,13 @@ void sinsp::autodump_stop()
 
 	if(m_dumper != NULL)
 	{
-		scap_dump_close(m_dumper);
+		int32_t res = scap_dump_close(m_dumper);
 		m_dumper = NULL;
+
+		if(res != SCAP_SUCCESS)
+		{
+			throw sinsp_exception("error writing the trace file");
+		}
 	}
 }
 
@@ -440,7 +484,7 @@ void sinsp::on_new_entry_from_proc(void* context,
 								   scap_fdinfo* fdinfo,
 								   scap_t* newhandle)
 {
-	ASSERT(tinfo != NULL);
+	ASSERT(tinfo != NULL || fdinfo != NULL);
 
 	//
 	// Retrieve machine information if we don't have it yet
@@ -467,6 +511,15 @@ void sinsp::on_new_entry_from_proc(void* context,
 		sinsp_threadinfo newti(this);
 		newti.init(tinfo);
 
+		//
+		// With lazy fd loading, scap didn't scan the fds of this process.
+		// Remember it so that the table is loaded the first time it's accessed.
+		//
+		if(m_lazy_fds && m_islive && newti.m_tid == newti.m_pid)
+		{
+			newti.m_flags |= PPM_CL_FDS_NOT_LOADED;
+		}
+
 		m_thread_manager->add_thread(newti, true);
 	}
 	else
@@ -475,6 +528,16 @@ void sinsp::on_new_entry_from_proc(void* context,
 
 		if(sinsp_tinfo == NULL)
 		{
+			//
+			// When reading a file the fds come in their own blocks, after the
+			// process they belong to
+			//
+			if(tinfo == NULL)
+			{
+				ASSERT(false);
+				return;
+			}
+
 			sinsp_threadinfo newti(this);
 			newti.init(tinfo);
 
@@ -502,24 +565,6 @@ void on_new_entry_from_proc(void* context,
 	_this->on_new_entry_from_proc(context, tid, tinfo, fdinfo, newhandle);
 }
 
-void sinsp::import_thread_table()
-{
-	scap_threadinfo *pi;
-	scap_threadinfo *tpi;
-
-	scap_threadinfo *table = scap_get_proc_table(m_h);
-
-	//
-	// Scan the scap table and add the threads to our list
-	//
-	HASH_ITER(hh, table, pi, tpi)
-	{
-		sinsp_threadinfo newti(this);
-		newti.init(pi);
-		m_thread_manager->add_thread(newti, true);
-	}
-}
-
 void sinsp::import_ifaddr_list()
 {
 	m_network_interfaces = new sinsp_network_interfaces;
@@ -754,11 +799,26 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	m_nevts++;
 	evt->m_evtnum = m_nevts;
 	m_lastevent_ts = ts;
+
+	if(m_progress_callback != NULL && (m_nevts & (PROGRESS_CHECK_EVTS - 1)) == 0)
+	{
+		report_progress();
+	}
 #ifdef HAS_FILTERING
 	if(m_firstevent_ts == 0)
 	{
 		m_firstevent_ts = m_lastevent_ts;
 	}
+
+	if(m_extraction_cache_enabled)
+	{
+		m_extraction_cache->invalidate();
+		evt->m_extraction_cache = m_extraction_cache;
+	}
+	else
+	{
+		evt->m_extraction_cache = NULL;
+	}
 #endif
 
 #ifndef HAS_ANALYZER
@@ -835,7 +895,25 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		return SCAP_TIMEOUT;
 	}
 #else
-	m_parser->process_event(evt);
+	if(m_dump_only_mode)
+	{
+		m_parser->process_event_dump_only(evt);
+	}
+	else
+	{
+		m_parser->process_event(evt);
+	}
+#endif
+
+#ifdef HAS_FILTERING
+	//
+	// The capture filter may have extracted fields before the state engine
+	// updated what they depend on
+	//
+	if(m_extraction_cache_enabled)
+	{
+		m_extraction_cache->invalidate();
+	}
 #endif
 
 	//
@@ -1191,6 +1269,20 @@ const string sinsp::get_filter()
 	return m_filterstring;
 }
 
+void sinsp::set_extraction_cache_enabled(bool enable)
+{
+	//
+	// The cache is never deleted before the inspector, because the checks
+	// that used it keep referring to it
+	//
+	if(enable && m_extraction_cache == NULL)
+	{
+		m_extraction_cache = new sinsp_extraction_cache();
+	}
+
+	m_extraction_cache_enabled = enable;
+}
+
 #endif
 
 const scap_machine_info* sinsp::get_machine_info()
@@ -1399,6 +1491,36 @@ double sinsp::get_read_progress()
 	return (double)fpos * 100 / m_filesize;
 }
 
+void sinsp::set_progress_callback(sinsp_progress_callback cb, void* context, uint64_t interval_ns)
+{
+	m_progress_callback = cb;
+	m_progress_callback_context = context;
+	m_progress_interval_ns = interval_ns;
+	m_next_progress_tod = 0;
+}
+
+void sinsp::report_progress()
+{
+	struct timeval tod;
+
+	if(m_islive || m_filesize <= 0)
+	{
+		return;
+	}
+
+	gettimeofday(&tod, NULL);
+	uint64_t now = (uint64_t)tod.tv_sec * ONE_SECOND_IN_NS + tod.tv_usec * 1000;
+
+	if(now < m_next_progress_tod)
+	{
+		return;
+	}
+
+	m_next_progress_tod = now + m_progress_interval_ns;
+
+	m_progress_callback(get_read_progress(), m_progress_callback_context);
+}
+
 bool sinsp::remove_inactive_threads()
 {
 	return m_thread_manager->remove_inactive_threads();
@@ -103,6 +103,7 @@ class sinsp_partial_transaction;
 class sinsp_parser;
 class sinsp_analyzer;
 class sinsp_filter;
+class sinsp_extraction_cache;
 class cycle_writer;
 class sinsp_protodecoder;
 
@@ -180,6 +181,12 @@ struct sinsp_capture_interrupt_exception : sinsp_exception
 */
 #define DEFAULT_OUTPUT_STR "*%evt.num %evt.time %evt.cpu %proc.name (%thread.tid) %evt.dir %evt.type %evt.args"
 
+/*!
+  \brief Function that receives the read progress of a trace file as a number
+   between 0 and 100. See \ref sinsp::set_progress_callback().
+*/
+typedef void (*sinsp_progress_callback)(double progress_pct, void* context);
+
 //
 // Internal stuff for meta event management
 //
@@ -302,6 +309,38 @@ public:
 	*/
 	void set_import_users(bool import_users);
 
+	/*!
+	  \brief Determine if the fd tables of the processes that are running
+	  when a live capture starts are loaded on demand.
+
+	  \param lazy_fds if true, /proc/<pid>/fd is not scanned when the capture
+	  is opened. The fd table of a process is loaded the first time one of
+	  its events refers to an fd that the inspector doesn't know. On machines
+	  with many processes or many open fds this reduces startup time
+	  considerably. The downside is that the fds of processes that never
+	  produce fd events are not known to the inspector: they don't show up in
+	  the thread table walks (e.g. the lsof chisel), and the client/server
+	  direction of some connections could be detected incorrectly.
+
+	  \note default behavior is lazy_fds=false. The setting has no effect on
+	  offline captures, and trace files written with -w always contain the
+	  full fd tables.
+	*/
+	void set_lazy_fds(bool lazy_fds);
+
+	/*!
+	  \brief Enables or disables the dump only mode, for captures whose events
+	   are only written to a trace file.
+
+	  \param enable if true, only the events that create or terminate
+	   processes go through the state engine, which is enough to keep the
+	   process and container information of the trace file current, and
+	   everything else, like fd tracking, is skipped. The events returned by
+	   next() don't carry thread or fd information, so this can only be used
+	   when there is no filter and nothing but the dumper consumes the events.
+	*/
+	void set_dump_only_mode(bool enable);
+
 	/*!
 	  \brief temporarily pauses event capture.
 
@@ -337,6 +376,16 @@ public:
 	   string if no filter has been set yet.
 	*/
 	const string get_filter();
+
+	/*!
+	  \brief Enables or disables the per-event extraction cache.
+
+	  \param enable when true, the filters, formatters, chisels and views
+	   that extract the same field from the same event share a single
+	   extraction. Worth enabling when more than one of them processes the
+	   events.
+	*/
+	void set_extraction_cache_enabled(bool enable);
 #endif
 
 	/*!
@@ -376,6 +425,17 @@ public:
 	   of failure.
 	*/
 	void autodump_start(const string& dump_filename, bool compress);
+
+	/*!
+	  \brief Select the compression format of the trace files that are
+	   written with compression enabled, both by \ref autodump_start() and
+	   by \ref sinsp_dumper.
+
+	  \param mode the compression mode. The default is SCAP_COMPRESSION_GZIP.
+	   SCAP_COMPRESSION_EVTCODEC produces smaller files that are faster to
+	   read, but can't be opened by older versions of the library.
+	*/
+	void set_compression_mode(compression_mode mode);
  
  	/*!
 	  \brief Cycles the file pointer to a new capture file
@@ -618,6 +678,20 @@ public:
 	*/
 	double get_read_progress();
 
+	/*!
+	  \brief When reading events from a trace file, periodically call a
+	   function with the read progress, so that callers don't need to poll
+	   \ref get_read_progress() while processing the events.
+
+	  \param cb the function to call, or NULL to stop reporting the progress.
+	  \param context opaque pointer passed back to cb.
+	  \param interval_ns minimum wall clock time between two calls.
+
+	  \note cb is called from \ref next(). It is not called when the end of
+	   the file is reached.
+	*/
+	void set_progress_callback(sinsp_progress_callback cb, void* context, uint64_t interval_ns);
+
 	//
 	// Misc internal stuff
 	//
@@ -654,7 +728,6 @@ private:
 #endif
 
 	void init();
-	void import_thread_table();
 	void import_ifaddr_list();
 	void import_user_list();
 	void add_protodecoders();
@@ -668,6 +741,7 @@ private:
 	//       and m_last_tinfo is not set.
 	//
 	inline sinsp_threadinfo* find_thread(int64_t tid, bool lookup_only);
+	void report_progress();
 	// this is here for testing purposes only
 	sinsp_threadinfo* find_thread_test(int64_t tid, bool lookup_only);
 	bool remove_inactive_threads();
@@ -681,6 +755,7 @@ private:
 	bool m_isfatfile_enabled;
 	uint32_t m_max_evt_output_len;
 	bool m_compress;
+	compression_mode m_compression_mode;
 	sinsp_evt m_evt;
 	string m_lasterr;
 	int64_t m_tid_to_remove;
@@ -711,6 +786,8 @@ private:
 	uint64_t m_firstevent_ts;
 	sinsp_filter* m_filter;
 	string m_filterstring;
+	sinsp_extraction_cache* m_extraction_cache;
+	bool m_extraction_cache_enabled;
 #endif
 
 	//
@@ -749,6 +826,16 @@ private:
 	//
 	sinsp_evt::param_fmt m_buffer_format;
 
+	//
+	// True if the fd tables of the processes found in /proc are loaded on demand
+	//
+	bool m_lazy_fds;
+
+	//
+	// True if the events are only parsed as much as the dumper needs
+	//
+	bool m_dump_only_mode;
+
 	//
 	// User and group tables
 	//
@@ -784,6 +871,14 @@ private:
 	sinsp_evt* m_skipped_evt;
 	meta_event_callback m_meta_event_callback;
 
+	//
+	// Progress reporting
+	//
+	sinsp_progress_callback m_progress_callback;
+	void* m_progress_callback_context;
+	uint64_t m_progress_interval_ns;
+	uint64_t m_next_progress_tod;
+
 	//
 	// End of second housekeeping
 	//
@@ -17,6 +17,7 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <algorithm>
+#include <math.h>
 #ifndef _WIN32
 #include <curses.h>
 #endif
@@ -75,6 +76,1229 @@ typedef struct table_row_cmp
 	bool m_ascending;
 }table_row_cmp;
 
+//
+// Aggregation kernels for the numeric types
+//
+template<typename T> struct table_aggregators
+{
+	static void sum(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+	{
+		T* dst = col->slot<T>(row);
+		uint32_t cnt2 = src->m_cnt;
+
+		if(cnt2 < 2)
+		{
+			*dst += *(T*)src->m_val;
+			return;
+		}
+
+		//
+		// src is an average, which happens when merging. Sum the averages.
+		//
+		uint32_t cnt1 = col->m_cnts[row];
+
+		if(cnt1 > 1)
+		{
+			*dst = *dst / cnt1;
+		}
+
+		*dst += (*(T*)src->m_val) / cnt2;
+		col->m_cnts[row] = 1;
+	}
+
+	static void quantile(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+	{
+		//
+		// Skip the default values
+		//
+		if(src->m_cnt == 0)
+		{
+			return;
+		}
+
+		double v = (double)*(T*)src->m_val;
+
+		if(src->m_cnt > 1)
+		{
+			v /= src->m_cnt;
+		}
+
+		col->m_quantiles[row].add(v);
+	}
+
+	static void avg(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+	{
+		col->m_cnts[row] += src->m_cnt;
+		*col->slot<T>(row) += *(T*)src->m_val;
+	}
+
+	static void max(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+	{
+		T* dst = col->slot<T>(row);
+
+		if(*dst < *(T*)src->m_val)
+		{
+			*dst = *(T*)src->m_val;
+		}
+	}
+};
+
+//
+// Aggregation kernels for the types that can't be summed. They only keep
+// track of the entry count.
+//
+static void untyped_sum(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+{
+	if(src->m_cnt >= 2)
+	{
+		col->m_cnts[row] = 1;
+	}
+}
+
+static void untyped_avg(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+{
+	col->m_cnts[row] += src->m_cnt;
+}
+
+//
+// The max of strings and buffers is the last value
+//
+static void buffer_max(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+{
+	sinsp_table_field* dst = &col->m_refs[row];
+
+	if(dst->m_len >= src->m_len)
+	{
+		memcpy(dst->m_val, src->m_val, src->m_len);
+	}
+	else
+	{
+		dst->m_val = buffer->copy(src->m_val, src->m_len);
+	}
+
+	dst->m_len = src->m_len;
+}
+
+//
+// Distinct counts work on the value bytes, so they don't depend on the type
+//
+static void distinct_add(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer)
+{
+	if(src->m_cnt == 0)
+	{
+		return;
+	}
+
+	col->m_distinct[row].add(sinsp_table_field_hasher::hash(src->m_val, src->m_len));
+}
+
+template<typename T> static sinsp_table_aggregator select_typed_aggregator(sinsp_field_aggregation aggregation)
+{
+	switch(aggregation)
+	{
+	case A_SUM:
+	case A_TIME_AVG:
+		return table_aggregators<T>::sum;
+	case A_AVG:
+		return table_aggregators<T>::avg;
+	case A_MAX:
+		return table_aggregators<T>::max;
+	case A_P50:
+	case A_P90:
+	case A_P95:
+	case A_P99:
+		return table_aggregators<T>::quantile;
+	default:
+		return NULL;
+	}
+}
+
+static sinsp_table_aggregator select_aggregator(ppm_param_type type, sinsp_field_aggregation aggregation)
+{
+	if(aggregation == A_DISTINCT)
+	{
+		return distinct_add;
+	}
+
+	switch(type)
+	{
+	case PT_INT8:
+		return select_typed_aggregator<int8_t>(aggregation);
+	case PT_INT16:
+		return select_typed_aggregator<int16_t>(aggregation);
+	case PT_INT32:
+		return select_typed_aggregator<int32_t>(aggregation);
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_PID:
+	case PT_FD:
+		return select_typed_aggregator<int64_t>(aggregation);
+	case PT_UINT8:
+		return select_typed_aggregator<uint8_t>(aggregation);
+	case PT_UINT16:
+		return select_typed_aggregator<uint16_t>(aggregation);
+	case PT_UINT32:
+	case PT_BOOL:
+		return select_typed_aggregator<uint32_t>(aggregation);
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return select_typed_aggregator<uint64_t>(aggregation);
+	case PT_DOUBLE:
+		return select_typed_aggregator<double>(aggregation);
+	default:
+		break;
+	}
+
+	switch(aggregation)
+	{
+	case A_SUM:
+	case A_TIME_AVG:
+		return untyped_sum;
+	case A_AVG:
+		return untyped_avg;
+	case A_MAX:
+		if(type == PT_CHARBUF || type == PT_BYTEBUF)
+		{
+			return buffer_max;
+		}
+
+		return NULL;
+	default:
+		return NULL;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_column implementation
+///////////////////////////////////////////////////////////////////////////////
+sinsp_table_column::sinsp_table_column(ppm_param_type type, sinsp_field_aggregation aggregation)
+{
+	m_type = type;
+	m_fixed_len = get_fixed_len(type);
+	m_aggregator = select_aggregator(type, aggregation);
+	m_sketch = is_sketch(aggregation)? aggregation : A_NONE;
+	m_merges_sketches = false;
+}
+
+uint32_t sinsp_table_column::get_fixed_len(ppm_param_type type)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		return 1;
+	case PT_INT16:
+		return 2;
+	case PT_INT32:
+		return 4;
+	case PT_INT64:
+	case PT_FD:
+	case PT_PID:
+	case PT_ERRNO:
+		return 8;
+	case PT_FLAGS8:
+	case PT_UINT8:
+	case PT_SIGTYPE:
+		return 1;
+	case PT_FLAGS16:
+	case PT_UINT16:
+	case PT_PORT:
+	case PT_SYSCALLID:
+		return 2;
+	case PT_UINT32:
+	case PT_FLAGS32:
+	case PT_BOOL:
+	case PT_IPV4ADDR:
+		return 4;
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		return 8;
+	case PT_DOUBLE:
+		return sizeof(double);
+	default:
+		return 0;
+	}
+}
+
+void sinsp_table_column::add_sketch()
+{
+	if(m_sketch == A_DISTINCT)
+	{
+		m_distinct.push_back(sinsp_table_distinct_counter());
+	}
+	else
+	{
+		m_quantiles.push_back(sinsp_table_quantile_sketch());
+	}
+}
+
+void sinsp_table_column::merge_sketch(uint32_t row, sinsp_table_column* src, uint32_t src_row)
+{
+	if(m_sketch == A_DISTINCT)
+	{
+		m_distinct[row].merge(&src->m_distinct[src_row]);
+	}
+	else
+	{
+		m_quantiles[row].merge(&src->m_quantiles[src_row]);
+	}
+}
+
+void sinsp_table_column::finalize_sketches()
+{
+	double q;
+
+	switch(m_sketch)
+	{
+	case A_P50:
+		q = 0.5;
+		break;
+	case A_P90:
+		q = 0.9;
+		break;
+	case A_P95:
+		q = 0.95;
+		break;
+	case A_P99:
+		q = 0.99;
+		break;
+	default:
+		q = 0;
+		break;
+	}
+
+	for(uint32_t j = 0; j < m_slots.size(); j++)
+	{
+		uint64_t* slot = &m_slots[j];
+
+		if(m_sketch == A_DISTINCT)
+		{
+			*slot = m_distinct[j].estimate();
+			continue;
+		}
+
+		double v = m_quantiles[j].quantile(q);
+
+		switch(m_type)
+		{
+		case PT_INT8:
+		case PT_INT16:
+		case PT_INT32:
+		case PT_INT64:
+			{
+				//
+				// The sketches don't store negative values, so this is never
+				// negative
+				//
+				int64_t iv = (int64_t)(v + 0.5);
+				memcpy(slot, &iv, m_fixed_len);
+			}
+			break;
+		case PT_DOUBLE:
+			memcpy(slot, &v, sizeof(double));
+			break;
+		default:
+			{
+				uint64_t uv = (uint64_t)(v + 0.5);
+				memcpy(slot, &uv, m_fixed_len);
+			}
+			break;
+		}
+
+		m_cnts[j] = 1;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_distinct_counter implementation
+///////////////////////////////////////////////////////////////////////////////
+void sinsp_table_distinct_counter::to_registers()
+{
+	m_registers.resize(1 << SINSP_TABLE_DISTINCT_PRECISION, 0);
+
+	for(auto it = m_sparse.begin(); it != m_sparse.end(); ++it)
+	{
+		add_to_registers(*it);
+	}
+
+	vector<uint64_t>().swap(m_sparse);
+}
+
+void sinsp_table_distinct_counter::merge(sinsp_table_distinct_counter* other)
+{
+	if(other->m_registers.size() == 0)
+	{
+		for(auto it = other->m_sparse.begin(); it != other->m_sparse.end(); ++it)
+		{
+			add(*it);
+		}
+
+		return;
+	}
+
+	if(m_registers.size() == 0)
+	{
+		to_registers();
+	}
+
+	for(uint32_t j = 0; j < m_registers.size(); j++)
+	{
+		if(m_registers[j] < other->m_registers[j])
+		{
+			m_registers[j] = other->m_registers[j];
+		}
+	}
+}
+
+uint64_t sinsp_table_distinct_counter::estimate()
+{
+	if(m_registers.size() == 0)
+	{
+		return m_sparse.size();
+	}
+
+	uint32_t m = (uint32_t)m_registers.size();
+	uint32_t nzeros = 0;
+	double sum = 0;
+
+	for(uint32_t j = 0; j < m; j++)
+	{
+		sum += 1.0 / ((uint64_t)1 << m_registers[j]);
+
+		if(m_registers[j] == 0)
+		{
+			nzeros++;
+		}
+	}
+
+	double res = (0.7213 / (1 + 1.079 / m)) * m * m / sum;
+
+	//
+	// Linear counting is more accurate for the small cardinalities
+	//
+	if(res <= 2.5 * m && nzeros != 0)
+	{
+		res = m * log((double)m / nzeros);
+	}
+
+	return (uint64_t)(res + 0.5);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_quantile_sketch implementation
+///////////////////////////////////////////////////////////////////////////////
+static const double g_quantile_gamma = (1 + SINSP_TABLE_QUANTILE_ACCURACY) / (1 - SINSP_TABLE_QUANTILE_ACCURACY);
+static const double g_quantile_log_gamma = log(g_quantile_gamma);
+
+void sinsp_table_quantile_sketch::add_to_bucket(int32_t idx, uint64_t cnt)
+{
+	m_cnt += cnt;
+
+	if(m_counts.size() == 0)
+	{
+		m_offset = idx;
+		m_counts.push_back((uint32_t)cnt);
+		return;
+	}
+
+	if(idx < m_offset)
+	{
+		//
+		// Grow the window downwards, unless it's already full, in which case
+		// the value goes in the lowest bucket
+		//
+		uint32_t room = SINSP_TABLE_QUANTILE_MAX_BUCKETS - (uint32_t)m_counts.size();
+
+		if(room == 0)
+		{
+			m_counts[0] += (uint32_t)cnt;
+			return;
+		}
+
+		uint32_t grow = min((uint32_t)(m_offset - idx), room);
+		m_counts.insert(m_counts.begin(), grow, 0);
+		m_offset -= grow;
+		m_counts[0] += (uint32_t)cnt;
+		return;
+	}
+
+	uint32_t pos = (uint32_t)(idx - m_offset);
+
+	if(pos >= m_counts.size())
+	{
+		m_counts.resize(pos + 1, 0);
+
+		//
+		// Too wide, collapse the lowest buckets
+		//
+		if(m_counts.size() > SINSP_TABLE_QUANTILE_MAX_BUCKETS)
+		{
+			uint32_t excess = (uint32_t)m_counts.size() - SINSP_TABLE_QUANTILE_MAX_BUCKETS;
+			uint32_t collapsed = 0;
+
+			for(uint32_t j = 0; j <= excess; j++)
+			{
+				collapsed += m_counts[j];
+			}
+
+			m_counts.erase(m_counts.begin(), m_counts.begin() + excess);
+			m_counts[0] = collapsed;
+			m_offset += excess;
+			pos -= excess;
+		}
+	}
+
+	m_counts[pos] += (uint32_t)cnt;
+}
+
+void sinsp_table_quantile_sketch::add(double v)
+{
+	//
+	// Values below 1 would need an unbounded number of buckets, and the
+	// fields we aggregate are mostly integers anyway, so they count as 0
+	//
+	if(v < 1)
+	{
+		m_zero_cnt++;
+		m_cnt++;
+		return;
+	}
+
+	add_to_bucket((int32_t)ceil(log(v) / g_quantile_log_gamma), 1);
+}
+
+void sinsp_table_quantile_sketch::merge(sinsp_table_quantile_sketch* other)
+{
+	m_zero_cnt += other->m_zero_cnt;
+	m_cnt += other->m_zero_cnt;
+
+	//
+	// Start from the top, so that the lowest buckets are the ones that get
+	// collapsed if the window gets too wide
+	//
+	for(int32_t j = (int32_t)other->m_counts.size() - 1; j >= 0; j--)
+	{
+		if(other->m_counts[j] != 0)
+		{
+			add_to_bucket(other->m_offset + j, other->m_counts[j]);
+		}
+	}
+}
+
+double sinsp_table_quantile_sketch::quantile(double q)
+{
+	if(m_cnt == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(q * (m_cnt - 1));
+
+	if(rank < m_zero_cnt)
+	{
+		return 0;
+	}
+
+	uint64_t cnt = m_zero_cnt;
+
+	for(uint32_t j = 0; j < m_counts.size(); j++)
+	{
+		cnt += m_counts[j];
+
+		if(cnt > rank)
+		{
+			//
+			// The bucket covers (gamma^(i-1), gamma^i], and this is the value
+			// with the same relative error from both ends
+			//
+			return 2 * pow(g_quantile_gamma, m_offset + (int32_t)j) / (g_quantile_gamma + 1);
+		}
+	}
+
+	return 2 * pow(g_quantile_gamma, m_offset + (int32_t)m_counts.size() - 1) / (g_quantile_gamma + 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_storage implementation
+///////////////////////////////////////////////////////////////////////////////
+uint32_t sinsp_table_storage::add_row(sinsp_table_field* vals, bool copy_vals)
+{
+	for(uint32_t j = 0; j < m_columns.size(); j++)
+	{
+		sinsp_table_column* col = &m_columns[j];
+		sinsp_table_field* src = &vals[j];
+
+		if(col->m_sketch != A_NONE)
+		{
+			//
+			// The value is computed from the sketch by finalize_sketches()
+			//
+			col->m_slots.push_back(0);
+			col->m_cnts.push_back(1);
+			col->add_sketch();
+
+			if(col->m_aggregator != NULL)
+			{
+				col->m_aggregator(col, m_nrows, src, &m_buffer);
+			}
+
+			continue;
+		}
+
+		if(col->m_fixed_len != 0)
+		{
+			uint64_t slot = 0;
+
+			ASSERT(src->m_len == col->m_fixed_len);
+			memcpy(&slot, src->m_val, col->m_fixed_len);
+			col->m_slots.push_back(slot);
+		}
+		else
+		{
+			uint8_t* val = src->m_val;
+
+			if(copy_vals)
+			{
+				val = m_buffer.copy(val, src->m_len);
+			}
+
+			col->m_refs.push_back(sinsp_table_field(val, src->m_len, 0));
+		}
+
+		col->m_cnts.push_back(src->m_cnt);
+	}
+
+	return m_nrows++;
+}
+
+void sinsp_table_storage::clear()
+{
+	for(auto it = m_columns.begin(); it != m_columns.end(); ++it)
+	{
+		it->m_slots.clear();
+		it->m_refs.clear();
+		it->m_cnts.clear();
+		it->m_distinct.clear();
+		it->m_quantiles.clear();
+	}
+
+	m_buffer.clear();
+	m_nrows = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_history implementation
+///////////////////////////////////////////////////////////////////////////////
+static inline void put_varint(vector<uint8_t>* dst, uint64_t v)
+{
+	while(v >= 0x80)
+	{
+		dst->push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+
+	dst->push_back((uint8_t)v);
+}
+
+static inline uint64_t get_varint(const uint8_t** src)
+{
+	const uint8_t* p = *src;
+	uint64_t res = 0;
+	uint32_t shift = 0;
+
+	while(*p & 0x80)
+	{
+		res |= ((uint64_t)(*p & 0x7f)) << shift;
+		shift += 7;
+		p++;
+	}
+
+	res |= ((uint64_t)*p) << shift;
+	*src = p + 1;
+	return res;
+}
+
+//
+// Map small negative numbers to small positive ones, so that they take few
+// bytes as varints
+//
+static inline uint64_t zigzag_encode(int64_t v)
+{
+	return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t v)
+{
+	return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static bool history_value_to_double(ppm_param_type type, uint64_t v, uint32_t cnt, double* res)
+{
+	switch(type)
+	{
+	case PT_INT8:
+		*res = (int8_t)v;
+		break;
+	case PT_INT16:
+		*res = (int16_t)v;
+		break;
+	case PT_INT32:
+		*res = (int32_t)v;
+		break;
+	case PT_INT64:
+	case PT_ERRNO:
+	case PT_PID:
+	case PT_FD:
+		*res = (double)(int64_t)v;
+		break;
+	case PT_UINT8:
+	case PT_UINT16:
+	case PT_UINT32:
+	case PT_BOOL:
+	case PT_UINT64:
+	case PT_RELTIME:
+	case PT_ABSTIME:
+		*res = (double)v;
+		break;
+	case PT_DOUBLE:
+		memcpy(res, &v, sizeof(double));
+		break;
+	default:
+		return false;
+	}
+
+	if(cnt > 1)
+	{
+		*res /= cnt;
+	}
+
+	return true;
+}
+
+void sinsp_table_history::state::resize(uint32_t nkeys, uint32_t ncols)
+{
+	if(m_seqs.size() < nkeys)
+	{
+		m_seqs.resize(nkeys, 0);
+		m_vals.resize(nkeys * ncols, 0);
+		m_refs.resize(nkeys * ncols);
+		m_bufs.resize(nkeys * ncols);
+		m_cnts.resize(nkeys * ncols, 0);
+	}
+}
+
+sinsp_table_history::sinsp_table_history()
+{
+	m_size = 0;
+	m_ncols = 0;
+	m_last_seq = 0;
+}
+
+sinsp_table_history::~sinsp_table_history()
+{
+	clear();
+}
+
+void sinsp_table_history::configure(uint32_t size, vector<ppm_param_type>* types)
+{
+	clear();
+
+	m_size = size;
+	m_types = *types;
+	m_ncols = (uint32_t)types->size();
+	m_kinds.clear();
+	m_lens.clear();
+
+	for(auto it = types->begin(); it != types->end(); ++it)
+	{
+		uint32_t len = sinsp_table_column::get_fixed_len(*it);
+
+		if(*it == PT_DOUBLE)
+		{
+			m_kinds.push_back(CK_DOUBLE);
+		}
+		else if(len != 0)
+		{
+			m_kinds.push_back(CK_INTEGER);
+		}
+		else
+		{
+			m_kinds.push_back(CK_BYTES);
+		}
+
+		m_lens.push_back(len);
+	}
+}
+
+void sinsp_table_history::clear()
+{
+	for(auto it = m_keys.begin(); it != m_keys.end(); ++it)
+	{
+		if(it->m_key.m_val != NULL)
+		{
+			delete[] it->m_key.m_val;
+		}
+	}
+
+	m_samples.clear();
+	m_keys.clear();
+	m_key_ids.clear();
+	m_free_ids.clear();
+	m_encoder = state();
+	m_decoder = state();
+	m_rebase_state = state();
+	m_rows.clear();
+	m_out_buffer.clear();
+}
+
+uint32_t sinsp_table_history::get_key_id(sinsp_table_field* key)
+{
+	auto it = m_key_ids.find(*key);
+
+	if(it != m_key_ids.end())
+	{
+		m_keys[it->second].m_refcnt++;
+		return it->second;
+	}
+
+	key_info ki;
+	ki.m_key.m_val = new uint8_t[key->m_len];
+	ki.m_key.m_len = key->m_len;
+	ki.m_key.m_cnt = key->m_cnt;
+	ki.m_refcnt = 1;
+	memcpy(ki.m_key.m_val, key->m_val, key->m_len);
+
+	uint32_t id;
+
+	if(m_free_ids.size() != 0)
+	{
+		id = m_free_ids.back();
+		m_free_ids.pop_back();
+		m_keys[id] = ki;
+		m_encoder.m_seqs[id] = 0;
+	}
+	else
+	{
+		id = (uint32_t)m_keys.size();
+		m_keys.push_back(ki);
+		m_encoder.resize((uint32_t)m_keys.size(), m_ncols);
+	}
+
+	m_key_ids[ki.m_key] = id;
+	return id;
+}
+
+void sinsp_table_history::release_key(uint32_t id)
+{
+	key_info* ki = &m_keys[id];
+
+	ASSERT(ki->m_refcnt != 0);
+
+	if(--ki->m_refcnt == 0)
+	{
+		m_key_ids.erase(ki->m_key);
+		delete[] ki->m_key.m_val;
+		ki->m_key.m_val = NULL;
+		m_free_ids.push_back(id);
+	}
+}
+
+//
+// Every row is encoded as the key id, a bitmask of the columns whose entry
+// count changed, the values and finally the counts that changed. A value is
+// relative to the one that the key had in the previous sample, if the key
+// was there, as recorded in st.
+//
+void sinsp_table_history::encode(vector<sinsp_sample_row>* rows, vector<uint32_t>* ids, state* st, uint64_t seq, encoded_sample* res)
+{
+	uint32_t nmask = (m_ncols + 7) / 8;
+	uint32_t j;
+
+	m_scratch.clear();
+
+	for(uint32_t r = 0; r < rows->size(); r++)
+	{
+		sinsp_sample_row* row = &rows->at(r);
+		uint32_t id = ids->at(r);
+		uint32_t base = id * m_ncols;
+		bool prev = (st->m_seqs[id] != 0 && st->m_seqs[id] + 1 == seq);
+
+		put_varint(&m_scratch, id);
+
+		size_t maskpos = m_scratch.size();
+		m_scratch.resize(maskpos + nmask, 0);
+
+		for(j = 0; j < m_ncols; j++)
+		{
+			sinsp_table_field* fld = &row->m_values[j];
+			uint32_t idx = base + j;
+
+			if(!prev || fld->m_cnt != st->m_cnts[idx])
+			{
+				m_scratch[maskpos + j / 8] |= (uint8_t)(1 << (j % 8));
+			}
+
+			switch(m_kinds[j])
+			{
+			case CK_INTEGER:
+			{
+				uint64_t v = 0;
+				memcpy(&v, fld->m_val, m_lens[j]);
+				put_varint(&m_scratch, zigzag_encode((int64_t)(v - (prev? st->m_vals[idx] : 0))));
+				st->m_vals[idx] = v;
+				break;
+			}
+			case CK_DOUBLE:
+			{
+				uint64_t v;
+				memcpy(&v, fld->m_val, sizeof(double));
+				put_varint(&m_scratch, v ^ (prev? st->m_vals[idx] : 0));
+				st->m_vals[idx] = v;
+				break;
+			}
+			case CK_BYTES:
+				if(prev && st->m_bufs[idx].size() == fld->m_len &&
+					memcmp(st->m_bufs[idx].data(), fld->m_val, fld->m_len) == 0)
+				{
+					put_varint(&m_scratch, 0);
+				}
+				else
+				{
+					put_varint(&m_scratch, (uint64_t)fld->m_len + 1);
+					m_scratch.insert(m_scratch.end(), fld->m_val, fld->m_val + fld->m_len);
+					st->m_bufs[idx].assign((char*)fld->m_val, fld->m_len);
+				}
+				break;
+			}
+		}
+
+		for(j = 0; j < m_ncols; j++)
+		{
+			if(m_scratch[maskpos + j / 8] & (1 << (j % 8)))
+			{
+				put_varint(&m_scratch, row->m_values[j].m_cnt);
+				st->m_cnts[base + j] = row->m_values[j].m_cnt;
+			}
+		}
+
+		st->m_seqs[id] = seq;
+	}
+
+	res->m_nrows = (uint32_t)rows->size();
+	res->m_data.assign(m_scratch.begin(), m_scratch.end());
+}
+
+//
+// Decode a sample on top of st, which must contain the previous sample. If
+// rows is not NULL, the decoded rows are returned there. Their values point
+// to st and to the encoded samples.
+//
+void sinsp_table_history::decode(encoded_sample* sample, uint64_t seq, state* st, vector<sinsp_sample_row>* rows, vector<uint32_t>* ids)
+{
+	const uint8_t* p = sample->m_data.data();
+	uint32_t nmask = (m_ncols + 7) / 8;
+	uint32_t j;
+
+	if(rows != NULL)
+	{
+		rows->resize(sample->m_nrows);
+	}
+
+	if(ids != NULL)
+	{
+		ids->resize(sample->m_nrows);
+	}
+
+	for(uint32_t r = 0; r < sample->m_nrows; r++)
+	{
+		uint32_t id = (uint32_t)get_varint(&p);
+		uint32_t base = id * m_ncols;
+		bool prev = (st->m_seqs[id] != 0 && st->m_seqs[id] + 1 == seq);
+		const uint8_t* mask = p;
+
+		p += nmask;
+
+		for(j = 0; j < m_ncols; j++)
+		{
+			uint32_t idx = base + j;
+
+			switch(m_kinds[j])
+			{
+			case CK_INTEGER:
+				st->m_vals[idx] = (prev? st->m_vals[idx] : 0) + (uint64_t)zigzag_decode(get_varint(&p));
+				break;
+			case CK_DOUBLE:
+				st->m_vals[idx] = (prev? st->m_vals[idx] : 0) ^ get_varint(&p);
+				break;
+			case CK_BYTES:
+			{
+				uint64_t tag = get_varint(&p);
+
+				if(tag != 0)
+				{
+					st->m_refs[idx] = sinsp_table_field((uint8_t*)p, (uint32_t)(tag - 1), 0);
+					p += tag - 1;
+				}
+
+				break;
+			}
+			}
+		}
+
+		for(j = 0; j < m_ncols; j++)
+		{
+			if(mask[j / 8] & (1 << (j % 8)))
+			{
+				st->m_cnts[base + j] = (uint32_t)get_varint(&p);
+			}
+		}
+
+		st->m_seqs[id] = seq;
+
+		if(rows != NULL)
+		{
+			sinsp_sample_row* row = &rows->at(r);
+
+			row->m_key = m_keys[id].m_key;
+			row->m_values.resize(m_ncols);
+
+			for(j = 0; j < m_ncols; j++)
+			{
+				uint32_t idx = base + j;
+
+				if(m_kinds[j] == CK_BYTES)
+				{
+					row->m_values[j] = st->m_refs[idx];
+				}
+				else
+				{
+					row->m_values[j].m_val = (uint8_t*)&st->m_vals[idx];
+					row->m_values[j].m_len = m_lens[j];
+				}
+
+				row->m_values[j].m_cnt = st->m_cnts[idx];
+			}
+		}
+
+		if(ids != NULL)
+		{
+			(*ids)[r] = id;
+		}
+	}
+
+	ASSERT(p == sample->m_data.data() + sample->m_data.size());
+}
+
+//
+// Drop the oldest sample, and encode the next one on its own
+//
+void sinsp_table_history::evict()
+{
+	uint64_t first = get_first_seq();
+	vector<uint32_t> ids;
+	vector<uint32_t> next_ids;
+
+	m_decoder.resize((uint32_t)m_keys.size(), m_ncols);
+	std::fill(m_decoder.m_seqs.begin(), m_decoder.m_seqs.end(), 0);
+
+	decode(&m_samples[0], first, &m_decoder, NULL, &ids);
+
+	if(m_samples.size() > 1)
+	{
+		decode(&m_samples[1], first + 1, &m_decoder, &m_rows, &next_ids);
+
+		m_rebase_state.resize((uint32_t)m_keys.size(), m_ncols);
+		std::fill(m_rebase_state.m_seqs.begin(), m_rebase_state.m_seqs.end(), 0);
+
+		encode(&m_rows, &next_ids, &m_rebase_state, first + 1, &m_samples[1]);
+	}
+
+	for(auto it = ids.begin(); it != ids.end(); ++it)
+	{
+		release_key(*it);
+	}
+
+	m_samples.pop_front();
+}
+
+void sinsp_table_history::add_sample(vector<sinsp_sample_row>* sample, uint64_t ts)
+{
+	if(m_size == 0)
+	{
+		return;
+	}
+
+	m_ids.clear();
+
+	for(auto it = sample->begin(); it != sample->end(); ++it)
+	{
+		m_ids.push_back(get_key_id(&it->m_key));
+	}
+
+	m_last_seq++;
+
+	m_samples.push_back(encoded_sample());
+	m_samples.back().m_ts = ts;
+	encode(sample, &m_ids, &m_encoder, m_last_seq, &m_samples.back());
+
+	while(m_samples.size() > m_size)
+	{
+		evict();
+	}
+}
+
+uint64_t sinsp_table_history::get_sample(uint64_t seq, vector<sinsp_sample_row>* res)
+{
+	uint64_t first = get_first_seq();
+	uint32_t j;
+
+	if(first == 0 || seq < first || seq > m_last_seq)
+	{
+		res->clear();
+		return 0;
+	}
+
+	m_decoder.resize((uint32_t)m_keys.size(), m_ncols);
+	std::fill(m_decoder.m_seqs.begin(), m_decoder.m_seqs.end(), 0);
+
+	for(uint64_t s = first; s < seq; s++)
+	{
+		decode(&m_samples[s - first], s, &m_decoder, NULL, NULL);
+	}
+
+	encoded_sample* es = &m_samples[seq - first];
+	decode(es, seq, &m_decoder, res, NULL);
+
+	//
+	// Copy the rows out of the decoder and of the samples, which change when
+	// the next sample is added
+	//
+	m_out_buffer.clear();
+	m_out_slots.resize(es->m_nrows * m_ncols);
+
+	for(uint32_t r = 0; r < es->m_nrows; r++)
+	{
+		sinsp_sample_row* row = &res->at(r);
+
+		row->m_key.m_val = m_out_buffer.copy(row->m_key.m_val, row->m_key.m_len);
+
+		for(j = 0; j < m_ncols; j++)
+		{
+			sinsp_table_field* fld = &row->m_values[j];
+
+			if(m_kinds[j] == CK_BYTES)
+			{
+				fld->m_val = m_out_buffer.copy(fld->m_val, fld->m_len);
+			}
+			else
+			{
+				uint64_t* slot = &m_out_slots[r * m_ncols + j];
+				*slot = *(uint64_t*)fld->m_val;
+				fld->m_val = (uint8_t*)slot;
+			}
+		}
+	}
+
+	return es->m_ts;
+}
+
+bool sinsp_table_history::get_series(vector<sinsp_table_field*>* keys, uint32_t col, uint64_t last_seq, uint32_t nsamples, vector<vector<double>>* res)
+{
+	uint64_t first = get_first_seq();
+	vector<int64_t> ids;
+	double val;
+
+	if(col >= m_ncols || !history_value_to_double(m_types[col], 0, 0, &val))
+	{
+		return false;
+	}
+
+	res->assign(keys->size(), vector<double>());
+
+	if(first == 0 || nsamples == 0 || last_seq < first)
+	{
+		return true;
+	}
+
+	if(last_seq > m_last_seq)
+	{
+		last_seq = m_last_seq;
+	}
+
+	uint64_t from = (last_seq - first >= nsamples)? last_seq - nsamples + 1 : first;
+
+	for(auto it = keys->begin(); it != keys->end(); ++it)
+	{
+		auto kit = m_key_ids.find(**it);
+
+		if(kit != m_key_ids.end())
+		{
+			ids.push_back(kit->second);
+		}
+		else
+		{
+			ids.push_back(-1);
+		}
+	}
+
+	m_decoder.resize((uint32_t)m_keys.size(), m_ncols);
+	std::fill(m_decoder.m_seqs.begin(), m_decoder.m_seqs.end(), 0);
+
+	for(uint64_t s = first; s <= last_seq; s++)
+	{
+		decode(&m_samples[s - first], s, &m_decoder, NULL, NULL);
+
+		if(s < from)
+		{
+			continue;
+		}
+
+		for(uint32_t k = 0; k < ids.size(); k++)
+		{
+			int64_t id = ids[k];
+
+			if(id == -1 || m_decoder.m_seqs[id] != s)
+			{
+				val = 0;
+			}
+			else
+			{
+				uint32_t idx = (uint32_t)id * m_ncols + col;
+				history_value_to_double(m_types[col], m_decoder.m_vals[idx], m_decoder.m_cnts[idx], &val);
+			}
+
+			(*res)[k].push_back(val);
+		}
+	}
+
+	return true;
+}
+
+uint64_t sinsp_table_history::get_memory_usage()
+{
+	uint64_t res = 0;
+
+	for(auto it = m_samples.begin(); it != m_samples.end(); ++it)
+	{
+		res += it->m_data.size();
+	}
+
+	for(auto it = m_keys.begin(); it != m_keys.end(); ++it)
+	{
+		if(it->m_key.m_val != NULL)
+		{
+			res += it->m_key.m_len;
+		}
+	}
+
+	return res;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table implementation
+///////////////////////////////////////////////////////////////////////////////
+
 sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_interval_ns, bool print_to_stdout)
 {
 	m_inspector = inspector;
@@ -89,9 +1313,10 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_n_postmerge_fields = 0;
 	m_refresh_interval_ns = refresh_interval_ns;
 	m_print_to_stdout = print_to_stdout;
+	m_include_proctable = true;
 	m_next_flush_time_ns = 0;
 	m_printer = new sinsp_filter_check_reference();
-	m_buffer = &m_buffer1;
+	m_storage = &m_storage1;
 	m_is_sorting_ascending = false;
 	m_sorting_col = -1;
 	m_just_sorted = true;
@@ -105,6 +1330,12 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_zero_double = 0;
 	m_paused = false;
 	m_sample_data = NULL;
+	m_topk = 0;
+	m_n_sorted_rows = 0;
+	m_history_size = 0;
+	m_rewind_seq = 0;
+	m_rewind_changed = false;
+	m_history_sample_seq = 0;
 }
 
 sinsp_table::~sinsp_table()
@@ -174,6 +1405,7 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 		m_chks_to_free.push_back(chk);
 
 		chk->parse_field_name(vit.m_field.c_str(), true);
+		chk->m_cache_key = vit.m_field;
 
 		if((vit.m_flags & TEF_IS_KEY) != 0)
 		{
@@ -242,9 +1474,30 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 		m_premerge_legend.push_back(*(*it)->get_field_info());
 	}
 
+	m_premerge_input_types = m_premerge_types;
+
+	if(m_type == sinsp_table::TT_TABLE)
+	{
+		for(uint32_t j = 1; j < m_n_premerge_fields; j++)
+		{
+			set_sketch_type(m_premerge_extractors[j]->m_aggregation, &m_premerge_types[j], &m_premerge_legend[j]);
+		}
+	}
+
 	m_premerge_vals_array_sz = (m_n_fields - 1) * sizeof(sinsp_table_field);
 	m_vals_array_sz = m_premerge_vals_array_sz;
 
+	if(m_type == sinsp_table::TT_TABLE)
+	{
+		m_premerge_table.set_fixed_key_len(sinsp_table_column::get_fixed_len(m_premerge_types[0]));
+
+		for(uint32_t j = 1; j < m_n_premerge_fields; j++)
+		{
+			m_storage1.add_column(m_premerge_types[j], m_premerge_extractors[j]->m_aggregation);
+			m_storage2.add_column(m_premerge_types[j], m_premerge_extractors[j]->m_aggregation);
+		}
+	}
+
 	//////////////////////////////////////////////////////////////////////////////////////
 	// If a merge has been specified, configure it 
 	//////////////////////////////////////////////////////////////////////////////////////
@@ -329,67 +1582,115 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 		throw sinsp_exception("groupby table has no values");
 	}
 
-	for(auto it = m_postmerge_extractors.begin(); it != m_postmerge_extractors.end(); ++it)
+	//
+	// The columns start with the type of the premerge values they aggregate,
+	// which is not the field type for the distinct counts
+	//
+	for(uint32_t j = 0; j < m_n_postmerge_fields; j++)
 	{
-		m_postmerge_types.push_back((*it)->get_field_info()->m_type);
-		m_postmerge_legend.push_back(*(*it)->get_field_info());
+		m_postmerge_types.push_back(m_premerge_types[m_groupby_columns[j]]);
+		m_postmerge_legend.push_back(m_premerge_legend[m_groupby_columns[j]]);
+
+		if(j != 0)
+		{
+			set_sketch_type(m_postmerge_extractors[j]->m_merge_aggregation, &m_postmerge_types[j], &m_postmerge_legend[j]);
+		}
 	}
 
 	m_postmerge_vals_array_sz = (m_n_postmerge_fields - 1) * sizeof(sinsp_table_field);
+
+	m_merge_table.set_fixed_key_len(sinsp_table_column::get_fixed_len(m_postmerge_types[0]));
+
+	for(uint32_t j = 1; j < m_n_postmerge_fields; j++)
+	{
+		sinsp_field_aggregation aggregation = m_postmerge_extractors[j]->m_aggregation;
+		sinsp_field_aggregation merge_aggregation = m_postmerge_extractors[j]->m_merge_aggregation;
+
+		m_merge_storage.add_column(m_postmerge_types[j], merge_aggregation);
+
+		//
+		// Sketches of the same kind are merged, so that for example the
+		// percentiles of a group are computed on all the values of its rows,
+		// and not on the percentiles of the rows
+		//
+		if(sinsp_table_column::are_sketches_compatible(aggregation, merge_aggregation))
+		{
+			sinsp_table_column* col = &m_merge_storage.m_columns.back();
+
+			col->m_aggregator = NULL;
+			col->m_merges_sketches = true;
+		}
+	}
 }
 
-void sinsp_table::add_row(bool merging)
+//
+// Set the type of a column with the given aggregation. The distinct counts
+// are numbers whatever the type of the field, and the percentiles can only
+// be computed on numbers.
+//
+void sinsp_table::set_sketch_type(sinsp_field_aggregation aggregation, ppm_param_type* type, filtercheck_field_info* legend)
+{
+	if(aggregation == A_DISTINCT)
+	{
+		*type = PT_UINT64;
+		legend->m_type = PT_UINT64;
+		legend->m_print_format = PF_DEC;
+	}
+	else if(sinsp_table_column::is_sketch(aggregation))
+	{
+		switch(*type)
+		{
+		case PT_INT8:
+		case PT_INT16:
+		case PT_INT32:
+		case PT_INT64:
+		case PT_UINT8:
+		case PT_UINT16:
+		case PT_UINT32:
+		case PT_UINT64:
+		case PT_RELTIME:
+		case PT_ABSTIME:
+		case PT_DOUBLE:
+			break;
+		default:
+			throw sinsp_exception("percentiles can only be computed on numeric fields, " + string(legend->m_name) + " is not numeric");
+		}
+	}
+}
+
+void sinsp_table::add_row()
 {
 	uint32_t j;
 
-	sinsp_table_field key(m_fld_pointers[0].m_val, 
-		m_fld_pointers[0].m_len,
-		m_fld_pointers[0].m_cnt);
+	sinsp_table_field key(m_premerge_fld_pointers[0].m_val, 
+		m_premerge_fld_pointers[0].m_len,
+		m_premerge_fld_pointers[0].m_cnt);
 
 	if(m_type == sinsp_table::TT_TABLE)
 	{
 		//
 		// This is a table. Do a proper key lookup and update the entry
 		//
-		auto it = m_table->find(key);
+		uint64_t h = m_premerge_table.hash(&key);
+		sinsp_table_map::entry* e = m_premerge_table.find(&key, h);
 
-		if(it == m_table->end())
+		if(e == NULL)
 		{
 			//
-			// New entry
+			// New entry. The values point to the extractors' storage and
+			// need to be copied.
 			//
-			key.m_val = key.m_val;
+			key.m_val = m_storage->m_buffer.copy(key.m_val, key.m_len);
 			key.m_cnt = 1;
-			m_vals = (sinsp_table_field*)m_buffer->reserve(m_vals_array_sz);
-
-			for(j = 1; j < m_n_fields; j++)
-			{
-				uint32_t vlen = get_field_len(j);
-				m_vals[j - 1].m_val = m_fld_pointers[j].m_val;
-				m_vals[j - 1].m_len = vlen;
-				m_vals[j - 1].m_cnt = m_fld_pointers[j].m_cnt;
-			}
 
-			(*m_table)[key] = m_vals;
+			m_premerge_table.insert(&key, m_storage->add_row(m_premerge_fld_pointers + 1, true), h);
 		}
 		else
 		{
 			//
 			// Existing entry
 			//
-			m_vals = it->second;
-
-			for(j = 1; j < m_n_fields; j++)
-			{
-				if(merging)
-				{
-					add_fields(j, &m_fld_pointers[j], m_postmerge_extractors[j]->m_merge_aggregation);
-				}
-				else
-				{
-					add_fields(j, &m_fld_pointers[j], m_premerge_extractors[j]->m_aggregation);
-				}
-			}
+			m_storage->aggregate_row(e->m_row, m_premerge_fld_pointers + 1);
 		}
 	}
 	else
@@ -407,16 +1708,16 @@ void sinsp_table::add_row(bool merging)
 		//
 		// This is a list. Create the new entry and push it back.
 		//
-		key.m_val = key.m_val;
+		key.m_val = m_storage->m_buffer.copy(key.m_val, key.m_len);
 		key.m_cnt = 1;
 		row.m_key = key;
 
-		m_vals = (sinsp_table_field*)m_buffer->reserve(m_vals_array_sz);
+		m_vals = (sinsp_table_field*)m_storage->m_buffer.reserve(m_vals_array_sz);
 
 		for(j = 1; j < m_n_fields; j++)
 		{
 			uint32_t vlen = get_field_len(j);
-			m_vals[j - 1].m_val = m_fld_pointers[j].m_val;
+			m_vals[j - 1].m_val = m_storage->m_buffer.copy(m_fld_pointers[j].m_val, vlen);
 			m_vals[j - 1].m_len = vlen;
 			m_vals[j - 1].m_cnt = 1;
 			row.m_values.push_back(m_vals[j - 1]);
@@ -442,12 +1743,16 @@ void sinsp_table::process_event(sinsp_evt* evt)
 	}
 
 	//
-	// Extract the values and create the row to add
+	// Extract the values and create the row to add.
+	// The row points to the extracted values, which are only copied into the
+	// table buffer by add_row() if the key is new. Existing rows are updated in
+	// place, so the buffer grows with the number of rows and not with the
+	// number of events.
 	//
 	for(j = 0; j < m_n_premerge_fields; j++)
 	{
 		uint32_t len;
-		uint8_t* val = m_premerge_extractors[j]->extract(evt, &len);
+		uint8_t* val = m_premerge_extractors[j]->extract_cached(evt, &len);
 
 		sinsp_table_field* pfld = &(m_premerge_fld_pointers[j]);
 
@@ -467,7 +1772,6 @@ void sinsp_table::process_event(sinsp_evt* evt)
 				}
 
 				pfld->m_len = get_field_len(j);
-				pfld->m_val = m_buffer->copy(pfld->m_val, pfld->m_len);
 				pfld->m_cnt = 0;
 			}
 			else
@@ -479,7 +1783,6 @@ void sinsp_table::process_event(sinsp_evt* evt)
 		{
 			pfld->m_val = val;
 			pfld->m_len = get_field_len(j);
-			pfld->m_val = m_buffer->copy(val, pfld->m_len);
 			pfld->m_cnt = 1;
 		}
 	}
@@ -487,7 +1790,7 @@ void sinsp_table::process_event(sinsp_evt* evt)
 	//
 	// Add the row
 	//
-	add_row(false);
+	add_row();
 
 	return;
 }
@@ -546,7 +1849,10 @@ void sinsp_table::flush(sinsp_evt* evt)
 			// Time to emit the sample! 
 			// Add the proctable as a sample at the end of the second
 			//
-			process_proctable(evt);
+			if(m_include_proctable && evt != NULL)
+			{
+				process_proctable(evt);
+			}
 
 			//
 			// If there is a merging step, switch the types to point to the merging ones.
@@ -568,6 +1874,14 @@ void sinsp_table::flush(sinsp_evt* evt)
 
 			if(m_type == sinsp_table::TT_TABLE)
 			{
+				//
+				// Keep the sample in the history
+				//
+				if(m_history_size != 0)
+				{
+					m_history.add_sample(&m_full_sample_data, m_next_flush_time_ns);
+				}
+
 				//
 				// Switch the data storage so that the current one is still usable by the 
 				// consumers of the table.
@@ -577,7 +1891,7 @@ void sinsp_table::flush(sinsp_evt* evt)
 				//
 				// Clear the current data storage
 				//
-				m_buffer->clear();
+				m_storage->clear();
 			}
 
 			//
@@ -588,6 +1902,11 @@ void sinsp_table::flush(sinsp_evt* evt)
 		}
 	}
 
+	if(evt == NULL)
+	{
+		return;
+	}
+
 	uint64_t ts = evt->get_ts();
 
 	m_next_flush_time_ns = ts - (ts % m_refresh_interval_ns) + m_refresh_interval_ns;
@@ -634,7 +1953,7 @@ void sinsp_table::filter_sample()
 
 	m_filtered_sample_data.clear();
 
-	for(auto it : m_full_sample_data)
+	for(auto it : *get_full_sample())
 	{
 		for(uint32_t j = 0; j < it.m_values.size(); j++)
 		{
@@ -678,22 +1997,18 @@ sinsp_table_field* sinsp_table::search_in_sample(string text)
 {
 	vector<filtercheck_field_info>* legend = get_legend();
 
-	for(auto it = m_full_sample_data.begin(); it != m_full_sample_data.end(); ++it)
+	if(m_sample_data != NULL)
+	{
+		extend_sort((uint32_t)m_sample_data->size());
+	}
+
+	vector<sinsp_sample_row>* full_sample = get_full_sample();
+
+	for(auto it = full_sample->begin(); it != full_sample->end(); ++it)
 	{
 		for(uint32_t j = 0; j < it->m_values.size(); j++)
 		{
-			ppm_param_type type;
-
-			if(m_do_merging)
-			{
-				ASSERT(m_types->size() == it->m_values.size() + 2);
-				type = m_types->at(j + 2);
-			}
-			else
-			{
-				ASSERT(m_types->size() == it->m_values.size() + 1);
-				type = m_types->at(j + 1);
-			}
+			ppm_param_type type = legend->at(j + 1).m_type;
 
 			if(type == PT_CHARBUF || type == PT_BYTEBUF || type == PT_SYSCALLID ||
 				type == PT_PORT || type == PT_L4PROTO || type == PT_SOCKFAMILY || type == PT_IPV4ADDR ||
@@ -718,6 +2033,13 @@ sinsp_table_field* sinsp_table::search_in_sample(string text)
 	return NULL;
 }
 
+void sinsp_table::get_row_cmp(table_row_cmp* cc)
+{
+	cc->m_colid = m_sorting_col;
+	cc->m_ascending = m_is_sorting_ascending;
+	cc->m_type = m_do_merging? m_postmerge_types[m_sorting_col + 1] : m_premerge_types[m_sorting_col + 1];
+}
+
 void sinsp_table::sort_sample()
 {
 	if(m_type == sinsp_table::TT_LIST)
@@ -730,7 +2052,11 @@ void sinsp_table::sort_sample()
 		m_just_sorted = false;
 	}
 
-	if(m_sample_data->size() != 0)
+	uint32_t nrows = (uint32_t)m_sample_data->size();
+
+	m_n_sorted_rows = nrows;
+
+	if(nrows != 0)
 	{
 		if(m_sorting_col >= (int32_t)m_sample_data->at(0).m_values.size())
 		{
@@ -738,24 +2064,116 @@ void sinsp_table::sort_sample()
 		}
 
 		table_row_cmp cc;
-		cc.m_colid = m_sorting_col;
-		cc.m_ascending = m_is_sorting_ascending;
-		uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
-		cc.m_type = m_premerge_types[tyid];
+		get_row_cmp(&cc);
+
+		if(m_type == sinsp_table::TT_TABLE && m_topk != 0 && m_topk < nrows)
+		{
+			sort_topk(&cc);
+			return;
+		}
 
-		sort(m_sample_data->begin(),
+		//
+		// Rows with the same value keep the order in which their key was
+		// first seen
+		//
+		stable_sort(m_sample_data->begin(),
 			m_sample_data->end(),
 			cc);
 	}
 }
 
+//
+// Move the top m_topk rows of the sample, sorted, to its beginning, and leave
+// the other ones after them in their original order.
+// The rows are selected on a permutation of the sample, breaking ties with
+// the row position, so that the result is the same as the one of the full
+// stable sort and extend_sort() can complete it by sorting the other rows.
+//
+void sinsp_table::sort_topk(table_row_cmp* cc)
+{
+	uint32_t nrows = (uint32_t)m_sample_data->size();
+	uint32_t j;
+
+	m_sort_perm.resize(nrows);
+	m_sort_selected.assign(nrows, 0);
+
+	for(j = 0; j < nrows; j++)
+	{
+		m_sort_perm[j] = j;
+	}
+
+	vector<sinsp_sample_row>* rows = m_sample_data;
+
+	partial_sort(m_sort_perm.begin(), 
+		m_sort_perm.begin() + m_topk, 
+		m_sort_perm.end(),
+		[rows, cc](uint32_t r1, uint32_t r2)
+		{
+			if((*cc)(rows->at(r1), rows->at(r2)))
+			{
+				return true;
+			}
+			else if((*cc)(rows->at(r2), rows->at(r1)))
+			{
+				return false;
+			}
+
+			return r1 < r2;
+		});
+
+	m_sort_buffer.clear();
+	m_sort_buffer.reserve(nrows);
+
+	for(j = 0; j < m_topk; j++)
+	{
+		m_sort_buffer.push_back(std::move(rows->at(m_sort_perm[j])));
+		m_sort_selected[m_sort_perm[j]] = 1;
+	}
+
+	for(j = 0; j < nrows; j++)
+	{
+		if(!m_sort_selected[j])
+		{
+			m_sort_buffer.push_back(std::move(rows->at(j)));
+		}
+	}
+
+	rows->swap(m_sort_buffer);
+	m_n_sorted_rows = m_topk;
+}
+
+void sinsp_table::extend_sort(uint32_t nrows)
+{
+	if(m_sample_data == NULL || m_type != sinsp_table::TT_TABLE || m_sorting_col < 0)
+	{
+		return;
+	}
+
+	if(nrows <= m_n_sorted_rows || m_n_sorted_rows >= m_sample_data->size())
+	{
+		return;
+	}
+
+	table_row_cmp cc;
+	get_row_cmp(&cc);
+
+	stable_sort(m_sample_data->begin() + m_n_sorted_rows,
+		m_sample_data->end(),
+		cc);
+
+	m_n_sorted_rows = (uint32_t)m_sample_data->size();
+}
+
 vector<sinsp_sample_row>* sinsp_table::get_sample(uint64_t time_delta)
 {
 	//
-	// No sample generation happens when the table is paused
+	// No sample generation happens when the table is paused, unless the
+	// user moved in the history
 	//
-	if(!m_paused)
+	if(!m_paused || m_rewind_changed)
 	{
+		m_rewind_changed = false;
+
 		//
 		// If we have a freetext filter, we start by filtering the sample
 		//
@@ -766,7 +2184,7 @@ vector<sinsp_sample_row>* sinsp_table::get_sample(uint64_t time_delta)
 		}
 		else
 		{
-			m_sample_data = &m_full_sample_data;
+			m_sample_data = get_full_sample();
 		}
 
 		//
@@ -846,6 +2264,9 @@ void sinsp_table::set_sorting_col(uint32_t col)
 			case PT_INT16:
 			case PT_INT32:
 			case PT_INT64:
+			case PT_ERRNO:
+			case PT_PID:
+			case PT_FD:
 			case PT_UINT8:
 			case PT_UINT16:
 			case PT_UINT32:
@@ -879,56 +2300,37 @@ void sinsp_table::create_sample()
 		m_full_sample_data.clear();
 		sinsp_sample_row row;
 
-		//
-		// If merging is on, perform the merge and switch to the merged table 
-		//
-		if(m_do_merging)
-		{
-			m_table = &m_merge_table;
-			m_merge_table.clear();
+		sinsp_table_storage* storage;
 
-			for(auto it = m_premerge_table.begin(); it != m_premerge_table.end(); ++it)
-			{
-				for(j = 0; j < m_n_postmerge_fields; j++)
-				{
-					sinsp_table_field* pfld = &(m_postmerge_fld_pointers[j]);
-
-					uint32_t col = m_groupby_columns[j];
-					if(col == 0)
-					{
-						pfld->m_val = it->first.m_val;
-						pfld->m_len = it->first.m_len;
-						pfld->m_cnt = it->first.m_cnt;
-					}
-					else
-					{
-						pfld->m_val = it->second[col - 1].m_val;
-						pfld->m_len = it->second[col - 1].m_len;
-						pfld->m_cnt = it->second[col - 1].m_cnt;
-					}
-				}
+		m_storage->finalize_sketches();
 
-				add_row(true);
-			}
+		//
+		// If merging is on, perform the merge and switch to the merged table 
+		//
+		if(m_do_merging)
+		{
+			merge();
+			m_table = &m_merge_table;
+			storage = &m_merge_storage;
 		}
 		else
 		{
 			m_table = &m_premerge_table;
+			storage = m_storage;
 		}
 
 		//
 		// Emit the table
 		//
+		row.m_values.resize(m_n_fields - 1);
+
 		for(auto it = m_table->begin(); it != m_table->end(); ++it)
 		{
-			row.m_key = it->first;
-
-			row.m_values.clear();
+			row.m_key = it->m_key;
 
-			sinsp_table_field* fields = it->second;
 			for(j = 0; j < m_n_fields - 1; j++)
 			{
-				row.m_values.push_back(fields[j]);
+				storage->m_columns[j].get(it->m_row, &row.m_values[j]);
 			}
 
 			m_full_sample_data.push_back(row);
@@ -944,253 +2346,200 @@ void sinsp_table::create_sample()
 	}
 }
 
-void sinsp_table::add_fields_sum(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+//
+// The sample to show: the last one, or the one selected in the history
+//
+vector<sinsp_sample_row>* sinsp_table::get_full_sample()
 {
-	uint8_t* operand1 = dst->m_val;
-	uint8_t* operand2 = src->m_val;
-	
-	switch(type)
+	if(m_rewind_seq == 0)
 	{
-	case PT_INT8:
-		*(int8_t*)operand1 += *(int8_t*)operand2;
-		return;
-	case PT_INT16:
-		*(int16_t*)operand1 += *(int16_t*)operand2;
-		return;
-	case PT_INT32:
-		*(int32_t*)operand1 += *(int32_t*)operand2;
-		return;
-	case PT_INT64:
-		*(int64_t*)operand1 += *(int64_t*)operand2;
-		return;
-	case PT_UINT8:
-		*(uint8_t*)operand1 += *(uint8_t*)operand2;
-		return;
-	case PT_UINT16:
-		*(uint16_t*)operand1 += *(uint16_t*)operand2;
-		return;
-	case PT_UINT32:
-	case PT_BOOL:
-		*(uint32_t*)operand1 += *(uint32_t*)operand2;
-		return;
-	case PT_UINT64:
-	case PT_RELTIME:
-	case PT_ABSTIME:
-		*(uint64_t*)operand1 += *(uint64_t*)operand2;
-		return;
-	case PT_DOUBLE:
-		*(double*)operand1 += *(double*)operand2;
-		return;
-	default:
-		return;
+		return &m_full_sample_data;
+	}
+
+	//
+	// The sample may have been evicted in the meantime
+	//
+	if(m_rewind_seq < m_history.get_first_seq())
+	{
+		m_rewind_seq = m_history.get_first_seq();
+	}
+
+	if(m_history_sample_seq != m_rewind_seq)
+	{
+		m_history.get_sample(m_rewind_seq, &m_history_sample_data);
+		m_history_sample_seq = m_rewind_seq;
 	}
+
+	return &m_history_sample_data;
 }
 
-void sinsp_table::add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::set_history_size(uint32_t nsamples)
 {
-	uint8_t* operand1 = dst->m_val;
-	uint8_t* operand2 = src->m_val;
-	uint32_t cnt1 = dst->m_cnt;
-	uint32_t cnt2 = src->m_cnt;
-	
-	switch(type)
+	if(m_type != sinsp_table::TT_TABLE)
 	{
-	case PT_INT8:
-		if(cnt1 > 1)
-		{
-			*(int8_t*)operand1 = *(int8_t*)operand1 / cnt1;
-		}
+		return;
+	}
 
-		*(int8_t*)operand1 += (*(int8_t*)operand2) / cnt2;
-		break;
-	case PT_INT16:
-		if(cnt1 > 1)
-		{
-			*(int16_t*)operand1 = *(int16_t*)operand1 / cnt1;
-		}
+	vector<ppm_param_type>* types = m_do_merging? &m_postmerge_types : &m_premerge_types;
+	vector<ppm_param_type> valtypes(types->begin() + 1, types->end());
 
-		*(int16_t*)operand1 += (*(int16_t*)operand2) / cnt2;
-		break;
-	case PT_INT32:
-		if(cnt1 > 1)
-		{
-			*(int32_t*)operand1 = *(int32_t*)operand1 / cnt1;
-		}
+	m_history_size = nsamples;
+	m_history.configure(nsamples, &valtypes);
+	m_rewind_seq = 0;
+	m_history_sample_seq = 0;
+}
 
-		*(int32_t*)operand1 += (*(int32_t*)operand2) / cnt2;
-		break;
-	case PT_INT64:
-		if(cnt1 > 1)
-		{
-			*(int64_t*)operand1 = *(int64_t*)operand1 / cnt1;
-		}
+uint32_t sinsp_table::rewind(int32_t nsamples)
+{
+	int64_t first = (int64_t)m_history.get_first_seq();
+	int64_t last = (int64_t)m_history.get_last_seq();
 
-		*(int64_t*)operand1 += (*(int64_t*)operand2) / cnt2;
-		break;
-	case PT_UINT8:
-		if(cnt1 > 1)
-		{
-			*(uint8_t*)operand1 = *(uint8_t*)operand1 / cnt1;
-		}
+	if(first == 0)
+	{
+		return 0;
+	}
 
-		*(uint8_t*)operand1 += (*(uint8_t*)operand2) / cnt2;
-		break;
-	case PT_UINT16:
-		if(cnt1 > 1)
-		{
-			*(uint16_t*)operand1 = *(uint16_t*)operand1 / cnt1;
-		}
+	int64_t target = (m_rewind_seq != 0)? max((int64_t)m_rewind_seq, first) : last;
+	target -= nsamples;
 
-		*(uint16_t*)operand1 += (*(uint16_t*)operand2) / cnt2;
-		break;
-	case PT_UINT32:
-	case PT_BOOL:
-		if(cnt1 > 1)
-		{
-			*(uint32_t*)operand1 = *(uint32_t*)operand1 / cnt1;
-		}
+	if(target >= last)
+	{
+		m_rewind_seq = 0;
+	}
+	else if(target < first)
+	{
+		m_rewind_seq = (uint64_t)first;
+	}
+	else
+	{
+		m_rewind_seq = (uint64_t)target;
+	}
 
-		*(uint32_t*)operand1 += (*(uint32_t*)operand2) / cnt2;
-		break;
-	case PT_UINT64:
-	case PT_RELTIME:
-	case PT_ABSTIME:
-		if(cnt1 > 1)
-		{
-			*(uint64_t*)operand1 = *(uint64_t*)operand1 / cnt1;
-		}
+	m_rewind_changed = true;
+	return get_rewind_distance();
+}
 
-		*(uint64_t*)operand1 += (*(uint64_t*)operand2) / cnt2;
-		break;
-	case PT_DOUBLE:
-		if(cnt1 > 1)
-		{
-			*(double*)operand1 = *(double*)operand1 / cnt1;
-		}
+uint32_t sinsp_table::get_rewind_distance()
+{
+	if(m_rewind_seq == 0)
+	{
+		return 0;
+	}
 
-		*(double*)operand1 += (*(double*)operand2) / cnt2;
-		break;
-	default:
-		break;
+	return (uint32_t)(m_history.get_last_seq() - max(m_rewind_seq, m_history.get_first_seq()));
+}
+
+bool sinsp_table::get_history_series(vector<sinsp_table_field*>* keys, uint32_t col, uint32_t nsamples, vector<vector<double>>* res)
+{
+	if(m_history_size == 0)
+	{
+		return false;
+	}
+
+	uint64_t last_seq = m_history.get_last_seq();
+
+	if(m_rewind_seq != 0)
+	{
+		last_seq = max(m_rewind_seq, m_history.get_first_seq());
 	}
 
-	src->m_cnt = 1;
-	dst->m_cnt = 1;
+	return m_history.get_series(keys, col, last_seq, nsamples, res);
+}
+
+void sinsp_table::get_premerge_value(const sinsp_table_field* key, uint32_t row, uint32_t col, sinsp_table_field* res)
+{
+	if(col == 0)
+	{
+		*res = *key;
+	}
+	else
+	{
+		m_storage->m_columns[col - 1].get(row, res);
+	}
 }
 
-void sinsp_table::add_fields_max(ppm_param_type type, sinsp_table_field *dst, sinsp_table_field *src)
+void sinsp_table::merge()
 {
-	uint8_t* operand1 = dst->m_val;
-	uint8_t* operand2 = src->m_val;
+	uint32_t j;
+	uint32_t k;
 
-	switch(type)
+	m_merge_table.clear();
+	m_merge_storage.clear();
+	m_merge_src_rows.clear();
+	m_merge_dst_rows.clear();
+	m_merge_first_rows.clear();
+
+	//
+	// Find the group of every row. New groups are created from their first
+	// row, the other rows are put aside to be aggregated.
+	//
+	for(auto it = m_premerge_table.begin(); it != m_premerge_table.end(); ++it)
 	{
-	case PT_INT8:
-		if(*(int8_t*)operand1 < *(int8_t*)operand2)
-		{
-			*(int8_t*)operand1 = *(int8_t*)operand2;
-		}
-		return;
-	case PT_INT16:
-		if(*(int16_t*)operand1 < *(int16_t*)operand2)
-		{
-			*(int16_t*)operand1 = *(int16_t*)operand2;
-		}
-		return;
-	case PT_INT32:
-		if(*(int32_t*)operand1 < *(int32_t*)operand2)
-		{
-			*(int32_t*)operand1 = *(int32_t*)operand2;
-		}
-		return;
-	case PT_INT64:
-		if(*(int64_t*)operand1 < *(int64_t*)operand2)
-		{
-			*(int64_t*)operand1 = *(int64_t*)operand2;
-		}
-		return;
-	case PT_UINT8:
-		if(*(uint8_t*)operand1 < *(uint8_t*)operand2)
-		{
-			*(uint8_t*)operand1 = *(uint8_t*)operand2;
-		}
-		return;
-	case PT_UINT16:
-		if(*(uint16_t*)operand1 < *(uint16_t*)operand2)
-		{
-			*(uint16_t*)operand1 = *(uint16_t*)operand2;
-		}
-		return;
-	case PT_UINT32:
-	case PT_BOOL:
-		if(*(uint32_t*)operand1 < *(uint32_t*)operand2)
-		{
-			*(uint32_t*)operand1 = *(uint32_t*)operand2;
-		}
-		return;
-	case PT_UINT64:
-	case PT_RELTIME:
-	case PT_ABSTIME:
-		if(*(uint64_t*)operand1 < *(uint64_t*)operand2)
-		{
-			*(uint64_t*)operand1 = *(uint64_t*)operand2;
-		}
-		return;
-	case PT_DOUBLE:
-		if(*(double*)operand1 < *(double*)operand2)
-		{
-			*(double*)operand1 = *(double*)operand2;
-		}
-		return;
-	case PT_CHARBUF:
-	case PT_BYTEBUF:
-		if(dst->m_len >= src->m_len)
+		sinsp_table_field key;
+
+		get_premerge_value(&it->m_key, it->m_row, m_groupby_columns[0], &key);
+
+		uint64_t h = m_merge_table.hash(&key);
+		sinsp_table_map::entry* e = m_merge_table.find(&key, h);
+
+		if(e == NULL)
 		{
-			memcpy(dst->m_val, src->m_val, src->m_len);
+			for(j = 1; j < m_n_postmerge_fields; j++)
+			{
+				get_premerge_value(&it->m_key, it->m_row, m_groupby_columns[j], &m_postmerge_fld_pointers[j]);
+			}
+
+			key.m_cnt = 1;
+			uint32_t row = m_merge_storage.add_row(m_postmerge_fld_pointers + 1, false);
+			m_merge_table.insert(&key, row, h);
+			m_merge_first_rows.push_back(pair<uint32_t, uint32_t>(it->m_row, row));
 		}
 		else
 		{
-			dst->m_val = m_buffer->copy(src->m_val, src->m_len);
+			m_merge_src_rows.push_back(pair<const sinsp_table_field*, uint32_t>(&it->m_key, it->m_row));
+			m_merge_dst_rows.push_back(e->m_row);
 		}
-
-		dst->m_len = src->m_len;
-	default:
-		return;
 	}
-}
-
-void sinsp_table::add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr)
-{
-	ppm_param_type type = (*m_types)[dst_id];
-	sinsp_table_field* dst = &(m_vals[dst_id - 1]);
 
-	switch(aggr)
+	//
+	// Aggregate the rows into their groups, one column at a time
+	//
+	for(j = 1; j < m_n_postmerge_fields; j++)
 	{
-	case A_NONE:
-		return;
-	case A_SUM:
-	case A_TIME_AVG:
-		if(src->m_cnt < 2)
+		sinsp_table_column* dst = &m_merge_storage.m_columns[j - 1];
+		uint32_t col = m_groupby_columns[j];
+		sinsp_table_field src;
+
+		if(dst->m_merges_sketches)
 		{
-			add_fields_sum(type, dst, src);
+			sinsp_table_column* srccol = &m_storage->m_columns[col - 1];
+
+			for(k = 0; k < m_merge_first_rows.size(); k++)
+			{
+				dst->merge_sketch(m_merge_first_rows[k].second, srccol, m_merge_first_rows[k].first);
+			}
+
+			for(k = 0; k < m_merge_dst_rows.size(); k++)
+			{
+				dst->merge_sketch(m_merge_dst_rows[k], srccol, m_merge_src_rows[k].second);
+			}
+
+			continue;
 		}
-		else
+
+		if(dst->m_aggregator == NULL)
 		{
-			add_fields_sum_of_avg(type, dst, src);
+			continue;
 		}
 
-		return;
-	case A_AVG:
-		dst->m_cnt += src->m_cnt;
-		add_fields_sum(type, dst, src);		
-		return;
-	case A_MAX:
-		add_fields_max(type, dst, src);		
-		return;
-	default:
-		ASSERT(false);
-		return;
+		for(k = 0; k < m_merge_dst_rows.size(); k++)
+		{
+			get_premerge_value(m_merge_src_rows[k].first, m_merge_src_rows[k].second, col, &src);
+			dst->m_aggregator(dst, m_merge_dst_rows[k], &src, &m_merge_storage.m_buffer);
+		}
 	}
+
+	m_merge_storage.finalize_sketches();
 }
 
 uint32_t sinsp_table::get_field_len(uint32_t id)
@@ -1198,53 +2547,21 @@ uint32_t sinsp_table::get_field_len(uint32_t id)
 	ppm_param_type type;
 	sinsp_table_field *fld;
 
-	type = (*m_types)[id];
+	type = m_premerge_input_types[id];
 	fld = &(m_fld_pointers[id]);
 
 	switch(type)
 	{
-	case PT_INT8:
-		return 1;
-	case PT_INT16:
-		return 2;
-	case PT_INT32:
-		return 4;
-	case PT_INT64:
-	case PT_FD:
-	case PT_PID:
-	case PT_ERRNO:
-		return 8;
-	case PT_FLAGS8:
-	case PT_UINT8:
-	case PT_SIGTYPE:
-		return 1;
-	case PT_FLAGS16:
-	case PT_UINT16:
-	case PT_PORT:
-	case PT_SYSCALLID:
-		return 2;
-	case PT_UINT32:
-	case PT_FLAGS32:
-	case PT_BOOL:
-	case PT_IPV4ADDR:
-		return 4;
-	case PT_UINT64:
-	case PT_RELTIME:
-	case PT_ABSTIME:
-		return 8;
 	case PT_CHARBUF:
 		return (uint32_t)(strlen((char*)fld->m_val) + 1);
 	case PT_BYTEBUF:
 		return fld->m_len;
-	case PT_DOUBLE:
-		return sizeof(double);
-	case PT_SOCKADDR:
-	case PT_SOCKTUPLE:
-	case PT_FDLIST:
-	case PT_FSPATH:
 	default:
-		ASSERT(false);
-		return false;
+		{
+			uint32_t len = sinsp_table_column::get_fixed_len(type);
+			ASSERT(len != 0);
+			return len;
+		}
 	}
 }
 
@@ -1286,13 +2603,13 @@ uint8_t* sinsp_table::get_default_val(filtercheck_field_info* fld)
 
 void sinsp_table::switch_buffers()
 {
-	if(m_buffer == &m_buffer1)
+	if(m_storage == &m_storage1)
 	{
-		m_buffer = &m_buffer2;
+		m_storage = &m_storage2;
 	}
 	else
 	{
-		m_buffer = &m_buffer1;
+		m_storage = &m_storage1;
 	}
 }
 
@@ -1322,6 +2639,7 @@ pair<filtercheck_field_info*, string> sinsp_table::get_row_key_name_and_val(uint
 	else
 	{
 		vector<filtercheck_field_info>* legend = get_legend();
+		extend_sort(rownum + 1);
 		res.first = (filtercheck_field_info*)((*extractors)[0])->get_field_info();
 		ASSERT(res.first != NULL);
 
@@ -1344,6 +2662,8 @@ sinsp_table_field* sinsp_table::get_row_key(uint32_t rownum)
 		return NULL;
 	}
 
+	extend_sort(rownum + 1);
+
 	return &m_sample_data->at(rownum).m_key;
 }
 
@@ -1359,6 +2679,16 @@ int32_t sinsp_table::get_row_from_key(sinsp_table_field* key)
 		{
 			if(memcmp(rowkey->m_val, key->m_val, key->m_len) == 0)
 			{
+				if(j >= m_n_sorted_rows && m_type == sinsp_table::TT_TABLE)
+				{
+					//
+					// The row is in the part of the sample that is not sorted
+					// yet, so its position is not final
+					//
+					extend_sort(j + 1);
+					return get_row_from_key(key);
+				}
+
 				return j;
 			}
 		}
@@ -1377,7 +2707,7 @@ void sinsp_table::clear()
 	if(m_type == sinsp_table::TT_LIST)
 	{
 		m_full_sample_data.clear();
-		m_buffer->clear();
+		m_storage->clear();
 	}
 	else
 	{
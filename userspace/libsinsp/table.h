@@ -18,8 +18,15 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 
 #define SINSP_TABLE_DEFAULT_REFRESH_INTERVAL_NS 1000000000
 #define SINSP_TABLE_BUFFER_ENTRY_SIZE 16384
+#define SINSP_TABLE_MAP_INITIAL_SIZE 256
+#define SINSP_TABLE_DEFAULT_HISTORY_SIZE 60
+#define SINSP_TABLE_DISTINCT_PRECISION 10
+#define SINSP_TABLE_DISTINCT_SPARSE_SIZE 64
+#define SINSP_TABLE_QUANTILE_ACCURACY 0.02
+#define SINSP_TABLE_QUANTILE_MAX_BUCKETS 512
 
 class sinsp_filter_check_reference;
+struct table_row_cmp;
 
 typedef enum sysdig_table_action
 {
@@ -120,21 +127,72 @@ private:
 	uint32_t m_storage_len;
 };
 
-struct sinsp_table_field_hasher
+//
+// Hash functions for the table keys. Variable size keys are hashed a 64 bit
+// word at a time. Keys of 4 or 8 bytes (pids, fds, addresses...) are read as
+// a single integer and go through the final mix only.
+//
+class sinsp_table_field_hasher
 {
-  size_t operator()(const sinsp_table_field& k) const
-  {
-	  size_t h = 0;
-	  uint8_t* s = k.m_val;
-	  uint32_t len = k.m_len;
-
-	  while(--len)
-	  {
-		  h = h * 101 + (unsigned) *s++;
-	  }
-
-	  return h;  
-  }
+public:
+	static inline uint64_t mix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	static inline uint64_t hash(const uint8_t* val, uint32_t len)
+	{
+		uint64_t h = len * 0x9e3779b97f4a7c15ULL;
+		uint64_t w;
+
+		while(len >= 8)
+		{
+			memcpy(&w, val, 8);
+			h ^= w * 0x87c37b91114253d5ULL;
+			h = ((h << 27) | (h >> 37)) * 0x9e3779b97f4a7c15ULL;
+			val += 8;
+			len -= 8;
+		}
+
+		if(len != 0)
+		{
+			w = 0;
+			memcpy(&w, val, len);
+			h ^= w * 0x87c37b91114253d5ULL;
+		}
+
+		return mix(h);
+	}
+
+	static inline uint64_t hash_fixed(const uint8_t* val, uint32_t len)
+	{
+		if(len == 8)
+		{
+			uint64_t w;
+			memcpy(&w, val, 8);
+			return mix(w);
+		}
+		else if(len == 4)
+		{
+			uint32_t w;
+			memcpy(&w, val, 4);
+			return mix(w);
+		}
+		else
+		{
+			return hash(val, len);
+		}
+	}
+
+	size_t operator()(const sinsp_table_field& k) const
+	{
+		return (size_t)hash(k.m_val, k.m_len);
+	}
 };
 
 class sinsp_table_buffer
@@ -208,6 +266,413 @@ public:
 	uint32_t m_pos;
 };
 
+//
+// Approximate count of distinct values (A_DISTINCT), based on HyperLogLog.
+// The values are added as 64 bit hashes. The first
+// SINSP_TABLE_DISTINCT_SPARSE_SIZE distinct hashes are stored as they are,
+// and counted exactly. After that, they are replaced by
+// 2^SINSP_TABLE_DISTINCT_PRECISION one byte registers, for a standard error
+// of about 3%. Either way, the counter takes at most 1KB.
+//
+class sinsp_table_distinct_counter
+{
+public:
+	inline void add(uint64_t hash)
+	{
+		if(m_registers.size() != 0)
+		{
+			add_to_registers(hash);
+			return;
+		}
+
+		for(auto it = m_sparse.begin(); it != m_sparse.end(); ++it)
+		{
+			if(*it == hash)
+			{
+				return;
+			}
+		}
+
+		if(m_sparse.size() < SINSP_TABLE_DISTINCT_SPARSE_SIZE)
+		{
+			m_sparse.push_back(hash);
+		}
+		else
+		{
+			to_registers();
+			add_to_registers(hash);
+		}
+	}
+
+	void merge(sinsp_table_distinct_counter* other);
+	uint64_t estimate();
+
+private:
+	inline void add_to_registers(uint64_t hash)
+	{
+		uint32_t idx = (uint32_t)(hash >> (64 - SINSP_TABLE_DISTINCT_PRECISION));
+		uint64_t w = (hash << SINSP_TABLE_DISTINCT_PRECISION) | (1ULL << (SINSP_TABLE_DISTINCT_PRECISION - 1));
+		uint8_t rank = 1;
+
+		while((w & 0x8000000000000000ULL) == 0)
+		{
+			w <<= 1;
+			rank++;
+		}
+
+		if(m_registers[idx] < rank)
+		{
+			m_registers[idx] = rank;
+		}
+	}
+
+	void to_registers();
+
+	vector<uint64_t> m_sparse;
+	vector<uint8_t> m_registers; // Empty while the hashes are stored in m_sparse
+};
+
+//
+// Approximate quantiles (A_P50, A_P90...), computed with logarithmic buckets
+// so that the relative error is at most SINSP_TABLE_QUANTILE_ACCURACY.
+// Values go in the bucket ceil(log(v) / log(gamma)), with
+// gamma = (1 + accuracy) / (1 - accuracy), and the ones below 1, negative
+// values included, are counted as 0. The buckets are a dense window: when it
+// gets wider than SINSP_TABLE_QUANTILE_MAX_BUCKETS, the lowest buckets are
+// collapsed, so only the lowest quantiles lose accuracy. Sketches of the same
+// column can be merged by adding the buckets.
+//
+class sinsp_table_quantile_sketch
+{
+public:
+	sinsp_table_quantile_sketch()
+	{
+		m_offset = 0;
+		m_zero_cnt = 0;
+		m_cnt = 0;
+	}
+
+	void add(double v);
+	void merge(sinsp_table_quantile_sketch* other);
+	//
+	// q is between 0 and 1
+	//
+	double quantile(double q);
+
+private:
+	void add_to_bucket(int32_t idx, uint64_t cnt);
+
+	int32_t m_offset; // Index of the first bucket in m_counts
+	vector<uint32_t> m_counts;
+	uint64_t m_zero_cnt;
+	uint64_t m_cnt;
+};
+
+class sinsp_table_column;
+
+//
+// An aggregation kernel, i.e. the function that folds the value src into
+// the given row of a column. One is picked for every column, based on its
+// type and aggregation, when the table is configured.
+//
+typedef void (*sinsp_table_aggregator)(sinsp_table_column* col, uint32_t row, sinsp_table_field* src, sinsp_table_buffer* buffer);
+
+//
+// The values of one table column, indexed by row id.
+// Fixed size values (numbers, but also ports, addresses, flags...) are
+// stored in their native type in an array of 8 byte slots. Strings and
+// buffers live in the table buffer and are referenced from m_refs.
+//
+class sinsp_table_column
+{
+public:
+	sinsp_table_column(ppm_param_type type, sinsp_field_aggregation aggregation);
+
+	template<typename T> inline T* slot(uint32_t row)
+	{
+		return (T*)&m_slots[row];
+	}
+
+	inline void get(uint32_t row, sinsp_table_field* res)
+	{
+		if(m_fixed_len != 0)
+		{
+			res->m_val = (uint8_t*)&m_slots[row];
+			res->m_len = m_fixed_len;
+		}
+		else
+		{
+			res->m_val = m_refs[row].m_val;
+			res->m_len = m_refs[row].m_len;
+		}
+
+		res->m_cnt = m_cnts[row];
+	}
+
+	//
+	// Length of the values of the given type, or 0 if it's variable
+	//
+	static uint32_t get_fixed_len(ppm_param_type type);
+
+	//
+	// Sketch columns keep a sketch per row, and the value of the row is the
+	// estimate computed by finalize_sketches()
+	//
+	static bool is_sketch(sinsp_field_aggregation aggregation)
+	{
+		return aggregation >= A_DISTINCT && aggregation <= A_P99;
+	}
+
+	static bool are_sketches_compatible(sinsp_field_aggregation a1, sinsp_field_aggregation a2)
+	{
+		return is_sketch(a1) && is_sketch(a2) && ((a1 == A_DISTINCT) == (a2 == A_DISTINCT));
+	}
+
+	void add_sketch();
+	void merge_sketch(uint32_t row, sinsp_table_column* src, uint32_t src_row);
+	void finalize_sketches();
+
+	ppm_param_type m_type;
+	uint32_t m_fixed_len;
+	sinsp_table_aggregator m_aggregator; // NULL if the column is not aggregated
+	vector<uint64_t> m_slots;
+	vector<sinsp_table_field> m_refs;
+	vector<uint32_t> m_cnts; // For averages, the entry count of every row
+	sinsp_field_aggregation m_sketch; // A_NONE if this is not a sketch column
+	bool m_merges_sketches; // Aggregated by merging the sketches of the premerge column
+	vector<sinsp_table_distinct_counter> m_distinct;
+	vector<sinsp_table_quantile_sketch> m_quantiles;
+};
+
+//
+// Columnar storage for the rows of a table, together with the buffer that
+// holds their keys and variable size values
+//
+class sinsp_table_storage
+{
+public:
+	sinsp_table_storage()
+	{
+		m_nrows = 0;
+	}
+
+	void add_column(ppm_param_type type, sinsp_field_aggregation aggregation)
+	{
+		m_columns.push_back(sinsp_table_column(type, aggregation));
+	}
+
+	//
+	// Create a row with the given values, one per column, and return its id.
+	// If copy_vals is true, the variable size values are copied into the
+	// buffer, otherwise the row references them.
+	//
+	uint32_t add_row(sinsp_table_field* vals, bool copy_vals);
+
+	//
+	// Fold vals into the given row, using the column aggregators
+	//
+	inline void aggregate_row(uint32_t row, sinsp_table_field* vals)
+	{
+		for(uint32_t j = 0; j < m_columns.size(); j++)
+		{
+			sinsp_table_column* col = &m_columns[j];
+
+			if(col->m_aggregator != NULL)
+			{
+				col->m_aggregator(col, row, &vals[j], &m_buffer);
+			}
+		}
+	}
+
+	void clear();
+
+	//
+	// Compute the values of the sketch columns
+	//
+	void finalize_sketches()
+	{
+		for(auto it = m_columns.begin(); it != m_columns.end(); ++it)
+		{
+			if(it->m_sketch != A_NONE)
+			{
+				it->finalize_sketches();
+			}
+		}
+	}
+
+	sinsp_table_buffer m_buffer;
+	vector<sinsp_table_column> m_columns;
+	uint32_t m_nrows;
+};
+
+//
+// The map from the table keys to the row ids.
+// It uses open addressing with linear probing. Every slot packs the upper
+// half of the key hash, to skip most key comparisons, and the index of the
+// entry, while the entries are kept in insertion order, which is the order
+// in which the map is iterated. Keys are not owned by the map.
+//
+class sinsp_table_map
+{
+public:
+	class entry
+	{
+	public:
+		sinsp_table_field m_key;
+		uint32_t m_row;
+	};
+
+	typedef vector<entry>::iterator iterator;
+
+	sinsp_table_map()
+	{
+		m_fixed_key_len = 0;
+		m_slots.resize(SINSP_TABLE_MAP_INITIAL_SIZE, 0);
+		m_mask = SINSP_TABLE_MAP_INITIAL_SIZE - 1;
+	}
+
+	//
+	// Declare that the keys have the given fixed length, so that they can be
+	// hashed and compared as integers
+	//
+	void set_fixed_key_len(uint32_t len)
+	{
+		m_fixed_key_len = len;
+	}
+
+	inline uint64_t hash(const sinsp_table_field* key)
+	{
+		if(m_fixed_key_len != 0)
+		{
+			return sinsp_table_field_hasher::hash_fixed(key->m_val, m_fixed_key_len);
+		}
+		else
+		{
+			return sinsp_table_field_hasher::hash(key->m_val, key->m_len);
+		}
+	}
+
+	//
+	// Return the entry of the given key, or NULL if the key is not in the map
+	//
+	inline entry* find(const sinsp_table_field* key, uint64_t h)
+	{
+		uint64_t tag = h >> 32;
+		uint64_t pos = h & m_mask;
+
+		while(true)
+		{
+			uint64_t slot = m_slots[pos];
+
+			if(slot == 0)
+			{
+				return NULL;
+			}
+
+			if((slot >> 32) == tag)
+			{
+				entry* e = &m_entries[(slot & 0xffffffff) - 1];
+
+				if(key_equals(&e->m_key, key))
+				{
+					return e;
+				}
+			}
+
+			pos = (pos + 1) & m_mask;
+		}
+	}
+
+	inline entry* find(const sinsp_table_field* key)
+	{
+		return find(key, hash(key));
+	}
+
+	//
+	// Add a key that is not in the map. h is the key hash.
+	//
+	inline void insert(const sinsp_table_field* key, uint32_t row, uint64_t h)
+	{
+		if((m_entries.size() + 1) * 2 > m_slots.size())
+		{
+			grow();
+		}
+
+		entry e;
+		e.m_key = *key;
+		e.m_row = row;
+		m_entries.push_back(e);
+
+		insert_slot(h, (uint32_t)m_entries.size());
+	}
+
+	iterator begin()
+	{
+		return m_entries.begin();
+	}
+
+	iterator end()
+	{
+		return m_entries.end();
+	}
+
+	uint32_t size()
+	{
+		return (uint32_t)m_entries.size();
+	}
+
+	void clear()
+	{
+		if(m_entries.size() != 0)
+		{
+			m_entries.clear();
+			std::fill(m_slots.begin(), m_slots.end(), 0);
+		}
+	}
+
+private:
+	inline bool key_equals(const sinsp_table_field* k1, const sinsp_table_field* k2)
+	{
+		switch(m_fixed_key_len)
+		{
+		case 8:
+			return *(uint64_t*)k1->m_val == *(uint64_t*)k2->m_val;
+		case 4:
+			return *(uint32_t*)k1->m_val == *(uint32_t*)k2->m_val;
+		default:
+			return k1->m_len == k2->m_len && memcmp(k1->m_val, k2->m_val, k1->m_len) == 0;
+		}
+	}
+
+	inline void insert_slot(uint64_t h, uint32_t entry_id)
+	{
+		uint64_t pos = h & m_mask;
+
+		while(m_slots[pos] != 0)
+		{
+			pos = (pos + 1) & m_mask;
+		}
+
+		m_slots[pos] = (h & 0xffffffff00000000ULL) | entry_id;
+	}
+
+	void grow()
+	{
+		m_slots.assign(m_slots.size() * 2, 0);
+		m_mask = m_slots.size() - 1;
+
+		for(uint32_t j = 0; j < m_entries.size(); j++)
+		{
+			insert_slot(hash(&m_entries[j].m_key), j + 1);
+		}
+	}
+
+	vector<entry> m_entries;
+	vector<uint64_t> m_slots;
+	uint64_t m_mask;
+	uint32_t m_fixed_key_len;
+};
+
 class sinsp_sample_row
 {
 public:
@@ -215,6 +680,134 @@ public:
 	vector<sinsp_table_field> m_values;
 };
 
+//
+// A ring with the last samples of a table.
+// Every key is stored once, and the samples reference it by id. The values
+// of every row are encoded as varints: numbers as the difference from the
+// value that the key had in the previous sample, strings and buffers only
+// when they change. The oldest sample is always encoded on its own, so that
+// evicting it only requires to rewrite the next one. Samples are numbered
+// from 1.
+//
+class sinsp_table_history
+{
+public:
+	sinsp_table_history();
+	~sinsp_table_history();
+
+	//
+	// Keep up to size samples, whose values have the given types. This
+	// clears the history.
+	//
+	void configure(uint32_t size, vector<ppm_param_type>* types);
+
+	//
+	// Append a sample, evicting the oldest one if the history is full.
+	// ts is the time of the end of the sample.
+	//
+	void add_sample(vector<sinsp_sample_row>* sample, uint64_t ts);
+
+	//
+	// The sequence numbers of the oldest and of the newest sample, or 0 if
+	// the history is empty
+	//
+	uint64_t get_first_seq()
+	{
+		return (m_samples.size() == 0)? 0 : m_last_seq - m_samples.size() + 1;
+	}
+
+	uint64_t get_last_seq()
+	{
+		return (m_samples.size() == 0)? 0 : m_last_seq;
+	}
+
+	//
+	// Decode a sample into res, and return its time. The rows point to
+	// memory that belongs to the history, and that stays valid until the
+	// next call.
+	//
+	uint64_t get_sample(uint64_t seq, vector<sinsp_sample_row>* res);
+
+	//
+	// For each of the given keys, return the values of column col in the
+	// last nsamples samples up to last_seq, oldest first. The value is 0 in
+	// the samples that don't contain the key. Returns false if the column is
+	// not numeric.
+	//
+	bool get_series(vector<sinsp_table_field*>* keys, uint32_t col, uint64_t last_seq, uint32_t nsamples, vector<vector<double>>* res);
+
+	//
+	// Size of the encoded samples and of the keys, in bytes
+	//
+	uint64_t get_memory_usage();
+
+	void clear();
+
+private:
+	enum column_kind
+	{
+		CK_INTEGER,
+		CK_DOUBLE,
+		CK_BYTES,
+	};
+
+	class encoded_sample
+	{
+	public:
+		uint64_t m_ts;
+		uint32_t m_nrows;
+		vector<uint8_t> m_data;
+	};
+
+	class key_info
+	{
+	public:
+		sinsp_table_field m_key;
+		uint32_t m_refcnt; // Number of samples in the history that contain the key
+	};
+
+	//
+	// The values of every key in the last sample that has been encoded or
+	// decoded, indexed by key id and column
+	//
+	class state
+	{
+	public:
+		void resize(uint32_t nkeys, uint32_t ncols);
+
+		vector<uint64_t> m_seqs; // Per key, the last sample that contained it
+		vector<uint64_t> m_vals;
+		vector<sinsp_table_field> m_refs;
+		vector<string> m_bufs;
+		vector<uint32_t> m_cnts;
+	};
+
+	uint32_t get_key_id(sinsp_table_field* key);
+	void release_key(uint32_t id);
+	void encode(vector<sinsp_sample_row>* rows, vector<uint32_t>* ids, state* st, uint64_t seq, encoded_sample* res);
+	void decode(encoded_sample* sample, uint64_t seq, state* st, vector<sinsp_sample_row>* rows, vector<uint32_t>* ids);
+	void evict();
+
+	uint32_t m_size;
+	uint32_t m_ncols;
+	vector<ppm_param_type> m_types;
+	vector<column_kind> m_kinds;
+	vector<uint32_t> m_lens;
+	deque<encoded_sample> m_samples;
+	uint64_t m_last_seq;
+	unordered_map<sinsp_table_field, uint32_t, sinsp_table_field_hasher> m_key_ids;
+	vector<key_info> m_keys;
+	vector<uint32_t> m_free_ids;
+	state m_encoder;
+	state m_decoder;
+	state m_rebase_state;
+	vector<uint8_t> m_scratch;
+	vector<sinsp_sample_row> m_rows;
+	vector<uint32_t> m_ids;
+	sinsp_table_buffer m_out_buffer;
+	vector<uint64_t> m_out_slots;
+};
+
 class sinsp_table
 {
 public:	
@@ -229,6 +822,10 @@ public:
 	~sinsp_table();
 	void configure(vector<sinsp_view_column_info>* entries, const string& filter, bool use_defaults);
 	void process_event(sinsp_evt* evt);
+	//
+	// Emit the sample, if it's time for it, and start a new one. evt can be
+	// NULL at the end of the capture, to emit the last sample.
+	//
 	void flush(sinsp_evt* evt);
 	void filter_sample();
 	//
@@ -236,6 +833,28 @@ public:
 	//
 	sinsp_table_field* search_in_sample(string text);
 	void sort_sample();
+	//
+	// Only sort the top k rows of the samples. The other rows are sorted
+	// when they are accessed through the table, or when extend_sort() is
+	// called. 0, the default, means that the samples are fully sorted.
+	//
+	void set_topk(uint32_t k)
+	{
+		m_topk = k;
+	}
+	//
+	// When a sample is emitted, add a row for every thread in the thread
+	// table, so that the processes that had no events show up too. Enabled
+	// by default.
+	//
+	void set_include_proctable(bool include_proctable)
+	{
+		m_include_proctable = include_proctable;
+	}
+	//
+	// Make sure that at least the first nrows rows of the sample are sorted
+	//
+	void extend_sort(uint32_t nrows);
 	vector<sinsp_sample_row>* get_sample(uint64_t time_delta);
 	vector<filtercheck_field_info>* get_legend()
 	{
@@ -279,26 +898,52 @@ public:
 	{
 		m_is_sorting_ascending = is_sorting_ascending;
 	}
+	//
+	// Keep the last nsamples samples, so that they can be shown again with
+	// rewind(). 0, the default, disables the history. Must be called after
+	// configure().
+	//
+	void set_history_size(uint32_t nsamples);
+	bool has_history()
+	{
+		return m_history_size != 0;
+	}
+	//
+	// Make get_sample() return the sample that is nsamples older than the
+	// current one, or newer if nsamples is negative. Going past the most
+	// recent sample goes back to the live data. Returns the number of samples
+	// between the returned sample and the most recent one.
+	//
+	uint32_t rewind(int32_t nsamples);
+	uint32_t get_rewind_distance();
+	//
+	// For each of the given keys, the values of column col in the last
+	// nsamples samples up to the one returned by get_sample(), oldest first.
+	// Returns false if there is no history or the column is not numeric.
+	//
+	bool get_history_series(vector<sinsp_table_field*>* keys, uint32_t col, uint32_t nsamples, vector<vector<double>>* res);
 
 	uint64_t m_next_flush_time_ns;
 
 private:
-	inline void add_row(bool merging);
-	inline void add_fields_sum(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_sum_of_avg(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields_max(ppm_param_type type, sinsp_table_field* dst, sinsp_table_field* src);
-	inline void add_fields(uint32_t dst_id, sinsp_table_field* src, uint32_t aggr);
+	inline void add_row();
+	inline void get_premerge_value(const sinsp_table_field* key, uint32_t row, uint32_t col, sinsp_table_field* res);
+	void merge();
 	void process_proctable(sinsp_evt* evt);
 	inline uint32_t get_field_len(uint32_t id);
 	inline uint8_t* get_default_val(filtercheck_field_info* fld);
 	void create_sample();
+	vector<sinsp_sample_row>* get_full_sample();
+	void set_sketch_type(sinsp_field_aggregation aggregation, ppm_param_type* type, filtercheck_field_info* legend);
+	void get_row_cmp(table_row_cmp* cc);
+	void sort_topk(table_row_cmp* cc);
 	void switch_buffers();
 	void stdout_print(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
 
 	sinsp* m_inspector;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher>* m_table;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher> m_premerge_table;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher> m_merge_table;
+	sinsp_table_map* m_table;
+	sinsp_table_map m_premerge_table;
+	sinsp_table_map m_merge_table;
 	vector<filtercheck_field_info> m_premerge_legend;
 	vector<sinsp_filter_check*> m_premerge_extractors;
 	vector<sinsp_filter_check*> m_postmerge_extractors;
@@ -306,6 +951,7 @@ private:
 	vector<sinsp_filter_check*> m_chks_to_free;
 	vector<ppm_param_type>* m_types;
 	vector<ppm_param_type> m_premerge_types;
+	vector<ppm_param_type> m_premerge_input_types; // Before the sketch columns get their result type
 	vector<ppm_param_type> m_postmerge_types;
 	bool m_is_key_present;
 	bool m_is_groupby_key_present;
@@ -317,9 +963,13 @@ private:
 	uint32_t m_n_fields;
 	uint32_t m_n_premerge_fields;
 	uint32_t m_n_postmerge_fields;
-	sinsp_table_buffer* m_buffer;
-	sinsp_table_buffer m_buffer1;
-	sinsp_table_buffer m_buffer2;
+	sinsp_table_storage* m_storage;
+	sinsp_table_storage m_storage1;
+	sinsp_table_storage m_storage2;
+	sinsp_table_storage m_merge_storage;
+	vector<pair<const sinsp_table_field*, uint32_t>> m_merge_src_rows;
+	vector<uint32_t> m_merge_dst_rows;
+	vector<pair<uint32_t, uint32_t>> m_merge_first_rows;
 	uint32_t m_vals_array_sz;
 	uint32_t m_premerge_vals_array_sz;
 	uint32_t m_postmerge_vals_array_sz;
@@ -331,6 +981,11 @@ private:
 	sinsp_table_field* m_vals;
 	int32_t m_sorting_col;
 	bool m_just_sorted;
+	uint32_t m_topk;
+	uint32_t m_n_sorted_rows;
+	vector<uint32_t> m_sort_perm;
+	vector<uint8_t> m_sort_selected;
+	vector<sinsp_sample_row> m_sort_buffer;
 	bool m_is_sorting_ascending;
 	bool m_do_merging;
 	sinsp_filter* m_filter;
@@ -341,6 +996,13 @@ private:
 	string m_freetext_filter;
 	tabletype m_type;
 	bool m_print_to_stdout;
+	bool m_include_proctable;
+	uint32_t m_history_size;
+	sinsp_table_history m_history;
+	uint64_t m_rewind_seq; // 0 when showing live data
+	bool m_rewind_changed;
+	uint64_t m_history_sample_seq;
+	vector<sinsp_sample_row> m_history_sample_data;
 
 	friend class curses_table;	
 	friend class sinsp_cursesui;
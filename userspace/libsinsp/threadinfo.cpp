@@ -99,6 +99,56 @@ sinsp_threadinfo::~sinsp_threadinfo()
 	m_private_state.clear();
 }
 
+//
+// Load the fd table of a process that was imported from /proc with lazy fd
+// loading enabled. The fds are added through sinsp::on_new_entry_from_proc().
+//
+void sinsp_threadinfo::load_fds_from_proc()
+{
+	//
+	// Clear the flag first, so that adding the fds doesn't trigger another load.
+	// If the scan fails, the process has most likely exited and its table stays
+	// empty.
+	//
+	m_flags &= ~PPM_CL_FDS_NOT_LOADED;
+
+#ifdef HAS_CAPTURE
+	if(m_inspector == NULL || m_inspector->m_h == NULL || !m_inspector->is_live())
+	{
+		return;
+	}
+
+	if(scap_proc_scan_fds(m_inspector->m_h, m_pid, true) == SCAP_SUCCESS)
+	{
+		fix_sockets_coming_from_proc();
+	}
+#endif
+}
+
+//
+// Load the fd table of this thread's process if it was not loaded yet.
+// Returns true if the table was loaded. The fds of a process that is exiting
+// are not loaded, since it's not going to use them anymore.
+//
+bool sinsp_threadinfo::load_fds_if_needed()
+{
+	sinsp_threadinfo* root = get_fd_table_root();
+
+	if(root == NULL || !(root->m_flags & PPM_CL_FDS_NOT_LOADED))
+	{
+		return false;
+	}
+
+	if(root->m_flags & PPM_CL_CLOSED)
+	{
+		root->m_flags &= ~PPM_CL_FDS_NOT_LOADED;
+		return false;
+	}
+
+	root->load_fds_from_proc();
+	return true;
+}
+
 void sinsp_threadinfo::fix_sockets_coming_from_proc()
 {
 	unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
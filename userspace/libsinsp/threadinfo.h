@@ -148,7 +148,18 @@ public:
 
 		if(fdt)
 		{
-			return fdt->find(fd);
+			sinsp_fdinfo_t* fdinfo = fdt->find(fd);
+
+			//
+			// If the fds of this process were not loaded from /proc when the
+			// capture started, this is the time to do it
+			//
+			if(fdinfo == NULL && load_fds_if_needed())
+			{
+				fdinfo = fdt->find(fd);
+			}
+
+			return fdinfo;
 		}
 
 		return NULL;
@@ -235,24 +246,33 @@ VISIBILITY_PRIVATE
 	void init();
 	void init(const scap_threadinfo* pi);
 	void fix_sockets_coming_from_proc();
+	void load_fds_from_proc();
+	bool load_fds_if_needed();
 	sinsp_fdinfo_t* add_fd(int64_t fd, sinsp_fdinfo_t *fdinfo);
 	void add_fd(scap_fdinfo *fdinfo);
 	void remove_fd(int64_t fd);
-	inline sinsp_fdtable* get_fd_table()
+	inline sinsp_threadinfo* get_fd_table_root()
 	{
-		sinsp_threadinfo* root;
-
 		if(!(m_flags & PPM_CL_CLONE_FILES))
 		{
-			root = this;
+			return this;
 		}
 		else
 		{
-			root = get_main_thread();
-			if(NULL == root)
-			{
-				return NULL;
-			}
+			return get_main_thread();
+		}
+	}
+	//
+	// Note: this doesn't load the fds of the processes imported with lazy fd
+	// loading, so their table can be empty. Only get_fd() loads them.
+	//
+	inline sinsp_fdtable* get_fd_table()
+	{
+		sinsp_threadinfo* root = get_fd_table_root();
+
+		if(NULL == root)
+		{
+			return NULL;
 		}
 
 		return &(root->m_fdtable);
@@ -0,0 +1,186 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <gtest.h>
+#define VISIBILITY_PRIVATE
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "parsers.h"
+#include "../../driver/ppm_events_public.h"
+
+//
+// Helpers to encode the event parameters like the driver does
+//
+string u32_param(uint32_t val)
+{
+	return string((char*)&val, sizeof(val));
+}
+
+string u64_param(uint64_t val)
+{
+	return string((char*)&val, sizeof(val));
+}
+
+string str_param(const char* val)
+{
+	return string(val, strlen(val) + 1);
+}
+
+//
+// An event built in memory and parsed by the inspector, as if it came from
+// the driver
+//
+class test_event
+{
+public:
+	test_event(sinsp* inspector, uint16_t type, int64_t tid, const vector<string>& params):
+		m_evt(inspector)
+	{
+		uint32_t len = sizeof(scap_evt) + params.size() * sizeof(uint16_t);
+		for(uint32_t j = 0; j < params.size(); j++)
+		{
+			len += params[j].size();
+		}
+
+		m_buf.resize(len);
+		scap_evt* pevt = (scap_evt*)&m_buf[0];
+		pevt->ts = 1;
+		pevt->tid = tid;
+		pevt->len = len;
+		pevt->type = type;
+
+		uint16_t* lens = (uint16_t*)(&m_buf[0] + sizeof(scap_evt));
+		char* data = (char*)(lens + params.size());
+		for(uint32_t j = 0; j < params.size(); j++)
+		{
+			lens[j] = params[j].size();
+			memcpy(data, params[j].data(), params[j].size());
+			data += params[j].size();
+		}
+
+		m_evt.m_pevt = pevt;
+		m_evt.m_cpuid = 0;
+		m_evt.m_evtnum = 1;
+		inspector->m_parser->process_event(&m_evt);
+	}
+
+	vector<char> m_buf;
+	sinsp_evt m_evt;
+};
+
+//
+// Add a process that was found in /proc when a live capture started, with its
+// fds not loaded yet. The inspector is not open, so loading them always gives
+// an empty table.
+//
+sinsp_threadinfo* add_lazy_process(sinsp* inspector, int64_t pid)
+{
+	inspector->m_islive = true;
+
+	sinsp_threadinfo tinfo(inspector);
+	tinfo.m_tid = pid;
+	tinfo.m_pid = pid;
+	tinfo.m_ptid = 1;
+	tinfo.m_comm = "test";
+	tinfo.m_exe = "test";
+	tinfo.m_flags = PPM_CL_FDS_NOT_LOADED;
+	inspector->m_thread_manager->add_thread(tinfo, true);
+	return inspector->get_thread(pid, false, true);
+}
+
+void execve(sinsp* inspector, int64_t pid)
+{
+	vector<string> params;
+	params.push_back(u64_param(0));				// res
+	params.push_back(str_param("/bin/true"));	// exe
+	params.push_back(str_param("arg"));			// args
+	params.push_back(u64_param(pid));			// tid
+	params.push_back(u64_param(pid));			// pid
+	params.push_back(u64_param(1));				// ptid
+	params.push_back(str_param("/"));			// cwd
+	params.push_back(u64_param(1024));			// fdlimit
+	params.push_back(u64_param(0));				// pgft_maj
+	params.push_back(u64_param(0));				// pgft_min
+	params.push_back(u32_param(0));				// vm_size
+	params.push_back(u32_param(0));				// vm_rss
+	params.push_back(u32_param(0));				// vm_swap
+	params.push_back(str_param("true"));		// comm
+	params.push_back(str_param(""));			// cgroups
+	params.push_back(str_param(""));			// env
+
+	test_event(inspector, PPME_SYSCALL_EXECVE_16_X, pid, params);
+}
+
+TEST(lazy_fds,execve_keeps_fds_not_loaded)
+{
+	sinsp inspector;
+	sinsp_threadinfo* tinfo = add_lazy_process(&inspector, 100);
+	ASSERT_TRUE(tinfo != NULL);
+
+	execve(&inspector, 100);
+
+	tinfo = inspector.get_thread(100, false, true);
+	ASSERT_TRUE(tinfo != NULL);
+	EXPECT_EQ("true", tinfo->m_comm);
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_ACTIVE) != 0);
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_FDS_NOT_LOADED) != 0);
+
+	//
+	// The first fd lookup that misses loads the table
+	//
+	EXPECT_TRUE(tinfo->get_fd(3) == NULL);
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_FDS_NOT_LOADED) == 0);
+}
+
+TEST(lazy_fds,fd_table_walk_doesnt_load)
+{
+	sinsp inspector;
+	sinsp_threadinfo* tinfo = add_lazy_process(&inspector, 100);
+	ASSERT_TRUE(tinfo != NULL);
+
+	EXPECT_EQ(0, tinfo->get_fd_table()->size());
+	inspector.m_thread_manager->update_statistics();
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_FDS_NOT_LOADED) != 0);
+
+	//
+	// An fd that was added by an event is found without loading the table
+	//
+	sinsp_fdinfo_t fdinfo;
+	fdinfo.m_name = "/tmp/test";
+	tinfo->add_fd(3, &fdinfo);
+	ASSERT_TRUE(tinfo->get_fd(3) != NULL);
+	EXPECT_EQ("/tmp/test", tinfo->get_fd(3)->m_name);
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_FDS_NOT_LOADED) != 0);
+}
+
+TEST(lazy_fds,exiting_process_doesnt_load)
+{
+	sinsp inspector;
+	sinsp_threadinfo* tinfo = add_lazy_process(&inspector, 100);
+	ASSERT_TRUE(tinfo != NULL);
+
+	vector<string> params;
+	params.push_back(u64_param(0));				// status
+	test_event(&inspector, PPME_PROCEXIT_1_E, 100, params);
+
+	tinfo = inspector.get_thread(100, false, true);
+	ASSERT_TRUE(tinfo != NULL);
+	EXPECT_TRUE((tinfo->m_flags & PPM_CL_CLOSED) != 0);
+	EXPECT_FALSE(tinfo->load_fds_if_needed());
+	EXPECT_TRUE(tinfo->get_fd(3) == NULL);
+}
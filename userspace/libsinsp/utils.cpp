@@ -170,11 +170,11 @@ sinsp_initializer::~sinsp_initializer()
 
 //
 // errno to string conversion.
-// Only the first 40 error codes are currently implemented
+// Returns NULL for the codes that are not known.
 //
-const char* sinsp_utils::errno_to_str(int32_t code)
+static const char* errno_name(uint32_t err)
 {
-	switch(-code)
+	switch(err)
 	{
 	case SE_EPERM:
 		return "EPERM";
@@ -291,9 +291,42 @@ const char* sinsp_utils::errno_to_str(int32_t code)
 	case SE_ENOMEDIUM:
 		return "ENOMEDIUM";
 	default:
-		ASSERT(false);
-		return "";
+		return NULL;
+	}
+}
+
+//
+// Direct lookup table for errno_to_str(), filled from errno_name() the first
+// time it's used. Must be bigger than the largest SE_ code.
+//
+#define ERRNO_TABLE_SIZE 1024
+
+class errno_table
+{
+public:
+	errno_table()
+	{
+		for(uint32_t j = 0; j < ERRNO_TABLE_SIZE; j++)
+		{
+			m_names[j] = errno_name(j);
+		}
+	}
+
+	const char* m_names[ERRNO_TABLE_SIZE];
+};
+
+const char* sinsp_utils::errno_to_str(int32_t code)
+{
+	static const errno_table table;
+	uint64_t err = (uint64_t)(-(int64_t)code);
+
+	if(err < ERRNO_TABLE_SIZE && table.m_names[err] != NULL)
+	{
+		return table.m_names[err];
 	}
+
+	ASSERT(false);
+	return "";
 }
 
 //
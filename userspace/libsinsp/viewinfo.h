@@ -29,6 +29,11 @@ typedef enum sinsp_field_aggregation
 	A_TIME_AVG,
 	A_MIN,
 	A_MAX,		
+	A_DISTINCT,	// Approximate number of distinct values
+	A_P50,		// Approximate percentiles
+	A_P90,
+	A_P95,
+	A_P99,
 }sinsp_field_aggregation;
 
 //
@@ -143,6 +143,27 @@ function pairs_top_by_val(t, num, order)
 	end
 end
 
+--[[
+Convert the rows of a native chisel table (see chisel.set_table()) to the
+key-value format used by print_sorted_table(). The first nkeys columns of each
+row are joined into the key, and the next column is the value.
+]]--
+function table_rows_to_grtable(rows, nkeys)
+	local res = {}
+
+	for i, row in ipairs(rows) do
+		local key = tostring(row[1])
+
+		for j = 2, nkeys do
+			key = key .. "\001\001" .. tostring(row[j])
+		end
+
+		res[key] = row[nkeys + 1]
+	end
+
+	return res
+end
+
 --[[
 Timestamp <-> string conversion
 ]]--
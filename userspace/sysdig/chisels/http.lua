@@ -66,14 +66,9 @@ function parse_response(resp_buffer)
 end
 
 function run_http_parser(evt, on_transaction)
-    buf = evt.field(buffer_field)
-    fd = evt.field(fd_field)
-    pid = evt.field(pid_field)
-    evt_dir = evt.field(dir_field)
+    buf, fd, pid, evt_dir, timestamp = evt.fields(buffer_field, fd_field, pid_field, dir_field, rawtime_field)
     key = string.format("%d\001\001%d", pid, fd)
 
-    timestamp = evt.field(rawtime_field)
-
     transaction = partial_transactions[key]
     if not transaction then
         request = parse_request(buf)
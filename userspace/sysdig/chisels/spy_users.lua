@@ -97,26 +97,17 @@ function on_event()
 	end
 		
 
-	local user = evt.field(fuser)
-	local dtime = evt.field(fdtime)
-	local pid = evt.field(fpid)
-	local ppid = evt.field(fppid)
-	local ischdir = evt.field(fetype) == "chdir"
-	local containername = evt.field(fcontainername)
-	local containerid = evt.field(fcontainerid)
+	local user, dtime, pid, ppid, etype, containername, containerid =
+		evt.fields(fuser, fdtime, fpid, fppid, fetype, fcontainername, fcontainerid)
+	local ischdir = etype == "chdir"
 	local aname
 	local icorr = 1
 
+	-- For chdir, the shell is the process itself, so its ancestors are looked
+	-- up starting one level lower
 	if ischdir then
 		ppid = pid
-		table.insert(fanames, 0, 0)
-		table.insert(fapids, 0, 0)
 		icorr = 0
-	else
-		for j = 0, MAX_ANCESTOR_NAVIGATION do
-			fanames[j] = chisel.request_field("proc.aname[" .. j .. "]")
-			fapids[j] = chisel.request_field("proc.apid[" .. j .. "]")
-		end
 	end
 
 	if user == nil then
@@ -129,15 +120,15 @@ function on_event()
 		process_tree[ppid] = {-1}
 
 		for j = 1, MAX_ANCESTOR_NAVIGATION do
-			aname = evt.field(fanames[j])
+			aname = evt.field(fanames[j - 1 + icorr])
 
 			if aname == nil then
-				if evt.field(fapids[j]) == nil then
+				if evt.field(fapids[j - 1 + icorr]) == nil then
 					-- no shell in the ancestor list, hide this command
 					break
 				end
 			elseif string.len(aname) >= 2 and aname:sub(-2) == "sh" then
-				apid = evt.field(fapids[j])
+				apid = evt.field(fapids[j - 1 + icorr])
 				if process_tree[apid] then
 					process_tree[ppid] = {j - 1, apid}
 				else
@@ -195,6 +186,8 @@ function on_event()
 			end
 		end
 
+		local exe, args = evt.fields(fexe, fargs)
+
 		-- The -pc or -pcontainer options was supplied on the cmd line
 		if  print_container then
 
@@ -208,16 +201,16 @@ function on_event()
 				  dtime .. " " ..
 				  user .. "@" ..
 				  containername ..") " ..
-				  evt.field(fexe) .. " " ..
-				  evt.field(fargs))
+				  exe .. " " ..
+				  args)
 		else
 
 			print(color ..
 				  extend_string("", 3 * (process_tree[pid][1] - 1)) .. process_tree[pid][2] .. " " ..
 				  dtime .. " " ..
 				  user ..") " ..
-				  evt.field(fexe) .. " " ..
-				  evt.field(fargs))
+				  exe .. " " ..
+				  args)
 
 		end
 
@@ -121,6 +121,36 @@ function on_init()
 
 	fvalue = chisel.request_field(vizinfo.value_fld)
 
+	-- With a single key, the table is aggregated natively and on_event() is
+	-- not needed
+	if #vizinfo.key_fld == 1 then
+		local tfilter = vizinfo.value_fld .. " > 0"
+
+		if filter ~= "" then
+			tfilter = "(" .. filter .. ") and " .. tfilter
+		end
+
+		chisel.set_table({
+			filter = tfilter,
+			top_number = vizinfo.top_number,
+			columns =
+			{
+				{
+					field = vizinfo.key_fld[1],
+					is_key = true
+				},
+				{
+					field = vizinfo.value_fld,
+					aggregation = "SUM",
+					is_sorting = true
+				}
+			}
+		})
+
+		on_event = nil
+		return true
+	end
+
 	-- set the filter
 	if filter ~= "" then
 		chisel.set_filter(filter)
@@ -179,7 +209,11 @@ function on_event()
 end
 
 -- Periodic timeout callback
-function on_interval(ts_s, ts_ns, delta)	
+function on_interval(ts_s, ts_ns, delta, rows)
+	if rows ~= nil then
+		grtable = table_rows_to_grtable(rows, 1)
+	end
+
 	if vizinfo.output_format ~= "json" then
 		terminal.clearscreen()
 		terminal.moveto(0, 0)
@@ -194,13 +228,17 @@ function on_interval(ts_s, ts_ns, delta)
 end
 
 -- Called by the engine at the end of the capture (Ctrl-C)
-function on_capture_end(ts_s, ts_ns, delta)
+function on_capture_end(ts_s, ts_ns, delta, rows)
 	if islive and vizinfo.output_format ~= "json" then
 		terminal.clearscreen()
 		terminal.moveto(0 ,0)
 		terminal.showcursor()
 		return true
 	end
+
+	if rows ~= nil then
+		grtable = table_rows_to_grtable(rows, 1)
+	end
 	
 	print_sorted_table(grtable, ts_s, 0, delta, vizinfo)
 	
@@ -66,6 +66,12 @@ static void usage()
 "csysdig version " SYSDIG_VERSION "\n"
 "Usage: csysdig [options] [filter]\n\n"
 "Options:\n"
+" --concurrent-views=<view_ids>\n"
+"                    Keep the given views (a comma separated list of view IDs,\n"
+"                    or 'all' for all the table views) aggregating in the\n"
+"                    background, so that switching to them shows their data\n"
+"                    immediately instead of restarting from an empty table.\n"
+"                    Each view costs CPU and memory for every event.\n"
 " -d <period>, --delay=<period>\n"
 "                    Set the delay between updates, in milliseconds. This works\n"
 "                    similarly to the -d option in top.\n"
@@ -92,6 +98,13 @@ static void usage()
 "                    Read the events from <readfile>.\n"
 " --raw              Print raw output on a regular terminal instead of enabling\n"
 "                    ncurses-based ANSI output.\n"
+" --render-benchmark[=full]\n"
+"                    Render every sample of the trace file given with -r without\n"
+"                    showing it, and print how many bytes each screen refresh\n"
+"                    sends to the terminal. With 'full', the table is fully\n"
+"                    repainted on every refresh instead of only updating the\n"
+"                    cells that changed. The screen size is taken from the\n"
+"                    LINES and COLUMNS environment variables.\n"
 " -s <len>, --snaplen=<len>\n"
 "                    Capture the first <len> bytes of each I/O buffer.\n"
 "                    By default, the first 80 bytes are captured. Use this\n"
@@ -217,9 +230,15 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 	uint64_t refresh_interval_ns = 2000000000;
 	bool list_flds = false;
 	bool m_raw_output = false;
+	string concurrent_views;
+	bool render_benchmark = false;
+	bool render_benchmark_incremental = true;
+	FILE* render_benchmark_out = NULL;
+	FILE* render_benchmark_in = NULL;
 
 	static struct option long_options[] =
 	{
+		{"concurrent-views", required_argument, 0, 0 },
 		{"delay", required_argument, 0, 'd' },
 		{"exclude-users", no_argument, 0, 'E' },
 		{"help", no_argument, 0, 'h' },
@@ -228,6 +247,7 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 		{"print", required_argument, 0, 'p' },
 		{"readfile", required_argument, 0, 'r' },
 		{"raw", no_argument, 0, 0 },
+		{"render-benchmark", optional_argument, 0, 0 },
 		{"snaplen", required_argument, 0, 's' },
 		{"logfile", required_argument, 0, 0 },
 		{"view", required_argument, 0, 'v' },
@@ -342,6 +362,24 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 					{
 						m_raw_output = true;
 					}
+					else if(optname == "concurrent-views")
+					{
+						concurrent_views = optarg;
+					}
+					else if(optname == "render-benchmark")
+					{
+						render_benchmark = true;
+
+						if(optarg != NULL)
+						{
+							if(string(optarg) != "full")
+							{
+								throw sinsp_exception(string("invalid --render-benchmark argument ") + optarg);
+							}
+
+							render_benchmark_incremental = false;
+						}
+					}
 				}
 				break;
 			default:
@@ -397,13 +435,39 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 			goto exit;
 		}
 
+		if(render_benchmark && (m_raw_output || infiles.size() == 0))
+		{
+			throw sinsp_exception("--render-benchmark requires a trace file and can't be used with --raw");
+		}
+
 		//
 		// Initialize ncurses
 		//
 #ifndef NOCURSESUI
 		if(!m_raw_output)
 		{
-			(void) initscr();      // initialize the curses library
+			if(render_benchmark)
+			{
+				//
+				// Headless screen, whose output goes to a temporary file that
+				// the UI measures after every refresh
+				//
+				const char* term = getenv("TERM");
+
+				render_benchmark_out = tmpfile();
+				render_benchmark_in = fopen("/dev/null", "r");
+
+				if(render_benchmark_out == NULL || render_benchmark_in == NULL ||
+					newterm((char*)((term != NULL)? term : "xterm"), render_benchmark_out, render_benchmark_in) == NULL)
+				{
+					throw sinsp_exception("can't initialize the render benchmark screen");
+				}
+			}
+			else
+			{
+				(void) initscr();      // initialize the curses library
+			}
+
 			(void) nonl();         // tell curses not to do NL->CR/NL on output
 			intrflush(stdscr, false);
 			keypad(stdscr, true);
@@ -480,6 +544,19 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 				m_raw_output);
 
 			ui.configure(&view_manager);
+
+			if(concurrent_views != "")
+			{
+				ui.set_concurrent_views(concurrent_views);
+			}
+
+#ifndef NOCURSESUI
+			if(render_benchmark)
+			{
+				ui.set_render_benchmark(render_benchmark_out, render_benchmark_incremental);
+			}
+#endif
+
 			ui.start(false, false);
 
 			//
@@ -558,6 +635,13 @@ sysdig_init_res csysdig_init(int argc, char **argv)
 				cnt,
 				&ui);
 
+#ifndef NOCURSESUI
+			if(render_benchmark)
+			{
+				ui.print_render_benchmark();
+			}
+#endif
+
 			//
 			// Done. Close the capture.
 			//
@@ -592,6 +676,16 @@ exit:
 	{
 		endwin();
 	}
+
+	if(render_benchmark_out != NULL)
+	{
+		fclose(render_benchmark_out);
+	}
+
+	if(render_benchmark_in != NULL)
+	{
+		fclose(render_benchmark_in);
+	}
 #endif
 
 	if(errorstr != "")
@@ -0,0 +1,196 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include <sinsp.h>
+#include "output_sink.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+output_sink::output_sink(int fd, uint32_t bufsize)
+{
+	m_fd = fd;
+	m_bufsize = bufsize;
+	m_buf = new char[bufsize];
+	m_len = 0;
+	m_max_delay_ns = DEFAULT_MAX_DELAY_MS * 1000000;
+	m_last_flush_ns = now_ns();
+	m_nrecords = 0;
+	m_error = false;
+
+#ifdef _WIN32
+	m_policy = _isatty(fd) ? FP_LINE : FP_FULL;
+#else
+	m_policy = isatty(fd) ? FP_LINE : FP_FULL;
+#endif
+}
+
+output_sink::~output_sink()
+{
+	flush();
+	delete[] m_buf;
+}
+
+void output_sink::set_flush_policy(flush_policy policy)
+{
+	m_policy = policy;
+	flush();
+}
+
+uint64_t output_sink::now_ns()
+{
+#ifdef _WIN32
+	return (uint64_t)GetTickCount64() * 1000000;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+bool output_sink::write_all(const char* data, uint32_t len)
+{
+	while(len > 0)
+	{
+#ifdef _WIN32
+		int res = _write(m_fd, data, len);
+#else
+		ssize_t res = ::write(m_fd, data, len);
+#endif
+		if(res < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			return false;
+		}
+
+		data += res;
+		len -= (uint32_t)res;
+	}
+
+	return true;
+}
+
+void output_sink::flush()
+{
+	if(m_len != 0 && !m_error)
+	{
+		m_error = !write_all(m_buf, m_len);
+	}
+
+	m_len = 0;
+	m_last_flush_ns = now_ns();
+}
+
+void output_sink::on_idle()
+{
+	if(m_len != 0 && now_ns() - m_last_flush_ns >= m_max_delay_ns)
+	{
+		flush();
+	}
+}
+
+void output_sink::write_slow(const char* data, uint32_t len, const char* sep, uint32_t seplen)
+{
+	if(len + seplen <= m_bufsize)
+	{
+		//
+		// The record fits in the buffer, but not in what's left of it
+		//
+		flush();
+		memcpy(m_buf, data, len);
+		memcpy(m_buf + len, sep, seplen);
+		m_len = len + seplen;
+		return;
+	}
+
+	//
+	// The record is bigger than the whole buffer. Write it directly
+	// instead of copying it.
+	//
+	if(m_error)
+	{
+		m_len = 0;
+		return;
+	}
+
+#ifdef _WIN32
+	m_error = !write_all(m_buf, m_len) ||
+		!write_all(data, len) ||
+		!write_all(sep, seplen);
+#else
+	struct iovec iov[3];
+	int iovcnt = 3;
+	struct iovec* cur = iov;
+
+	iov[0].iov_base = m_buf;
+	iov[0].iov_len = m_len;
+	iov[1].iov_base = (void*)data;
+	iov[1].iov_len = len;
+	iov[2].iov_base = (void*)sep;
+	iov[2].iov_len = seplen;
+
+	while(iovcnt > 0)
+	{
+		ssize_t res = writev(m_fd, cur, iovcnt);
+
+		if(res < 0)
+		{
+			if(errno == EINTR)
+			{
+				continue;
+			}
+
+			m_error = true;
+			break;
+		}
+
+		//
+		// Skip what has been written, partial writes are possible on pipes
+		//
+		while(iovcnt > 0 && (size_t)res >= cur->iov_len)
+		{
+			res -= cur->iov_len;
+			cur++;
+			iovcnt--;
+		}
+
+		if(iovcnt > 0)
+		{
+			cur->iov_base = (char*)cur->iov_base + res;
+			cur->iov_len -= res;
+		}
+	}
+#endif
+
+	m_len = 0;
+	m_last_flush_ns = now_ns();
+}
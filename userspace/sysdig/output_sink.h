@@ -0,0 +1,110 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+//
+// Buffered writer for the event output.
+// Records are accumulated in a large buffer that is written with a single
+// system call when it fills up, when the oldest buffered record is older
+// than the maximum delay, or after every record when line buffering is on.
+//
+class output_sink
+{
+public:
+	enum flush_policy
+	{
+		FP_LINE,	// Flush after every record. The default for terminals.
+		FP_FULL,	// Flush when the buffer is full or the max delay expires.
+	};
+
+	output_sink(int fd, uint32_t bufsize = DEFAULT_BUFFER_SIZE);
+	~output_sink();
+
+	void set_flush_policy(flush_policy policy);
+	flush_policy get_flush_policy()
+	{
+		return m_policy;
+	}
+	void set_max_delay_ms(uint64_t max_delay_ms)
+	{
+		m_max_delay_ns = max_delay_ms * 1000000;
+	}
+
+	//
+	// Add a record to the output. sep is appended to the record
+	// (e.g. a newline), and can be empty.
+	//
+	inline void write(const string& record, const char* sep, uint32_t seplen)
+	{
+		uint32_t len = (uint32_t)record.size();
+
+		if(m_len + len + seplen > m_bufsize)
+		{
+			write_slow(record.c_str(), len, sep, seplen);
+		}
+		else
+		{
+			memcpy(m_buf + m_len, record.c_str(), len);
+			memcpy(m_buf + m_len + len, sep, seplen);
+			m_len += len + seplen;
+		}
+
+		end_record();
+	}
+
+	//
+	// Give the sink a chance to honor the max delay when no records come in,
+	// e.g. on capture timeouts.
+	//
+	void on_idle();
+	void flush();
+
+	static const uint32_t DEFAULT_BUFFER_SIZE = 256 * 1024;
+	static const uint64_t DEFAULT_MAX_DELAY_MS = 100;
+
+private:
+	inline void end_record()
+	{
+		if(m_policy == FP_LINE)
+		{
+			flush();
+		}
+		else if((++m_nrecords & (TIME_CHECK_INTERVAL - 1)) == 0)
+		{
+			on_idle();
+		}
+	}
+
+	void write_slow(const char* data, uint32_t len, const char* sep, uint32_t seplen);
+	bool write_all(const char* data, uint32_t len);
+	uint64_t now_ns();
+
+	// Number of records between two checks of the max delay
+	static const uint32_t TIME_CHECK_INTERVAL = 256;
+
+	int m_fd;
+	char* m_buf;
+	uint32_t m_bufsize;
+	uint32_t m_len;
+	flush_policy m_policy;
+	uint64_t m_max_delay_ns;
+	uint64_t m_last_flush_ns;
+	uint64_t m_nrecords;
+	bool m_error;
+};
@@ -0,0 +1,430 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+
+#include <sinsp.h>
+#include "summary.h"
+
+//
+// What we keep in the thread info of every thread
+//
+struct summary_thread_state
+{
+	uint32_t m_proc_slot; // The slot of the thread's process in m_procs, plus one
+	uint16_t m_pending_exit_type; // Exit type matching the last enter event, 0 if none
+};
+
+struct summary_event_rsort_comparer
+{
+	summary_event_rsort_comparer(const vector<summary_table_entry>* events)
+	{
+		m_events = events;
+	}
+
+	bool operator() (uint32_t first, uint32_t second) const
+	{
+		return (*m_events)[first].m_ncalls > (*m_events)[second].m_ncalls;
+	}
+
+	const vector<summary_table_entry>* m_events;
+};
+
+struct summary_proc_rsort_comparer
+{
+	summary_proc_rsort_comparer(const vector<summary_proc_entry>* procs)
+	{
+		m_procs = procs;
+	}
+
+	bool operator() (uint32_t first, uint32_t second) const
+	{
+		return (*m_procs)[first].m_nevts > (*m_procs)[second].m_nevts;
+	}
+
+	const vector<summary_proc_entry>* m_procs;
+};
+
+static inline uint32_t latency_bucket(uint64_t latency)
+{
+	uint32_t res = 0;
+
+	while(latency != 0 && res < SUMMARY_LATENCY_BUCKETS - 1)
+	{
+		latency >>= 1;
+		res++;
+	}
+
+	return res;
+}
+
+//
+// Return the upper bound of the bucket that contains the given percentile
+//
+static uint64_t latency_percentile(const summary_table_entry* e, uint64_t nsamples, double pct)
+{
+	uint64_t target = (uint64_t)(nsamples * pct / 100);
+	uint64_t cnt = 0;
+	uint32_t j;
+
+	for(j = 0; j < SUMMARY_LATENCY_BUCKETS - 1; j++)
+	{
+		cnt += e->m_latency_hist[j];
+
+		if(cnt > target)
+		{
+			break;
+		}
+	}
+
+	return ((uint64_t)1) << j;
+}
+
+static string format_latency(uint64_t ns)
+{
+	char buf[32];
+
+	if(ns < 1000)
+	{
+		snprintf(buf, sizeof(buf), "%" PRIu64 "ns", ns);
+	}
+	else if(ns < 1000000)
+	{
+		snprintf(buf, sizeof(buf), "%.1lfus", (double)ns / 1000);
+	}
+	else if(ns < ONE_SECOND_IN_NS)
+	{
+		snprintf(buf, sizeof(buf), "%.1lfms", (double)ns / 1000000);
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "%.1lfs", (double)ns / ONE_SECOND_IN_NS);
+	}
+
+	return buf;
+}
+
+summary_stats::summary_stats(sinsp* inspector)
+{
+	m_inspector = inspector;
+
+	//
+	// The syscalls without a dedicated event type go after the event types,
+	// with separate entries for enter and exit
+	//
+	summary_table_entry empty;
+	memset(&empty, 0, sizeof(empty));
+	m_events.resize(PPM_EVENT_MAX + PPM_SC_MAX * 2, empty);
+
+	m_th_state_id = inspector->reserve_thread_memory(sizeof(summary_thread_state));
+}
+
+summary_proc_entry* summary_stats::get_proc_entry(sinsp_threadinfo* tinfo)
+{
+	summary_thread_state* ts = (summary_thread_state*)tinfo->get_private_state(m_th_state_id);
+
+	if(ts->m_proc_slot == 0)
+	{
+		//
+		// First event of this thread. Find the slot of its process, or
+		// create it.
+		//
+		unordered_map<int64_t, uint32_t>::iterator it = m_proc_slots.find(tinfo->m_pid);
+
+		if(it != m_proc_slots.end())
+		{
+			ts->m_proc_slot = it->second + 1;
+		}
+		else
+		{
+			summary_proc_entry pe;
+			pe.m_pid = tinfo->m_pid;
+			pe.m_comm = tinfo->m_comm;
+			pe.m_nevts = 0;
+			pe.m_nerrors = 0;
+			pe.m_bytes = 0;
+			pe.m_time_ns = 0;
+
+			m_proc_slots[tinfo->m_pid] = (uint32_t)m_procs.size();
+			m_procs.push_back(pe);
+			ts->m_proc_slot = (uint32_t)m_procs.size();
+		}
+	}
+
+	return &m_procs[ts->m_proc_slot - 1];
+}
+
+void summary_stats::process_event(sinsp_evt* evt)
+{
+	uint16_t etype = evt->get_type();
+	uint32_t id = etype;
+
+	if(etype == PPME_GENERIC_E || etype == PPME_GENERIC_X)
+	{
+		sinsp_evt_param *parinfo = evt->get_param(0);
+		uint16_t scid = *(int16_t *)parinfo->m_val;
+		id = PPM_EVENT_MAX + scid * 2 + (PPME_IS_ENTER(etype)? 0 : 1);
+	}
+
+	summary_table_entry* e = &m_events[id];
+	e->m_ncalls++;
+
+	uint16_t cpuid = (uint16_t)evt->get_cpuid();
+
+	if(cpuid >= m_cpus.size())
+	{
+		summary_cpu_entry empty;
+		memset(&empty, 0, sizeof(empty));
+		m_cpus.resize(cpuid + 1, empty);
+	}
+
+	summary_cpu_entry* ce = &m_cpus[cpuid];
+	ce->m_nevts++;
+
+	sinsp_threadinfo* tinfo = evt->get_thread_info();
+	summary_thread_state* ts = NULL;
+	summary_proc_entry* pe = NULL;
+
+	if(tinfo != NULL)
+	{
+		pe = get_proc_entry(tinfo);
+		pe->m_nevts++;
+		ts = (summary_thread_state*)tinfo->get_private_state(m_th_state_id);
+	}
+
+	if(PPME_IS_ENTER(etype))
+	{
+		if(ts != NULL)
+		{
+			ts->m_pending_exit_type = etype + 1;
+		}
+
+		return;
+	}
+
+	//
+	// Exit event: account errors, bytes and latency
+	//
+	if(evt->get_errorcode() != 0)
+	{
+		e->m_nerrors++;
+		ce->m_nerrors++;
+
+		if(pe != NULL)
+		{
+			pe->m_nerrors++;
+		}
+	}
+	else if((evt->get_flags() & (EF_READS_FROM_FD | EF_WRITES_TO_FD)) &&
+		evt->get_num_params() != 0 &&
+		evt->get_param_info(0)->type == PT_ERRNO)
+	{
+		sinsp_evt_param *parinfo = evt->get_param(0);
+		int64_t res = *(int64_t *)parinfo->m_val;
+
+		if(res > 0)
+		{
+			e->m_bytes += res;
+			ce->m_bytes += res;
+
+			if(pe != NULL)
+			{
+				pe->m_bytes += res;
+			}
+		}
+	}
+
+	if(pe != NULL)
+	{
+		//
+		// Only trust the latency if the exit matches the last enter event of
+		// the thread, i.e. the enter event was not dropped
+		//
+		if(etype == ts->m_pending_exit_type)
+		{
+			ts->m_pending_exit_type = 0;
+
+#ifdef HAS_FILTERING
+			uint64_t latency = tinfo->m_latency;
+
+			e->m_time_ns += latency;
+			e->m_latency_hist[latency_bucket(latency)]++;
+			ce->m_time_ns += latency;
+			pe->m_time_ns += latency;
+#endif
+		}
+
+		//
+		// execve changes the process name
+		//
+		if(evt->get_category() & EC_PROCESS)
+		{
+			if(pe->m_comm != tinfo->m_comm)
+			{
+				pe->m_comm = tinfo->m_comm;
+			}
+		}
+	}
+}
+
+void summary_stats::print_events(uint32_t nentries)
+{
+	sinsp_evttables* einfo = m_inspector->get_event_info_tables();
+	vector<uint32_t> ids;
+	uint32_t j;
+
+	for(j = 0; j < m_events.size(); j++)
+	{
+		if(m_events[j].m_ncalls != 0)
+		{
+			ids.push_back(j);
+		}
+	}
+
+	nentries = min(nentries, (uint32_t)ids.size());
+	partial_sort(ids.begin(), ids.begin() + nentries, ids.end(),
+		summary_event_rsort_comparer(&m_events));
+
+	printf("----------------------------------------------------------------------------------------------\n");
+	printf("%-18s%12s%10s%14s%12s%10s%10s%10s\n",
+		"Event", "#Calls", "#Errors", "Bytes", "Time(ms)", "AvgLat", "p50", "p99");
+	printf("----------------------------------------------------------------------------------------------\n");
+
+	for(j = 0; j < nentries; j++)
+	{
+		uint32_t id = ids[j];
+		summary_table_entry* e = &m_events[id];
+		const char* name;
+		bool is_enter;
+
+		if(id >= PPM_EVENT_MAX)
+		{
+			uint32_t scid = id - PPM_EVENT_MAX;
+
+			name = einfo->m_syscall_info_table[scid / 2].name;
+			is_enter = PPME_IS_ENTER(scid);
+		}
+		else
+		{
+			name = einfo->m_event_info[id].name;
+			is_enter = PPME_IS_ENTER(id);
+		}
+
+		if(is_enter)
+		{
+			printf("> %-16s%12" PRIu64 "\n", name, e->m_ncalls);
+			continue;
+		}
+
+		uint64_t nsamples = 0;
+
+		for(uint32_t k = 0; k < SUMMARY_LATENCY_BUCKETS; k++)
+		{
+			nsamples += e->m_latency_hist[k];
+		}
+
+		if(nsamples == 0)
+		{
+			printf("< %-16s%12" PRIu64 "%10" PRIu64 "%14" PRIu64 "\n",
+				name, e->m_ncalls, e->m_nerrors, e->m_bytes);
+			continue;
+		}
+
+		printf("< %-16s%12" PRIu64 "%10" PRIu64 "%14" PRIu64 "%12.3lf%10s%10s%10s\n",
+			name,
+			e->m_ncalls,
+			e->m_nerrors,
+			e->m_bytes,
+			(double)e->m_time_ns / 1000000,
+			format_latency(e->m_time_ns / nsamples).c_str(),
+			format_latency(latency_percentile(e, nsamples, 50)).c_str(),
+			format_latency(latency_percentile(e, nsamples, 99)).c_str());
+	}
+}
+
+void summary_stats::print_cpus()
+{
+	printf("\n------------------------------------------------------------\n");
+	printf("%-8s%14s%12s%14s%12s\n", "CPU", "#Events", "#Errors", "Bytes", "Time(ms)");
+	printf("------------------------------------------------------------\n");
+
+	for(uint32_t j = 0; j < m_cpus.size(); j++)
+	{
+		summary_cpu_entry* ce = &m_cpus[j];
+
+		if(ce->m_nevts == 0)
+		{
+			continue;
+		}
+
+		printf("%-8u%14" PRIu64 "%12" PRIu64 "%14" PRIu64 "%12.3lf\n",
+			j,
+			ce->m_nevts,
+			ce->m_nerrors,
+			ce->m_bytes,
+			(double)ce->m_time_ns / 1000000);
+	}
+}
+
+void summary_stats::print_procs(uint32_t nentries)
+{
+	vector<uint32_t> ids;
+	uint32_t j;
+
+	for(j = 0; j < m_procs.size(); j++)
+	{
+		ids.push_back(j);
+	}
+
+	nentries = min(nentries, (uint32_t)ids.size());
+
+	if(nentries == 0)
+	{
+		return;
+	}
+
+	partial_sort(ids.begin(), ids.begin() + nentries, ids.end(),
+		summary_proc_rsort_comparer(&m_procs));
+
+	printf("\n--------------------------------------------------------------------------\n");
+	printf("%-22s%14s%12s%14s%12s\n", "Process", "#Events", "#Errors", "Bytes", "Time(ms)");
+	printf("--------------------------------------------------------------------------\n");
+
+	for(j = 0; j < nentries; j++)
+	{
+		summary_proc_entry* pe = &m_procs[ids[j]];
+		char name[64];
+
+		snprintf(name, sizeof(name), "%s (%" PRId64 ")", pe->m_comm.c_str(), pe->m_pid);
+
+		printf("%-22s%14" PRIu64 "%12" PRIu64 "%14" PRIu64 "%12.3lf\n",
+			name,
+			pe->m_nevts,
+			pe->m_nerrors,
+			pe->m_bytes,
+			(double)pe->m_time_ns / 1000000);
+	}
+}
+
+void summary_stats::print(uint32_t nevents, uint32_t nprocs)
+{
+	print_events(nevents);
+	print_cpus();
+	print_procs(nprocs);
+}
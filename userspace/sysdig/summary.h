@@ -0,0 +1,104 @@
+/*
+Copyright (C) 2013-2014 Draios inc.
+
+This file is part of sysdig.
+
+sysdig is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 2 as
+published by the Free Software Foundation.
+
+sysdig is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+//
+// Number of buckets of the latency histograms. Bucket n counts the calls
+// that took less than 2^n nanoseconds, the last one also counts all the
+// slower ones.
+//
+#define SUMMARY_LATENCY_BUCKETS 36
+
+//
+// Number of events and processes printed in the summary
+//
+#define SUMMARY_NEVENTS 100
+#define SUMMARY_NPROCS 20
+
+class summary_table_entry
+{
+public:
+	uint64_t m_ncalls;
+	uint64_t m_nerrors;
+	uint64_t m_bytes;
+	uint64_t m_time_ns;
+	uint64_t m_latency_hist[SUMMARY_LATENCY_BUCKETS];
+};
+
+class summary_cpu_entry
+{
+public:
+	uint64_t m_nevts;
+	uint64_t m_nerrors;
+	uint64_t m_bytes;
+	uint64_t m_time_ns;
+};
+
+class summary_proc_entry
+{
+public:
+	int64_t m_pid;
+	string m_comm;
+	uint64_t m_nevts;
+	uint64_t m_nerrors;
+	uint64_t m_bytes;
+	uint64_t m_time_ns;
+};
+
+//
+// The engine behind -S. For every event type it counts the calls, the
+// failures, the bytes moved by I/O calls and the time spent in the call,
+// with a histogram of the enter to exit latency. The same counters are also
+// kept per CPU and per process.
+// Everything is stored in flat arrays: events are indexed by type (with the
+// syscalls that don't have a dedicated event type after PPM_EVENT_MAX),
+// CPUs by id, and processes by a slot that is cached in the thread info, so
+// that accounting an event costs a few increments and no lookups.
+//
+class summary_stats
+{
+public:
+	//
+	// Must be created before the capture is opened, because it stores
+	// state in the thread table.
+	//
+	summary_stats(sinsp* inspector);
+
+	void process_event(sinsp_evt* evt);
+
+	//
+	// Print the top nevents events, the per-CPU counters and the top nprocs
+	// processes. The counters are not reset, so this can be called
+	// periodically.
+	//
+	void print(uint32_t nevents, uint32_t nprocs);
+
+private:
+	summary_proc_entry* get_proc_entry(sinsp_threadinfo* tinfo);
+	void print_events(uint32_t nentries);
+	void print_cpus();
+	void print_procs(uint32_t nentries);
+
+	sinsp* m_inspector;
+	vector<summary_table_entry> m_events;
+	vector<summary_cpu_entry> m_cpus;
+	vector<summary_proc_entry> m_procs;
+	unordered_map<int64_t, uint32_t> m_proc_slots;
+	uint32_t m_th_state_id;
+};
@@ -31,6 +31,8 @@ along with sysdig.  If not, see <http://www.gnu.org/licenses/>.
 #include "chisel.h"
 #include "sysdig.h"
 #include "utils.h"
+#include "output_sink.h"
+#include "summary.h"
 
 #ifdef _WIN32
 #include "win32/getopt.h"
@@ -70,6 +72,11 @@ static void usage()
 " -b, --print-base64 Print data buffers in base64. This is useful for encoding\n"
 "                    binary data that needs to be used over media designed to\n"
 "                    handle textual data (i.e., terminal or json).\n"
+" --binary           Emit output as binary records, for programs that consume\n"
+"                    sysdig output. The fields of the -p format are written\n"
+"                    in their native encoding, after a header that describes\n"
+"                    them. Refer to the sinsp_evt_formatter documentation for\n"
+"                    the details.\n"
 #ifdef HAS_CHISELS
 " -c <chiselname> <chiselargs>, --chisel  <chiselname> <chiselargs>\n"
 "                    run the specified chisel. If the chisel require arguments,\n"
@@ -132,6 +139,13 @@ static void usage()
 " -j, --json         Emit output as json, data buffer encoding will depend from the\n"
 "                    print format selected.\n"
 " -L, --list-events  List the events that the engine supports\n"
+" --lazy-fds         Don't scan the file descriptors of the processes that are\n"
+"                    running when a live capture starts. The fd table of each\n"
+"                    process is loaded the first time one of its events is seen.\n"
+"                    This reduces startup time on machines with many processes\n"
+"                    or open files, at the cost of possibly misdetecting the\n"
+"                    client/server side of connections opened before sysdig\n"
+"                    started.\n"
 " -l, --list         List the fields that can be used for filtering and output\n"
 "                    formatting. Use -lv to get additional information for each\n"
 "                    field.\n"
@@ -146,8 +160,15 @@ static void usage()
 "                    Useful when dumping to disk.\n"
 " -r <readfile>, --read=<readfile>\n"
 "                    Read the events from <readfile>.\n"
-" -S, --summary      print the event summary (i.e. the list of the top events)\n"
-"                    when the capture ends.\n"
+" -S, --summary      print the event summary when the capture ends: the top\n"
+"                    events with their number of calls, errors, bytes moved\n"
+"                    and enter to exit latency (average, 50th and 99th\n"
+"                    percentiles, approximated to the next power of two),\n"
+"                    followed by the same counters per CPU and for the top\n"
+"                    processes.\n"
+" --summary-interval=<secs>\n"
+"                    Implies -S. Also print the summary of the events seen so\n"
+"                    far every <secs> seconds while capturing.\n"
 " -s <len>, --snaplen=<len>\n"
 "                    Capture the first <len> bytes of each I/O buffer.\n"
 "                    By default, the first 80 bytes are captured. Use this\n"
@@ -158,6 +179,10 @@ static void usage()
 "                    epoch, r for relative time from the beginning of the\n"
 "                    capture, d for delta between event enter and exit, and\n"
 "                    D for delta from the previous event.\n"
+" --unbuffered       Write every event to standard output as soon as it's\n"
+"                    formatted. By default this only happens when the output\n"
+"                    is a terminal; otherwise events are written in large\n"
+"                    batches, at most 100ms apart.\n"
 " -v, --verbose      Verbose output.\n"
 "                    This flag will cause the full content of text and binary\n"
 "                    buffers to be printed on screen, instead of being truncated\n"
@@ -181,6 +206,16 @@ static void usage()
 " -X, --print-hex-ascii\n"
 "                    Print data buffers in hex and ASCII.\n"
 " -z, --compress     Used with -w, enables compression for tracefiles.\n"
+" --compression=<gzip|events|lz>\n"
+"                    Used with -w, enables compression for tracefiles and selects\n"
+"                    the format. 'gzip' (the default with -z) compresses the\n"
+"                    whole file. 'events' encodes the events with a codec that\n"
+"                    exploits the structure of syscall streams before gzipping\n"
+"                    them, producing smaller files that are faster to read.\n"
+"                    'lz' uses a fast LZ77 compressor, which keeps up with\n"
+"                    much higher event rates than gzip at the cost of larger\n"
+"                    files. 'events' and 'lz' files can't be read by older\n"
+"                    versions of sysdig.\n"
 "\n"
 "Output format:\n\n"
 "By default, sysdig prints the information for each captured event on a single\n"
@@ -214,54 +249,6 @@ static void usage()
     );
 }
 
-void print_summary_table(sinsp* inspector,
-						 vector<summary_table_entry>* summary_table,
-						 uint32_t nentries)
-{
-	sinsp_evttables* einfo = inspector->get_event_info_tables();
-
-	cout << "----------------------\n";
-	string tstr = string("Event");
-	tstr.resize(16, ' ');
-	tstr += "#Calls\n";
-	cout << tstr;
-	cout << "----------------------\n";
-
-	sort(summary_table->begin(), summary_table->end(),
-		summary_table_entry_rsort_comparer());
-
-	for(uint32_t j = 0; j < nentries; j++)
-	{
-		summary_table_entry* e = &summary_table->at(j);
-
-		if(e->m_ncalls == 0)
-		{
-			break;
-		}
-
-		if(e->m_is_unsupported_syscall)
-		{
-			tstr = einfo->m_syscall_info_table[e->m_id / 2].name;
-			tstr.resize(16, ' ');
-
-			printf("%s%s%" PRIu64 "\n",
-				(PPME_IS_ENTER(e->m_id))? "> ": "< ",
-				tstr.c_str(),
-				e->m_ncalls);
-		}
-		else
-		{
-			tstr = einfo->m_event_info[e->m_id].name;
-			tstr.resize(16, ' ');
-
-			printf("%s%s%" PRIu64 "\n",
-				(PPME_IS_ENTER(e->m_id))? "> ": "< ",
-				tstr.c_str(),
-				e->m_ncalls);
-		}
-	}
-}
-
 #ifdef HAS_CHISELS
 static void add_chisel_dirs(sinsp* inspector)
 {
@@ -418,7 +405,7 @@ static void chisels_do_timeout(sinsp_evt* ev)
 #endif
 }
 
-void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NULL)
+void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NULL, output_sink* sink = NULL)
 {
 	string line;
 
@@ -427,7 +414,19 @@ void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NU
 	// write any terminating characters
 	if(formatter != NULL && formatter->on_capture_end(&line))
 	{
-		cout << line << endl;
+		if(sink != NULL)
+		{
+			sink->write(line, "\n", 1);
+		}
+		else
+		{
+			cout << line << endl;
+		}
+	}
+
+	if(sink != NULL)
+	{
+		sink->flush();
 	}
 
 	//
@@ -452,17 +451,53 @@ void handle_end_of_file(bool print_progress, sinsp_evt_formatter* formatter = NU
 	}
 }
 
+//
+// Called by the inspector while reading a trace file, when -P is specified
+//
+static void on_read_progress(double progress_pct, void* context)
+{
+	double* last_printed_progress_pct = (double*)context;
+
+	if(progress_pct - *last_printed_progress_pct > 0.1)
+	{
+		fprintf(stderr, "%.2lf\n", progress_pct);
+		fflush(stderr);
+		*last_printed_progress_pct = progress_pct;
+	}
+}
+
+//
+// Removes the progress callback when do_inspect() returns or throws, because
+// its context lives on the do_inspect() stack
+//
+struct progress_callback_remover
+{
+	progress_callback_remover(sinsp* inspector)
+	{
+		m_inspector = inspector;
+	}
+
+	~progress_callback_remover()
+	{
+		m_inspector->set_progress_callback(NULL, NULL, 0);
+	}
+
+	sinsp* m_inspector;
+};
+
 //
 // Event processing loop
 //
 captureinfo do_inspect(sinsp* inspector,
 					   uint64_t cnt,
 					   bool quiet,
-					   bool json,
+					   bool no_newlines,
 					   bool print_progress,
 					   sinsp_filter* display_filter,
-					   vector<summary_table_entry>* summary_table,
-					   sinsp_evt_formatter* formatter)
+					   summary_stats* summary,
+					   uint64_t summary_interval_ns,
+					   sinsp_evt_formatter* formatter,
+					   output_sink* sink)
 {
 	captureinfo retval;
 	int32_t res;
@@ -470,8 +505,17 @@ captureinfo do_inspect(sinsp* inspector,
 	uint64_t ts;
 	uint64_t deltats = 0;
 	uint64_t firstts = 0;
+	uint64_t next_summary_ts = 0;
 	string line;
 	double last_printed_progress_pct = 0;
+	progress_callback_remover progress_remover(inspector);
+
+	if(print_progress)
+	{
+		inspector->set_progress_callback(on_read_progress,
+			&last_printed_progress_pct,
+			ONE_SECOND_IN_NS / 10);
+	}
 
 	//
 	// Loop through the events
@@ -484,7 +528,7 @@ captureinfo do_inspect(sinsp* inspector,
 			// End of capture, either because the user stopped it, or because
 			// we reached the event count specified with -n.
 			//
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			break;
 		}
 
@@ -492,6 +536,8 @@ captureinfo do_inspect(sinsp* inspector,
 
 		if(res == SCAP_TIMEOUT)
 		{
+			sink->on_idle();
+
 			if(ev != NULL && ev->is_filtered_out())
 			{
 				//
@@ -505,7 +551,7 @@ captureinfo do_inspect(sinsp* inspector,
 		}
 		else if(res == SCAP_EOF)
 		{
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			break;
 		}
 		else if(res != SCAP_SUCCESS)
@@ -514,7 +560,7 @@ captureinfo do_inspect(sinsp* inspector,
 			// Event read error.
 			// Notify the chisels that we're exiting, and then die with an error.
 			//
-			handle_end_of_file(print_progress, formatter);
+			handle_end_of_file(print_progress, formatter, sink);
 			cerr << "res = " << res << endl;
 			throw sinsp_exception(inspector->getlasterr().c_str());
 		}
@@ -528,21 +574,6 @@ captureinfo do_inspect(sinsp* inspector,
 		}
 		deltats = ts - firstts;
 
-		if(print_progress)
-		{
-			if(ev->get_num() % 10000 == 0)
-			{
-				double progress_pct = inspector->get_read_progress();
-
-				if(progress_pct - last_printed_progress_pct > 0.1)
-				{
-					fprintf(stderr, "%.2lf\n", progress_pct);
-					fflush(stderr);
-					last_printed_progress_pct = progress_pct;
-				}
-			}
-		}
-
 		//
 		// If there are chisels to run, run them
 		//
@@ -563,25 +594,21 @@ captureinfo do_inspect(sinsp* inspector,
 			//
 			// If we're supposed to summarize, increase the count for this event
 			//
-			if(summary_table != NULL)
+			if(summary != NULL)
 			{
-				uint16_t etype = ev->get_type();
+				summary->process_event(ev);
 
-				if(etype == PPME_GENERIC_E)
-				{
-					sinsp_evt_param *parinfo = ev->get_param(0);
-					uint16_t id = *(int16_t *)parinfo->m_val;
-					((*summary_table)[PPM_EVENT_MAX + id * 2]).m_ncalls++;
-				}
-				else if(etype == PPME_GENERIC_X)
+				if(summary_interval_ns != 0 && ts >= next_summary_ts)
 				{
-					sinsp_evt_param *parinfo = ev->get_param(0);
-					uint16_t id = *(int16_t *)parinfo->m_val;
-					((*summary_table)[PPM_EVENT_MAX + id * 2 + 1]).m_ncalls++;
-				}
-				else
-				{
-					((*summary_table)[etype]).m_ncalls++;
+					if(next_summary_ts != 0)
+					{
+						sink->flush();
+						summary->print(SUMMARY_NEVENTS, SUMMARY_NPROCS);
+						printf("\n");
+						fflush(stdout);
+					}
+
+					next_summary_ts = ts - ts % summary_interval_ns + summary_interval_ns;
 				}
 			}
 
@@ -600,27 +627,30 @@ captureinfo do_inspect(sinsp* inspector,
 				continue;
 			}
 
+			//
+			// Apply the display filter before formatting, so that the
+			// events that are not shown don't pay for it
+			//
+			if(display_filter)
+			{
+				if(!display_filter->run(ev))
+				{
+					continue;
+				}
+			}
+
 			if(formatter->tostring(ev, &line))
 			{
 				//
 				// Output the line
 				//
-				if(display_filter)
-				{
-					if(!display_filter->run(ev))
-					{
-						continue;
-					}
-				}
-
-				cout << line;
-				if(!json)
+				if(!no_newlines)
 				{
-					cout << endl;
+					sink->write(line, "\n", 1);
 				}
 				else
 				{
-					cout << flush;
+					sink->write(line, "", 0);
 				}
 			}
 		}
@@ -647,6 +677,7 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 	bool list_flds = false;
 	bool print_progress = false;
 	bool compress = false;
+	bool unbuffered = false;
 	sinsp_evt::param_fmt event_buffer_format = sinsp_evt::PF_NORMAL;
 	sinsp_filter* display_filter = NULL;
 	double duration = 1;
@@ -657,8 +688,10 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 	int32_t n_filterargs = 0;
 	int cflag = 0;
 	bool jflag = false;
+	bool binflag = false;
 	string cname;
-	vector<summary_table_entry>* summary_table = NULL;
+	summary_stats* summary = NULL;
+	uint64_t summary_interval_ns = 0;
 	string timefmt = "%evt.time";
 
 	// These variables are for the cycle_writer engine
@@ -671,6 +704,7 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 	{
 		{"print-ascii", no_argument, 0, 'A' },
 		{"print-base64", no_argument, 0, 'b' },
+		{"binary", no_argument, 0, 0 },
 #ifdef HAS_CHISELS
 		{"chisel", required_argument, 0, 'c' },
 		{"list-chisels", no_argument, &cflag, 1 },
@@ -689,6 +723,8 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 		{"json", no_argument, 0, 'j' },
 		{"list", no_argument, 0, 'l' },
 		{"list-events", no_argument, 0, 'L' },
+		{"lazy-fds", no_argument, 0, 0 },
+		{"unbuffered", no_argument, 0, 0 },
 		{"numevents", required_argument, 0, 'n' },
 		{"progress", required_argument, 0, 'P' },
 		{"print", required_argument, 0, 'p' },
@@ -696,6 +732,7 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 		{"readfile", required_argument, 0, 'r' },
 		{"snaplen", required_argument, 0, 's' },
 		{"summary", no_argument, 0, 'S' },
+		{"summary-interval", required_argument, 0, 0 },
 		{"timetype", required_argument, 0, 't' },
 		{"verbose", no_argument, 0, 'v' },
 		{"version", no_argument, 0, 0 },
@@ -704,6 +741,7 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 		{"print-hex", no_argument, 0, 'x'},
 		{"print-hex-ascii", no_argument, 0, 'X'},
 		{"compress", no_argument, 0, 'z' },
+		{"compression", required_argument, 0, 0 },
 		{0, 0, 0, 0}
 	};
 
@@ -934,16 +972,9 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 				infiles.push_back(optarg);
 				break;
 			case 'S':
-				summary_table = new vector<summary_table_entry>;
-
-				for(uint32_t j = 0; j < PPM_EVENT_MAX; j++)
-				{
-					summary_table->push_back(summary_table_entry(j, false));
-				}
-
-				for(uint32_t j = 0; j < PPM_SC_MAX * 2; j++)
+				if(summary == NULL)
 				{
-					summary_table->push_back(summary_table_entry(j, true));
+					summary = new summary_stats(inspector);
 				}
 
 				break;
@@ -1033,12 +1064,77 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 				break;
 			}
 
+			//
+			// getopt_long only updates long_index for long options, so
+			// don't look at it for the short ones
+			//
+			if(op != 0)
+			{
+				continue;
+			}
+
 			if(string(long_options[long_index].name) == "version")
 			{
 				printf("sysdig version %s\n", SYSDIG_VERSION);
 				delete inspector;
 				return sysdig_init_res(EXIT_SUCCESS);
 			}
+			else if(string(long_options[long_index].name) == "lazy-fds")
+			{
+				inspector->set_lazy_fds(true);
+			}
+			else if(string(long_options[long_index].name) == "unbuffered")
+			{
+				unbuffered = true;
+			}
+			else if(string(long_options[long_index].name) == "summary-interval")
+			{
+				summary_interval_ns = (uint64_t)(atof(optarg) * ONE_SECOND_IN_NS);
+
+				if(summary_interval_ns == 0)
+				{
+					throw sinsp_exception("invalid summary interval " + string(optarg));
+				}
+
+				if(summary == NULL)
+				{
+					summary = new summary_stats(inspector);
+				}
+			}
+			else if(string(long_options[long_index].name) == "binary")
+			{
+				binflag = true;
+			}
+			else if(string(long_options[long_index].name) == "compression")
+			{
+				string mode(optarg);
+
+				if(mode == "gzip")
+				{
+					inspector->set_compression_mode(SCAP_COMPRESSION_GZIP);
+				}
+				else if(mode == "events")
+				{
+					inspector->set_compression_mode(SCAP_COMPRESSION_EVTCODEC);
+				}
+				else if(mode == "lz")
+				{
+					inspector->set_compression_mode(SCAP_COMPRESSION_LZ);
+				}
+				else
+				{
+					throw sinsp_exception("invalid compression mode " + mode);
+				}
+
+				compress = true;
+			}
+		}
+
+		if(jflag && binflag)
+		{
+			fprintf(stderr, "you cannot specify more than one output format\n");
+			res.m_res = EXIT_FAILURE;
+			goto exit;
 		}
 
 		//
@@ -1145,6 +1241,41 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 		//
 		sinsp_evt_formatter formatter(inspector, output_format);
 
+		if(binflag)
+		{
+			formatter.set_binary_output(true);
+		}
+
+#ifdef HAS_FILTERING
+		//
+		// Let several chisels share the fields they extract from the same
+		// event. With a single consumer the cache only adds copy overhead.
+		//
+		if(g_chisels.size() > 1)
+		{
+			inspector->set_extraction_cache_enabled(true);
+		}
+#endif
+
+		//
+		// When the events are only written to disk, they don't need to go
+		// through the full state engine
+		//
+		if(quiet && outfile != "" && filter.empty() && g_chisels.size() == 0 && summary == NULL)
+		{
+			inspector->set_dump_only_mode(true);
+		}
+
+		//
+		// Create the buffered writer for the event output
+		//
+		output_sink sink(fileno(stdout));
+
+		if(unbuffered)
+		{
+			sink.set_flush_policy(output_sink::FP_LINE);
+		}
+
 		//
 		// Set output buffers len
 		//
@@ -1255,11 +1386,13 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 			cinfo = do_inspect(inspector,
 				cnt,
 				quiet,
-				jflag,
+				jflag || binflag,
 				print_progress,
 				display_filter,
-				summary_table,
-				&formatter);
+				summary,
+				summary_interval_ns,
+				&formatter,
+				&sink);
 
 			duration = ((double)clock()) / CLOCKS_PER_SEC - duration;
 
@@ -1279,8 +1412,14 @@ sysdig_init_res sysdig_init(int argc, char **argv)
 			}
 
 			//
-			// Done. Close the capture.
+			// Done. Write the last events to the trace file, so that a write
+			// error is reported, and close the capture.
 			//
+			if(outfile != "")
+			{
+				inspector->autodump_stop();
+			}
+
 			inspector->close();
 		}
 	}
@@ -1317,9 +1456,10 @@ exit:
 	//
 	// If there's a summary table, sort and print it
 	//
-	if(summary_table != NULL)
+	if(summary != NULL)
 	{
-		print_summary_table(inspector, summary_table, 100);
+		summary->print(SUMMARY_NEVENTS, SUMMARY_NPROCS);
+		delete summary;
 	}
 
 	//